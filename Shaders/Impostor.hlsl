@@ -0,0 +1,89 @@
+//Draws a far away castle as one camera-facing quad, textured with the
+//picture from the impostor atlas taken closest to the current view direction.
+
+Texture2D gImpostorAtlas : register(t0);
+
+SamplerState gsamLinearClamp : register(s0);
+
+cbuffer cbPass : register(b1)
+{
+	float4x4 gView;
+	float4x4 gInvView;
+	float4x4 gProj;
+	float4x4 gInvProj;
+	float4x4 gViewProj;
+	float4x4 gInvViewProj;
+	float3 gEyePosW;
+	float cbPerObjectPad1;
+	float2 gRenderTargetSize;
+	float2 gInvRenderTargetSize;
+	float gNearZ;
+	float gFarZ;
+	float gTotalTime;
+	float gDeltaTime;
+};
+
+cbuffer cbImpostor : register(b2)
+{
+	// World space center and radius of the castle's bounding sphere.
+	float3 gImpostorCenter;
+	float gImpostorHalfSize;
+
+	// Number of pictures around the castle, side by side in the atlas.
+	float gImpostorViewCount;
+
+	// Lowest atlas level filled in so far.
+	float gImpostorMaxMip;
+	float2 cbImpostorPad;
+};
+
+struct VertexOut
+{
+	float4 PosH : SV_POSITION;
+	float2 TexC : TEXCOORD;
+};
+
+VertexOut VS(uint vid : SV_VertexID)
+{
+	VertexOut vout;
+
+	// Two triangles, corners in [-1, 1].
+	const float2 corners[6] =
+	{
+		float2(-1.0f, -1.0f), float2(-1.0f, +1.0f), float2(+1.0f, +1.0f),
+		float2(-1.0f, -1.0f), float2(+1.0f, +1.0f), float2(+1.0f, -1.0f)
+	};
+	float2 corner = corners[vid];
+
+	// Face the camera: span the quad with the camera's right and up axes.
+	float3 right = gInvView[0].xyz;
+	float3 up = gInvView[1].xyz;
+	float3 posW = gImpostorCenter + (corner.x * right + corner.y * up) * gImpostorHalfSize;
+	vout.PosH = mul(float4(posW, 1.0f), gViewProj);
+
+	// The pictures were taken at evenly spaced angles around the castle,
+	// starting from +x.  Pick the one nearest the direction to the eye.
+	float3 toEye = gEyePosW - gImpostorCenter;
+	float angleStep = 6.28318530f / gImpostorViewCount;
+	float tile = round(atan2(toEye.z, toEye.x) / angleStep);
+	tile = tile < 0.0f ? tile + gImpostorViewCount : tile;
+	tile = tile >= gImpostorViewCount ? tile - gImpostorViewCount : tile;
+
+	float2 uv = float2(corner.x * 0.5f + 0.5f, 0.5f - corner.y * 0.5f);
+	vout.TexC = float2((tile + uv.x) / gImpostorViewCount, uv.y);
+
+	return vout;
+}
+
+float4 PS(VertexOut pin) : SV_Target
+{
+	// The levels below the top arrive a few frames after the bake; until
+	// then the clamp keeps the sampler off them.
+	float lod = min(gImpostorAtlas.CalculateLevelOfDetail(gsamLinearClamp, pin.TexC), gImpostorMaxMip);
+	float4 color = gImpostorAtlas.SampleLevel(gsamLinearClamp, pin.TexC, lod);
+
+	// Everything outside the castle's silhouette was cleared to zero alpha.
+	clip(color.a - 0.5f);
+
+	return color;
+}
@@ -1,4 +1,3 @@
-
 struct VertexOut
 {
 	float4 PosH  : SV_POSITION;
@@ -7,5 +6,12 @@ struct VertexOut
 
 float4 PS(VertexOut pin) : SV_Target
 {
+#ifdef ALPHA_TEST
+	// Discard pixel if alpha < 0.1.  We do this test as soon
+	// as possible in the shader so that we can potentially exit the
+	// shader early, thereby skipping the rest of the shader code.
+	clip(pin.Color.a - 0.1f);
+#endif
+
 	return pin.Color;
-}
\ No newline at end of file
+}
@@ -0,0 +1,63 @@
+//Draws CPU simulated particles as camera-facing quads, one instance per
+//particle.  Colors arrive premultiplied by alpha and are blended with
+//ONE, INV_SRC_ALPHA: alpha 0 adds light, alpha 1 covers what is behind.
+
+cbuffer cbPass : register(b1)
+{
+	float4x4 gView;
+	float4x4 gInvView;
+	float4x4 gProj;
+	float4x4 gInvProj;
+	float4x4 gViewProj;
+	float4x4 gInvViewProj;
+	float3 gEyePosW;
+	float cbPerObjectPad1;
+	float2 gRenderTargetSize;
+	float2 gInvRenderTargetSize;
+	float gNearZ;
+	float gFarZ;
+	float gTotalTime;
+	float gDeltaTime;
+};
+
+struct InstanceIn
+{
+	// Center in world space, and half the width of the quad.
+	float4 PosSize : POSITION;
+	float4 Color : COLOR;
+};
+
+struct VertexOut
+{
+	float4 PosH : SV_POSITION;
+	float2 Corner : TEXCOORD;
+	float4 Color : COLOR;
+};
+
+VertexOut VS(InstanceIn iin, uint vid : SV_VertexID)
+{
+	VertexOut vout;
+
+	// Four corners in [-1, 1], in triangle strip order.
+	float2 corner = float2((vid & 1) ? 1.0f : -1.0f, (vid & 2) ? -1.0f : 1.0f);
+
+	// Face the camera: span the quad with the camera's right and up axes.
+	float3 right = gInvView[0].xyz;
+	float3 up = gInvView[1].xyz;
+	float3 posW = iin.PosSize.xyz + (corner.x * right + corner.y * up) * iin.PosSize.w;
+	vout.PosH = mul(float4(posW, 1.0f), gViewProj);
+
+	vout.Corner = corner;
+	vout.Color = iin.Color;
+
+	return vout;
+}
+
+float4 PS(VertexOut pin) : SV_Target
+{
+	// A soft disc.  Scaling all four channels keeps the color premultiplied.
+	float falloff = saturate(1.0f - dot(pin.Corner, pin.Corner));
+	clip(falloff - 0.004f);
+
+	return pin.Color * falloff;
+}
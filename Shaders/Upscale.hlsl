@@ -0,0 +1,38 @@
+//Stretches the scene color, rendered at the dynamic internal resolution into
+//the top-left corner of the offscreen target, over the whole back buffer.
+
+Texture2D gSceneColor : register(t0);
+
+SamplerState gsamLinearClamp : register(s0);
+
+cbuffer cbUpscale : register(b2)
+{
+	// Size of the rendered corner relative to the whole target.
+	float2 gUVScale;
+
+	// Largest UV that keeps the bilinear footprint inside the corner.
+	float2 gUVClamp;
+};
+
+struct VertexOut
+{
+	float4 PosH : SV_POSITION;
+	float2 TexC : TEXCOORD;
+};
+
+VertexOut VS(uint vid : SV_VertexID)
+{
+	VertexOut vout;
+
+	// One triangle that covers the screen: (0,0), (2,0), (0,2) in UV space.
+	vout.TexC = float2((vid << 1) & 2, vid & 2);
+	vout.PosH = float4(vout.TexC.x * 2.0f - 1.0f, 1.0f - vout.TexC.y * 2.0f, 0.0f, 1.0f);
+
+	return vout;
+}
+
+float4 PS(VertexOut pin) : SV_Target
+{
+	float2 uv = min(pin.TexC * gUVScale, gUVClamp);
+	return gSceneColor.Sample(gsamLinearClamp, uv);
+}
@@ -29,27 +29,119 @@ cbuffer cbPass : register(b1)
 
 struct VertexIn
 {
-	float3 PosL  : POSITION;
-	float4 Color : COLOR;
+	float3 PosL     : POSITION;
+	float4 Color    : COLOR;
+	float2 NormalL  : NORMAL;  // octahedral, R16G16_SNORM
+	float2 TangentL : TANGENT; // octahedral, R16G16_SNORM
 };
 
+// Unit vector from its octahedral encoding (PackUnitVector on the CPU).
+float3 DecodeOctahedral(float2 e)
+{
+	float3 v = float3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-v.z);
+	v.xy += v.xy >= 0.0f ? -t : t;
+	return normalize(v);
+}
+
+// Normals go through the inverse transpose of world's upper 3x3.  That is
+// its cofactor matrix over its determinant, and the cofactors are cross
+// products of its rows, so non-uniformly scaled objects need no second
+// matrix.  The determinant only matters for its sign.
+float3 TransformNormal(float3 n, float4x4 world)
+{
+	float3 r0 = world[0].xyz;
+	float3 r1 = world[1].xyz;
+	float3 r2 = world[2].xyz;
+	float3 c0 = cross(r1, r2);
+	float3 c1 = cross(r2, r0);
+	float3 c2 = cross(r0, r1);
+	float3 normal = normalize(n.x * c0 + n.y * c1 + n.z * c2);
+	return dot(r0, c0) < 0.0f ? -normal : normal;
+}
+
+#ifdef VERTEX_PULLING
+// Vertex pulling: no input layout.  Each vertex is fetched from the shared
+// buffers by SV_VertexID, through the current draw's offsets.
+ByteAddressBuffer gVertices : register(t1); // Vertex: float3 Pos, float4 Color, uint Normal, uint Tangent
+ByteAddressBuffer gIndices  : register(t2); // 32-bit indices
+ByteAddressBuffer gObjects  : register(t3); // ObjectConstants, 256 bytes apart
+
+cbuffer cbDraw : register(b3)
+{
+	uint gObjectIndex;
+	uint gFirstIndex;
+	int  gBaseVertex;
+};
+
+static const uint VertexStride = 36;
+static const uint ObjectStride = 256;
+
+VertexIn FetchVertex(uint vertexId)
+{
+	uint index = gIndices.Load((gFirstIndex + vertexId) * 4);
+	uint address = (uint)((int)index + gBaseVertex) * VertexStride;
+
+	VertexIn vin;
+	vin.PosL = asfloat(gVertices.Load3(address));
+	vin.Color = asfloat(gVertices.Load4(address + 12));
+
+	// Sign extend each 16-bit half and read it as the input assembler reads
+	// SNORM: -32768 clamps to -1.
+	uint2 frame = gVertices.Load2(address + 28);
+	int4 halves = int4(frame.x << 16, frame.x, frame.y << 16, frame.y) >> 16;
+	float4 snorm = max(float4(halves) / 32767.0f, -1.0f);
+	vin.NormalL = snorm.xy;
+	vin.TangentL = snorm.zw;
+	return vin;
+}
+
+// gWorld as the cbuffer would see it.  The CPU stores it transposed, so
+// the four rows read back are its columns.
+float4x4 FetchWorld()
+{
+	uint address = gObjectIndex * ObjectStride;
+	float4x4 worldT = float4x4(
+		asfloat(gObjects.Load4(address)),
+		asfloat(gObjects.Load4(address + 16)),
+		asfloat(gObjects.Load4(address + 32)),
+		asfloat(gObjects.Load4(address + 48)));
+	return transpose(worldT);
+}
+#endif
+
 struct VertexOut
 {
-	float4 PosH  : SV_POSITION;
-	float4 Color : COLOR;
+	float4 PosH     : SV_POSITION;
+	float4 Color    : COLOR;
+	float3 NormalW  : NORMAL;
+	float3 TangentW : TANGENT;
 };
 
+#ifdef VERTEX_PULLING
+VertexOut VS(uint vertexId : SV_VertexID)
+{
+	VertexIn vin = FetchVertex(vertexId);
+	float4x4 world = FetchWorld();
+#else
 VertexOut VS(VertexIn vin)
 {
+	float4x4 world = gWorld;
+#endif
 	VertexOut vout;
 
 	////step14
 	// Transform to homogeneous clip space.
-	float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+	float4 posW = mul(float4(vin.PosL, 1.0f), world);
 	vout.PosH = mul(posW, gViewProj);
 
 	// Just pass vertex color into the pixel shader.
 	vout.Color = vin.Color;
 
+	// The frame for lighting.  Tangents move with the surface, like
+	// positions.
+	vout.NormalW = TransformNormal(DecodeOctahedral(vin.NormalL), world);
+	vout.TangentW = normalize(mul(DecodeOctahedral(vin.TangentL), (float3x3)world));
+
 	return vout;
 }
@@ -0,0 +1,835 @@
+#include "BCnEncoder.h"
+#include "DDSFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BCN_ENCODER_SSE2 1
+#endif
+
+namespace
+{
+	// A block's texels, one row of 16 per channel, so four texels at a time
+	// fill a SIMD register.
+	struct BlockTexels
+	{
+		alignas(16) float C[4][16];
+	};
+
+	void LoadBlock(const std::uint8_t* rgba, BlockTexels& texels)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+				texels.C[c][i] = rgba[i * 4 + c];
+		}
+	}
+
+	// Picks for each texel the nearest of count palette entries, comparing
+	// channels [first, first + channels).  Returns the summed squared error.
+	float ChooseIndices(const BlockTexels& texels, const float (*palette)[4], int count,
+		int first, int channels, std::uint8_t* indices)
+	{
+		float total = 0.0f;
+#if BCN_ENCODER_SSE2
+		for (int g = 0; g < 16; g += 4)
+		{
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128 bestIndex = _mm_setzero_ps();
+			for (int p = 0; p < count; ++p)
+			{
+				__m128 err = _mm_setzero_ps();
+				for (int c = first; c < first + channels; ++c)
+				{
+					__m128 d = _mm_sub_ps(_mm_load_ps(&texels.C[c][g]), _mm_set1_ps(palette[p][c]));
+					err = _mm_add_ps(err, _mm_mul_ps(d, d));
+				}
+
+				__m128 less = _mm_cmplt_ps(err, best);
+				best = _mm_min_ps(err, best);
+				bestIndex = _mm_or_ps(_mm_and_ps(less, _mm_set1_ps((float)p)), _mm_andnot_ps(less, bestIndex));
+			}
+
+			alignas(16) float errors[4];
+			alignas(16) float index[4];
+			_mm_store_ps(errors, best);
+			_mm_store_ps(index, bestIndex);
+			for (int k = 0; k < 4; ++k)
+			{
+				total += errors[k];
+				indices[g + k] = (std::uint8_t)index[k];
+			}
+		}
+#else
+		for (int i = 0; i < 16; ++i)
+		{
+			float best = FLT_MAX;
+			for (int p = 0; p < count; ++p)
+			{
+				float err = 0.0f;
+				for (int c = first; c < first + channels; ++c)
+				{
+					float d = texels.C[c][i] - palette[p][c];
+					err += d * d;
+				}
+				if (err < best)
+				{
+					best = err;
+					indices[i] = (std::uint8_t)p;
+				}
+			}
+			total += best;
+		}
+#endif
+		return total;
+	}
+
+	float Clamp255(float v)
+	{
+		return (std::min)((std::max)(v, 0.0f), 255.0f);
+	}
+
+	// Corners of the block's bounding box, pulled in by a sixteenth of its
+	// size so the interpolated entries land on more of the texels.  Of the
+	// box's diagonals, the one taken runs the way each channel moves with
+	// the widest one, so a block fading from red to blue is not fitted with
+	// a black to magenta line.
+	void BoundingBoxEndpoints(const BlockTexels& texels, int first, int channels, float* e0, float* e1)
+	{
+		float mean[4] = {};
+		int widest = first;
+		for (int c = first; c < first + channels; ++c)
+		{
+			float lo = texels.C[c][0];
+			float hi = texels.C[c][0];
+			for (int i = 0; i < 16; ++i)
+			{
+				lo = (std::min)(lo, texels.C[c][i]);
+				hi = (std::max)(hi, texels.C[c][i]);
+				mean[c] += texels.C[c][i];
+			}
+			mean[c] /= 16.0f;
+
+			float inset = (hi - lo) / 16.0f;
+			e0[c] = lo + inset;
+			e1[c] = hi - inset;
+			if (e1[c] - e0[c] > e1[widest] - e0[widest])
+				widest = c;
+		}
+
+		for (int c = first; c < first + channels; ++c)
+		{
+			float covariance = 0.0f;
+			for (int i = 0; i < 16; ++i)
+				covariance += (texels.C[c][i] - mean[c]) * (texels.C[widest][i] - mean[widest]);
+			if (covariance < 0.0f)
+				std::swap(e0[c], e1[c]);
+		}
+	}
+
+	// The segment of the line through the texels' mean along their principal
+	// axis (found by power iteration on the covariance) that spans them.
+	void PrincipalEndpoints(const BlockTexels& texels, int first, int channels, float* e0, float* e1)
+	{
+		float mean[4] = {};
+		for (int c = first; c < first + channels; ++c)
+		{
+			for (int i = 0; i < 16; ++i)
+				mean[c] += texels.C[c][i];
+			mean[c] /= 16.0f;
+		}
+
+		float cov[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int a = first; a < first + channels; ++a)
+			{
+				for (int b = first; b < first + channels; ++b)
+					cov[a][b] += (texels.C[a][i] - mean[a]) * (texels.C[b][i] - mean[b]);
+			}
+		}
+
+		// Start from the channel that varies most.
+		float axis[4] = {};
+		int widest = first;
+		for (int c = first; c < first + channels; ++c)
+		{
+			if (cov[c][c] > cov[widest][widest])
+				widest = c;
+		}
+		axis[widest] = 1.0f;
+
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float largest = 0.0f;
+			for (int a = first; a < first + channels; ++a)
+			{
+				for (int b = first; b < first + channels; ++b)
+					next[a] += cov[a][b] * axis[b];
+				largest = (std::max)(largest, std::fabs(next[a]));
+			}
+			if (largest < 1e-6f)
+				break;
+			for (int c = first; c < first + channels; ++c)
+				axis[c] = next[c] / largest;
+		}
+
+		float length = 0.0f;
+		for (int c = first; c < first + channels; ++c)
+			length += axis[c] * axis[c];
+		length = std::sqrt(length);
+
+		float lo = 0.0f;
+		float hi = 0.0f;
+		if (length > 1e-6f)
+		{
+			for (int c = first; c < first + channels; ++c)
+				axis[c] /= length;
+
+			lo = FLT_MAX;
+			hi = -FLT_MAX;
+			for (int i = 0; i < 16; ++i)
+			{
+				float t = 0.0f;
+				for (int c = first; c < first + channels; ++c)
+					t += (texels.C[c][i] - mean[c]) * axis[c];
+				lo = (std::min)(lo, t);
+				hi = (std::max)(hi, t);
+			}
+		}
+
+		for (int c = first; c < first + channels; ++c)
+		{
+			e0[c] = Clamp255(mean[c] + axis[c] * lo);
+			e1[c] = Clamp255(mean[c] + axis[c] * hi);
+		}
+	}
+
+	// The endpoints with the least squared error for fixed indices, where
+	// index i blends weights[i] of the way from e0 to e1.  False when every
+	// texel uses the same blend, which leaves the endpoints undetermined.
+	bool FitToIndices(const BlockTexels& texels, int first, int channels, const std::uint8_t* indices,
+		const float* weights, float* e0, float* e1)
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			float b = weights[indices[i]];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = first; c < first + channels; ++c)
+			{
+				ax[c] += a * texels.C[c][i];
+				bx[c] += b * texels.C[c][i];
+			}
+		}
+
+		float det = aa * bb - ab * ab;
+		if (std::fabs(det) < 1e-6f)
+			return false;
+
+		for (int c = first; c < first + channels; ++c)
+		{
+			e0[c] = Clamp255((bb * ax[c] - ab * bx[c]) / det);
+			e1[c] = Clamp255((aa * bx[c] - ab * ax[c]) / det);
+		}
+		return true;
+	}
+
+	//
+	// BC1 color block, also the color half of BC3.  Only the four color mode
+	// is written, since BC3 decodes its color block that way regardless.
+	//
+
+	const float BC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	struct ColorBlock
+	{
+		std::uint16_t C0 = 0;
+		std::uint16_t C1 = 0;
+		std::uint8_t Indices[16] = {};
+		float Error = FLT_MAX;
+	};
+
+	std::uint16_t To565(const float* c)
+	{
+		int r = (int)(c[0] * 31.0f / 255.0f + 0.5f);
+		int g = (int)(c[1] * 63.0f / 255.0f + 0.5f);
+		int b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+		return (std::uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void From565(std::uint16_t v, float* c)
+	{
+		int r = (v >> 11) & 31;
+		int g = (v >> 5) & 63;
+		int b = v & 31;
+		c[0] = (float)((r << 3) | (r >> 2));
+		c[1] = (float)((g << 2) | (g >> 4));
+		c[2] = (float)((b << 3) | (b >> 2));
+		c[3] = 255.0f;
+	}
+
+	void EvaluateColor(const BlockTexels& texels, std::uint16_t c0, std::uint16_t c1, ColorBlock& result)
+	{
+		float palette[4][4];
+		From565(c0, palette[0]);
+		From565(c1, palette[1]);
+		for (int c = 0; c < 4; ++c)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+
+		result.C0 = c0;
+		result.C1 = c1;
+		result.Error = ChooseIndices(texels, palette, 4, 0, 3, result.Indices);
+	}
+
+	void EncodeColorBlock(const BlockTexels& texels, std::uint8_t* block, BCQuality quality)
+	{
+		float e0[4] = {};
+		float e1[4] = {};
+		if (quality == BCQuality::Fast)
+			BoundingBoxEndpoints(texels, 0, 3, e0, e1);
+		else
+			PrincipalEndpoints(texels, 0, 3, e0, e1);
+
+		ColorBlock best;
+		EvaluateColor(texels, To565(e0), To565(e1), best);
+
+		int refinements = quality == BCQuality::Fast ? 0 : quality == BCQuality::Normal ? 1 : 3;
+		for (int r = 0; r < refinements; ++r)
+		{
+			if (!FitToIndices(texels, 0, 3, best.Indices, BC1Weights, e0, e1))
+				break;
+
+			ColorBlock trial;
+			EvaluateColor(texels, To565(e0), To565(e1), trial);
+			if (trial.Error >= best.Error)
+				break;
+			best = trial;
+		}
+
+		// Step each channel of each endpoint by one while that helps.
+		if (quality == BCQuality::High)
+		{
+			const int shifts[3] = { 11, 5, 0 };
+			const int masks[3] = { 31, 63, 31 };
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				bool improved = false;
+				for (int endpoint = 0; endpoint < 2; ++endpoint)
+				{
+					for (int c = 0; c < 3; ++c)
+					{
+						for (int delta = -1; delta <= 1; delta += 2)
+						{
+							std::uint16_t color = endpoint == 0 ? best.C0 : best.C1;
+							int value = ((color >> shifts[c]) & masks[c]) + delta;
+							if (value < 0 || value > masks[c])
+								continue;
+							color = (std::uint16_t)((color & ~(masks[c] << shifts[c])) | (value << shifts[c]));
+
+							ColorBlock trial;
+							EvaluateColor(texels, endpoint == 0 ? color : best.C0, endpoint == 1 ? color : best.C1, trial);
+							if (trial.Error < best.Error)
+							{
+								best = trial;
+								improved = true;
+							}
+						}
+					}
+				}
+				if (!improved)
+					break;
+			}
+		}
+
+		// Four color mode needs C0 > C1.  Swapping the endpoints swaps index
+		// 0 with 1 and 2 with 3.  Equal endpoints only decode right through
+		// index 0.
+		if (best.C0 < best.C1)
+		{
+			std::swap(best.C0, best.C1);
+			for (auto& index : best.Indices)
+				index ^= 1;
+		}
+		else if (best.C0 == best.C1)
+		{
+			std::memset(best.Indices, 0, sizeof(best.Indices));
+		}
+
+		block[0] = (std::uint8_t)(best.C0 & 0xff);
+		block[1] = (std::uint8_t)(best.C0 >> 8);
+		block[2] = (std::uint8_t)(best.C1 & 0xff);
+		block[3] = (std::uint8_t)(best.C1 >> 8);
+		for (int row = 0; row < 4; ++row)
+		{
+			const std::uint8_t* index = &best.Indices[row * 4];
+			block[4 + row] = (std::uint8_t)(index[0] | (index[1] << 2) | (index[2] << 4) | (index[3] << 6));
+		}
+	}
+
+	//
+	// BC3 alpha block: two 8-bit endpoints and a 3-bit index per texel.  A0
+	// greater than A1 interpolates eight values, otherwise six plus exact 0
+	// and 255.
+	//
+
+	float EvaluateAlpha(const BlockTexels& texels, int a0, int a1, std::uint8_t* indices)
+	{
+		float palette[8][4] = {};
+		palette[0][3] = (float)a0;
+		palette[1][3] = (float)a1;
+		if (a0 > a1)
+		{
+			for (int i = 1; i < 7; ++i)
+				palette[i + 1][3] = ((7 - i) * a0 + i * a1) / 7.0f;
+		}
+		else
+		{
+			for (int i = 1; i < 5; ++i)
+				palette[i + 1][3] = ((5 - i) * a0 + i * a1) / 5.0f;
+			palette[6][3] = 0.0f;
+			palette[7][3] = 255.0f;
+		}
+
+		return ChooseIndices(texels, palette, 8, 3, 1, indices);
+	}
+
+	void EncodeAlphaBlock(const BlockTexels& texels, std::uint8_t* block, BCQuality quality)
+	{
+		int lo = 255;
+		int hi = 0;
+		int lo6 = 255;
+		int hi6 = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			int a = (int)texels.C[3][i];
+			lo = (std::min)(lo, a);
+			hi = (std::max)(hi, a);
+
+			// Six value mode gets 0 and 255 for free, so its endpoints only
+			// need to span the other alphas.
+			if (a != 0 && a != 255)
+			{
+				lo6 = (std::min)(lo6, a);
+				hi6 = (std::max)(hi6, a);
+			}
+		}
+
+		int bestA0 = hi;
+		int bestA1 = lo;
+		std::uint8_t bestIndices[16] = {};
+		float bestError = 0.0f;
+		if (hi > lo)
+		{
+			bestError = EvaluateAlpha(texels, hi, lo, bestIndices);
+
+			std::uint8_t indices[16];
+			if (quality != BCQuality::Fast)
+			{
+				if (lo6 > hi6)
+				{
+					lo6 = 0;
+					hi6 = 255;
+				}
+				float error = EvaluateAlpha(texels, lo6, hi6, indices);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestA0 = lo6;
+					bestA1 = hi6;
+					std::memcpy(bestIndices, indices, sizeof(indices));
+				}
+			}
+
+			// Pulling the eight value endpoints in a little can put the
+			// interpolated values closer to the texels.
+			if (quality == BCQuality::High)
+			{
+				for (int a0 = hi; a0 >= hi - 3; --a0)
+				{
+					for (int a1 = lo; a1 <= lo + 3 && a1 < a0; ++a1)
+					{
+						float error = EvaluateAlpha(texels, a0, a1, indices);
+						if (error < bestError)
+						{
+							bestError = error;
+							bestA0 = a0;
+							bestA1 = a1;
+							std::memcpy(bestIndices, indices, sizeof(indices));
+						}
+					}
+				}
+			}
+		}
+
+		block[0] = (std::uint8_t)bestA0;
+		block[1] = (std::uint8_t)bestA1;
+
+		std::uint64_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= (std::uint64_t)bestIndices[i] << (3 * i);
+		for (int i = 0; i < 6; ++i)
+			block[2 + i] = (std::uint8_t)(bits >> (8 * i));
+	}
+
+	//
+	// BC7 mode 6: one subset, RGBA endpoints of 7 bits per channel plus a
+	// shared low bit (p-bit) per endpoint, and 4-bit indices.
+	//
+
+	const int BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Mode6Endpoint
+	{
+		int C[4] = {};
+		int P = 0;
+	};
+
+	struct Mode6Block
+	{
+		Mode6Endpoint E0;
+		Mode6Endpoint E1;
+		std::uint8_t Indices[16] = {};
+		float Error = FLT_MAX;
+	};
+
+	Mode6Endpoint QuantizeMode6(const float* e, int p)
+	{
+		Mode6Endpoint result;
+		result.P = p;
+		for (int c = 0; c < 4; ++c)
+			result.C[c] = (std::min)((std::max)((int)((e[c] - p) * 0.5f + 0.5f), 0), 127);
+		return result;
+	}
+
+	void EvaluateMode6(const BlockTexels& texels, const Mode6Endpoint& e0, const Mode6Endpoint& e1, Mode6Block& result)
+	{
+		float palette[16][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			int a = (e0.C[c] << 1) | e0.P;
+			int b = (e1.C[c] << 1) | e1.P;
+			for (int i = 0; i < 16; ++i)
+				palette[i][c] = (float)(((64 - BC7Weights4[i]) * a + BC7Weights4[i] * b + 32) >> 6);
+		}
+
+		result.E0 = e0;
+		result.E1 = e1;
+		result.Error = ChooseIndices(texels, palette, 16, 0, 4, result.Indices);
+	}
+
+	// Quantizes continuous endpoints.  Fast picks each endpoint's p-bit by
+	// its own rounding error; the other presets try all four pairs.
+	void QuantizeAndEvaluateMode6(const BlockTexels& texels, const float* e0, const float* e1,
+		BCQuality quality, Mode6Block& result)
+	{
+		if (quality == BCQuality::Fast)
+		{
+			Mode6Endpoint best[2];
+			const float* e[2] = { e0, e1 };
+			for (int endpoint = 0; endpoint < 2; ++endpoint)
+			{
+				float bestError = FLT_MAX;
+				for (int p = 0; p < 2; ++p)
+				{
+					Mode6Endpoint q = QuantizeMode6(e[endpoint], p);
+					float error = 0.0f;
+					for (int c = 0; c < 4; ++c)
+					{
+						float d = e[endpoint][c] - (float)((q.C[c] << 1) | p);
+						error += d * d;
+					}
+					if (error < bestError)
+					{
+						bestError = error;
+						best[endpoint] = q;
+					}
+				}
+			}
+			EvaluateMode6(texels, best[0], best[1], result);
+			return;
+		}
+
+		result.Error = FLT_MAX;
+		for (int p = 0; p < 4; ++p)
+		{
+			Mode6Block trial;
+			EvaluateMode6(texels, QuantizeMode6(e0, p & 1), QuantizeMode6(e1, p >> 1), trial);
+			if (trial.Error < result.Error)
+				result = trial;
+		}
+	}
+
+	// Packs fields into a 128-bit block, least significant bit first.
+	struct BitWriter
+	{
+		std::uint64_t Bits[2] = {};
+		int Position = 0;
+
+		void Put(std::uint32_t value, int count)
+		{
+			for (int i = 0; i < count; ++i, ++Position)
+			{
+				if ((value >> i) & 1)
+					Bits[Position >> 6] |= 1ull << (Position & 63);
+			}
+		}
+
+		void Store(std::uint8_t* block)const
+		{
+			for (int i = 0; i < 16; ++i)
+				block[i] = (std::uint8_t)(Bits[i >> 3] >> (8 * (i & 7)));
+		}
+	};
+
+	void EncodeMode6Block(const BlockTexels& texels, std::uint8_t* block, BCQuality quality)
+	{
+		float e0[4] = {};
+		float e1[4] = {};
+		if (quality == BCQuality::Fast)
+			BoundingBoxEndpoints(texels, 0, 4, e0, e1);
+		else
+			PrincipalEndpoints(texels, 0, 4, e0, e1);
+
+		Mode6Block best;
+		QuantizeAndEvaluateMode6(texels, e0, e1, quality, best);
+
+		float weights[16];
+		for (int i = 0; i < 16; ++i)
+			weights[i] = BC7Weights4[i] / 64.0f;
+
+		int refinements = quality == BCQuality::Fast ? 0 : quality == BCQuality::Normal ? 1 : 3;
+		for (int r = 0; r < refinements; ++r)
+		{
+			if (!FitToIndices(texels, 0, 4, best.Indices, weights, e0, e1))
+				break;
+
+			Mode6Block trial;
+			QuantizeAndEvaluateMode6(texels, e0, e1, quality, trial);
+			if (trial.Error >= best.Error)
+				break;
+			best = trial;
+		}
+
+		if (quality == BCQuality::High)
+		{
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				bool improved = false;
+				for (int endpoint = 0; endpoint < 2; ++endpoint)
+				{
+					for (int c = 0; c < 4; ++c)
+					{
+						for (int delta = -1; delta <= 1; delta += 2)
+						{
+							Mode6Endpoint a = best.E0;
+							Mode6Endpoint b = best.E1;
+							Mode6Endpoint& e = endpoint == 0 ? a : b;
+							e.C[c] += delta;
+							if (e.C[c] < 0 || e.C[c] > 127)
+								continue;
+
+							Mode6Block trial;
+							EvaluateMode6(texels, a, b, trial);
+							if (trial.Error < best.Error)
+							{
+								best = trial;
+								improved = true;
+							}
+						}
+					}
+				}
+				if (!improved)
+					break;
+			}
+		}
+
+		// The first texel's index is stored without its top bit, which must
+		// therefore be clear; swapping the endpoints mirrors every index.
+		if (best.Indices[0] >= 8)
+		{
+			std::swap(best.E0, best.E1);
+			for (auto& index : best.Indices)
+				index = (std::uint8_t)(15 - index);
+		}
+
+		BitWriter writer;
+		writer.Put(1 << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			writer.Put(best.E0.C[c], 7);
+			writer.Put(best.E1.C[c], 7);
+		}
+		writer.Put(best.E0.P, 1);
+		writer.Put(best.E1.P, 1);
+		writer.Put(best.Indices[0], 3);
+		for (int i = 1; i < 16; ++i)
+			writer.Put(best.Indices[i], 4);
+		writer.Store(block);
+	}
+}
+
+std::uint32_t BCBlockBytes(BCFormat format)
+{
+	return format == BCFormat::BC1 ? 8 : 16;
+}
+
+void EncodeBC1Block(const std::uint8_t* rgba, std::uint8_t* block, BCQuality quality)
+{
+	BlockTexels texels;
+	LoadBlock(rgba, texels);
+	EncodeColorBlock(texels, block, quality);
+}
+
+void EncodeBC3Block(const std::uint8_t* rgba, std::uint8_t* block, BCQuality quality)
+{
+	BlockTexels texels;
+	LoadBlock(rgba, texels);
+	EncodeAlphaBlock(texels, block, quality);
+	EncodeColorBlock(texels, block + 8, quality);
+}
+
+void EncodeBC7Block(const std::uint8_t* rgba, std::uint8_t* block, BCQuality quality)
+{
+	BlockTexels texels;
+	LoadBlock(rgba, texels);
+	EncodeMode6Block(texels, block, quality);
+}
+
+std::vector<std::uint8_t> CompressImage(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height,
+	std::size_t rowPitch, BCFormat format, BCQuality quality, ThreadPool& pool)
+{
+	std::uint32_t blocksWide = (width + 3) / 4;
+	std::uint32_t blocksHigh = (height + 3) / 4;
+	std::uint32_t blockBytes = BCBlockBytes(format);
+
+	std::vector<std::uint8_t> result((std::size_t)blocksWide * blocksHigh * blockBytes);
+
+	// Blocks are independent; each job takes one row of them.
+	pool.ParallelFor(blocksHigh, 1, [&](std::size_t by)
+	{
+		std::uint8_t texels[64];
+		for (std::uint32_t bx = 0; bx < blocksWide; ++bx)
+		{
+			for (std::uint32_t y = 0; y < 4; ++y)
+			{
+				std::size_t sy = (std::min)((std::uint32_t)by * 4 + y, height - 1);
+				for (std::uint32_t x = 0; x < 4; ++x)
+				{
+					std::size_t sx = (std::min)(bx * 4 + x, width - 1);
+					std::memcpy(&texels[(y * 4 + x) * 4], rgba + sy * rowPitch + sx * 4, 4);
+				}
+			}
+
+			std::uint8_t* block = result.data() + (by * blocksWide + bx) * blockBytes;
+			switch (format)
+			{
+			case BCFormat::BC1:
+				EncodeBC1Block(texels, block, quality);
+				break;
+			case BCFormat::BC3:
+				EncodeBC3Block(texels, block, quality);
+				break;
+			case BCFormat::BC7:
+				EncodeBC7Block(texels, block, quality);
+				break;
+			}
+		}
+	});
+
+	return result;
+}
+
+bool CompressDDS(const std::vector<std::uint8_t>& source, BCFormat format, BCQuality quality,
+	ThreadPool& pool, std::vector<std::uint8_t>& result, std::string* error)
+{
+	DDSImage image;
+	if (!ParseDDS(source.data(), source.size(), image, error))
+		return false;
+
+	bool bgra = false;
+	bool srgb = false;
+	bool opaque = false;
+	switch (image.Format)
+	{
+	case DDSFormat::R8G8B8A8Unorm:
+		break;
+	case DDSFormat::R8G8B8A8UnormSrgb:
+		srgb = true;
+		break;
+	case DDSFormat::B8G8R8A8Unorm:
+		bgra = true;
+		break;
+	case DDSFormat::B8G8R8X8Unorm:
+		bgra = true;
+		opaque = true;
+		break;
+	case DDSFormat::B8G8R8A8UnormSrgb:
+		bgra = true;
+		srgb = true;
+		break;
+	default:
+		if (error != nullptr)
+			*error = "source must hold 8-bit RGBA or BGRA texels";
+		return false;
+	}
+
+	DDSImage compressed = image;
+	compressed.Mips.clear();
+	switch (format)
+	{
+	case BCFormat::BC1:
+		compressed.Format = srgb ? DDSFormat::BC1UnormSrgb : DDSFormat::BC1Unorm;
+		break;
+	case BCFormat::BC3:
+		compressed.Format = srgb ? DDSFormat::BC3UnormSrgb : DDSFormat::BC3Unorm;
+		break;
+	case BCFormat::BC7:
+		compressed.Format = srgb ? DDSFormat::BC7UnormSrgb : DDSFormat::BC7Unorm;
+		break;
+	}
+
+	result.clear();
+	WriteDDSHeader(compressed, result);
+
+	// The levels are listed in file order, which is the order they are
+	// written in.
+	std::vector<std::uint8_t> rgba;
+	for (auto& level : image.Mips)
+	{
+		rgba.resize((std::size_t)level.Width * level.Height * 4);
+		for (std::uint32_t y = 0; y < level.Height; ++y)
+		{
+			const std::uint8_t* src = source.data() + level.Offset + y * level.RowPitch;
+			std::uint8_t* dst = rgba.data() + (std::size_t)y * level.Width * 4;
+			for (std::uint32_t x = 0; x < level.Width; ++x, src += 4, dst += 4)
+			{
+				dst[0] = bgra ? src[2] : src[0];
+				dst[1] = src[1];
+				dst[2] = bgra ? src[0] : src[2];
+				dst[3] = opaque ? 255 : src[3];
+			}
+		}
+
+		auto blocks = CompressImage(rgba.data(), level.Width, level.Height, (std::size_t)level.Width * 4, format, quality, pool);
+		result.insert(result.end(), blocks.begin(), blocks.end());
+	}
+
+	return true;
+}
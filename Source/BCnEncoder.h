@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+enum class BCFormat
+{
+	BC1,
+	BC3,
+	BC7
+};
+
+// How hard the encoder looks for endpoints.
+// - Fast: the block's bounding box.
+// - Normal: the block's principal axis, refined once by least squares.
+// - High: Normal refined further, then a greedy nudge of each endpoint.
+enum class BCQuality
+{
+	Fast,
+	Normal,
+	High
+};
+
+std::uint32_t BCBlockBytes(BCFormat format);
+
+// Encodes one 4x4 block of RGBA8 texels given row by row (64 bytes) into
+// BCBlockBytes bytes.  BC1 ignores alpha; BC7 uses mode 6 only (one
+// subset, RGBA with per-endpoint p-bits and 4-bit indices).
+void EncodeBC1Block(const std::uint8_t* rgba, std::uint8_t* block, BCQuality quality);
+void EncodeBC3Block(const std::uint8_t* rgba, std::uint8_t* block, BCQuality quality);
+void EncodeBC7Block(const std::uint8_t* rgba, std::uint8_t* block, BCQuality quality);
+
+// Compresses a width x height RGBA8 image (rowPitch bytes per row) into
+// rows of blocks, spreading the rows of blocks across pool.  Partial blocks
+// at the right and bottom edges repeat the last column and row.
+std::vector<std::uint8_t> CompressImage(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height,
+	std::size_t rowPitch, BCFormat format, BCQuality quality, ThreadPool& pool);
+
+// Converts a DDS file of 8-bit RGBA or BGRA texels into a DDS file of the
+// given block format, keeping its mips, array slices and sRGB-ness.
+// DDSTextureLoader reads the result.  On failure returns false and
+// describes why in error.
+bool CompressDDS(const std::vector<std::uint8_t>& source, BCFormat format, BCQuality quality,
+	ThreadPool& pool, std::vector<std::uint8_t>& result, std::string* error = nullptr);
@@ -0,0 +1,58 @@
+#include "BundleCache.h"
+
+BundleCache::BundleCache(ID3D12Device* device, UINT frameCount)
+	: mDevice(device), mEntries(frameCount)
+{
+}
+
+BundleCache::~BundleCache()
+{
+}
+
+ID3D12GraphicsCommandList* BundleCache::Get(UINT frameIndex, const void* owner, ID3D12PipelineState* pso,
+	const std::function<void(ID3D12GraphicsCommandList*)>& record)
+{
+	auto& entries = mEntries[frameIndex];
+	auto it = entries.find(Key(owner, pso));
+	if (it != entries.end())
+	{
+		mHits++;
+		return it->second.Bundle.Get();
+	}
+
+	// Each bundle gets its own allocator, freed with it.
+	Entry& entry = entries[Key(owner, pso)];
+	ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE,
+		IID_PPV_ARGS(entry.Allocator.GetAddressOf())));
+	ThrowIfFailed(mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE,
+		entry.Allocator.Get(), pso, IID_PPV_ARGS(entry.Bundle.GetAddressOf())));
+
+	record(entry.Bundle.Get());
+	ThrowIfFailed(entry.Bundle->Close());
+
+	mRecords++;
+
+	return entry.Bundle.Get();
+}
+
+void BundleCache::Clear()
+{
+	for (auto& entries : mEntries)
+		entries.clear();
+}
+
+UINT BundleCache::Hits()const
+{
+	return mHits;
+}
+
+UINT BundleCache::Records()const
+{
+	return mRecords;
+}
+
+void BundleCache::ResetStats()
+{
+	mHits = 0;
+	mRecords = 0;
+}
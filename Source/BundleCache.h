@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+
+#include <functional>
+#include <map>
+#include <utility>
+
+// Prerecorded bundles for draw sequences that repeat from frame to frame.
+// Each bundle is cached under the object whose draws it holds and the PSO
+// it starts with, separately per frame resource (the recorded descriptor
+// tables point at that frame's constant buffers), and recorded once.
+//
+// A bundle bakes in the root signature, the descriptor heap layout and the
+// geometry it draws.  Whoever rebuilds any of those, or changes what an
+// owner draws, must Clear the cache.
+class BundleCache
+{
+public:
+	BundleCache(ID3D12Device* device, UINT frameCount);
+	BundleCache(const BundleCache& rhs) = delete;
+	BundleCache& operator=(const BundleCache& rhs) = delete;
+	~BundleCache();
+
+	// Returns the bundle for owner's draws with pso, recording it with record
+	// first if it is missing.  The bundle starts with pso bound.  Only call
+	// this for the current frame resource, once the GPU is done with it.
+	ID3D12GraphicsCommandList* Get(UINT frameIndex, const void* owner, ID3D12PipelineState* pso,
+		const std::function<void(ID3D12GraphicsCommandList*)>& record);
+
+	// Drops every bundle.  The GPU must be idle.
+	void Clear();
+
+	// Bundles reused and recorded since the last ResetStats.
+	UINT Hits()const;
+	UINT Records()const;
+	void ResetStats();
+
+private:
+	struct Entry
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> Bundle;
+	};
+
+	typedef std::pair<const void*, ID3D12PipelineState*> Key;
+
+	ID3D12Device* mDevice = nullptr;
+	std::vector<std::map<Key, Entry>> mEntries;
+
+	UINT mHits = 0;
+	UINT mRecords = 0;
+};
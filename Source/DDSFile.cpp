@@ -0,0 +1,393 @@
+#include "DDSFile.h"
+
+#include <cstring>
+
+namespace
+{
+	const std::uint32_t DDSMagic = 0x20534444; // "DDS "
+
+	// Header flags and caps.
+	const std::uint32_t DDSD_CAPS = 0x1;
+	const std::uint32_t DDSD_HEIGHT = 0x2;
+	const std::uint32_t DDSD_WIDTH = 0x4;
+	const std::uint32_t DDSD_PITCH = 0x8;
+	const std::uint32_t DDSD_PIXELFORMAT = 0x1000;
+	const std::uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const std::uint32_t DDSD_LINEARSIZE = 0x80000;
+	const std::uint32_t DDSD_DEPTH = 0x800000;
+	const std::uint32_t DDSCAPS_COMPLEX = 0x8;
+	const std::uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const std::uint32_t DDSCAPS_MIPMAP = 0x400000;
+	const std::uint32_t DDSCAPS2_CUBEMAP = 0x200;
+	const std::uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0xfc00;
+	const std::uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+	// Pixel format flags.
+	const std::uint32_t DDPF_ALPHAPIXELS = 0x1;
+	const std::uint32_t DDPF_FOURCC = 0x4;
+	const std::uint32_t DDPF_RGB = 0x40;
+	const std::uint32_t DDPF_LUMINANCE = 0x20000;
+
+	// DX10 header.
+	const std::uint32_t ResourceDimensionTexture2D = 3;
+	const std::uint32_t ResourceMiscTextureCube = 0x4;
+
+	struct PixelFormat
+	{
+		std::uint32_t Size;
+		std::uint32_t Flags;
+		std::uint32_t FourCC;
+		std::uint32_t RGBBitCount;
+		std::uint32_t RBitMask;
+		std::uint32_t GBitMask;
+		std::uint32_t BBitMask;
+		std::uint32_t ABitMask;
+	};
+
+	struct Header
+	{
+		std::uint32_t Size;
+		std::uint32_t Flags;
+		std::uint32_t Height;
+		std::uint32_t Width;
+		std::uint32_t PitchOrLinearSize;
+		std::uint32_t Depth;
+		std::uint32_t MipMapCount;
+		std::uint32_t Reserved1[11];
+		PixelFormat Format;
+		std::uint32_t Caps;
+		std::uint32_t Caps2;
+		std::uint32_t Caps3;
+		std::uint32_t Caps4;
+		std::uint32_t Reserved2;
+	};
+
+	struct HeaderDX10
+	{
+		std::uint32_t Format;
+		std::uint32_t ResourceDimension;
+		std::uint32_t MiscFlag;
+		std::uint32_t ArraySize;
+		std::uint32_t MiscFlags2;
+	};
+
+	static_assert(sizeof(Header) == 124, "DDS header layout");
+	static_assert(sizeof(HeaderDX10) == 20, "DDS DX10 header layout");
+
+	std::uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return (std::uint32_t)(std::uint8_t)a | ((std::uint32_t)(std::uint8_t)b << 8) |
+			((std::uint32_t)(std::uint8_t)c << 16) | ((std::uint32_t)(std::uint8_t)d << 24);
+	}
+
+	bool Fail(std::string* error, const char* message)
+	{
+		if (error != nullptr)
+			*error = message;
+		return false;
+	}
+
+	// a + b and a * b into result, or false if the result does not fit.
+	bool CheckedAdd(std::uint64_t a, std::uint64_t b, std::uint64_t& result)
+	{
+		if (a > UINT64_MAX - b)
+			return false;
+		result = a + b;
+		return true;
+	}
+
+	bool CheckedMul(std::uint64_t a, std::uint64_t b, std::uint64_t& result)
+	{
+		if (a != 0 && b > UINT64_MAX / a)
+			return false;
+		result = a * b;
+		return true;
+	}
+
+	// Legacy (pre-DX10) pixel formats that map onto a DXGI format.
+	std::uint32_t LegacyFormat(const PixelFormat& pf)
+	{
+		if (pf.Flags & DDPF_FOURCC)
+		{
+			if (pf.FourCC == MakeFourCC('D', 'X', 'T', '1')) return DDSFormat::BC1Unorm;
+			if (pf.FourCC == MakeFourCC('D', 'X', 'T', '2')) return DDSFormat::BC2Unorm;
+			if (pf.FourCC == MakeFourCC('D', 'X', 'T', '3')) return DDSFormat::BC2Unorm;
+			if (pf.FourCC == MakeFourCC('D', 'X', 'T', '4')) return DDSFormat::BC3Unorm;
+			if (pf.FourCC == MakeFourCC('D', 'X', 'T', '5')) return DDSFormat::BC3Unorm;
+			if (pf.FourCC == MakeFourCC('A', 'T', 'I', '1')) return DDSFormat::BC4Unorm;
+			if (pf.FourCC == MakeFourCC('B', 'C', '4', 'U')) return DDSFormat::BC4Unorm;
+			if (pf.FourCC == MakeFourCC('B', 'C', '4', 'S')) return DDSFormat::BC4Snorm;
+			if (pf.FourCC == MakeFourCC('A', 'T', 'I', '2')) return DDSFormat::BC5Unorm;
+			if (pf.FourCC == MakeFourCC('B', 'C', '5', 'U')) return DDSFormat::BC5Unorm;
+			if (pf.FourCC == MakeFourCC('B', 'C', '5', 'S')) return DDSFormat::BC5Snorm;
+
+			// D3DFMT_A16B16G16R16F and D3DFMT_A32B32G32R32F.
+			if (pf.FourCC == 113) return DDSFormat::R16G16B16A16Float;
+			if (pf.FourCC == 116) return DDSFormat::R32G32B32A32Float;
+			return DDSFormat::Unknown;
+		}
+
+		if (pf.Flags & DDPF_RGB)
+		{
+			if (pf.RGBBitCount == 32)
+			{
+				if (pf.RBitMask == 0x000000ff && pf.GBitMask == 0x0000ff00 && pf.BBitMask == 0x00ff0000)
+					return DDSFormat::R8G8B8A8Unorm;
+				if (pf.RBitMask == 0x00ff0000 && pf.GBitMask == 0x0000ff00 && pf.BBitMask == 0x000000ff)
+					return (pf.Flags & DDPF_ALPHAPIXELS) ? DDSFormat::B8G8R8A8Unorm : DDSFormat::B8G8R8X8Unorm;
+				if (pf.RBitMask == 0x000003ff && pf.GBitMask == 0x000ffc00 && pf.BBitMask == 0x3ff00000)
+					return DDSFormat::R10G10B10A2Unorm;
+			}
+			return DDSFormat::Unknown;
+		}
+
+		if (pf.Flags & DDPF_LUMINANCE)
+		{
+			if (pf.RGBBitCount == 8 && pf.RBitMask == 0xff)
+				return DDSFormat::R8Unorm;
+			if (pf.RGBBitCount == 16 && pf.RBitMask == 0x00ff && pf.ABitMask == 0xff00)
+				return DDSFormat::R8G8Unorm;
+		}
+
+		return DDSFormat::Unknown;
+	}
+}
+
+bool DDSFormatInfo(std::uint32_t format, std::uint32_t& blockBytes, std::uint32_t& blockSize)
+{
+	blockSize = 1;
+	switch (format)
+	{
+	case DDSFormat::R32G32B32A32Float:
+		blockBytes = 16;
+		return true;
+	case DDSFormat::R16G16B16A16Float:
+		blockBytes = 8;
+		return true;
+	case DDSFormat::R10G10B10A2Unorm:
+	case DDSFormat::R8G8B8A8Unorm:
+	case DDSFormat::R8G8B8A8UnormSrgb:
+	case DDSFormat::B8G8R8A8Unorm:
+	case DDSFormat::B8G8R8X8Unorm:
+	case DDSFormat::B8G8R8A8UnormSrgb:
+		blockBytes = 4;
+		return true;
+	case DDSFormat::R8G8Unorm:
+		blockBytes = 2;
+		return true;
+	case DDSFormat::R8Unorm:
+		blockBytes = 1;
+		return true;
+	case DDSFormat::BC1Unorm:
+	case DDSFormat::BC1UnormSrgb:
+	case DDSFormat::BC4Unorm:
+	case DDSFormat::BC4Snorm:
+		blockBytes = 8;
+		blockSize = 4;
+		return true;
+	case DDSFormat::BC2Unorm:
+	case DDSFormat::BC2UnormSrgb:
+	case DDSFormat::BC3Unorm:
+	case DDSFormat::BC3UnormSrgb:
+	case DDSFormat::BC5Unorm:
+	case DDSFormat::BC5Snorm:
+	case DDSFormat::BC6HUF16:
+	case DDSFormat::BC6HSF16:
+	case DDSFormat::BC7Unorm:
+	case DDSFormat::BC7UnormSrgb:
+		blockBytes = 16;
+		blockSize = 4;
+		return true;
+	default:
+		blockBytes = 0;
+		return false;
+	}
+}
+
+bool ParseDDS(const std::uint8_t* data, std::size_t size, DDSImage& image, std::string* error)
+{
+	image = DDSImage();
+
+	std::uint32_t magic = 0;
+	if (data == nullptr || size < sizeof(magic) + sizeof(Header))
+		return Fail(error, "file is too small for a DDS header");
+	std::memcpy(&magic, data, sizeof(magic));
+	if (magic != DDSMagic)
+		return Fail(error, "not a DDS file");
+
+	Header header;
+	std::memcpy(&header, data + sizeof(magic), sizeof(Header));
+	if (header.Size != sizeof(Header) || header.Format.Size != sizeof(PixelFormat))
+		return Fail(error, "bad DDS header size");
+
+	std::uint64_t offset = sizeof(magic) + sizeof(Header);
+
+	image.Width = header.Width;
+	image.Height = header.Height;
+	image.MipCount = (header.Flags & DDSD_MIPMAPCOUNT) && header.MipMapCount > 0 ? header.MipMapCount : 1;
+	image.ArraySize = 1;
+
+	if (header.Format.Flags & DDPF_FOURCC && header.Format.FourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		if (size < offset + sizeof(HeaderDX10))
+			return Fail(error, "file is too small for a DX10 header");
+
+		HeaderDX10 dx10;
+		std::memcpy(&dx10, data + offset, sizeof(HeaderDX10));
+		offset += sizeof(HeaderDX10);
+
+		if (dx10.ResourceDimension != ResourceDimensionTexture2D)
+			return Fail(error, "only 2D textures are supported");
+
+		image.Format = dx10.Format;
+		image.ArraySize = dx10.ArraySize > 0 ? dx10.ArraySize : 1;
+		if (dx10.MiscFlag & ResourceMiscTextureCube)
+		{
+			if (image.ArraySize > UINT32_MAX / 6)
+				return Fail(error, "too many cube maps");
+			image.IsCubeMap = true;
+			image.ArraySize *= 6;
+		}
+	}
+	else
+	{
+		if ((header.Flags & DDSD_DEPTH) || (header.Caps2 & DDSCAPS2_VOLUME))
+			return Fail(error, "volume textures are not supported");
+
+		image.Format = LegacyFormat(header.Format);
+		if (header.Caps2 & DDSCAPS2_CUBEMAP)
+		{
+			image.IsCubeMap = true;
+			image.ArraySize = 6;
+		}
+	}
+
+	std::uint32_t blockBytes = 0;
+	std::uint32_t blockSize = 1;
+	if (!DDSFormatInfo(image.Format, blockBytes, blockSize))
+		return Fail(error, "unsupported pixel format");
+
+	if (image.Width == 0 || image.Height == 0)
+		return Fail(error, "texture has no texels");
+
+	// A full chain ends at 1x1; more levels than that is a broken file.
+	std::uint32_t maxMips = 1;
+	for (std::uint32_t extent = image.Width > image.Height ? image.Width : image.Height; extent > 1; extent >>= 1)
+		maxMips++;
+	if (image.MipCount > maxMips)
+		return Fail(error, "more mip levels than the texture size allows");
+
+	// Size the whole chain before allocating anything for it, so a header
+	// with absurd dimensions or array size fails here rather than asking for
+	// more memory than the file could ever describe.
+	std::uint64_t sliceBytes = 0;
+	std::uint32_t width = image.Width;
+	std::uint32_t height = image.Height;
+	for (std::uint32_t mip = 0; mip < image.MipCount; ++mip)
+	{
+		std::uint64_t rowPitch = (std::uint64_t)((width - 1) / blockSize + 1) * blockBytes;
+		std::uint64_t mipBytes = 0;
+		if (!CheckedMul(rowPitch, (height - 1) / blockSize + 1, mipBytes) ||
+			!CheckedAdd(sliceBytes, mipBytes, sliceBytes))
+			return Fail(error, "texture is too large");
+
+		width = width > 1 ? width >> 1 : 1;
+		height = height > 1 ? height >> 1 : 1;
+	}
+
+	std::uint64_t end = 0;
+	if (!CheckedMul(sliceBytes, image.ArraySize, end) || !CheckedAdd(offset, end, end))
+		return Fail(error, "texture is too large");
+	if (end > size)
+		return Fail(error, "file is truncated");
+
+	image.Mips.resize((std::size_t)image.ArraySize * image.MipCount);
+	for (std::uint32_t slice = 0; slice < image.ArraySize; ++slice)
+	{
+		width = image.Width;
+		height = image.Height;
+		for (std::uint32_t mip = 0; mip < image.MipCount; ++mip)
+		{
+			DDSMipLevel& level = image.Mips[(std::size_t)slice * image.MipCount + mip];
+			level.Width = width;
+			level.Height = height;
+			level.RowPitch = (std::uint64_t)((width - 1) / blockSize + 1) * blockBytes;
+			level.RowCount = (height - 1) / blockSize + 1;
+			level.SizeInBytes = level.RowPitch * level.RowCount;
+			level.Offset = offset;
+			offset += level.SizeInBytes;
+
+			width = width > 1 ? width >> 1 : 1;
+			height = height > 1 ? height >> 1 : 1;
+		}
+	}
+
+	return true;
+}
+
+void WriteDDSHeader(const DDSImage& image, std::vector<std::uint8_t>& out)
+{
+	std::uint32_t blockBytes = 0;
+	std::uint32_t blockSize = 1;
+	DDSFormatInfo(image.Format, blockBytes, blockSize);
+
+	Header header = {};
+	header.Size = sizeof(Header);
+	header.Flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+	header.Height = image.Height;
+	header.Width = image.Width;
+	header.MipMapCount = image.MipCount;
+	header.Caps = DDSCAPS_TEXTURE;
+	if (image.MipCount > 1)
+		header.Caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	if (image.IsCubeMap)
+	{
+		header.Caps |= DDSCAPS_COMPLEX;
+		header.Caps2 = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+	}
+
+	// Compressed formats record the size of the top mip, others its pitch.
+	std::uint64_t topRowPitch = (std::uint64_t)((image.Width + blockSize - 1) / blockSize) * blockBytes;
+	if (blockSize > 1)
+	{
+		header.Flags |= DDSD_LINEARSIZE;
+		header.PitchOrLinearSize = (std::uint32_t)(topRowPitch * ((image.Height + blockSize - 1) / blockSize));
+	}
+	else
+	{
+		header.Flags |= DDSD_PITCH;
+		header.PitchOrLinearSize = (std::uint32_t)topRowPitch;
+	}
+
+	header.Format.Size = sizeof(PixelFormat);
+	header.Format.Flags = DDPF_FOURCC;
+
+	bool legacy = image.ArraySize == (image.IsCubeMap ? 6u : 1u);
+	if (legacy && image.Format == DDSFormat::BC1Unorm)
+		header.Format.FourCC = MakeFourCC('D', 'X', 'T', '1');
+	else if (legacy && image.Format == DDSFormat::BC2Unorm)
+		header.Format.FourCC = MakeFourCC('D', 'X', 'T', '3');
+	else if (legacy && image.Format == DDSFormat::BC3Unorm)
+		header.Format.FourCC = MakeFourCC('D', 'X', 'T', '5');
+	else
+		header.Format.FourCC = MakeFourCC('D', 'X', '1', '0');
+
+	std::size_t start = out.size();
+	std::uint32_t magic = DDSMagic;
+	out.resize(start + sizeof(magic) + sizeof(Header));
+	std::memcpy(out.data() + start, &magic, sizeof(magic));
+	std::memcpy(out.data() + start + sizeof(magic), &header, sizeof(Header));
+
+	if (header.Format.FourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		HeaderDX10 dx10 = {};
+		dx10.Format = image.Format;
+		dx10.ResourceDimension = ResourceDimensionTexture2D;
+		dx10.MiscFlag = image.IsCubeMap ? ResourceMiscTextureCube : 0;
+		dx10.ArraySize = image.IsCubeMap ? image.ArraySize / 6 : image.ArraySize;
+
+		start = out.size();
+		out.resize(start + sizeof(HeaderDX10));
+		std::memcpy(out.data() + start, &dx10, sizeof(HeaderDX10));
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// DXGI_FORMAT values of the formats ParseDDS understands.  Plain numbers so
+// the parser builds without the DXGI headers; they cast straight to
+// DXGI_FORMAT.
+namespace DDSFormat
+{
+	const std::uint32_t Unknown = 0;
+	const std::uint32_t R32G32B32A32Float = 2;
+	const std::uint32_t R16G16B16A16Float = 10;
+	const std::uint32_t R10G10B10A2Unorm = 24;
+	const std::uint32_t R8G8B8A8Unorm = 28;
+	const std::uint32_t R8G8B8A8UnormSrgb = 29;
+	const std::uint32_t R8G8Unorm = 49;
+	const std::uint32_t R8Unorm = 61;
+	const std::uint32_t BC1Unorm = 71;
+	const std::uint32_t BC1UnormSrgb = 72;
+	const std::uint32_t BC2Unorm = 74;
+	const std::uint32_t BC2UnormSrgb = 75;
+	const std::uint32_t BC3Unorm = 77;
+	const std::uint32_t BC3UnormSrgb = 78;
+	const std::uint32_t BC4Unorm = 80;
+	const std::uint32_t BC4Snorm = 81;
+	const std::uint32_t BC5Unorm = 83;
+	const std::uint32_t BC5Snorm = 84;
+	const std::uint32_t B8G8R8A8Unorm = 87;
+	const std::uint32_t B8G8R8X8Unorm = 88;
+	const std::uint32_t B8G8R8A8UnormSrgb = 91;
+	const std::uint32_t BC6HUF16 = 95;
+	const std::uint32_t BC6HSF16 = 96;
+	const std::uint32_t BC7Unorm = 98;
+	const std::uint32_t BC7UnormSrgb = 99;
+}
+
+// Storage of a format: bytes per block, and the block edge in texels (4
+// for block compressed formats, 1 otherwise).  False if unsupported.
+bool DDSFormatInfo(std::uint32_t format, std::uint32_t& blockBytes, std::uint32_t& blockSize);
+
+// Where one mip level of one array slice lives in the file, and how its
+// rows of blocks are laid out there (tightly packed).
+struct DDSMipLevel
+{
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+
+	std::uint64_t RowPitch = 0;
+	std::uint32_t RowCount = 0;
+	std::uint64_t SizeInBytes = 0;
+
+	std::uint64_t Offset = 0;
+};
+
+// A 2D texture (or texture array) described by a DDS file.  Mips holds
+// ArraySize * MipCount levels, slice-major, as they are stored in the file.
+struct DDSImage
+{
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+	std::uint32_t MipCount = 0;
+	std::uint32_t ArraySize = 0;
+	std::uint32_t Format = DDSFormat::Unknown;
+	bool IsCubeMap = false;
+
+	std::vector<DDSMipLevel> Mips;
+
+	const DDSMipLevel& Mip(std::uint32_t slice, std::uint32_t mip)const
+	{
+		return Mips[slice * MipCount + mip];
+	}
+};
+
+// Reads the header of a DDS file held in memory and lays out its mip
+// chain.  Volume textures and formats without a DXGI equivalent are
+// rejected.  On failure returns false and describes why in error.
+bool ParseDDS(const std::uint8_t* data, std::size_t size, DDSImage& image, std::string* error = nullptr);
+
+// Appends the magic number and header(s) describing image to out; the
+// caller appends the mips in the order image.Mips lists them.  BC1-BC3 2D
+// textures get a legacy FourCC header, everything else a DX10 header.
+void WriteDDSHeader(const DDSImage& image, std::vector<std::uint8_t>& out);
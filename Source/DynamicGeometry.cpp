@@ -0,0 +1,127 @@
+#include "DynamicGeometry.h"
+
+#include <algorithm>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Spans start 16 byte aligned, more than any vertex or index format
+	// needs, so whole SIMD stores line up with them.
+	const UINT64 SpanAlignment = 16;
+
+	// Grown buffers are rounded up to this.
+	const UINT64 GrowGranularity = 64 * 1024;
+
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+DynamicGeometryBuffer::DynamicGeometryBuffer(ID3D12Device* device, UINT64 byteSize)
+	: mDevice(device)
+{
+	CreateBuffer((std::max)(AlignUp(byteSize, SpanAlignment), SpanAlignment));
+}
+
+DynamicGeometryBuffer::~DynamicGeometryBuffer()
+{
+	if (mBuffer != nullptr)
+		mBuffer->Unmap(0, nullptr);
+}
+
+void DynamicGeometryBuffer::Reset()
+{
+	mRetired.clear();
+	mOffset = 0;
+
+	mLastFrameBytes = mFrameBytes;
+	mFrameBytes = 0;
+}
+
+DynamicVertexSpan DynamicGeometryBuffer::AllocateVertices(UINT count, UINT stride)
+{
+	DynamicVertexSpan span;
+	UINT64 byteSize = (UINT64)count * stride;
+	span.View.BufferLocation = Allocate(byteSize, &span.Data);
+	span.View.StrideInBytes = stride;
+	span.View.SizeInBytes = (UINT)byteSize;
+	return span;
+}
+
+DynamicIndexSpan DynamicGeometryBuffer::AllocateIndices(UINT count, DXGI_FORMAT format)
+{
+	DynamicIndexSpan span;
+	UINT64 byteSize = (UINT64)count * (format == DXGI_FORMAT_R16_UINT ? 2 : 4);
+	span.View.BufferLocation = Allocate(byteSize, &span.Data);
+	span.View.Format = format;
+	span.View.SizeInBytes = (UINT)byteSize;
+	return span;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS DynamicGeometryBuffer::Allocate(UINT64 byteSize, void** data)
+{
+	UINT64 alignedSize = AlignUp(byteSize, SpanAlignment);
+	if (mOffset + alignedSize > mCapacity)
+	{
+		// The spans already handed out stay where they are, still mapped, as
+		// their data may not be written yet; the rest of the frame, and
+		// every frame after it, uses the new buffer.
+		mRetired.push_back(mBuffer);
+		CreateBuffer(AlignUp((std::max)(mCapacity * 2, mFrameBytes + alignedSize), GrowGranularity));
+		mGrowCount++;
+	}
+
+	UINT64 offset = mOffset;
+	mOffset += alignedSize;
+	mFrameBytes += alignedSize;
+	mPeakFrameBytes = (std::max)(mPeakFrameBytes, mFrameBytes);
+
+	*data = mMappedData + offset;
+	return mBuffer->GetGPUVirtualAddress() + offset;
+}
+
+void DynamicGeometryBuffer::CreateBuffer(UINT64 byteSize)
+{
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mBuffer)));
+
+	// Upload heaps can stay mapped while the GPU reads them; the CPU only
+	// ever writes.
+	D3D12_RANGE readRange = { 0, 0 };
+	ThrowIfFailed(mBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mMappedData)));
+
+	mCapacity = byteSize;
+	mOffset = 0;
+}
+
+UINT64 DynamicGeometryBuffer::Capacity()const
+{
+	return mCapacity;
+}
+
+UINT64 DynamicGeometryBuffer::UsedBytes()const
+{
+	return mFrameBytes;
+}
+
+UINT64 DynamicGeometryBuffer::LastFrameBytes()const
+{
+	return mLastFrameBytes;
+}
+
+UINT64 DynamicGeometryBuffer::PeakFrameBytes()const
+{
+	return mPeakFrameBytes;
+}
+
+UINT DynamicGeometryBuffer::GrowCount()const
+{
+	return mGrowCount;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+
+// Vertices written by the CPU for one frame, and the view to draw them.
+struct DynamicVertexSpan
+{
+	void* Data = nullptr;
+	D3D12_VERTEX_BUFFER_VIEW View = {};
+};
+
+struct DynamicIndexSpan
+{
+	void* Data = nullptr;
+	D3D12_INDEX_BUFFER_VIEW View = {};
+};
+
+// Geometry that changes every frame (particles, debug lines, waves), handed
+// out in spans from one persistently mapped upload buffer.  Each frame
+// resource owns one, so together they form a ring: a frame's spans stay
+// untouched while the GPU reads them and are reclaimed all at once by
+// Reset, when the frame resource comes round again and its fence has
+// completed.
+//
+// A frame that asks for more than fits moves to a buffer twice the size
+// (or large enough for the frame so far), so the next frames fit.  The old
+// buffer still holds spans this frame's commands use, so it is only
+// released at the next Reset.
+class DynamicGeometryBuffer
+{
+public:
+	DynamicGeometryBuffer(ID3D12Device* device, UINT64 byteSize);
+	DynamicGeometryBuffer(const DynamicGeometryBuffer& rhs) = delete;
+	DynamicGeometryBuffer& operator=(const DynamicGeometryBuffer& rhs) = delete;
+	~DynamicGeometryBuffer();
+
+	// Reclaims every span.  Only call this once the GPU is done with the
+	// frame that used them.
+	void Reset();
+
+	// Room for count vertices of stride bytes, or count indices of format
+	// (DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT).  The memory is
+	// write-combined: write it in order and do not read it back.
+	DynamicVertexSpan AllocateVertices(UINT count, UINT stride);
+	DynamicIndexSpan AllocateIndices(UINT count, DXGI_FORMAT format);
+
+	UINT64 Capacity()const;
+
+	// Bytes handed out since the last Reset, in the frame before it, and
+	// in the busiest frame so far, and how many times the buffer grew.
+	UINT64 UsedBytes()const;
+	UINT64 LastFrameBytes()const;
+	UINT64 PeakFrameBytes()const;
+	UINT GrowCount()const;
+
+private:
+	// Aligned space for byteSize bytes, growing first if it does not fit.
+	D3D12_GPU_VIRTUAL_ADDRESS Allocate(UINT64 byteSize, void** data);
+	void CreateBuffer(UINT64 byteSize);
+
+private:
+	ID3D12Device* mDevice = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mBuffer = nullptr;
+	BYTE* mMappedData = nullptr;
+	UINT64 mCapacity = 0;
+	UINT64 mOffset = 0;
+
+	// Buffers outgrown this frame, kept until the GPU is done with it.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mRetired;
+
+	UINT64 mFrameBytes = 0;
+	UINT64 mLastFrameBytes = 0;
+	UINT64 mPeakFrameBytes = 0;
+	UINT mGrowCount = 0;
+};
@@ -0,0 +1,76 @@
+#include "DynamicResolution.h"
+
+#include <cmath>
+
+DynamicResolution::DynamicResolution(float targetFrameMs, float minScale, float maxScale)
+	: mTargetFrameMs(targetFrameMs), mMinScale(minScale), mMaxScale(maxScale), mScale(maxScale)
+{
+}
+
+void DynamicResolution::SetTargetFrameMs(float targetFrameMs)
+{
+	mTargetFrameMs = targetFrameMs;
+}
+
+float DynamicResolution::TargetFrameMs()const
+{
+	return mTargetFrameMs;
+}
+
+float DynamicResolution::Update(float frameMs)
+{
+	if (frameMs <= 0.0f || mTargetFrameMs <= 0.0f)
+		return mScale;
+
+	// Smooth out single slow frames before they reach the controller.
+	mFilteredMs = mFilteredMs == 0.0f ? frameMs : mFilteredMs + 0.2f * (frameMs - mFilteredMs);
+
+	// Positive error means headroom, so the scale can go up.
+	float error = (mTargetFrameMs - mFilteredMs) / mTargetFrameMs;
+
+	// The derivative sees the raw error, so crossing the deadband edge does
+	// not kick it.
+	float derivative = error - mPrevError;
+	mPrevError = error;
+
+	if (fabsf(error) < mDeadband)
+		error = 0.0f;
+
+	// Positional form: the scale is worked out from full resolution each
+	// frame, and the integral alone holds it below that at steady state.
+	// The integral is frozen inside the deadband, and while the output is
+	// pinned against a limit in the direction the error pushes, so it does
+	// not wind up there.
+	float scale = mMaxScale + mKp * error + mKi * mIntegral + mKd * derivative;
+	bool pinned = (scale >= mMaxScale && error > 0.0f) || (scale <= mMinScale && error < 0.0f);
+	if (!pinned)
+		mIntegral += error;
+
+	scale = mMaxScale + mKp * error + mKi * mIntegral + mKd * derivative;
+	mScale = scale < mMinScale ? mMinScale : (scale > mMaxScale ? mMaxScale : scale);
+	return mScale;
+}
+
+void DynamicResolution::Reset()
+{
+	mFilteredMs = 0.0f;
+	mIntegral = 0.0f;
+	mPrevError = 0.0f;
+	mScale = mMaxScale;
+}
+
+float DynamicResolution::Scale()const
+{
+	return mScale;
+}
+
+void DynamicResolution::ScaledSize(int outputWidth, int outputHeight, int& width, int& height)const
+{
+	width = (int)(outputWidth * mScale);
+	height = (int)(outputHeight * mScale);
+
+	if (width < 1)
+		width = 1;
+	if (height < 1)
+		height = 1;
+}
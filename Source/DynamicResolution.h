@@ -0,0 +1,46 @@
+#pragma once
+
+// Picks the render scale for the next frame from measured GPU frame times.
+// A PID controller works on the relative headroom against the target frame
+// time, so the gains do not depend on the target itself.  The scale applies
+// to both axes; the pixel count goes with its square.
+class DynamicResolution
+{
+public:
+	DynamicResolution(float targetFrameMs, float minScale = 0.5f, float maxScale = 1.0f);
+
+	void SetTargetFrameMs(float targetFrameMs);
+	float TargetFrameMs()const;
+
+	// Feeds one measured frame and returns the scale to render the next frame at.
+	float Update(float frameMs);
+
+	// Drops the controller state and goes back to full resolution.
+	void Reset();
+
+	float Scale()const;
+
+	// Internal resolution for a given output size at the current scale.
+	// Never less than one pixel.
+	void ScaledSize(int outputWidth, int outputHeight, int& width, int& height)const;
+
+private:
+	float mTargetFrameMs = 16.6f;
+	float mMinScale = 0.5f;
+	float mMaxScale = 1.0f;
+
+	float mKp = 0.12f;
+	float mKi = 0.05f;
+	float mKd = 0.04f;
+
+	// Ignore errors smaller than this, so the scale does not hunt around the
+	// target from frame time noise.
+	float mDeadband = 0.03f;
+
+	// Low-pass filtered frame time fed to the controller.
+	float mFilteredMs = 0.0f;
+
+	float mIntegral = 0.0f;
+	float mPrevError = 0.0f;
+	float mScale = 1.0f;
+};
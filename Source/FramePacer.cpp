@@ -0,0 +1,292 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_WIN32)
+#include <windows.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+#include <errno.h>
+#include <time.h>
+#endif
+
+#if defined(_WIN32)
+
+namespace
+{
+	// Waitable timers are not shareable between threads that wait at the
+	// same time, so each thread gets its own.  The high resolution flag needs
+	// Windows 10 1803; older systems fall back to a regular timer and a
+	// longer spin.
+	struct ThreadTimer
+	{
+		ThreadTimer()
+		{
+			Handle = CreateWaitableTimerExW(nullptr, nullptr,
+				CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+			HighResolution = Handle != nullptr;
+			if (Handle == nullptr)
+				Handle = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+		}
+
+		~ThreadTimer()
+		{
+			if (Handle != nullptr)
+				CloseHandle(Handle);
+		}
+
+		HANDLE Handle = nullptr;
+		bool HighResolution = false;
+	};
+
+	ThreadTimer& GetThreadTimer()
+	{
+		thread_local ThreadTimer timer;
+		return timer;
+	}
+}
+
+std::int64_t PacerClock::Now()
+{
+	static LARGE_INTEGER frequency = []()
+	{
+		LARGE_INTEGER f;
+		QueryPerformanceFrequency(&f);
+		return f;
+	}();
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	// Split the conversion to avoid overflowing 64 bits.
+	std::int64_t seconds = counter.QuadPart / frequency.QuadPart;
+	std::int64_t remainder = counter.QuadPart % frequency.QuadPart;
+	return seconds * 1000000000LL + remainder * 1000000000LL / frequency.QuadPart;
+}
+
+void PacerClock::Sleep(std::int64_t ns)
+{
+	if (ns <= 0)
+		return;
+
+	ThreadTimer& timer = GetThreadTimer();
+	if (timer.Handle == nullptr)
+	{
+		::Sleep((DWORD)(ns / 1000000));
+		return;
+	}
+
+	// Negative due time is relative, in 100 ns units.
+	LARGE_INTEGER dueTime;
+	dueTime.QuadPart = -(ns / 100);
+	if (SetWaitableTimerEx(timer.Handle, &dueTime, 0, nullptr, nullptr, nullptr, 0))
+		WaitForSingleObject(timer.Handle, INFINITE);
+}
+
+std::int64_t PacerClock::SpinThreshold()
+{
+	return GetThreadTimer().HighResolution ? 1000000 : 2000000;
+}
+
+#else
+
+std::int64_t PacerClock::Now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (std::int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void PacerClock::Sleep(std::int64_t ns)
+{
+	if (ns <= 0)
+		return;
+
+	timespec ts;
+	ts.tv_sec = (time_t)(ns / 1000000000LL);
+	ts.tv_nsec = (long)(ns % 1000000000LL);
+	// A signal cuts the sleep short and leaves what is left in ts.  Any
+	// other failure would fail again; the caller spins out the rest.
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+	{
+	}
+}
+
+std::int64_t PacerClock::SpinThreshold()
+{
+	return 200000;
+}
+
+#endif
+
+namespace
+{
+	class SystemTimeSource : public PacerTimeSource
+	{
+	public:
+		std::int64_t Now()override
+		{
+			return PacerClock::Now();
+		}
+
+		void Sleep(std::int64_t ns)override
+		{
+			PacerClock::Sleep(ns);
+		}
+
+		std::int64_t SpinThreshold()override
+		{
+			return PacerClock::SpinThreshold();
+		}
+	};
+}
+
+PacerTimeSource& PacerTimeSource::System()
+{
+	static SystemTimeSource system;
+	return system;
+}
+
+FramePacer::FramePacer(double targetHz, PacerTimeSource* time)
+	: mTime(time != nullptr ? time : &PacerTimeSource::System())
+{
+	SetTargetRate(targetHz);
+	mIntervalsMs.reserve(MaxIntervals);
+}
+
+void FramePacer::SetTargetRate(double targetHz)
+{
+	mPeriod = targetHz > 0.0 ? (std::int64_t)(1e9 / targetHz) : 0;
+	mNextDeadline = 0;
+}
+
+double FramePacer::TargetRate()const
+{
+	return mPeriod > 0 ? 1e9 / mPeriod : 0.0;
+}
+
+void FramePacer::SetLowLatency(bool lowLatency)
+{
+	mLowLatency = lowLatency;
+}
+
+bool FramePacer::LowLatency()const
+{
+	return mLowLatency;
+}
+
+void FramePacer::BeginFrame()
+{
+	if (mLowLatency && mPeriod > 0 && mNextDeadline != 0)
+	{
+		// Start just early enough for the frame to be ready at the deadline.
+		// The 10% margin absorbs frames that run a little over the estimate.
+		std::int64_t lead = (std::int64_t)(mPredictedWork * 1.1);
+		WaitUntil(mNextDeadline - lead);
+	}
+
+	mFrameStart = mTime->Now();
+}
+
+void FramePacer::EndFrame()
+{
+	std::int64_t now = mTime->Now();
+
+	if (mFrameStart != 0)
+	{
+		double work = (double)(now - mFrameStart);
+		mPredictedWork = mPredictedWork == 0.0 ? work : mPredictedWork + 0.1 * (work - mPredictedWork);
+	}
+
+	if (mLastPresent != 0)
+	{
+		double intervalMs = (now - mLastPresent) / 1e6;
+		if (mIntervalsMs.size() < MaxIntervals)
+			mIntervalsMs.push_back(intervalMs);
+		else
+			mIntervalsMs[mNextInterval] = intervalMs;
+		mNextInterval = (mNextInterval + 1) % MaxIntervals;
+	}
+	mLastPresent = now;
+
+	if (mPeriod <= 0)
+		return;
+
+	ScheduleNextDeadline(now);
+
+	if (!mLowLatency)
+		WaitUntil(mNextDeadline);
+}
+
+void FramePacer::SkipFrame()
+{
+	mFrameStart = 0;
+	mLastPresent = 0;
+	mNextDeadline = 0;
+}
+
+void FramePacer::ScheduleNextDeadline(std::int64_t now)
+{
+	// Step the deadline by whole periods so small overruns do not drift the
+	// cadence.  If we fell more than a frame behind (a hitch, or the window
+	// was dragged), resync instead of rushing frames out to catch up.
+	if (mNextDeadline == 0 || now - mNextDeadline > mPeriod)
+		mNextDeadline = now + mPeriod;
+	else
+		mNextDeadline += mPeriod;
+}
+
+void FramePacer::WaitUntil(std::int64_t deadline)
+{
+	std::int64_t remaining = deadline - mTime->Now();
+	std::int64_t spinThreshold = mTime->SpinThreshold();
+
+	if (remaining > spinThreshold)
+		mTime->Sleep(remaining - spinThreshold);
+
+	while (mTime->Now() < deadline)
+	{
+	}
+}
+
+FramePacingStats FramePacer::Stats()const
+{
+	FramePacingStats stats;
+	stats.Count = mIntervalsMs.size();
+	if (stats.Count == 0)
+		return stats;
+
+	double sum = 0.0;
+	stats.MinMs = mIntervalsMs[0];
+	stats.MaxMs = mIntervalsMs[0];
+	for (double ms : mIntervalsMs)
+	{
+		sum += ms;
+		stats.MinMs = (std::min)(stats.MinMs, ms);
+		stats.MaxMs = (std::max)(stats.MaxMs, ms);
+	}
+	stats.MeanMs = sum / stats.Count;
+
+	double variance = 0.0;
+	for (double ms : mIntervalsMs)
+		variance += (ms - stats.MeanMs) * (ms - stats.MeanMs);
+	stats.StdDevMs = std::sqrt(variance / stats.Count);
+
+	std::vector<double> sorted(mIntervalsMs);
+	std::size_t p99 = (std::size_t)std::ceil(0.99 * sorted.size()) - 1;
+	std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+	stats.P99Ms = sorted[p99];
+
+	return stats;
+}
+
+void FramePacer::ResetStats()
+{
+	// mLastPresent stays, so the next present still closes an interval.
+	mIntervalsMs.clear();
+	mNextInterval = 0;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Monotonic clock and sleep, the only platform specific part of the pacer.
+namespace PacerClock
+{
+	// Nanoseconds on a monotonic clock with an arbitrary epoch.
+	std::int64_t Now();
+
+	// Sleeps for about ns nanoseconds.  May overshoot by the OS timer
+	// granularity, which is why the pacer spins out the last stretch.
+	void Sleep(std::int64_t ns);
+
+	// How long before a deadline to stop sleeping and start spinning.
+	std::int64_t SpinThreshold();
+}
+
+// Where a pacer reads the time and sleeps.  The default forwards to
+// PacerClock; tests hand the pacer a simulated one.
+class PacerTimeSource
+{
+public:
+	virtual ~PacerTimeSource() = default;
+
+	virtual std::int64_t Now() = 0;
+	virtual void Sleep(std::int64_t ns) = 0;
+	virtual std::int64_t SpinThreshold() = 0;
+
+	// PacerClock as a time source.
+	static PacerTimeSource& System();
+};
+
+struct FramePacingStats
+{
+	// Number of present-to-present intervals the numbers below cover.
+	std::size_t Count = 0;
+
+	double MeanMs = 0.0;
+	double MinMs = 0.0;
+	double MaxMs = 0.0;
+
+	// Standard deviation of the intervals, i.e. the frame time jitter.
+	double StdDevMs = 0.0;
+
+	// 99th percentile interval, to catch the hitches the mean hides.
+	double P99Ms = 0.0;
+};
+
+// Holds the frame rate to a target with a coarse sleep followed by a short
+// spin, so frames start on time without burning a core for the whole frame.
+//
+// Call BeginFrame before sampling input and EndFrame right after Present.
+// In the default mode EndFrame waits out the rest of the frame.  In low
+// latency mode the wait moves to BeginFrame and is shortened by the
+// predicted cost of a frame, so input is sampled as late as possible while
+// the present still lands on the deadline.
+class FramePacer
+{
+public:
+	// time must outlive the pacer; null means PacerClock.
+	explicit FramePacer(double targetHz = 60.0, PacerTimeSource* time = nullptr);
+	FramePacer(const FramePacer& rhs) = delete;
+	FramePacer& operator=(const FramePacer& rhs) = delete;
+
+	// 0 disables the limiter; stats are still collected.
+	void SetTargetRate(double targetHz);
+	double TargetRate()const;
+
+	void SetLowLatency(bool lowLatency);
+	bool LowLatency()const;
+
+	void BeginFrame();
+	void EndFrame();
+
+	// Call instead of EndFrame when the frame was not presented.  The gap
+	// until the next present is not counted as an interval, and pacing
+	// starts over from that present.
+	void SkipFrame();
+
+	// Jitter statistics over the most recent present-to-present intervals.
+	FramePacingStats Stats()const;
+
+	// Starts a new window of statistics.  The interval in flight, from the
+	// last present to the next, still counts towards it.
+	void ResetStats();
+
+	// Blocks until the given time on the pacer's clock: sleep, then spin.
+	void WaitUntil(std::int64_t deadline);
+
+private:
+	void ScheduleNextDeadline(std::int64_t now);
+
+private:
+	static const std::size_t MaxIntervals = 256;
+
+	PacerTimeSource* mTime = nullptr;
+
+	std::int64_t mPeriod = 0;
+	bool mLowLatency = false;
+
+	std::int64_t mNextDeadline = 0;
+	std::int64_t mFrameStart = 0;
+	std::int64_t mLastPresent = 0;
+
+	// Smoothed cost of BeginFrame..EndFrame, used to start low latency
+	// frames just early enough.
+	double mPredictedWork = 0.0;
+
+	std::vector<double> mIntervalsMs;
+	std::size_t mNextInterval = 0;
+};
@@ -1,6 +1,6 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT drawCount, UINT64 dynamicGeometryBytes)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
@@ -8,9 +8,19 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
 
     PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
     ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+    DrawArgs = std::make_unique<UploadBuffer<IndirectDraw>>(device, drawCount, false);
+    DynamicGeometry = std::make_unique<DynamicGeometryBuffer>(device, dynamicGeometryBytes);
+
+    // Upload heap resources can be mapped more than once; this shares the
+    // mapping UploadBuffer already holds.
+    ThrowIfFailed(PassCB->Resource()->Map(0, nullptr, reinterpret_cast<void**>(&MappedPassCB)));
+    ThrowIfFailed(ObjectCB->Resource()->Map(0, nullptr, reinterpret_cast<void**>(&MappedObjectCB)));
 }
 
 FrameResource::~FrameResource()
 {
-
+    if (PassCB != nullptr)
+        PassCB->Resource()->Unmap(0, nullptr);
+    if (ObjectCB != nullptr)
+        ObjectCB->Resource()->Unmap(0, nullptr);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../../Common/d3dUtil.h"
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
+#include "DynamicGeometry.h"
 
 struct ObjectConstants
 {
@@ -27,10 +28,52 @@ struct PassConstants
     float DeltaTime = 0.0f;
 };
 
+// PassConstants is rebuilt and uploaded in three contiguous blocks that
+// change for different reasons: the camera (everything derived from the view
+// and projection matrices), the render target size, and the clock.
+enum class PassBlock : int
+{
+    Camera = 0,
+    Resize,
+    Time,
+    Count
+};
+
+// Byte range of a block within PassConstants.
+inline void PassBlockRange(PassBlock block, UINT& offset, UINT& size)
+{
+    const UINT bounds[] =
+    {
+        offsetof(PassConstants, View),
+        offsetof(PassConstants, RenderTargetSize),
+        offsetof(PassConstants, TotalTime),
+        sizeof(PassConstants)
+    };
+    offset = bounds[(int)block];
+    size = bounds[(int)block + 1] - offset;
+}
+
 struct Vertex
 {
     DirectX::XMFLOAT3 Pos;
     DirectX::XMFLOAT4 Color;
+
+    // Unit normal and tangent, each packed by PackUnitVector into
+    // R16G16_SNORM.  The bitangent is cross(Normal, Tangent).
+    UINT Normal;
+    UINT Tangent;
+};
+
+// One record of an ExecuteIndirect batch on the vertex pulling path: the
+// draw's root constants, then its D3D12_DRAW_ARGUMENTS.  The vertex
+// shader reads index FirstIndex + SV_VertexID of the shared index buffer
+// and offsets it by BaseVertex, so every draw is a plain non-indexed one.
+struct IndirectDraw
+{
+    UINT ObjectIndex = 0;
+    UINT FirstIndex = 0;
+    INT BaseVertex = 0;
+    D3D12_DRAW_ARGUMENTS Args = {};
 };
 
 // Step2: we usually use a circular array of three frame resource elements.The idea is that for frame n, the CPU will
@@ -45,7 +88,7 @@ struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT drawCount, UINT64 dynamicGeometryBytes);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -59,6 +102,23 @@ public:
     std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
 
+    // CPU address of the pass constants.  They are uploaded a block at a
+    // time, which UploadBuffer::CopyData (whole elements only) cannot do.
+    BYTE* MappedPassCB = nullptr;
+
+    // CPU address of the object constants, written in streams of adjacent
+    // elements rather than one CopyData per object.
+    BYTE* MappedObjectCB = nullptr;
+
+    // The frame's indirect draws for the vertex pulling path, a range per
+    // view and render layer.
+    std::unique_ptr<UploadBuffer<IndirectDraw>> DrawArgs = nullptr;
+
+    // Vertices and indices written for this frame only.  The frame
+    // resources' buffers make a ring: each is reset when its frame
+    // resource comes round again, after the fence.
+    std::unique_ptr<DynamicGeometryBuffer> DynamicGeometry = nullptr;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
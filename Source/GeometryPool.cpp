@@ -0,0 +1,135 @@
+#include "GeometryPool.h"
+#include "Stripifier.h"
+
+void GeometryPool::Add(const MeshGeometry* geo)
+{
+	if (geo == nullptr || geo->VertexBufferCPU == nullptr || geo->IndexBufferCPU == nullptr ||
+		geo->VertexByteStride != sizeof(Vertex) || mPlacements.count(geo) != 0)
+		return;
+
+	Placement placement;
+	placement.FirstVertex = (UINT)mVertices.size();
+	placement.FirstIndex = (UINT)mIndices.size();
+	mPlacements[geo] = placement;
+
+	const Vertex* vertices = reinterpret_cast<const Vertex*>(geo->VertexBufferCPU->GetBufferPointer());
+	mVertices.insert(mVertices.end(), vertices, vertices + geo->VertexBufferByteSize / sizeof(Vertex));
+
+	// Widened to 32 bits, so the shader needs no per-mesh index format.
+	if (geo->IndexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		const std::uint16_t* indices = reinterpret_cast<const std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+		mIndices.insert(mIndices.end(), indices, indices + geo->IndexBufferByteSize / sizeof(std::uint16_t));
+	}
+	else
+	{
+		const std::uint32_t* indices = reinterpret_cast<const std::uint32_t*>(geo->IndexBufferCPU->GetBufferPointer());
+		mIndices.insert(mIndices.end(), indices, indices + geo->IndexBufferByteSize / sizeof(std::uint32_t));
+	}
+}
+
+void GeometryPool::AddStrips(const RenderItem* ri)
+{
+	auto key = std::make_pair(ri->Geo, ri->StartIndexLocation);
+	if (ri->PrimitiveType != D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP || mPlacements.count(ri->Geo) == 0 ||
+		mStripRanges.count(key) != 0)
+		return;
+
+	const MeshGeometry* geo = ri->Geo;
+	std::vector<std::uint32_t> strips(ri->IndexCount);
+	std::uint32_t cutIndex = 0xFFFFFFFF;
+	if (geo->IndexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		const std::uint16_t* indices = reinterpret_cast<const std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+		strips.assign(indices + ri->StartIndexLocation, indices + ri->StartIndexLocation + ri->IndexCount);
+		cutIndex = 0xFFFF;
+	}
+	else
+	{
+		const std::uint32_t* indices = reinterpret_cast<const std::uint32_t*>(geo->IndexBufferCPU->GetBufferPointer());
+		strips.assign(indices + ri->StartIndexLocation, indices + ri->StartIndexLocation + ri->IndexCount);
+	}
+
+	// Vertex indices are unchanged, so the draw keeps ri's base vertex.
+	std::vector<std::uint32_t> triangles = UnstripTriangles(strips.data(), strips.size(), cutIndex);
+
+	StripRange range;
+	range.FirstIndex = (UINT)mIndices.size();
+	range.IndexCount = (UINT)triangles.size();
+	mStripRanges[key] = range;
+	mIndices.insert(mIndices.end(), triangles.begin(), triangles.end());
+}
+
+void GeometryPool::Build(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList)
+{
+	if (mVertices.empty() || mIndices.empty())
+		return;
+
+	// CreateDefaultBuffer leaves them in GENERIC_READ, which covers reading
+	// them as shader resources.
+	mVertexBuffer = d3dUtil::CreateDefaultBuffer(device, cmdList,
+		mVertices.data(), (UINT64)mVertices.size() * sizeof(Vertex), mVertexUploader);
+	mIndexBuffer = d3dUtil::CreateDefaultBuffer(device, cmdList,
+		mIndices.data(), (UINT64)mIndices.size() * sizeof(std::uint32_t), mIndexUploader);
+}
+
+bool GeometryPool::CanPull(const RenderItem* ri)const
+{
+	if (mVertexBuffer == nullptr)
+		return false;
+	if (ri->PrimitiveType == D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP)
+		return mStripRanges.count(std::make_pair(ri->Geo, ri->StartIndexLocation)) != 0;
+	return ri->PrimitiveType == D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST && mPlacements.count(ri->Geo) != 0;
+}
+
+IndirectDraw GeometryPool::Draw(const RenderItem* ri)const
+{
+	const Placement& placement = mPlacements.at(ri->Geo);
+
+	IndirectDraw draw;
+	draw.ObjectIndex = ri->ObjCBIndex;
+	draw.FirstIndex = placement.FirstIndex + ri->StartIndexLocation;
+	draw.BaseVertex = (INT)placement.FirstVertex + ri->BaseVertexLocation;
+	draw.Args.VertexCountPerInstance = ri->IndexCount;
+	if (ri->PrimitiveType == D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP)
+	{
+		const StripRange& range = mStripRanges.at(std::make_pair(ri->Geo, ri->StartIndexLocation));
+		draw.FirstIndex = range.FirstIndex;
+		draw.Args.VertexCountPerInstance = range.IndexCount;
+	}
+	draw.Args.InstanceCount = 1;
+	draw.Args.StartVertexLocation = 0;
+	draw.Args.StartInstanceLocation = 0;
+	return draw;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS GeometryPool::VertexBufferAddress()const
+{
+	return mVertexBuffer != nullptr ? mVertexBuffer->GetGPUVirtualAddress() : 0;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS GeometryPool::IndexBufferAddress()const
+{
+	return mIndexBuffer != nullptr ? mIndexBuffer->GetGPUVirtualAddress() : 0;
+}
+
+Microsoft::WRL::ComPtr<ID3D12CommandSignature> CreatePulledDrawSignature(ID3D12Device* device,
+	ID3D12RootSignature* rootSignature)
+{
+	D3D12_INDIRECT_ARGUMENT_DESC arguments[2] = {};
+	arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	arguments[0].Constant.RootParameterIndex = PulledDrawConstants;
+	arguments[0].Constant.DestOffsetIn32BitValues = 0;
+	arguments[0].Constant.Num32BitValuesToSet = offsetof(IndirectDraw, Args) / 4;
+	arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+
+	D3D12_COMMAND_SIGNATURE_DESC desc = {};
+	desc.ByteStride = sizeof(IndirectDraw);
+	desc.NumArgumentDescs = _countof(arguments);
+	desc.pArgumentDescs = arguments;
+	desc.NodeMask = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> signature;
+	ThrowIfFailed(device->CreateCommandSignature(&desc, rootSignature, IID_PPV_ARGS(&signature)));
+	return signature;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "RenderItem.h"
+#include "FrameResource.h"
+
+#include <map>
+#include <unordered_map>
+
+// Root parameters of the vertex pulling path, after the four every PSO
+// uses.  The pool's buffers and the frame's object constants are bound as
+// raw root SRVs once per frame; the per-draw constants are set by each
+// IndirectDraw.
+enum PulledRootParameter : UINT
+{
+	PulledVertices = 4,
+	PulledIndices,
+	PulledObjects,
+	PulledDrawConstants,
+	PulledRootParameterEnd
+};
+
+// Every MeshGeometry's vertices and indices concatenated into one raw
+// vertex buffer and one buffer of 32-bit indices.  VS.hlsl, built with
+// VERTEX_PULLING, fetches from them itself by SV_VertexID, so draws of any
+// mix of meshes need no input assembler state and fit in one
+// ExecuteIndirect.
+class GeometryPool
+{
+public:
+	GeometryPool() = default;
+	GeometryPool(const GeometryPool& rhs) = delete;
+	GeometryPool& operator=(const GeometryPool& rhs) = delete;
+
+	// Appends geo's CPU copies to the pool.  Only Vertex buffers are pooled;
+	// anything else is left to the input assembler.
+	void Add(const MeshGeometry* geo);
+
+	// Adds the triangles of ri's strips, once per range of its mesh, as a
+	// list the pulled PSOs can draw.  Call it after adding ri's mesh.
+	void AddStrips(const RenderItem* ri);
+
+	// Uploads the pool through cmdList.  The upload buffers are kept until
+	// the pool is destroyed, like MeshGeometry's.
+	void Build(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList);
+
+	// Whether ri can be drawn from the pool: its mesh was added and it is a
+	// triangle list, the only topology the pulled PSOs draw, or its strips
+	// were added as one.
+	bool CanPull(const RenderItem* ri)const;
+
+	// ri's draw with its offsets moved into the pool.
+	IndirectDraw Draw(const RenderItem* ri)const;
+
+	D3D12_GPU_VIRTUAL_ADDRESS VertexBufferAddress()const;
+	D3D12_GPU_VIRTUAL_ADDRESS IndexBufferAddress()const;
+
+	UINT VertexCount()const { return (UINT)mVertices.size(); }
+	UINT IndexCount()const { return (UINT)mIndices.size(); }
+
+private:
+	struct Placement
+	{
+		UINT FirstVertex = 0;
+		UINT FirstIndex = 0;
+	};
+
+	struct StripRange
+	{
+		UINT FirstIndex = 0;
+		UINT IndexCount = 0;
+	};
+
+	std::unordered_map<const MeshGeometry*, Placement> mPlacements;
+
+	// Unstripped ranges, by mesh and where the strips start in its index
+	// buffer.
+	std::map<std::pair<const MeshGeometry*, UINT>, StripRange> mStripRanges;
+
+	std::vector<Vertex> mVertices;
+	std::vector<std::uint32_t> mIndices;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mVertexBuffer = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mIndexBuffer = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mVertexUploader = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mIndexUploader = nullptr;
+};
+
+// Command signature for arrays of IndirectDraw: the draw constants at
+// PulledDrawConstants of rootSignature, then a non-indexed draw.
+Microsoft::WRL::ComPtr<ID3D12CommandSignature> CreatePulledDrawSignature(ID3D12Device* device,
+	ID3D12RootSignature* rootSignature);
@@ -0,0 +1,61 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer(ID3D12Device* device, ID3D12CommandQueue* queue, UINT frameCount)
+	: mFrameCount(frameCount)
+{
+	ThrowIfFailed(queue->GetTimestampFrequency(&mTimestampFrequency));
+
+	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = 2 * frameCount;
+	queryHeapDesc.NodeMask = 0;
+	ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&mQueryHeap)));
+
+	UINT64 byteSize = 2 * frameCount * sizeof(UINT64);
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&mReadbackBuffer)));
+}
+
+GpuTimer::~GpuTimer()
+{
+}
+
+void GpuTimer::Begin(ID3D12GraphicsCommandList* cmdList, UINT frameIndex)
+{
+	cmdList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * frameIndex);
+}
+
+void GpuTimer::End(ID3D12GraphicsCommandList* cmdList, UINT frameIndex)
+{
+	cmdList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * frameIndex + 1);
+
+	cmdList->ResolveQueryData(mQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+		2 * frameIndex, 2, mReadbackBuffer.Get(), 2 * frameIndex * sizeof(UINT64));
+}
+
+void GpuTimer::Readback(UINT frameIndex)
+{
+	SIZE_T begin = 2 * frameIndex * sizeof(UINT64);
+	D3D12_RANGE readRange = { begin, begin + 2 * sizeof(UINT64) };
+
+	BYTE* mappedData = nullptr;
+	ThrowIfFailed(mReadbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mappedData)));
+	const UINT64* timestamps = reinterpret_cast<const UINT64*>(mappedData + begin);
+	UINT64 ticks = timestamps[1] > timestamps[0] ? timestamps[1] - timestamps[0] : 0;
+
+	// We did not write anything.
+	D3D12_RANGE writeRange = { 0, 0 };
+	mReadbackBuffer->Unmap(0, &writeRange);
+
+	mElapsedMs = (float)(1000.0 * ticks / mTimestampFrequency);
+}
+
+float GpuTimer::ElapsedMs()const
+{
+	return mElapsedMs;
+}
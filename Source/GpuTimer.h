@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+
+// Measures GPU time between Begin and End with a pair of timestamp queries
+// per frame resource.  Like OverdrawCounter, the result for a frame can only
+// be read back once the GPU has finished that frame.
+class GpuTimer
+{
+public:
+	GpuTimer(ID3D12Device* device, ID3D12CommandQueue* queue, UINT frameCount);
+	GpuTimer(const GpuTimer& rhs) = delete;
+	GpuTimer& operator=(const GpuTimer& rhs) = delete;
+	~GpuTimer();
+
+	void Begin(ID3D12GraphicsCommandList* cmdList, UINT frameIndex);
+
+	// Writes the closing timestamp and resolves both into the readback buffer.
+	void End(ID3D12GraphicsCommandList* cmdList, UINT frameIndex);
+
+	// Fetches the resolved timestamps for frameIndex.  Only call this once the
+	// fence for that frame has been reached.
+	void Readback(UINT frameIndex);
+
+	// GPU time of the last frame read back, in milliseconds.
+	float ElapsedMs()const;
+
+private:
+	UINT mFrameCount = 0;
+	UINT64 mTimestampFrequency = 1;
+
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> mQueryHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mReadbackBuffer = nullptr;
+
+	float mElapsedMs = 0.0f;
+};
@@ -0,0 +1,281 @@
+#include "Impostor.h"
+
+using namespace DirectX;
+
+ImpostorAtlas::ImpostorAtlas(ID3D12Device* device, DXGI_FORMAT colorFormat, DXGI_FORMAT depthFormat,
+	UINT viewCount, UINT tileSize)
+	: mViewCount(viewCount), mTileSize(tileSize), mDevice(device)
+{
+	// The mips are filtered as 8-bit RGBA, down to a texel per tile.  The
+	// filter treats every channel alike, so BGRA works too.
+	bool rgba8 = colorFormat == DXGI_FORMAT_R8G8B8A8_UNORM || colorFormat == DXGI_FORMAT_B8G8R8A8_UNORM;
+	bool powerOfTwo = (mTileSize & (mTileSize - 1)) == 0;
+	mMipCount = rgba8 && powerOfTwo ? FullMipCount(mTileSize, mTileSize) : 1;
+
+	// The tiles sit side by side in one row.  The RTV is the top level's.
+	D3D12_RESOURCE_DESC atlasDesc = CD3DX12_RESOURCE_DESC::Tex2D(colorFormat,
+		mTileSize * mViewCount, mTileSize, 1, (UINT16)mMipCount, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+
+	// Cleared to transparent so the PS can clip around the silhouette.
+	float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	CD3DX12_CLEAR_VALUE atlasClear(colorFormat, clearColor);
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&atlasDesc,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+		&atlasClear,
+		IID_PPV_ARGS(&mAtlas)));
+
+	D3D12_RESOURCE_DESC depthDesc = CD3DX12_RESOURCE_DESC::Tex2D(depthFormat,
+		mTileSize * mViewCount, mTileSize, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+	CD3DX12_CLEAR_VALUE depthClear(depthFormat, 1.0f, 0);
+
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&depthDesc,
+		D3D12_RESOURCE_STATE_DEPTH_WRITE,
+		&depthClear,
+		IID_PPV_ARGS(&mDepth)));
+
+	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+	rtvHeapDesc.NumDescriptors = 1;
+	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+	ThrowIfFailed(device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&mRtvHeap)));
+	device->CreateRenderTargetView(mAtlas.Get(), nullptr, mRtvHeap->GetCPUDescriptorHandleForHeapStart());
+
+	D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
+	dsvHeapDesc.NumDescriptors = 1;
+	dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+	ThrowIfFailed(device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&mDsvHeap)));
+	device->CreateDepthStencilView(mDepth.Get(), nullptr, mDsvHeap->GetCPUDescriptorHandleForHeapStart());
+
+	mViewCB = std::make_unique<UploadBuffer<PassConstants>>(device, mViewCount, true);
+
+	if (mMipCount > 1)
+	{
+		UINT64 readbackBytes = 0;
+		device->GetCopyableFootprints(&atlasDesc, 0, 1, 0, &mReadbackLayout, nullptr, nullptr, &readbackBytes);
+
+		ThrowIfFailed(device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(readbackBytes),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&mReadback)));
+	}
+}
+
+ImpostorAtlas::~ImpostorAtlas()
+{
+}
+
+void ImpostorAtlas::SetArchetype(const BoundingBox& bounds, float elevation)
+{
+	BoundingSphere sphere;
+	BoundingSphere::CreateFromBoundingBox(sphere, bounds);
+	mCenter = sphere.Center;
+	mRadius = sphere.Radius;
+
+	// Orthographic views that just enclose the bounding sphere, from far
+	// enough away that the whole sphere lies between the clip planes.
+	XMVECTOR center = XMLoadFloat3(&mCenter);
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	XMMATRIX proj = XMMatrixOrthographicLH(2.0f * mRadius, 2.0f * mRadius, 0.5f * mRadius, 3.5f * mRadius);
+
+	for (UINT i = 0; i < mViewCount; ++i)
+	{
+		float yaw = i * XM_2PI / mViewCount;
+		XMVECTOR dir = XMVectorSet(cosf(elevation) * cosf(yaw), sinf(elevation), cosf(elevation) * sinf(yaw), 0.0f);
+		XMVECTOR eye = center + 2.0f * mRadius * dir;
+
+		XMMATRIX view = XMMatrixLookAtLH(eye, center, up);
+		XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+		XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+		XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
+		XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+
+		PassConstants viewCB;
+		XMStoreFloat4x4(&viewCB.View, XMMatrixTranspose(view));
+		XMStoreFloat4x4(&viewCB.InvView, XMMatrixTranspose(invView));
+		XMStoreFloat4x4(&viewCB.Proj, XMMatrixTranspose(proj));
+		XMStoreFloat4x4(&viewCB.InvProj, XMMatrixTranspose(invProj));
+		XMStoreFloat4x4(&viewCB.ViewProj, XMMatrixTranspose(viewProj));
+		XMStoreFloat4x4(&viewCB.InvViewProj, XMMatrixTranspose(invViewProj));
+		XMStoreFloat3(&viewCB.EyePosW, eye);
+		viewCB.RenderTargetSize = XMFLOAT2((float)mTileSize, (float)mTileSize);
+		viewCB.InvRenderTargetSize = XMFLOAT2(1.0f / mTileSize, 1.0f / mTileSize);
+		viewCB.NearZ = 0.5f * mRadius;
+		viewCB.FarZ = 3.5f * mRadius;
+
+		mViewCB->CopyData(i, viewCB);
+	}
+
+	mBaked = false;
+}
+
+void ImpostorAtlas::CreateViews(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle,
+	D3D12_CPU_DESCRIPTOR_HANDLE cbvHandle, UINT descriptorSize)
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = mAtlas->GetDesc().Format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = mMipCount;
+	device->CreateShaderResourceView(mAtlas.Get(), &srvDesc, srvHandle);
+
+	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
+	auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(cbvHandle);
+	for (UINT i = 0; i < mViewCount; ++i)
+	{
+		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
+		cbvDesc.BufferLocation = mViewCB->Resource()->GetGPUVirtualAddress() + i * passCBByteSize;
+		cbvDesc.SizeInBytes = passCBByteSize;
+		device->CreateConstantBufferView(&cbvDesc, handle);
+
+		handle.Offset(1, descriptorSize);
+	}
+}
+
+void ImpostorAtlas::Bake(ID3D12GraphicsCommandList* cmdList, const std::function<void(UINT view)>& drawView)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE rtv = mRtvHeap->GetCPUDescriptorHandleForHeapStart();
+	D3D12_CPU_DESCRIPTOR_HANDLE dsv = mDsvHeap->GetCPUDescriptorHandleForHeapStart();
+
+	float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	cmdList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+	cmdList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+	cmdList->OMSetRenderTargets(1, &rtv, true, &dsv);
+
+	for (UINT i = 0; i < mViewCount; ++i)
+	{
+		D3D12_VIEWPORT viewport = { (float)(i * mTileSize), 0.0f, (float)mTileSize, (float)mTileSize, 0.0f, 1.0f };
+		D3D12_RECT scissorRect = { (LONG)(i * mTileSize), 0, (LONG)((i + 1) * mTileSize), (LONG)mTileSize };
+		cmdList->RSSetViewports(1, &viewport);
+		cmdList->RSSetScissorRects(1, &scissorRect);
+
+		drawView(i);
+	}
+
+	// The levels below hold the old pictures until they are built again, so
+	// the shader is kept to the top level.
+	mBaked = true;
+	mMipState = MipState::None;
+}
+
+void ImpostorAtlas::ReadBack(ID3D12GraphicsCommandList* cmdList, UINT64 frameFence)
+{
+	if (mMipCount <= 1)
+		return;
+
+	CD3DX12_TEXTURE_COPY_LOCATION dst(mReadback.Get(), mReadbackLayout);
+	CD3DX12_TEXTURE_COPY_LOCATION src(mAtlas.Get(), 0);
+	cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+	mMipState = MipState::ReadingBack;
+	mMipFence = frameFence;
+}
+
+bool ImpostorAtlas::PrepareMips(UINT64 completedFence, ThreadPool& pool)
+{
+	// The upload buffer of the last UploadMips is free once its frame is.
+	if (mMipState == MipState::Uploading && completedFence >= mMipFence)
+	{
+		mMipUpload = nullptr;
+		mMipState = MipState::Done;
+	}
+
+	if (mMipState != MipState::ReadingBack || completedFence < mMipFence)
+		return false;
+
+	const D3D12_SUBRESOURCE_FOOTPRINT& footprint = mReadbackLayout.Footprint;
+	D3D12_RANGE readRange = { 0, (SIZE_T)footprint.RowPitch * footprint.Height };
+	BYTE* mapped = nullptr;
+	ThrowIfFailed(mReadback->Map(0, &readRange, reinterpret_cast<void**>(&mapped)));
+	GenerateMipChain(mapped, footprint.Width, footprint.Height, footprint.RowPitch,
+		false, MipFilter::Box, pool, mMips, mMipCount);
+	D3D12_RANGE writeRange = { 0, 0 };
+	mReadback->Unmap(0, &writeRange);
+
+	mMipState = MipState::Built;
+	return true;
+}
+
+void ImpostorAtlas::UploadMips(ID3D12GraphicsCommandList* cmdList, UINT64 frameFence)
+{
+	if (mMipState != MipState::Built)
+		return;
+
+	// Level 0 is in the atlas already; the rest go through an upload buffer
+	// laid out the way the copy engine wants them.
+	D3D12_RESOURCE_DESC desc = mAtlas->GetDesc();
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(mMipCount);
+	std::vector<UINT> rowCounts(mMipCount);
+	UINT64 uploadBytes = 0;
+	mDevice->GetCopyableFootprints(&desc, 1, mMipCount - 1, 0, &layouts[1], &rowCounts[1], nullptr, &uploadBytes);
+
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(uploadBytes),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mMipUpload)));
+
+	BYTE* mapped = nullptr;
+	ThrowIfFailed(mMipUpload->Map(0, nullptr, reinterpret_cast<void**>(&mapped)));
+	for (UINT mip = 1; mip < mMipCount; ++mip)
+	{
+		const MipChainLevel& level = mMips.Levels[mip];
+		const std::uint8_t* src = mMips.Data.data() + level.Offset;
+		BYTE* dst = mapped + layouts[mip].Offset;
+		for (UINT row = 0; row < rowCounts[mip]; ++row)
+			memcpy(dst + row * layouts[mip].Footprint.RowPitch, src + row * level.RowPitch, level.Width * 4);
+	}
+	mMipUpload->Unmap(0, nullptr);
+
+	for (UINT mip = 1; mip < mMipCount; ++mip)
+	{
+		CD3DX12_TEXTURE_COPY_LOCATION dst(mAtlas.Get(), mip);
+		CD3DX12_TEXTURE_COPY_LOCATION src(mMipUpload.Get(), layouts[mip]);
+		cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	}
+
+	mMips = MipChain();
+	mMipState = MipState::Uploading;
+	mMipFence = frameFence;
+}
+
+bool ImpostorAtlas::IsBaked()const
+{
+	return mBaked;
+}
+
+bool ImpostorAtlas::MipsPending()const
+{
+	return mMipState == MipState::ReadingBack || mMipState == MipState::Built;
+}
+
+ImpostorConstants ImpostorAtlas::Constants(const XMFLOAT3& position)const
+{
+	ImpostorConstants constants;
+	constants.Center = XMFLOAT3(mCenter.x + position.x, mCenter.y + position.y, mCenter.z + position.z);
+	constants.HalfSize = mRadius;
+	constants.ViewCount = (float)mViewCount;
+	constants.MaxMip = mMipState == MipState::Uploading || mMipState == MipState::Done ? (float)(mMipCount - 1) : 0.0f;
+	return constants;
+}
+
+ID3D12Resource* ImpostorAtlas::Atlas()const
+{
+	return mAtlas.Get();
+}
+
+UINT ImpostorAtlas::ViewCount()const
+{
+	return mViewCount;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "FrameResource.h"
+#include "MipGenerator.h"
+
+#include <functional>
+
+// One placed copy of an impostor archetype.
+struct ImpostorInstance
+{
+	// World space translation of the copy from the archetype.
+	DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+
+	// World space bounds of the copy's full geometry.  Each view decides
+	// from its own eye whether the copy is far enough away to be drawn as its
+	// impostor instead.
+	DirectX::BoundingBox Bounds;
+};
+
+// Root constants the impostor shader reads at b2.
+struct ImpostorConstants
+{
+	DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+	float HalfSize = 0.0f;
+	float ViewCount = 0.0f;
+
+	// Lowest atlas level the shader may sample: 0 until the mips are in.
+	float MaxMip = 0.0f;
+	DirectX::XMFLOAT2 Pad = { 0.0f, 0.0f };
+};
+
+// Pictures of an archetype (a whole castle) taken from ViewCount directions
+// around it, side by side in one atlas texture.  Far away copies of the
+// archetype are drawn as a single camera-facing quad showing the picture
+// taken from the direction closest to the camera's.
+//
+// The pictures are rendered on the GPU with the regular scene pipeline: each
+// view gets its own pass constants (orthographic, fitted to the archetype's
+// bounding sphere) and Bake calls back into the app to draw the archetype.
+//
+// Only the top level is rendered.  The levels below, down to one texel per
+// tile, are box filtered on the CPU from a copy read back after the bake
+// and copied up a few frames later, so far away impostors do not shimmer.
+// The tiles are a power of two wide, so no level mixes two pictures.
+class ImpostorAtlas
+{
+public:
+	ImpostorAtlas(ID3D12Device* device, DXGI_FORMAT colorFormat, DXGI_FORMAT depthFormat,
+		UINT viewCount = 8, UINT tileSize = 256);
+	ImpostorAtlas(const ImpostorAtlas& rhs) = delete;
+	ImpostorAtlas& operator=(const ImpostorAtlas& rhs) = delete;
+	~ImpostorAtlas();
+
+	// Fits the views around the archetype's bounds.  The views look down at
+	// the archetype from elevation radians above the horizon.  Marks the
+	// atlas for baking.
+	void SetArchetype(const DirectX::BoundingBox& bounds, float elevation);
+
+	// Creates the atlas SRV at srvHandle, and ViewCount() pass CBVs, one
+	// per view, starting at cbvHandle.
+	void CreateViews(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE srvHandle,
+		D3D12_CPU_DESCRIPTOR_HANDLE cbvHandle, UINT descriptorSize);
+
+	// Renders every view into its tile.  The atlas must be in the render
+	// target state.  drawView is called once per view with the viewport set
+	// and must bind that view's pass CBV and draw the archetype.
+	void Bake(ID3D12GraphicsCommandList* cmdList, const std::function<void(UINT view)>& drawView);
+
+	bool IsBaked()const;
+
+	// Copies the freshly baked top level out for the mips.  The atlas must be
+	// in the copy source state.  frameFence is the fence value of the frame
+	// being recorded.
+	void ReadBack(ID3D12GraphicsCommandList* cmdList, UINT64 frameFence);
+
+	// Once the GPU has reached the read back's fence (completedFence), builds
+	// the mips on pool and returns true: record UploadMips this frame.
+	bool PrepareMips(UINT64 completedFence, ThreadPool& pool);
+
+	// Copies the mips built by PrepareMips into the atlas, which must be in
+	// the copy dest state.  From this frame on the shader may sample them.
+	void UploadMips(ID3D12GraphicsCommandList* cmdList, UINT64 frameFence);
+
+	// Baked, but the mips are not in the atlas yet.
+	bool MipsPending()const;
+
+	// Constants for drawing the impostor of a copy placed at position.
+	ImpostorConstants Constants(const DirectX::XMFLOAT3& position)const;
+
+	ID3D12Resource* Atlas()const;
+	UINT ViewCount()const;
+
+private:
+	enum class MipState
+	{
+		None,
+		ReadingBack,
+		Built,
+		Uploading,
+		Done
+	};
+
+	UINT mViewCount = 0;
+	UINT mTileSize = 0;
+	UINT mMipCount = 1;
+
+	DirectX::XMFLOAT3 mCenter = { 0.0f, 0.0f, 0.0f };
+	float mRadius = 0.0f;
+	bool mBaked = false;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mAtlas = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mDepth = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mRtvHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mDsvHeap = nullptr;
+
+	std::unique_ptr<UploadBuffer<PassConstants>> mViewCB = nullptr;
+
+	ID3D12Device* mDevice = nullptr;
+	MipState mMipState = MipState::None;
+	UINT64 mMipFence = 0;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT mReadbackLayout = {};
+	Microsoft::WRL::ComPtr<ID3D12Resource> mReadback = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mMipUpload = nullptr;
+	MipChain mMips;
+};
@@ -0,0 +1,1143 @@
+#include "MeshCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+	const std::uint32_t Magic = 0x4348534D; // "MSHC"
+	const std::uint32_t Version = 3;
+
+	// Triangle codes.  A triangle that shares an edge with one of the last
+	// EdgeCacheSize edges seen is one byte: the edge's slot (0 is the
+	// newest) in bits 0-2, which rotation of the triangle starts with that
+	// edge in bits 3-4, and its third vertex in bits 5-7.  Any other
+	// triangle is MissCode, with its three vertices coded on their own.
+	const std::uint32_t EdgeCacheSize = 8;
+	const std::uint8_t MissCode = 0xFF;
+
+	// Vertex codes: the next unused vertex, a slot of the FIFO of recently
+	// missed vertices (1 is the newest), or an escape with the difference
+	// from the last index to follow.  A triangle code's third vertex can
+	// only name the newest TriangleVertexSlots slots.
+	const std::uint32_t VertexCacheSize = 32;
+	const std::uint32_t TriangleVertexSlots = 6;
+	const std::uint8_t NextCode = 0;
+
+	// rANS with 12-bit frequencies and 32-bit states kept in [2^16, 2^32),
+	// renormalized 16 bits at a time: a decode step refills at most once,
+	// which it does without a branch.  Eight states take turns so the
+	// decoder's steps do not wait on each other.
+	const std::uint32_t ProbBits = 12;
+	const std::uint32_t ProbScale = 1u << ProbBits;
+	const std::uint32_t RansLow = 1u << 16;
+	const std::uint32_t RansStates = 8;
+
+	enum class StreamMethod : std::uint8_t
+	{
+		Raw = 0,
+		Constant,
+		Rans
+	};
+
+	enum Stream
+	{
+		PositionLow = 0,
+		PositionHigh,
+		FrameMasks,
+		FrameLow,
+		FrameHigh,
+		ColorRuns,
+		TriangleCodes,
+		VertexCodes,
+		IndexEscapes,
+		StreamCount
+	};
+
+	// Vertices that share one set of quantization bounds and restart the
+	// deltas.
+	struct VertexRun
+	{
+		std::uint32_t VertexCount = 0;
+		float Min[3] = {};
+		float Scale[3] = {};
+	};
+
+	void Put8(std::vector<std::uint8_t>& out, std::uint8_t value)
+	{
+		out.push_back(value);
+	}
+
+	void Put16(std::vector<std::uint8_t>& out, std::uint16_t value)
+	{
+		out.push_back((std::uint8_t)value);
+		out.push_back((std::uint8_t)(value >> 8));
+	}
+
+	void Put32(std::vector<std::uint8_t>& out, std::uint32_t value)
+	{
+		for (int shift = 0; shift < 32; shift += 8)
+			out.push_back((std::uint8_t)(value >> shift));
+	}
+
+	void PutFloat(std::vector<std::uint8_t>& out, float value)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		Put32(out, bits);
+	}
+
+	std::uint32_t Load32(const std::uint8_t* p)
+	{
+		return (std::uint32_t)p[0] | ((std::uint32_t)p[1] << 8) | ((std::uint32_t)p[2] << 16) | ((std::uint32_t)p[3] << 24);
+	}
+
+	// Bounds checked reads from the encoded data.
+	struct Reader
+	{
+		const std::uint8_t* Ptr = nullptr;
+		const std::uint8_t* End = nullptr;
+
+		bool Has(std::size_t size)const { return (std::size_t)(End - Ptr) >= size; }
+
+		bool Read8(std::uint8_t& value)
+		{
+			if (!Has(1))
+				return false;
+			value = *Ptr++;
+			return true;
+		}
+
+		bool Read16(std::uint16_t& value)
+		{
+			if (!Has(2))
+				return false;
+			value = (std::uint16_t)(Ptr[0] | (Ptr[1] << 8));
+			Ptr += 2;
+			return true;
+		}
+
+		bool Read32(std::uint32_t& value)
+		{
+			if (!Has(4))
+				return false;
+			value = Load32(Ptr);
+			Ptr += 4;
+			return true;
+		}
+
+		bool ReadFloat(float& value)
+		{
+			std::uint32_t bits;
+			if (!Read32(bits))
+				return false;
+			std::memcpy(&value, &bits, sizeof(value));
+			return true;
+		}
+	};
+
+	std::uint16_t ZigZag16(std::uint16_t delta)
+	{
+		return (std::uint16_t)((delta << 1) ^ (std::uint16_t)((std::int16_t)delta >> 15));
+	}
+
+	std::uint16_t UnZigZag16(std::uint16_t value)
+	{
+		return (std::uint16_t)((value >> 1) ^ (std::uint16_t)(0 - (value & 1)));
+	}
+
+	std::uint32_t ZigZag32(std::uint32_t delta)
+	{
+		return (delta << 1) ^ (std::uint32_t)((std::int32_t)delta >> 31);
+	}
+
+	std::uint32_t UnZigZag32(std::uint32_t value)
+	{
+		return (value >> 1) ^ (0 - (value & 1));
+	}
+
+	void PutVarint(std::vector<std::uint8_t>& out, std::uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back((std::uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((std::uint8_t)value);
+	}
+
+	// Scales symbol counts to frequencies summing to ProbScale, keeping
+	// every present symbol at 1 or more.
+	void NormalizeFrequencies(const std::uint32_t counts[256], std::size_t total, std::uint32_t freqs[256])
+	{
+		std::uint32_t sum = 0;
+		int largest = -1;
+		for (int s = 0; s < 256; ++s)
+		{
+			freqs[s] = 0;
+			if (counts[s] == 0)
+				continue;
+
+			freqs[s] = (std::max)((std::uint32_t)((std::uint64_t)counts[s] * ProbScale / total), 1u);
+			sum += freqs[s];
+			if (largest < 0 || counts[s] > counts[largest])
+				largest = s;
+		}
+
+		// Rounding down leaves a shortfall for the most common symbol; the
+		// minimum of 1 can overshoot, which is taken back from the biggest.
+		if (sum < ProbScale)
+			freqs[largest] += ProbScale - sum;
+
+		while (sum > ProbScale)
+		{
+			int biggest = 0;
+			for (int s = 1; s < 256; ++s)
+			{
+				if (freqs[s] > freqs[biggest])
+					biggest = s;
+			}
+			freqs[biggest]--;
+			sum--;
+		}
+	}
+
+	void EncodeRans(const std::vector<std::uint8_t>& data, const std::uint32_t freqs[256], std::vector<std::uint8_t>& out)
+	{
+		std::uint32_t starts[256];
+		std::uint32_t start = 0;
+		for (int s = 0; s < 256; ++s)
+		{
+			starts[s] = start;
+			start += freqs[s];
+		}
+
+		// Symbols go in last to first, so the decoder reads them first to
+		// last.  A step writes one 16-bit word at most.
+		std::vector<std::uint8_t> buffer(data.size() * 2 + 16);
+		std::uint8_t* end = buffer.data() + buffer.size();
+		std::uint8_t* ptr = end;
+
+		std::uint32_t states[RansStates];
+		for (std::uint32_t j = 0; j < RansStates; ++j)
+			states[j] = RansLow;
+		for (std::size_t i = data.size(); i-- > 0; )
+		{
+			std::uint32_t& x = states[i % RansStates];
+			std::uint32_t freq = freqs[data[i]];
+			std::uint32_t xMax = ((RansLow >> ProbBits) << 16) * freq;
+			if (x >= xMax)
+			{
+				*--ptr = (std::uint8_t)(x >> 8);
+				*--ptr = (std::uint8_t)x;
+				x >>= 16;
+			}
+			x = ((x / freq) << ProbBits) + (x % freq) + starts[data[i]];
+		}
+
+		for (std::uint32_t j = RansStates; j-- > 0; )
+		{
+			std::uint32_t x = states[j];
+			*--ptr = (std::uint8_t)(x >> 24);
+			*--ptr = (std::uint8_t)(x >> 16);
+			*--ptr = (std::uint8_t)(x >> 8);
+			*--ptr = (std::uint8_t)x;
+		}
+
+		Put32(out, (std::uint32_t)(end - ptr));
+		out.insert(out.end(), ptr, end);
+	}
+
+	// Appends a stream: its method and size, then the bytes as they are,
+	// as one repeated byte, or rANS coded with its frequency table.
+	void PutStream(std::vector<std::uint8_t>& out, const std::vector<std::uint8_t>& data)
+	{
+		std::uint32_t counts[256] = {};
+		for (std::uint8_t value : data)
+			counts[value]++;
+
+		int symbolCount = 0;
+		for (int s = 0; s < 256; ++s)
+			symbolCount += counts[s] != 0;
+
+		if (symbolCount == 1)
+		{
+			Put8(out, (std::uint8_t)StreamMethod::Constant);
+			Put32(out, (std::uint32_t)data.size());
+			Put8(out, data[0]);
+			return;
+		}
+
+		std::uint32_t freqs[256] = {};
+		double bits = 0.0;
+		if (symbolCount > 1)
+		{
+			NormalizeFrequencies(counts, data.size(), freqs);
+			for (int s = 0; s < 256; ++s)
+			{
+				if (counts[s] != 0)
+					bits += counts[s] * (ProbBits - std::log2((double)freqs[s]));
+			}
+		}
+
+		double ransBytes = bits / 8.0 + 2 + 3.0 * symbolCount + 4 + 4 * RansStates;
+		if (symbolCount == 0 || ransBytes >= data.size())
+		{
+			Put8(out, (std::uint8_t)StreamMethod::Raw);
+			Put32(out, (std::uint32_t)data.size());
+			out.insert(out.end(), data.begin(), data.end());
+			return;
+		}
+
+		Put8(out, (std::uint8_t)StreamMethod::Rans);
+		Put32(out, (std::uint32_t)data.size());
+		Put16(out, (std::uint16_t)symbolCount);
+		for (int s = 0; s < 256; ++s)
+		{
+			if (freqs[s] != 0)
+			{
+				Put8(out, (std::uint8_t)s);
+				Put16(out, (std::uint16_t)freqs[s]);
+			}
+		}
+		EncodeRans(data, freqs, out);
+	}
+
+	// The first half of a rANS decode step: the symbol under x's slot, and
+	// x with it taken out.  A slot's table entry packs its symbol, its
+	// offset from the symbol's first slot and the symbol's frequency in 8,
+	// 12 and 12 bits; a rANS stream has two symbols or more, so no
+	// frequency is 4096.
+	inline std::uint8_t RansPop(std::uint32_t& x, const std::uint32_t* table)
+	{
+		std::uint32_t entry = table[x & (ProbScale - 1)];
+		x = (entry >> 20) * (x >> ProbBits) + ((entry >> 8) & (ProbScale - 1));
+		return (std::uint8_t)entry;
+	}
+
+	// The second half: x refilled from the word at ptr if it fell below
+	// RansLow.  Returns 1 if it took the word.
+	inline std::uint32_t RansRefill(std::uint32_t& x, const std::uint8_t* ptr)
+	{
+		// A shift by 0 or 16 and a mask rather than a select: compilers
+		// turn the select into a branch, which mispredicts whenever refills
+		// are not rare.
+		std::uint32_t refill = x < RansLow;
+		std::uint32_t word = (std::uint32_t)ptr[0] | ((std::uint32_t)ptr[1] << 8);
+		x = (x << (refill * 16)) | (word & (0 - refill));
+		return refill;
+	}
+
+	bool DecodeRans(Reader& reader, const std::uint32_t* table, std::uint8_t* out, std::size_t count)
+	{
+		std::uint32_t payloadSize;
+		if (!reader.Read32(payloadSize) || payloadSize < 4 * RansStates || !reader.Has(payloadSize))
+			return false;
+
+		const std::uint8_t* ptr = reader.Ptr;
+		const std::uint8_t* end = ptr + payloadSize;
+		reader.Ptr = end;
+
+		std::uint32_t states[RansStates];
+		for (std::uint32_t j = 0; j < RansStates; ++j, ptr += 4)
+		{
+			states[j] = Load32(ptr);
+			if (states[j] < RansLow)
+				return false;
+		}
+
+		// Copies, not the array: with its address taken the byte stores
+		// below could alias the states and keep them out of registers.
+		static_assert(RansStates == 8, "the group below is written out for eight states");
+		std::uint32_t x0 = states[0], x1 = states[1], x2 = states[2], x3 = states[3];
+		std::uint32_t x4 = states[4], x5 = states[5], x6 = states[6], x7 = states[7];
+
+		// With sixteen bytes left a group of eight steps needs no checks.
+		// The states read one shared stream in turn, so refilling each as it
+		// is popped would chain every step to the one before through ptr.
+		// Popping all eight first and then refilling at offsets known from
+		// the flags alone leaves only the refills in order, and keeps the
+		// table lookups independent.
+		std::size_t i = 0;
+		for (; i + RansStates <= count && end - ptr >= 2 * RansStates; i += RansStates)
+		{
+			out[i] = RansPop(x0, table);
+			out[i + 1] = RansPop(x1, table);
+			out[i + 2] = RansPop(x2, table);
+			out[i + 3] = RansPop(x3, table);
+			out[i + 4] = RansPop(x4, table);
+			out[i + 5] = RansPop(x5, table);
+			out[i + 6] = RansPop(x6, table);
+			out[i + 7] = RansPop(x7, table);
+
+			std::uint32_t used = 0;
+			used += 2 * RansRefill(x0, ptr + used);
+			used += 2 * RansRefill(x1, ptr + used);
+			used += 2 * RansRefill(x2, ptr + used);
+			used += 2 * RansRefill(x3, ptr + used);
+			used += 2 * RansRefill(x4, ptr + used);
+			used += 2 * RansRefill(x5, ptr + used);
+			used += 2 * RansRefill(x6, ptr + used);
+			used += 2 * RansRefill(x7, ptr + used);
+			ptr += used;
+		}
+
+		states[0] = x0; states[1] = x1; states[2] = x2; states[3] = x3;
+		states[4] = x4; states[5] = x5; states[6] = x6; states[7] = x7;
+		for (; i < count; ++i)
+		{
+			std::uint32_t& x = states[i % RansStates];
+			std::uint8_t symbol = RansPop(x, table);
+			if (x < RansLow)
+			{
+				if (end - ptr < 2)
+					return false;
+				x = (x << 16) | (std::uint32_t)ptr[0] | ((std::uint32_t)ptr[1] << 8);
+				ptr += 2;
+			}
+			out[i] = symbol;
+		}
+
+		// The encoder started every state at RansLow and used every byte.
+		bool finished = ptr == end;
+		for (std::uint32_t j = 0; j < RansStates; ++j)
+			finished = finished && states[j] == RansLow;
+		return finished;
+	}
+
+	bool ReadStream(Reader& reader, std::vector<std::uint8_t>& data, std::size_t maxSize)
+	{
+		std::uint8_t method;
+		std::uint32_t size;
+		if (!reader.Read8(method) || !reader.Read32(size) || size > maxSize)
+			return false;
+		data.resize(size);
+
+		switch ((StreamMethod)method)
+		{
+		case StreamMethod::Raw:
+			if (!reader.Has(size))
+				return false;
+			if (size != 0)
+				std::memcpy(data.data(), reader.Ptr, size);
+			reader.Ptr += size;
+			return true;
+
+		case StreamMethod::Constant:
+		{
+			std::uint8_t value;
+			if (!reader.Read8(value))
+				return false;
+			std::memset(data.data(), value, size);
+			return true;
+		}
+
+		case StreamMethod::Rans:
+		{
+			std::uint16_t symbolCount;
+			if (!reader.Read16(symbolCount) || symbolCount < 2 || symbolCount > 256)
+				return false;
+
+			std::uint32_t table[ProbScale];
+			std::uint32_t start = 0;
+			int lastSymbol = -1;
+			for (int k = 0; k < symbolCount; ++k)
+			{
+				std::uint8_t symbol;
+				std::uint16_t freq;
+				if (!reader.Read8(symbol) || !reader.Read16(freq) || symbol <= lastSymbol ||
+					freq == 0 || freq >= ProbScale || start + freq > ProbScale)
+					return false;
+
+				std::uint32_t entry = symbol | ((std::uint32_t)freq << 20);
+				for (std::uint32_t slot = 0; slot < freq; ++slot)
+					table[start + slot] = entry | (slot << 8);
+				start += freq;
+				lastSymbol = symbol;
+			}
+			if (start != ProbScale)
+				return false;
+
+			return DecodeRans(reader, table, data.data(), size);
+		}
+
+		default:
+			return false;
+		}
+	}
+
+	bool Fail(std::string* error, const char* message)
+	{
+		if (error != nullptr)
+			*error = message;
+		return false;
+	}
+
+	std::uint32_t ReadIndex(const void* indices, bool indices16, std::size_t i)
+	{
+		return indices16 ? static_cast<const std::uint16_t*>(indices)[i] : static_cast<const std::uint32_t*>(indices)[i];
+	}
+
+	// Each submesh's bounds grown to cover its vertices, then the vertices
+	// cut into runs that share bounds.  Vertices of no submesh use the
+	// bounds of every vertex.
+	std::vector<VertexRun> BuildRuns(const MeshCodecVertex* vertices, std::uint32_t vertexCount,
+		const std::vector<MeshCodecSubmesh>& submeshes)
+	{
+		std::size_t groupCount = submeshes.size() + 1;
+		std::vector<std::uint32_t> group(vertexCount, (std::uint32_t)submeshes.size());
+		for (std::size_t g = submeshes.size(); g-- > 0; )
+		{
+			const MeshCodecSubmesh& submesh = submeshes[g];
+			std::uint32_t last = (std::min)(vertexCount, submesh.FirstVertex + submesh.VertexCount);
+			for (std::uint32_t v = submesh.FirstVertex; v < last; ++v)
+				group[v] = (std::uint32_t)g;
+		}
+
+		std::vector<float> mins(groupCount * 3, (std::numeric_limits<float>::max)());
+		std::vector<float> maxs(groupCount * 3, -(std::numeric_limits<float>::max)());
+		for (std::size_t g = 0; g < submeshes.size(); ++g)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				mins[g * 3 + a] = submeshes[g].BoundsCenter[a] - submeshes[g].BoundsExtents[a];
+				maxs[g * 3 + a] = submeshes[g].BoundsCenter[a] + submeshes[g].BoundsExtents[a];
+			}
+		}
+		for (std::uint32_t v = 0; v < vertexCount; ++v)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				mins[group[v] * 3 + a] = (std::min)(mins[group[v] * 3 + a], vertices[v].Pos[a]);
+				maxs[group[v] * 3 + a] = (std::max)(maxs[group[v] * 3 + a], vertices[v].Pos[a]);
+			}
+		}
+
+		std::vector<VertexRun> runs;
+		for (std::uint32_t v = 0; v < vertexCount; ++v)
+		{
+			if (v == 0 || group[v] != group[v - 1])
+			{
+				VertexRun run;
+				for (int a = 0; a < 3; ++a)
+				{
+					run.Min[a] = mins[group[v] * 3 + a];
+					run.Scale[a] = (maxs[group[v] * 3 + a] - run.Min[a]) / 65535.0f;
+				}
+				runs.push_back(run);
+			}
+			runs.back().VertexCount++;
+		}
+		return runs;
+	}
+
+	std::uint8_t QuantizeColor(float value)
+	{
+		return (std::uint8_t)std::lround((std::min)((std::max)(value, 0.0f), 1.0f) * 255.0f);
+	}
+
+	struct ColorTable
+	{
+		float Values[256];
+
+		ColorTable()
+		{
+			for (int i = 0; i < 256; ++i)
+				Values[i] = i / 255.0f;
+		}
+	};
+
+	const ColorTable& ColorValues()
+	{
+		static const ColorTable table;
+		return table;
+	}
+
+	bool ReadVarint(const std::uint8_t*& ptr, const std::uint8_t* end, std::uint32_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift <= 28; shift += 7)
+		{
+			if (ptr == end)
+				return false;
+			std::uint8_t byte = *ptr++;
+			value |= (std::uint32_t)(byte & 0x7F) << shift;
+			if (byte < 0x80)
+				return true;
+		}
+		return false;
+	}
+
+	// What the encoder and decoder both remember of the indices so far.
+	// Each triangle pushes its edges reversed, the way a neighbour with the
+	// same winding walks them.
+	struct IndexCache
+	{
+		// An edge's first vertex in the low half, its second in the high.
+		std::uint64_t Edges[EdgeCacheSize];
+		std::uint32_t EdgesPushed = 0;
+		std::uint32_t Vertices[VertexCacheSize];
+		std::uint32_t VerticesPushed = 0;
+		std::uint32_t Next = 0;
+		std::uint32_t Last = 0;
+
+		void PushVertex(std::uint32_t index)
+		{
+			Vertices[VerticesPushed++ % VertexCacheSize] = index;
+		}
+
+		static std::uint64_t MakeEdge(std::uint32_t from, std::uint32_t to)
+		{
+			return from | ((std::uint64_t)to << 32);
+		}
+
+		void PushTriangle(std::uint32_t a, std::uint32_t b, std::uint32_t c)
+		{
+			Edges[EdgesPushed++ % EdgeCacheSize] = MakeEdge(b, a);
+			Edges[EdgesPushed++ % EdgeCacheSize] = MakeEdge(c, b);
+			Edges[EdgesPushed++ % EdgeCacheSize] = MakeEdge(a, c);
+		}
+	};
+
+	// Codes index against the cache and updates it; see NextCode.
+	std::uint8_t EncodeVertex(IndexCache& cache, std::uint32_t index, std::uint32_t slotCount,
+		std::vector<std::uint8_t>& escapes)
+	{
+		std::uint8_t code;
+		if (index == cache.Next)
+		{
+			code = NextCode;
+			cache.PushVertex(index);
+			cache.Next++;
+		}
+		else
+		{
+			std::uint32_t filled = (std::min)(cache.VerticesPushed, slotCount);
+			std::uint32_t slot = 0;
+			while (slot < filled && cache.Vertices[(cache.VerticesPushed - 1 - slot) % VertexCacheSize] != index)
+				slot++;
+
+			code = (std::uint8_t)(1 + slot);
+			if (slot == filled)
+			{
+				code = (std::uint8_t)(slotCount + 1);
+				PutVarint(escapes, ZigZag32(index - cache.Last));
+				cache.PushVertex(index);
+				cache.Next = (std::max)(cache.Next, index + 1);
+			}
+		}
+		cache.Last = index;
+		return code;
+	}
+
+	inline bool DecodeVertex(IndexCache& cache, std::uint32_t code, std::uint32_t slotCount,
+		const std::uint8_t*& escapes, const std::uint8_t* escapesEnd, std::uint32_t& index)
+	{
+		if (code == NextCode)
+		{
+			index = cache.Next++;
+			cache.PushVertex(index);
+		}
+		else if (code <= slotCount)
+		{
+			if (code > cache.VerticesPushed)
+				return false;
+			index = cache.Vertices[(cache.VerticesPushed - code) % VertexCacheSize];
+		}
+		else if (code == slotCount + 1)
+		{
+			std::uint32_t value;
+			if (!ReadVarint(escapes, escapesEnd, value))
+				return false;
+			index = cache.Last + UnZigZag32(value);
+			cache.PushVertex(index);
+			cache.Next = (std::max)(cache.Next, index + 1);
+		}
+		else
+		{
+			return false;
+		}
+		cache.Last = index;
+		return true;
+	}
+
+	// Decodes indexCount indices from the index streams.  Returns null, or
+	// what is wrong with the streams.  Templated on the index type so the
+	// loop carries no test of the format.
+	template <typename Index>
+	const char* DecodeIndices(const std::vector<std::uint8_t> streams[StreamCount], const std::vector<std::uint32_t>& resets,
+		Index* indices, std::uint32_t indexCount)
+	{
+		const std::uint8_t* codes = streams[TriangleCodes].data();
+		const std::uint8_t* vertexCodes = streams[VertexCodes].data();
+		const std::uint8_t* vertexCodesEnd = vertexCodes + streams[VertexCodes].size();
+		const std::uint8_t* escapes = streams[IndexEscapes].data();
+		const std::uint8_t* escapesEnd = escapes + streams[IndexEscapes].size();
+
+		const std::uint32_t maxIndex = (std::numeric_limits<Index>::max)();
+
+		std::uint32_t triangleCount = indexCount / 3;
+		IndexCache cache;
+		std::size_t reset = 0;
+		std::uint32_t nextReset = resets.empty() ? triangleCount : resets[0];
+		for (std::uint32_t t = 0; t < triangleCount; ++t)
+		{
+			if (t == nextReset)
+			{
+				cache = IndexCache();
+				reset++;
+				nextReset = reset < resets.size() ? resets[reset] : triangleCount;
+			}
+
+			// The triangle's vertices stay in registers: selects rather than
+			// an array indexed by the rotation, which would send every
+			// triangle through memory on the way to the next.
+			std::uint32_t a, b, c;
+			std::uint8_t code = codes[t];
+			if (code != MissCode)
+			{
+				std::uint32_t slot = code & 7;
+				std::uint32_t rotation = (code >> 3) & 3;
+				if (slot >= cache.EdgesPushed || rotation > 2)
+					return "triangle refers to an empty edge slot";
+
+				std::uint64_t edge = cache.Edges[(cache.EdgesPushed - 1 - slot) % EdgeCacheSize];
+				std::uint32_t from = (std::uint32_t)edge;
+				std::uint32_t to = (std::uint32_t)(edge >> 32);
+				std::uint32_t third;
+				if (!DecodeVertex(cache, code >> 5, TriangleVertexSlots, escapes, escapesEnd, third))
+					return "corrupt triangle vertex";
+
+				a = rotation == 0 ? from : rotation == 1 ? third : to;
+				b = rotation == 0 ? to : rotation == 1 ? from : third;
+				c = rotation == 0 ? third : rotation == 1 ? to : from;
+			}
+			else
+			{
+				if (vertexCodesEnd - vertexCodes < 3 ||
+					!DecodeVertex(cache, vertexCodes[0], VertexCacheSize, escapes, escapesEnd, a) ||
+					!DecodeVertex(cache, vertexCodes[1], VertexCacheSize, escapes, escapesEnd, b) ||
+					!DecodeVertex(cache, vertexCodes[2], VertexCacheSize, escapes, escapesEnd, c))
+					return "corrupt vertex code";
+				vertexCodes += 3;
+			}
+
+			if (a > maxIndex || b > maxIndex || c > maxIndex)
+				return "index out of range for its format";
+
+			indices[(std::size_t)t * 3] = (Index)a;
+			indices[(std::size_t)t * 3 + 1] = (Index)b;
+			indices[(std::size_t)t * 3 + 2] = (Index)c;
+			cache.PushTriangle(a, b, c);
+		}
+
+		for (std::uint32_t i = triangleCount * 3; i < indexCount; ++i)
+		{
+			std::uint32_t index;
+			if (vertexCodes == vertexCodesEnd || !DecodeVertex(cache, *vertexCodes++, VertexCacheSize, escapes, escapesEnd, index))
+				return "corrupt vertex code";
+			if (index > maxIndex)
+				return "index out of range for its format";
+			indices[i] = (Index)index;
+		}
+
+		if (vertexCodes != vertexCodesEnd || escapes != escapesEnd)
+			return "unused index codes";
+		return nullptr;
+	}
+}
+
+std::vector<std::uint8_t> EncodeMesh(const MeshCodecVertex* vertices, std::uint32_t vertexCount,
+	const void* indices, std::uint32_t indexCount, bool indices16, const std::vector<MeshCodecSubmesh>& submeshes)
+{
+	std::vector<VertexRun> runs = BuildRuns(vertices, vertexCount, submeshes);
+
+	std::vector<std::uint8_t> streams[StreamCount];
+	streams[PositionLow].reserve((std::size_t)vertexCount * 3);
+	streams[PositionHigh].reserve((std::size_t)vertexCount * 3);
+	streams[FrameMasks].reserve(vertexCount);
+	streams[FrameLow].reserve((std::size_t)vertexCount * 4);
+	streams[FrameHigh].reserve((std::size_t)vertexCount * 4);
+	streams[TriangleCodes].reserve(indexCount / 3);
+
+	std::uint32_t v = 0;
+	for (const VertexRun& run : runs)
+	{
+		std::uint16_t prev[3] = {};
+		std::uint16_t prevFrame[4] = {};
+		for (std::uint32_t end = v + run.VertexCount; v < end; ++v)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				float scaled = run.Scale[a] > 0.0f ? (vertices[v].Pos[a] - run.Min[a]) / run.Scale[a] : 0.0f;
+				std::uint16_t q = (std::uint16_t)(std::min)((std::max)(std::lround(scaled), 0L), 65535L);
+				std::uint16_t z = ZigZag16((std::uint16_t)(q - prev[a]));
+				streams[PositionLow].push_back((std::uint8_t)z);
+				streams[PositionHigh].push_back((std::uint8_t)(z >> 8));
+				prev[a] = q;
+			}
+
+			// The packed normal and tangent halves, exactly: a mask of the
+			// halves that changed, then the changes.  Flat or smoothly
+			// repeating surfaces cost one symbol a vertex.
+			const std::uint16_t frame[4] =
+			{
+				(std::uint16_t)vertices[v].Normal, (std::uint16_t)(vertices[v].Normal >> 16),
+				(std::uint16_t)vertices[v].Tangent, (std::uint16_t)(vertices[v].Tangent >> 16)
+			};
+			std::uint8_t mask = 0;
+			for (int c = 0; c < 4; ++c)
+			{
+				if (frame[c] == prevFrame[c])
+					continue;
+
+				std::uint16_t z = ZigZag16((std::uint16_t)(frame[c] - prevFrame[c]));
+				streams[FrameLow].push_back((std::uint8_t)z);
+				streams[FrameHigh].push_back((std::uint8_t)(z >> 8));
+				prevFrame[c] = frame[c];
+				mask |= (std::uint8_t)(1 << c);
+			}
+			streams[FrameMasks].push_back(mask);
+		}
+	}
+
+	// Colors rarely change within a mesh: runs of one color, each a
+	// count and the color.
+	std::vector<std::uint32_t> colors(vertexCount);
+	for (v = 0; v < vertexCount; ++v)
+	{
+		std::uint8_t color[4];
+		for (int c = 0; c < 4; ++c)
+			color[c] = QuantizeColor(vertices[v].Color[c]);
+		std::memcpy(&colors[v], color, sizeof(color));
+	}
+	for (v = 0; v < vertexCount; )
+	{
+		std::uint32_t count = 1;
+		while (v + count < vertexCount && colors[v + count] == colors[v])
+			count++;
+
+		PutVarint(streams[ColorRuns], count);
+		const std::uint8_t* color = reinterpret_cast<const std::uint8_t*>(&colors[v]);
+		streams[ColorRuns].insert(streams[ColorRuns].end(), color, color + 4);
+		v += count;
+	}
+
+	// The cache restarts at each submesh that begins on a triangle.
+	std::uint32_t triangleCount = indexCount / 3;
+	std::vector<std::uint32_t> resets;
+	for (auto& submesh : submeshes)
+	{
+		if (submesh.FirstIndex % 3 == 0 && submesh.FirstIndex > 0 && submesh.FirstIndex / 3 < triangleCount)
+			resets.push_back(submesh.FirstIndex / 3);
+	}
+	std::sort(resets.begin(), resets.end());
+	resets.erase(std::unique(resets.begin(), resets.end()), resets.end());
+
+	IndexCache cache;
+	std::size_t reset = 0;
+	for (std::uint32_t t = 0; t < triangleCount; ++t)
+	{
+		if (reset < resets.size() && resets[reset] == t)
+		{
+			cache = IndexCache();
+			reset++;
+		}
+
+		std::uint32_t tri[3];
+		for (int k = 0; k < 3; ++k)
+			tri[k] = ReadIndex(indices, indices16, (std::size_t)t * 3 + k);
+
+		// The newest cached edge that starts a rotation of the triangle.
+		std::uint32_t filled = (std::min)(cache.EdgesPushed, EdgeCacheSize);
+		std::uint32_t slot = 0, rotation = 0;
+		for (; slot < filled; ++slot)
+		{
+			std::uint32_t e = (cache.EdgesPushed - 1 - slot) % EdgeCacheSize;
+			for (rotation = 0; rotation < 3; ++rotation)
+			{
+				if (cache.Edges[e] == IndexCache::MakeEdge(tri[rotation], tri[(rotation + 1) % 3]))
+					break;
+			}
+			if (rotation < 3)
+				break;
+		}
+
+		if (slot < filled)
+		{
+			std::uint8_t third = EncodeVertex(cache, tri[(rotation + 2) % 3], TriangleVertexSlots, streams[IndexEscapes]);
+			streams[TriangleCodes].push_back((std::uint8_t)(slot | (rotation << 3) | (third << 5)));
+		}
+		else
+		{
+			streams[TriangleCodes].push_back(MissCode);
+			for (int k = 0; k < 3; ++k)
+				streams[VertexCodes].push_back(EncodeVertex(cache, tri[k], VertexCacheSize, streams[IndexEscapes]));
+		}
+		cache.PushTriangle(tri[0], tri[1], tri[2]);
+	}
+
+	// Indices past the last whole triangle.
+	for (std::uint32_t i = triangleCount * 3; i < indexCount; ++i)
+		streams[VertexCodes].push_back(EncodeVertex(cache, ReadIndex(indices, indices16, i), VertexCacheSize, streams[IndexEscapes]));
+
+	std::vector<std::uint8_t> out;
+	Put32(out, Magic);
+	Put32(out, Version);
+	Put32(out, vertexCount);
+	Put32(out, indexCount);
+	Put32(out, indices16 ? 1u : 0u);
+
+	Put32(out, (std::uint32_t)runs.size());
+	for (const VertexRun& run : runs)
+	{
+		Put32(out, run.VertexCount);
+		for (int a = 0; a < 3; ++a)
+			PutFloat(out, run.Min[a]);
+		for (int a = 0; a < 3; ++a)
+			PutFloat(out, run.Scale[a]);
+	}
+
+	Put32(out, (std::uint32_t)resets.size());
+	for (std::uint32_t position : resets)
+		Put32(out, position);
+
+	for (auto& stream : streams)
+		PutStream(out, stream);
+
+	return out;
+}
+
+bool ReadMeshInfo(const std::uint8_t* data, std::size_t size, MeshCodecInfo& info)
+{
+	Reader reader = { data, data + size };
+	std::uint32_t magic, version, flags;
+	if (!reader.Read32(magic) || !reader.Read32(version) || magic != Magic || version != Version ||
+		!reader.Read32(info.VertexCount) || !reader.Read32(info.IndexCount) || !reader.Read32(flags))
+		return false;
+
+	info.Indices16 = (flags & 1) != 0;
+	return true;
+}
+
+bool DecodeMesh(const std::uint8_t* data, std::size_t size, MeshCodecVertex* vertices, void* indices,
+	std::string* error)
+{
+	MeshCodecInfo info;
+	if (!ReadMeshInfo(data, size, info))
+		return Fail(error, "not an encoded mesh");
+
+	Reader reader = { data + 20, data + size };
+
+	std::uint32_t runCount;
+	if (!reader.Read32(runCount) || !reader.Has((std::size_t)runCount * 28))
+		return Fail(error, "truncated vertex runs");
+
+	std::vector<VertexRun> runs(runCount);
+	std::uint64_t runVertices = 0;
+	for (VertexRun& run : runs)
+	{
+		reader.Read32(run.VertexCount);
+		for (int a = 0; a < 3; ++a)
+			reader.ReadFloat(run.Min[a]);
+		for (int a = 0; a < 3; ++a)
+			reader.ReadFloat(run.Scale[a]);
+		runVertices += run.VertexCount;
+	}
+	if (runVertices != info.VertexCount)
+		return Fail(error, "vertex runs do not cover the vertices");
+
+	std::uint32_t resetCount;
+	if (!reader.Read32(resetCount) || !reader.Has((std::size_t)resetCount * 4))
+		return Fail(error, "truncated index resets");
+
+	std::vector<std::uint32_t> resets(resetCount);
+	for (auto& position : resets)
+		reader.Read32(position);
+
+	// Scratch for the decoded streams, kept per thread between calls.
+	thread_local std::vector<std::uint8_t> streams[StreamCount];
+	std::uint32_t triangleCount = info.IndexCount / 3;
+	const std::size_t maxSizes[StreamCount] =
+	{
+		(std::size_t)info.VertexCount * 3,
+		(std::size_t)info.VertexCount * 3,
+		info.VertexCount,
+		(std::size_t)info.VertexCount * 4,
+		(std::size_t)info.VertexCount * 4,
+		(std::size_t)info.VertexCount * 9,
+		triangleCount,
+		info.IndexCount,
+		(std::size_t)info.IndexCount * 5
+	};
+	for (int s = 0; s < StreamCount; ++s)
+	{
+		bool exactSize = s == PositionLow || s == PositionHigh || s == FrameMasks || s == TriangleCodes;
+		if (!ReadStream(reader, streams[s], maxSizes[s]) || (exactSize && streams[s].size() != maxSizes[s]))
+			return Fail(error, "corrupt stream");
+	}
+
+	// Every changed frame half takes one byte of each frame stream.
+	std::size_t frameChanges = 0;
+	for (std::uint8_t mask : streams[FrameMasks])
+	{
+		if (mask > 0xF)
+			return Fail(error, "corrupt frame mask");
+		frameChanges += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + (mask >> 3);
+	}
+	if (streams[FrameLow].size() != frameChanges || streams[FrameHigh].size() != frameChanges)
+		return Fail(error, "frame changes do not match their masks");
+
+	const std::uint8_t* low = streams[PositionLow].data();
+	const std::uint8_t* high = streams[PositionHigh].data();
+	const std::uint8_t* frameMasks = streams[FrameMasks].data();
+	const std::uint8_t* frameLow = streams[FrameLow].data();
+	const std::uint8_t* frameHigh = streams[FrameHigh].data();
+	MeshCodecVertex* vertex = vertices;
+	for (const VertexRun& run : runs)
+	{
+		// Locals, as the float stores below could otherwise alias the run.
+		const float minX = run.Min[0], minY = run.Min[1], minZ = run.Min[2];
+		const float scaleX = run.Scale[0], scaleY = run.Scale[1], scaleZ = run.Scale[2];
+		std::uint16_t x = 0, y = 0, z = 0;
+		std::uint16_t frame[4] = {};
+		for (std::uint32_t k = 0; k < run.VertexCount; ++k, ++vertex, low += 3, high += 3)
+		{
+			x = (std::uint16_t)(x + UnZigZag16((std::uint16_t)(low[0] | (high[0] << 8))));
+			y = (std::uint16_t)(y + UnZigZag16((std::uint16_t)(low[1] | (high[1] << 8))));
+			z = (std::uint16_t)(z + UnZigZag16((std::uint16_t)(low[2] | (high[2] << 8))));
+			vertex->Pos[0] = minX + x * scaleX;
+			vertex->Pos[1] = minY + y * scaleY;
+			vertex->Pos[2] = minZ + z * scaleZ;
+
+			// Mostly all four halves or none, so those skip the per-half tests.
+			std::uint32_t mask = *frameMasks++;
+			if (mask == 0xF)
+			{
+				for (int c = 0; c < 4; ++c)
+					frame[c] = (std::uint16_t)(frame[c] + UnZigZag16((std::uint16_t)(frameLow[c] | (frameHigh[c] << 8))));
+				frameLow += 4;
+				frameHigh += 4;
+			}
+			else if (mask != 0)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					if (mask & (1u << c))
+						frame[c] = (std::uint16_t)(frame[c] + UnZigZag16((std::uint16_t)(*frameLow++ | (*frameHigh++ << 8))));
+				}
+			}
+			vertex->Normal = frame[0] | ((std::uint32_t)frame[1] << 16);
+			vertex->Tangent = frame[2] | ((std::uint32_t)frame[3] << 16);
+		}
+	}
+
+	const float* colorValues = ColorValues().Values;
+	const std::uint8_t* colorRuns = streams[ColorRuns].data();
+	const std::uint8_t* colorRunsEnd = colorRuns + streams[ColorRuns].size();
+	for (std::uint32_t v = 0; v < info.VertexCount; )
+	{
+		std::uint32_t count;
+		if (!ReadVarint(colorRuns, colorRunsEnd, count))
+			return Fail(error, "corrupt color run");
+		if (count == 0 || count > info.VertexCount - v || colorRunsEnd - colorRuns < 4)
+			return Fail(error, "corrupt color run");
+
+		const float color[4] = { colorValues[colorRuns[0]], colorValues[colorRuns[1]], colorValues[colorRuns[2]], colorValues[colorRuns[3]] };
+		colorRuns += 4;
+		for (std::uint32_t end = v + count; v < end; ++v)
+			std::memcpy(vertices[v].Color, color, sizeof(color));
+	}
+
+	const char* indexError = info.Indices16 ?
+		DecodeIndices(streams, resets, static_cast<std::uint16_t*>(indices), info.IndexCount) :
+		DecodeIndices(streams, resets, static_cast<std::uint32_t*>(indices), info.IndexCount);
+	if (indexError != nullptr)
+		return Fail(error, indexError);
+
+	return true;
+}
+
+MeshCodecBenchResult RunMeshCodecBenchmark(const MeshCodecVertex* vertices, std::uint32_t vertexCount,
+	const void* indices, std::uint32_t indexCount, bool indices16, const std::vector<MeshCodecSubmesh>& submeshes,
+	int iterations)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	MeshCodecBenchResult result;
+	std::size_t indexBytes = (std::size_t)indexCount * (indices16 ? 2 : 4);
+	result.RawBytes = (std::size_t)vertexCount * sizeof(MeshCodecVertex) + indexBytes;
+
+	int encodeIterations = (std::max)(iterations / 10, 1);
+	std::vector<std::uint8_t> encoded;
+	auto start = Clock::now();
+	for (int i = 0; i < encodeIterations; ++i)
+		encoded = EncodeMesh(vertices, vertexCount, indices, indexCount, indices16, submeshes);
+	double encodeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	result.EncodedBytes = encoded.size();
+	result.Ratio = (double)result.RawBytes / encoded.size();
+	result.EncodeMBPerSecond = result.RawBytes * (double)encodeIterations / encodeSeconds / 1e6;
+
+	std::vector<MeshCodecVertex> decodedVertices(vertexCount);
+	std::vector<std::uint8_t> decodedIndices(indexBytes);
+
+	// One untimed decode warms the caches and the scratch streams.
+	bool decoded = DecodeMesh(encoded.data(), encoded.size(), decodedVertices.data(), decodedIndices.data());
+
+	// Each decode is timed on its own and the median kept, so a thread
+	// preempted now and then on a busy machine does not drag the figure.
+	std::vector<double> decodeSeconds;
+	decodeSeconds.reserve(iterations);
+	for (int i = 0; i < iterations && decoded; ++i)
+	{
+		start = Clock::now();
+		decoded = DecodeMesh(encoded.data(), encoded.size(), decodedVertices.data(), decodedIndices.data());
+		decodeSeconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+	}
+	if (!decodeSeconds.empty())
+	{
+		std::nth_element(decodeSeconds.begin(), decodeSeconds.begin() + decodeSeconds.size() / 2, decodeSeconds.end());
+		result.DecodeGBPerSecond = result.RawBytes / decodeSeconds[decodeSeconds.size() / 2] / 1e9;
+	}
+
+	if (!decoded)
+		return result;
+
+	result.IndicesMatch = indexBytes == 0 || std::memcmp(decodedIndices.data(), indices, indexBytes) == 0;
+
+	// Positions are checked against the step of the bounds they were
+	// quantized in, plus float rounding of the decode.
+	std::vector<VertexRun> runs = BuildRuns(vertices, vertexCount, submeshes);
+	bool withinBounds = true;
+	result.FramesMatch = true;
+	std::uint32_t v = 0;
+	for (const VertexRun& run : runs)
+	{
+		for (std::uint32_t end = v + run.VertexCount; v < end; ++v)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				float error = std::fabs(decodedVertices[v].Pos[a] - vertices[v].Pos[a]);
+				float bound = 0.5f * run.Scale[a] + 4.0f * std::numeric_limits<float>::epsilon() *
+					(std::fabs(run.Min[a]) + 65535.0f * run.Scale[a]);
+				result.MaxPositionError = (std::max)(result.MaxPositionError, error);
+				result.MaxPositionErrorBound = (std::max)(result.MaxPositionErrorBound, bound);
+				withinBounds = withinBounds && error <= bound;
+			}
+			result.FramesMatch = result.FramesMatch && decodedVertices[v].Normal == vertices[v].Normal &&
+				decodedVertices[v].Tangent == vertices[v].Tangent;
+			for (int c = 0; c < 4; ++c)
+			{
+				float source = (std::min)((std::max)(vertices[v].Color[c], 0.0f), 1.0f);
+				result.MaxColorError = (std::max)(result.MaxColorError, std::fabs(decodedVertices[v].Color[c] - source));
+			}
+		}
+	}
+
+	result.Passed = result.IndicesMatch && result.FramesMatch && withinBounds && result.MaxColorError <= 0.5f / 255.0f + 1e-6f;
+	return result;
+}
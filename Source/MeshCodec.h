@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Layout of the app's Vertex (FrameResource.h), which DecodeMesh writes
+// in place.
+struct MeshCodecVertex
+{
+	float Pos[3];
+	float Color[4];
+	std::uint32_t Normal;
+	std::uint32_t Tangent;
+};
+
+// A submesh's vertex and index ranges and its bounds, as in
+// SubmeshGeometry.  Its indices are relative to FirstVertex.
+struct MeshCodecSubmesh
+{
+	std::uint32_t FirstVertex = 0;
+	std::uint32_t VertexCount = 0;
+	std::uint32_t FirstIndex = 0;
+	std::uint32_t IndexCount = 0;
+	float BoundsCenter[3] = {};
+	float BoundsExtents[3] = {};
+};
+
+struct MeshCodecInfo
+{
+	std::uint32_t VertexCount = 0;
+	std::uint32_t IndexCount = 0;
+	bool Indices16 = false;
+};
+
+// Compresses a mesh for storage:
+// - Positions are quantized to 16 bits per axis against the bounds of the
+//   submesh that holds them (grown to fit, if a vertex pokes out), and
+//   delta coded against the vertex before.  Vertices outside every submesh
+//   use the bounds of all of them.
+// - Colors are quantized to 8 bits per channel, clamped to [0, 1], and
+//   stored as runs of one color.
+// - Packed normals and tangents are kept exactly, each 16-bit half delta
+//   coded against the vertex before.  A mask per vertex says which halves
+//   changed, and only those are stored.
+// - Triangles that share an edge with one of the last eight seen become a
+//   byte: the edge, and the third vertex as the next unused one, a slot of
+//   a FIFO of recently missed vertices (a model of the post-transform
+//   vertex cache), or an escape with its difference from the last index.
+//   Other triangles code their three vertices that way.  The caches
+//   restart at each submesh's FirstIndex.
+// - Every resulting byte stream is rANS coded against its own order-0
+//   statistics, or stored as is when that does not pay.
+// Indices are kept exactly, in their 16 or 32-bit format and triangle
+// order.
+std::vector<std::uint8_t> EncodeMesh(const MeshCodecVertex* vertices, std::uint32_t vertexCount,
+	const void* indices, std::uint32_t indexCount, bool indices16, const std::vector<MeshCodecSubmesh>& submeshes);
+
+// Reads the counts from an encoded mesh's header, to size the buffers
+// DecodeMesh writes.
+bool ReadMeshInfo(const std::uint8_t* data, std::size_t size, MeshCodecInfo& info);
+
+// Decodes into info.VertexCount vertices and info.IndexCount indices of
+// the encoded format.  On malformed input returns false and describes why
+// in error; it never reads past size bytes or writes past those counts.
+bool DecodeMesh(const std::uint8_t* data, std::size_t size, MeshCodecVertex* vertices, void* indices,
+	std::string* error = nullptr);
+
+struct MeshCodecBenchResult
+{
+	std::size_t RawBytes = 0;
+	std::size_t EncodedBytes = 0;
+	double Ratio = 0.0;
+	double EncodeMBPerSecond = 0.0;
+	double DecodeGBPerSecond = 0.0;
+
+	// Round trip checks: indices and packed normals and tangents must match
+	// exactly, positions within half a quantization step of their submesh
+	// bounds, colors within half of 1/255.
+	bool IndicesMatch = false;
+	bool FramesMatch = false;
+	float MaxPositionError = 0.0f;
+	float MaxPositionErrorBound = 0.0f;
+	float MaxColorError = 0.0f;
+	bool Passed = false;
+};
+
+// Encodes the mesh, decodes it iterations times on the calling thread and
+// checks the result against the source.  Throughput is measured against
+// the raw size: the vertex and index bytes decoded per second, in the
+// median decode.
+MeshCodecBenchResult RunMeshCodecBenchmark(const MeshCodecVertex* vertices, std::uint32_t vertexCount,
+	const void* indices, std::uint32_t indexCount, bool indices16, const std::vector<MeshCodecSubmesh>& submeshes,
+	int iterations);
@@ -0,0 +1,321 @@
+#include "MipGenerator.h"
+#include "DDSFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2 1
+#endif
+
+namespace
+{
+	// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and
+	// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT.
+	const std::uint32_t RowPitchAlignment = 256;
+	const std::uint64_t PlacementAlignment = 512;
+
+	// Rows per job.  Small levels end up as a single job.
+	const std::size_t RowGrain = 16;
+
+	// Kaiser window shape and reach, in texels of the new level.
+	const float KaiserAlpha = 4.0f;
+	const float KaiserWidth = 3.0f;
+
+	const float Pi = 3.14159265f;
+
+	struct Tap
+	{
+		std::uint32_t Source = 0;
+		float Weight = 0.0f;
+	};
+
+	// For each texel along one side of the new level, the texels of the old
+	// level it blends.
+	typedef std::vector<std::vector<Tap>> AxisTaps;
+
+	AxisTaps BoxTaps(std::uint32_t srcSize, std::uint32_t dstSize)
+	{
+		AxisTaps taps(dstSize);
+		for (std::uint32_t i = 0; i < dstSize; ++i)
+		{
+			if (srcSize == 1)
+			{
+				taps[i] = { { 0, 1.0f } };
+			}
+			else if (srcSize % 2 == 0)
+			{
+				taps[i] = { { 2 * i, 0.5f }, { 2 * i + 1, 0.5f } };
+			}
+			else
+			{
+				// An odd side of 2n+1 texels shrinks to n, each new texel
+				// covering 2 + 1/n old ones.
+				float n = (float)dstSize;
+				float total = 2.0f * n + 1.0f;
+				taps[i] = { { 2 * i, (n - i) / total }, { 2 * i + 1, n / total }, { 2 * i + 2, (i + 1) / total } };
+			}
+		}
+		return taps;
+	}
+
+	// Zeroth order modified Bessel function of the first kind, by its series.
+	float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 20; ++k)
+		{
+			term *= (x * 0.5f / k) * (x * 0.5f / k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	float KaiserSinc(float x)
+	{
+		float t = x / KaiserWidth;
+		if (t <= -1.0f || t >= 1.0f)
+			return 0.0f;
+
+		float sinc = x == 0.0f ? 1.0f : std::sin(Pi * x) / (Pi * x);
+		return sinc * BesselI0(KaiserAlpha * std::sqrt(1.0f - t * t)) / BesselI0(KaiserAlpha);
+	}
+
+	AxisTaps KaiserTaps(std::uint32_t srcSize, std::uint32_t dstSize)
+	{
+		AxisTaps taps(dstSize);
+		float scale = (float)srcSize / dstSize;
+		for (std::uint32_t i = 0; i < dstSize; ++i)
+		{
+			// Kernel centered on the new texel, measured in new texels, so it
+			// cuts off at the new level's Nyquist rate.  Texels past the
+			// edges repeat the edge.
+			float center = (i + 0.5f) * scale;
+			int first = (int)std::floor(center - KaiserWidth * scale);
+			int last = (int)std::ceil(center + KaiserWidth * scale);
+
+			float total = 0.0f;
+			for (int s = first; s <= last; ++s)
+			{
+				float weight = KaiserSinc((s + 0.5f - center) / scale);
+				if (weight == 0.0f)
+					continue;
+
+				std::uint32_t source = (std::uint32_t)(std::min)((std::max)(s, 0), (int)srcSize - 1);
+				if (!taps[i].empty() && taps[i].back().Source == source)
+					taps[i].back().Weight += weight;
+				else
+					taps[i].push_back({ source, weight });
+				total += weight;
+			}
+
+			for (auto& tap : taps[i])
+				tap.Weight /= total;
+		}
+		return taps;
+	}
+
+	// Weighted sum of RGBA texels base + tap.Source * stride.
+	void Blend(const float* base, std::size_t stride, const std::vector<Tap>& taps, float* out)
+	{
+#if MIP_GENERATOR_SSE2
+		__m128 sum = _mm_setzero_ps();
+		for (auto& tap : taps)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(base + tap.Source * stride), _mm_set1_ps(tap.Weight)));
+		_mm_storeu_ps(out, sum);
+#else
+		float sum[4] = {};
+		for (auto& tap : taps)
+		{
+			for (int c = 0; c < 4; ++c)
+				sum[c] += base[tap.Source * stride + c] * tap.Weight;
+		}
+		std::memcpy(out, sum, sizeof(sum));
+#endif
+	}
+
+	// Filters a level of linear RGBA floats down to the next, across the
+	// rows first and then down the columns.
+	void Downsample(const std::vector<float>& src, std::uint32_t srcWidth, std::uint32_t srcHeight,
+		std::vector<float>& dst, std::uint32_t dstWidth, std::uint32_t dstHeight, MipFilter filter, ThreadPool& pool)
+	{
+		AxisTaps xTaps = filter == MipFilter::Box ? BoxTaps(srcWidth, dstWidth) : KaiserTaps(srcWidth, dstWidth);
+		AxisTaps yTaps = filter == MipFilter::Box ? BoxTaps(srcHeight, dstHeight) : KaiserTaps(srcHeight, dstHeight);
+
+		std::vector<float> rows((std::size_t)dstWidth * srcHeight * 4);
+		pool.ParallelFor(srcHeight, RowGrain, [&](std::size_t y)
+		{
+			const float* srcRow = src.data() + y * srcWidth * 4;
+			float* row = rows.data() + y * dstWidth * 4;
+			for (std::uint32_t x = 0; x < dstWidth; ++x)
+				Blend(srcRow, 4, xTaps[x], row + x * 4);
+		});
+
+		dst.resize((std::size_t)dstWidth * dstHeight * 4);
+		pool.ParallelFor(dstHeight, RowGrain, [&](std::size_t y)
+		{
+			float* dstRow = dst.data() + y * dstWidth * 4;
+			for (std::uint32_t x = 0; x < dstWidth; ++x)
+				Blend(rows.data() + x * 4, (std::size_t)dstWidth * 4, yTaps[y], dstRow + x * 4);
+		});
+	}
+
+	float SRGBToLinear(float v)
+	{
+		return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+	}
+
+	// Decoding is a lookup; encoding searches the linear values halfway
+	// between neighbouring codes, so it rounds like an exact conversion.
+	struct SRGBTables
+	{
+		float Decode[256];
+		float Thresholds[255];
+
+		SRGBTables()
+		{
+			for (int i = 0; i < 256; ++i)
+				Decode[i] = SRGBToLinear(i / 255.0f);
+			for (int i = 0; i < 255; ++i)
+				Thresholds[i] = SRGBToLinear((i + 0.5f) / 255.0f);
+		}
+
+		std::uint8_t Encode(float v)const
+		{
+			return (std::uint8_t)(std::upper_bound(Thresholds, Thresholds + 255, v) - Thresholds);
+		}
+	};
+
+	const SRGBTables& Tables()
+	{
+		static const SRGBTables tables;
+		return tables;
+	}
+
+	std::uint8_t EncodeLinear(float v)
+	{
+		return (std::uint8_t)(std::min)((std::max)(v * 255.0f + 0.5f, 0.0f), 255.0f);
+	}
+}
+
+std::uint32_t FullMipCount(std::uint32_t width, std::uint32_t height)
+{
+	std::uint32_t count = 1;
+	for (std::uint32_t extent = (std::max)(width, height); extent > 1; extent >>= 1)
+		count++;
+	return count;
+}
+
+void GenerateMipChain(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height, std::size_t rowPitch,
+	bool srgb, MipFilter filter, ThreadPool& pool, MipChain& chain, std::uint32_t mipCount)
+{
+	std::uint32_t fullCount = FullMipCount(width, height);
+	if (mipCount == 0 || mipCount > fullCount)
+		mipCount = fullCount;
+
+	chain.Levels.resize(mipCount);
+	std::uint64_t size = 0;
+	for (std::uint32_t mip = 0; mip < mipCount; ++mip)
+	{
+		MipChainLevel& level = chain.Levels[mip];
+		level.Width = (std::max)(width >> mip, 1u);
+		level.Height = (std::max)(height >> mip, 1u);
+		level.RowPitch = (level.Width * 4 + RowPitchAlignment - 1) & ~(RowPitchAlignment - 1);
+		level.Offset = size;
+
+		size = level.Offset + (std::uint64_t)(level.Height - 1) * level.RowPitch + level.Width * 4;
+		size = (size + PlacementAlignment - 1) & ~(PlacementAlignment - 1);
+	}
+	chain.Data.assign((std::size_t)size, 0);
+
+	const SRGBTables& tables = Tables();
+
+	// Level 0 is copied as is, and decoded to linear floats for filtering.
+	// Later levels are filtered from the floats of the one above, so
+	// rounding never compounds down the chain.
+	std::vector<float> current((std::size_t)width * height * 4);
+	pool.ParallelFor(height, RowGrain, [&](std::size_t y)
+	{
+		const std::uint8_t* src = rgba + y * rowPitch;
+		std::memcpy(chain.Data.data() + y * chain.Levels[0].RowPitch, src, (std::size_t)width * 4);
+
+		float* dst = current.data() + y * width * 4;
+		for (std::uint32_t i = 0; i < width * 4; ++i)
+			dst[i] = srgb && i % 4 != 3 ? tables.Decode[src[i]] : src[i] / 255.0f;
+	});
+
+	std::vector<float> next;
+	for (std::uint32_t mip = 1; mip < mipCount; ++mip)
+	{
+		const MipChainLevel& above = chain.Levels[mip - 1];
+		const MipChainLevel& level = chain.Levels[mip];
+		Downsample(current, above.Width, above.Height, next, level.Width, level.Height, filter, pool);
+
+		pool.ParallelFor(level.Height, RowGrain, [&](std::size_t y)
+		{
+			const float* src = next.data() + y * level.Width * 4;
+			std::uint8_t* dst = chain.Data.data() + level.Offset + y * level.RowPitch;
+			for (std::uint32_t i = 0; i < level.Width * 4; ++i)
+				dst[i] = srgb && i % 4 != 3 ? tables.Encode(src[i]) : EncodeLinear(src[i]);
+		});
+
+		current.swap(next);
+	}
+}
+
+bool GenerateDDSMips(const std::vector<std::uint8_t>& source, MipFilter filter, ThreadPool& pool,
+	std::vector<std::uint8_t>& result, std::string* error)
+{
+	DDSImage image;
+	if (!ParseDDS(source.data(), source.size(), image, error))
+		return false;
+
+	// The channel order does not matter to the filter, only where alpha is.
+	bool srgb = false;
+	switch (image.Format)
+	{
+	case DDSFormat::R8G8B8A8Unorm:
+	case DDSFormat::B8G8R8A8Unorm:
+	case DDSFormat::B8G8R8X8Unorm:
+		break;
+	case DDSFormat::R8G8B8A8UnormSrgb:
+	case DDSFormat::B8G8R8A8UnormSrgb:
+		srgb = true;
+		break;
+	default:
+		if (error != nullptr)
+			*error = "source must hold 8-bit RGBA or BGRA texels";
+		return false;
+	}
+
+	DDSImage mipped = image;
+	mipped.MipCount = FullMipCount(image.Width, image.Height);
+	mipped.Mips.clear();
+
+	result.clear();
+	WriteDDSHeader(mipped, result);
+
+	// DDS rows are tightly packed, unlike the chain's.
+	MipChain chain;
+	for (std::uint32_t slice = 0; slice < image.ArraySize; ++slice)
+	{
+		const DDSMipLevel& top = image.Mip(slice, 0);
+		GenerateMipChain(source.data() + top.Offset, top.Width, top.Height, (std::size_t)top.RowPitch,
+			srgb, filter, pool, chain);
+
+		for (auto& level : chain.Levels)
+		{
+			for (std::uint32_t y = 0; y < level.Height; ++y)
+			{
+				const std::uint8_t* row = chain.Data.data() + level.Offset + (std::size_t)y * level.RowPitch;
+				result.insert(result.end(), row, row + level.Width * 4);
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// How each level is filtered from the one above it.
+// - Box: the average of the 2x2 texels under each texel (3 wide on odd
+//   sides), cheap and slightly blurry.
+// - Kaiser: a Kaiser windowed sinc over three texels of the new level on
+//   either side, sharper with less aliasing.
+enum class MipFilter
+{
+	Box,
+	Kaiser
+};
+
+// One level of a MipChain.  Rows are RowPitch bytes apart and levels start
+// at Offset, both aligned the way ID3D12Device::GetCopyableFootprints
+// lays out an R8G8B8A8 texture in an upload buffer (256 byte rows, 512
+// byte subresources), so the chain can be copied as is to any 512 byte
+// aligned spot of an upload buffer and copied from there level by level.
+struct MipChainLevel
+{
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+	std::uint32_t RowPitch = 0;
+	std::uint64_t Offset = 0;
+};
+
+struct MipChain
+{
+	std::vector<MipChainLevel> Levels;
+	std::vector<std::uint8_t> Data;
+};
+
+// Levels in a full chain down to 1x1.
+std::uint32_t FullMipCount(std::uint32_t width, std::uint32_t height);
+
+// Builds mipCount levels (0 for a full chain) from a width x height image of
+// 8-bit RGBA texels, rowPitch bytes per row.  Level 0 is the image itself.
+// Filtering happens on linear values in float: with srgb the color
+// channels are decoded from sRGB first and encoded again for each level
+// (alpha is always linear).  The rows of each level are spread across pool.
+void GenerateMipChain(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height, std::size_t rowPitch,
+	bool srgb, MipFilter filter, ThreadPool& pool, MipChain& chain, std::uint32_t mipCount = 0);
+
+// Gives a DDS file of 8-bit RGBA or BGRA texels a full mip chain, built
+// from its top level, and returns it as a new DDS file.  On failure
+// returns false and describes why in error.
+bool GenerateDDSMips(const std::vector<std::uint8_t>& source, MipFilter filter, ThreadPool& pool,
+	std::vector<std::uint8_t>& result, std::string* error = nullptr);
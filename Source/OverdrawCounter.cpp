@@ -0,0 +1,64 @@
+#include "OverdrawCounter.h"
+
+OverdrawCounter::OverdrawCounter(ID3D12Device* device, UINT frameCount)
+	: mFrameCount(frameCount)
+{
+	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_PIPELINE_STATISTICS;
+	queryHeapDesc.Count = frameCount;
+	queryHeapDesc.NodeMask = 0;
+	ThrowIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&mQueryHeap)));
+
+	UINT64 byteSize = frameCount * sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS);
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&mReadbackBuffer)));
+}
+
+OverdrawCounter::~OverdrawCounter()
+{
+}
+
+void OverdrawCounter::Begin(ID3D12GraphicsCommandList* cmdList, UINT frameIndex)
+{
+	cmdList->BeginQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_PIPELINE_STATISTICS, frameIndex);
+}
+
+void OverdrawCounter::End(ID3D12GraphicsCommandList* cmdList, UINT frameIndex)
+{
+	cmdList->EndQuery(mQueryHeap.Get(), D3D12_QUERY_TYPE_PIPELINE_STATISTICS, frameIndex);
+
+	cmdList->ResolveQueryData(mQueryHeap.Get(), D3D12_QUERY_TYPE_PIPELINE_STATISTICS,
+		frameIndex, 1, mReadbackBuffer.Get(), frameIndex * sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS));
+}
+
+void OverdrawCounter::Readback(UINT frameIndex)
+{
+	SIZE_T begin = frameIndex * sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS);
+	D3D12_RANGE readRange = { begin, begin + sizeof(D3D12_QUERY_DATA_PIPELINE_STATISTICS) };
+
+	BYTE* mappedData = nullptr;
+	ThrowIfFailed(mReadbackBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mappedData)));
+	mLastStats = *reinterpret_cast<D3D12_QUERY_DATA_PIPELINE_STATISTICS*>(mappedData + begin);
+
+	// We did not write anything.
+	D3D12_RANGE writeRange = { 0, 0 };
+	mReadbackBuffer->Unmap(0, &writeRange);
+}
+
+UINT64 OverdrawCounter::PixelShaderInvocations()const
+{
+	return mLastStats.PSInvocations;
+}
+
+float OverdrawCounter::Overdraw(UINT pixelCount)const
+{
+	if (pixelCount == 0)
+		return 0.0f;
+
+	return (float)((double)mLastStats.PSInvocations / pixelCount);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+
+// Counts pixel shader invocations with a pipeline statistics query, one query
+// per frame resource, so we can tell how many times each pixel was shaded.
+// The counters for a frame are available once the GPU has finished it.
+class OverdrawCounter
+{
+public:
+	OverdrawCounter(ID3D12Device* device, UINT frameCount);
+	OverdrawCounter(const OverdrawCounter& rhs) = delete;
+	OverdrawCounter& operator=(const OverdrawCounter& rhs) = delete;
+	~OverdrawCounter();
+
+	void Begin(ID3D12GraphicsCommandList* cmdList, UINT frameIndex);
+
+	// Ends the query and resolves it into the readback buffer.
+	void End(ID3D12GraphicsCommandList* cmdList, UINT frameIndex);
+
+	// Fetches the resolved counters for frameIndex.  Only call this once the
+	// fence for that frame has been reached.
+	void Readback(UINT frameIndex);
+
+	UINT64 PixelShaderInvocations()const;
+
+	// Average number of pixel shader invocations per pixel of the target.
+	float Overdraw(UINT pixelCount)const;
+
+private:
+	UINT mFrameCount = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> mQueryHeap = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mReadbackBuffer = nullptr;
+
+	D3D12_QUERY_DATA_PIPELINE_STATISTICS mLastStats = {};
+};
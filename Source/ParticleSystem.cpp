@@ -0,0 +1,449 @@
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PARTICLE_SYSTEM_SSE2 1
+#endif
+
+namespace
+{
+	// Particles per job.  A multiple of 4, so only a type's last chunk has
+	// a scalar tail.
+	const std::size_t ChunkSize = 16384;
+
+	// Emitters per birth job: the scene's emitters give birth to a few
+	// particles a step each, too little for a job of their own.
+	const std::size_t EmittersPerJob = 8;
+
+	std::size_t ChunkCount(std::size_t count)
+	{
+		return (count + ChunkSize - 1) / ChunkSize;
+	}
+
+	std::uint32_t PackColor(float r, float g, float b, float a)
+	{
+		return (std::uint32_t)(r * 255.0f + 0.5f) | ((std::uint32_t)(g * 255.0f + 0.5f) << 8) |
+			((std::uint32_t)(b * 255.0f + 0.5f) << 16) | ((std::uint32_t)(a * 255.0f + 0.5f) << 24);
+	}
+
+	// xorshift32, 24 bits of it as a float in [0, 1).
+	float Random(std::uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+}
+
+int ParticleSystem::AddType(const ParticleEmitterDesc& desc, std::size_t capacity)
+{
+	ParticleType type;
+	type.Desc = desc;
+	type.Capacity = capacity;
+	for (auto* component : { &type.PosX, &type.PosY, &type.PosZ, &type.VelX, &type.VelY, &type.VelZ,
+		&type.Age, &type.InvLifetime })
+	{
+		component->resize(capacity);
+	}
+	mTypes.push_back(std::move(type));
+	return (int)mTypes.size() - 1;
+}
+
+void ParticleSystem::AddEmitter(int type, float x, float y, float z)
+{
+	Emitter emitter;
+	emitter.Position[0] = x;
+	emitter.Position[1] = y;
+	emitter.Position[2] = z;
+
+	// Each emitter draws from its own sequence, so they can give birth side
+	// by side; xorshift never steps a nonzero state to zero.
+	Random(mRandomState);
+	emitter.RandomState = mRandomState;
+	mTypes[type].Emitters.push_back(emitter);
+}
+
+void ParticleSystem::Simulate(float dt, ThreadPool& pool)
+{
+	for (ParticleType& type : mTypes)
+	{
+		const std::size_t chunkCount = ChunkCount(type.Count);
+		if (mDead.size() < chunkCount)
+			mDead.resize(chunkCount);
+
+		const float damping = std::pow(type.Desc.Damping, dt);
+		const float accelX = type.Desc.Acceleration[0] * dt;
+		const float accelY = type.Desc.Acceleration[1] * dt;
+		const float accelZ = type.Desc.Acceleration[2] * dt;
+
+		pool.ParallelFor(chunkCount, 1, [&](std::size_t chunk)
+		{
+			// Locals, so the stores below cannot be taken to alias the type.
+			float* posX = type.PosX.data();
+			float* posY = type.PosY.data();
+			float* posZ = type.PosZ.data();
+			float* velX = type.VelX.data();
+			float* velY = type.VelY.data();
+			float* velZ = type.VelZ.data();
+			float* age = type.Age.data();
+			const float* invLifetime = type.InvLifetime.data();
+
+			std::vector<std::uint32_t>& dead = mDead[chunk];
+			dead.clear();
+
+			std::size_t i = chunk * ChunkSize;
+			const std::size_t end = (std::min)(i + ChunkSize, type.Count);
+#if PARTICLE_SYSTEM_SSE2
+			const __m128 step = _mm_set1_ps(dt);
+			const __m128 keep = _mm_set1_ps(damping);
+			const __m128 ax = _mm_set1_ps(accelX);
+			const __m128 ay = _mm_set1_ps(accelY);
+			const __m128 az = _mm_set1_ps(accelZ);
+			const __m128 one = _mm_set1_ps(1.0f);
+			for (; i + 4 <= end; i += 4)
+			{
+				__m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(velX + i), keep), ax);
+				__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(velY + i), keep), ay);
+				__m128 vz = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(velZ + i), keep), az);
+				_mm_storeu_ps(velX + i, vx);
+				_mm_storeu_ps(velY + i, vy);
+				_mm_storeu_ps(velZ + i, vz);
+				_mm_storeu_ps(posX + i, _mm_add_ps(_mm_loadu_ps(posX + i), _mm_mul_ps(vx, step)));
+				_mm_storeu_ps(posY + i, _mm_add_ps(_mm_loadu_ps(posY + i), _mm_mul_ps(vy, step)));
+				_mm_storeu_ps(posZ + i, _mm_add_ps(_mm_loadu_ps(posZ + i), _mm_mul_ps(vz, step)));
+
+				__m128 t = _mm_add_ps(_mm_loadu_ps(age + i), _mm_mul_ps(_mm_loadu_ps(invLifetime + i), step));
+				_mm_storeu_ps(age + i, t);
+
+				int died = _mm_movemask_ps(_mm_cmpge_ps(t, one));
+				for (int lane = 0; died != 0; ++lane, died >>= 1)
+				{
+					if (died & 1)
+						dead.push_back((std::uint32_t)(i + lane));
+				}
+			}
+#endif
+			for (; i < end; ++i)
+			{
+				velX[i] = velX[i] * damping + accelX;
+				velY[i] = velY[i] * damping + accelY;
+				velZ[i] = velZ[i] * damping + accelZ;
+				posX[i] += velX[i] * dt;
+				posY[i] += velY[i] * dt;
+				posZ[i] += velZ[i] * dt;
+				age[i] += invLifetime[i] * dt;
+				if (age[i] >= 1.0f)
+					dead.push_back((std::uint32_t)i);
+			}
+		});
+
+		Compact(type, chunkCount, pool);
+		Emit(type, dt, pool);
+	}
+}
+
+void ParticleSystem::Compact(ParticleType& type, std::size_t chunkCount, ThreadPool& pool)
+{
+	// The survivors end up in [0, alive): dead particles below alive are
+	// holes, and the live ones at or above it fill them, matched up in index
+	// order.  Both are counted per chunk first, so every chunk knows where
+	// its share starts without looking at the others.
+	std::size_t deadCount = 0;
+	for (std::size_t chunk = 0; chunk < chunkCount; ++chunk)
+		deadCount += mDead[chunk].size();
+	if (deadCount == 0)
+		return;
+
+	const std::size_t alive = type.Count - deadCount;
+	mHoleStarts.resize(chunkCount + 1);
+	mFillerStarts.resize(chunkCount + 1);
+	mHoleStarts[0] = mFillerStarts[0] = 0;
+	for (std::size_t chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		const std::vector<std::uint32_t>& dead = mDead[chunk];
+		std::size_t holes = std::lower_bound(dead.begin(), dead.end(), (std::uint32_t)alive) - dead.begin();
+
+		const std::size_t begin = (std::max)(chunk * ChunkSize, alive);
+		const std::size_t end = (std::min)(chunk * ChunkSize + ChunkSize, type.Count);
+		std::size_t fillers = end > begin ? end - begin - (dead.size() - holes) : 0;
+
+		mHoleStarts[chunk + 1] = mHoleStarts[chunk] + holes;
+		mFillerStarts[chunk + 1] = mFillerStarts[chunk] + fillers;
+	}
+	mFillers.resize(mFillerStarts[chunkCount]);
+
+	// The chunks past alive list their survivors...
+	pool.ParallelFor(chunkCount, 1, [&](std::size_t chunk)
+	{
+		if (mFillerStarts[chunk + 1] == mFillerStarts[chunk])
+			return;
+
+		const std::vector<std::uint32_t>& dead = mDead[chunk];
+		auto nextDead = std::lower_bound(dead.begin(), dead.end(), (std::uint32_t)alive);
+		std::uint32_t* filler = mFillers.data() + mFillerStarts[chunk];
+
+		const std::size_t end = (std::min)(chunk * ChunkSize + ChunkSize, type.Count);
+		for (std::size_t i = (std::max)(chunk * ChunkSize, alive); i < end; ++i)
+		{
+			if (nextDead != dead.end() && *nextDead == i)
+				++nextDead;
+			else
+				*filler++ = (std::uint32_t)i;
+		}
+	});
+
+	// ...and every chunk below it moves them into its holes.  Sources are
+	// all at or above alive and targets below, so no copy reads another's
+	// target.
+	pool.ParallelFor(chunkCount, 1, [&](std::size_t chunk)
+	{
+		const std::uint32_t* hole = mDead[chunk].data();
+		const std::uint32_t* filler = mFillers.data() + mHoleStarts[chunk];
+		const std::size_t holeCount = mHoleStarts[chunk + 1] - mHoleStarts[chunk];
+		for (auto* component : { &type.PosX, &type.PosY, &type.PosZ, &type.VelX, &type.VelY, &type.VelZ,
+			&type.Age, &type.InvLifetime })
+		{
+			float* values = component->data();
+			for (std::size_t h = 0; h < holeCount; ++h)
+				values[hole[h]] = values[filler[h]];
+		}
+	});
+
+	type.Count = alive;
+}
+
+void ParticleSystem::Emit(ParticleType& type, float dt, ThreadPool& pool)
+{
+	// Every emitter's births get their own range past the live particles,
+	// in emitter order until the type is full.
+	const ParticleEmitterDesc& desc = type.Desc;
+	std::size_t count = type.Count;
+	for (Emitter& emitter : type.Emitters)
+	{
+		emitter.Pending += desc.Rate * dt;
+		std::size_t births = (std::size_t)emitter.Pending;
+		emitter.Pending -= (float)births;
+
+		emitter.FirstBirth = count;
+		emitter.BirthCount = (std::min)(births, type.Capacity - count);
+		count += emitter.BirthCount;
+	}
+
+	pool.ParallelFor(type.Emitters.size(), EmittersPerJob, [&](std::size_t e)
+	{
+		Emitter& emitter = type.Emitters[e];
+		for (std::size_t i = emitter.FirstBirth; i < emitter.FirstBirth + emitter.BirthCount; ++i)
+		{
+			float lifetime = desc.Lifetime * (1.0f + desc.LifetimeJitter * (2.0f * Random(emitter.RandomState) - 1.0f));
+			type.InvLifetime[i] = 1.0f / (std::max)(lifetime, 1e-3f);
+
+			float velocity[3];
+			for (int a = 0; a < 3; ++a)
+				velocity[a] = desc.Velocity[a] + desc.VelocityJitter[a] * (2.0f * Random(emitter.RandomState) - 1.0f);
+
+			// Born somewhere within the step, and already that far along.
+			float born = Random(emitter.RandomState) * dt;
+			type.Age[i] = born * type.InvLifetime[i];
+			type.VelX[i] = velocity[0];
+			type.VelY[i] = velocity[1];
+			type.VelZ[i] = velocity[2];
+			type.PosX[i] = emitter.Position[0] + desc.Spread[0] * (2.0f * Random(emitter.RandomState) - 1.0f) + velocity[0] * born;
+			type.PosY[i] = emitter.Position[1] + desc.Spread[1] * (2.0f * Random(emitter.RandomState) - 1.0f) + velocity[1] * born;
+			type.PosZ[i] = emitter.Position[2] + desc.Spread[2] * (2.0f * Random(emitter.RandomState) - 1.0f) + velocity[2] * born;
+		}
+	});
+	type.Count = count;
+}
+
+void ParticleSystem::WriteInstances(ParticleInstance* out, float extrapolate, ThreadPool& pool)const
+{
+	static_assert(sizeof(ParticleInstance) == 20 && offsetof(ParticleInstance, Size) == 12,
+		"The position and size are stored as one 16 byte vector");
+
+	// Every type's chunks in one ParallelFor: (type, chunk) pairs.
+	std::vector<std::pair<int, std::size_t>> jobs;
+	for (int t = 0; t < (int)mTypes.size(); ++t)
+	{
+		for (std::size_t chunk = 0; chunk < ChunkCount(mTypes[t].Count); ++chunk)
+			jobs.push_back(std::make_pair(t, chunk));
+	}
+
+	pool.ParallelFor(jobs.size(), 1, [&](std::size_t job)
+	{
+		const ParticleType& type = mTypes[jobs[job].first];
+		const ParticleEmitterDesc& desc = type.Desc;
+		ParticleInstance* instances = out + FirstInstance(jobs[job].first);
+
+		const float* posX = type.PosX.data();
+		const float* posY = type.PosY.data();
+		const float* posZ = type.PosZ.data();
+		const float* velX = type.VelX.data();
+		const float* velY = type.VelY.data();
+		const float* velZ = type.VelZ.data();
+		const float* age = type.Age.data();
+		const float* invLifetime = type.InvLifetime.data();
+
+		const float startSize = desc.StartSize, sizeChange = desc.EndSize - desc.StartSize;
+		float startColor[4], colorChange[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			startColor[c] = desc.StartColor[c];
+			colorChange[c] = desc.EndColor[c] - desc.StartColor[c];
+		}
+
+		std::size_t i = jobs[job].second * ChunkSize;
+		const std::size_t end = (std::min)(i + ChunkSize, type.Count);
+#if PARTICLE_SYSTEM_SSE2
+		const __m128 ahead = _mm_set1_ps(extrapolate);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 size0 = _mm_set1_ps(startSize);
+		const __m128 sizeD = _mm_set1_ps(sizeChange);
+
+		// Colors in 0..255 plus the rounding half, so a truncating convert
+		// rounds.
+		__m128 color0[4], colorD[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			color0[c] = _mm_set1_ps(startColor[c] * 255.0f + 0.5f);
+			colorD[c] = _mm_set1_ps(colorChange[c] * 255.0f);
+		}
+
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 x = _mm_add_ps(_mm_loadu_ps(posX + i), _mm_mul_ps(_mm_loadu_ps(velX + i), ahead));
+			__m128 y = _mm_add_ps(_mm_loadu_ps(posY + i), _mm_mul_ps(_mm_loadu_ps(velY + i), ahead));
+			__m128 z = _mm_add_ps(_mm_loadu_ps(posZ + i), _mm_mul_ps(_mm_loadu_ps(velZ + i), ahead));
+			__m128 t = _mm_min_ps(_mm_add_ps(_mm_loadu_ps(age + i), _mm_mul_ps(_mm_loadu_ps(invLifetime + i), ahead)), one);
+			__m128 size = _mm_add_ps(size0, _mm_mul_ps(sizeD, t));
+
+			__m128i color = _mm_setzero_si128();
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128i channel = _mm_cvttps_epi32(_mm_add_ps(color0[c], _mm_mul_ps(colorD[c], t)));
+				color = _mm_or_si128(color, _mm_slli_epi32(channel, 8 * c));
+			}
+
+			// Rows to particles: each register becomes one x, y, z, size.
+			_MM_TRANSPOSE4_PS(x, y, z, size);
+			alignas(16) std::uint32_t colors[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(colors), color);
+
+			ParticleInstance* instance = instances + i;
+			_mm_storeu_ps(instance[0].Position, x);
+			instance[0].Color = colors[0];
+			_mm_storeu_ps(instance[1].Position, y);
+			instance[1].Color = colors[1];
+			_mm_storeu_ps(instance[2].Position, z);
+			instance[2].Color = colors[2];
+			_mm_storeu_ps(instance[3].Position, size);
+			instance[3].Color = colors[3];
+		}
+#endif
+		for (; i < end; ++i)
+		{
+			float t = (std::min)(age[i] + invLifetime[i] * extrapolate, 1.0f);
+			ParticleInstance& instance = instances[i];
+			instance.Position[0] = posX[i] + velX[i] * extrapolate;
+			instance.Position[1] = posY[i] + velY[i] * extrapolate;
+			instance.Position[2] = posZ[i] + velZ[i] * extrapolate;
+			instance.Size = startSize + sizeChange * t;
+			instance.Color = PackColor(startColor[0] + colorChange[0] * t, startColor[1] + colorChange[1] * t,
+				startColor[2] + colorChange[2] * t, startColor[3] + colorChange[3] * t);
+		}
+	});
+}
+
+int ParticleSystem::TypeCount()const
+{
+	return (int)mTypes.size();
+}
+
+std::size_t ParticleSystem::FirstInstance(int type)const
+{
+	std::size_t first = 0;
+	for (int t = 0; t < type; ++t)
+		first += mTypes[t].Count;
+	return first;
+}
+
+std::size_t ParticleSystem::Count(int type)const
+{
+	return mTypes[type].Count;
+}
+
+std::size_t ParticleSystem::TotalCount()const
+{
+	return FirstInstance((int)mTypes.size());
+}
+
+std::size_t ParticleSystem::Capacity()const
+{
+	std::size_t capacity = 0;
+	for (const ParticleType& type : mTypes)
+		capacity += type.Capacity;
+	return capacity;
+}
+
+ParticleBenchResult RunParticleBenchmark(std::size_t particleCount, int frames, ThreadPool& pool)
+{
+	typedef std::chrono::steady_clock Clock;
+	const float step = 1.0f / 60.0f;
+
+	// Smoke from a field of emitters: births and deaths every frame, as in
+	// the scene, with the births matching the deaths once full.
+	ParticleEmitterDesc smoke;
+	smoke.Lifetime = 2.0f;
+	smoke.LifetimeJitter = 0.25f;
+	smoke.Spread[0] = smoke.Spread[2] = 0.5f;
+	smoke.Velocity[1] = 1.0f;
+	smoke.VelocityJitter[0] = smoke.VelocityJitter[1] = smoke.VelocityJitter[2] = 0.3f;
+	smoke.Acceleration[0] = 0.4f;
+	smoke.Acceleration[1] = 0.2f;
+	smoke.Damping = 0.6f;
+	smoke.StartSize = 0.2f;
+	smoke.EndSize = 1.0f;
+
+	const int emitterCount = 64;
+	smoke.Rate = (float)particleCount / smoke.Lifetime / emitterCount;
+
+	ParticleSystem particles;
+	int type = particles.AddType(smoke, particleCount);
+	for (int e = 0; e < emitterCount; ++e)
+		particles.AddEmitter(type, (float)(e % 8) * 4.0f, 0.0f, (float)(e / 8) * 4.0f);
+
+	// The longest lifetime, so the count has settled.
+	for (float t = 0.0f; t < smoke.Lifetime * (1.0f + smoke.LifetimeJitter); t += step)
+		particles.Simulate(step, pool);
+
+	std::vector<ParticleInstance> instances(particles.Capacity());
+	double simulateSeconds = 0.0, writeSeconds = 0.0;
+	std::size_t liveSum = 0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		auto start = Clock::now();
+		particles.Simulate(step, pool);
+		auto simulated = Clock::now();
+		particles.WriteInstances(instances.data(), 0.5f * step, pool);
+		auto written = Clock::now();
+
+		simulateSeconds += std::chrono::duration<double>(simulated - start).count();
+		writeSeconds += std::chrono::duration<double>(written - simulated).count();
+		liveSum += particles.TotalCount();
+	}
+
+	ParticleBenchResult result;
+	result.Particles = frames > 0 ? liveSum / frames : particles.TotalCount();
+	result.Frames = frames;
+	result.Threads = pool.ThreadCount();
+	result.SimulateMs = frames > 0 ? simulateSeconds * 1000.0 / frames : 0.0;
+	result.WriteMs = frames > 0 ? writeSeconds * 1000.0 / frames : 0.0;
+	result.FrameMs = result.SimulateMs + result.WriteMs;
+	return result;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// One particle as the particle shader reads it, per instance: position and
+// half size as R32G32B32A32_FLOAT, then the color as R8G8B8A8_UNORM.
+struct ParticleInstance
+{
+	float Position[3];
+	float Size;
+
+	// Premultiplied by alpha, so one blend state covers both kinds of
+	// particle: alpha 0 adds light (flames), alpha 1 covers (smoke).
+	std::uint32_t Color;
+};
+
+// How the particles of one emitter type are born, move and fade.  Colors
+// are premultiplied; size and color go from Start to End over a lifetime.
+struct ParticleEmitterDesc
+{
+	// Particles per second from each emitter, and how long each lives, give
+	// or take LifetimeJitter of it.
+	float Rate = 100.0f;
+	float Lifetime = 1.0f;
+	float LifetimeJitter = 0.0f;
+
+	// Birth: within Spread of the emitter on each axis, moving at Velocity
+	// give or take VelocityJitter.
+	float Spread[3] = {};
+	float Velocity[3] = {};
+	float VelocityJitter[3] = {};
+
+	// Gravity, buoyancy and wind together, and the fraction of its velocity
+	// a particle keeps after a second.
+	float Acceleration[3] = {};
+	float Damping = 1.0f;
+
+	float StartSize = 0.1f;
+	float EndSize = 0.1f;
+	float StartColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	float EndColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+};
+
+// CPU particles for a handful of emitter types.  Each type keeps its live
+// particles packed in structure of arrays form (one array per component)
+// so the update runs four particles to an SSE register, in chunks spread
+// over the pool.  Dead particles are replaced by live ones from the end, so
+// the arrays stay packed; the order of particles is not kept.  Compaction
+// and births run over the pool too, so no pass over the particles is
+// serial.
+//
+// Instances come out grouped by type, so each type is one instanced draw
+// from FirstInstance(type) for Count(type) instances.
+class ParticleSystem
+{
+public:
+	// Adds a type with room for capacity live particles and returns its
+	// index.  Births past the capacity are dropped.
+	int AddType(const ParticleEmitterDesc& desc, std::size_t capacity);
+	void AddEmitter(int type, float x, float y, float z);
+
+	// Ages and moves every particle by dt, drops the ones whose life is
+	// over, then lets each emitter give birth for dt.  Births are spread
+	// over the step, so a fixed step does not show as pulses.
+	void Simulate(float dt, ThreadPool& pool);
+
+	// Writes every live particle, carried on extrapolate seconds past the
+	// last step at its current velocity, to TotalCount() instances at out.
+	// out may be write-combined memory: it is written in order, once.
+	void WriteInstances(ParticleInstance* out, float extrapolate, ThreadPool& pool)const;
+
+	int TypeCount()const;
+	std::size_t FirstInstance(int type)const;
+	std::size_t Count(int type)const;
+	std::size_t TotalCount()const;
+
+	// Room for the instances of every type at full capacity.
+	std::size_t Capacity()const;
+
+private:
+	struct Emitter
+	{
+		float Position[3];
+		float Pending = 0.0f;
+		std::uint32_t RandomState = 0;
+
+		// This step's births, at [FirstBirth, FirstBirth + BirthCount).
+		std::size_t FirstBirth = 0;
+		std::size_t BirthCount = 0;
+	};
+
+	struct ParticleType
+	{
+		ParticleEmitterDesc Desc;
+		std::size_t Capacity = 0;
+		std::size_t Count = 0;
+		std::vector<Emitter> Emitters;
+
+		// Age runs from 0 at birth to 1 at death, InvLifetime per second.
+		std::vector<float> PosX, PosY, PosZ;
+		std::vector<float> VelX, VelY, VelZ;
+		std::vector<float> Age, InvLifetime;
+	};
+
+	// Fills the holes mDead left below the new count with the survivors
+	// above it.
+	void Compact(ParticleType& type, std::size_t chunkCount, ThreadPool& pool);
+	void Emit(ParticleType& type, float dt, ThreadPool& pool);
+
+private:
+	std::vector<ParticleType> mTypes;
+
+	// Per chunk lists of the particles that died in a step, reused.
+	std::vector<std::vector<std::uint32_t>> mDead;
+
+	// Where each chunk's holes and survivors start in the list of
+	// survivors that fill the holes, also reused.
+	std::vector<std::size_t> mHoleStarts;
+	std::vector<std::size_t> mFillerStarts;
+	std::vector<std::uint32_t> mFillers;
+
+	// Seeds each emitter's random sequence.
+	std::uint32_t mRandomState = 0x9E3779B9u;
+};
+
+struct ParticleBenchResult
+{
+	std::size_t Particles = 0;
+	int Frames = 0;
+	unsigned Threads = 0;
+	double SimulateMs = 0.0;
+	double WriteMs = 0.0;
+	double FrameMs = 0.0;
+};
+
+// Fills one emitter type to particleCount live particles, then times
+// frames of a 1/60 s step and an instance write into plain host memory.
+// Times are per frame.
+ParticleBenchResult RunParticleBenchmark(std::size_t particleCount, int frames, ThreadPool& pool);
@@ -0,0 +1,132 @@
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <utility>
+
+namespace
+{
+	// Counts every item's first Passes digits in one read over the items.
+	// Passes is a template argument so the inner loop unrolls to exactly the
+	// histograms the sort uses.
+	template <int Passes, int DigitBits>
+	void CountDigits(const std::uint64_t* items, std::size_t count, std::uint32_t (*histograms)[1 << DigitBits])
+	{
+		const std::uint32_t digitMask = (1u << DigitBits) - 1;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			std::uint32_t key = (std::uint32_t)(items[i] >> 32);
+			for (int pass = 0; pass < Passes; ++pass)
+				histograms[pass][(key >> (pass * DigitBits)) & digitMask]++;
+		}
+	}
+}
+
+void RadixSorter::Sort(std::uint64_t* items, size_t count, int keyBits)
+{
+	if (count < 2 || keyBits <= 0)
+		return;
+
+	const int numPasses = keyBits >= 32 ? MaxPasses : (keyBits + DigitBits - 1) / DigitBits;
+	if (mScratch.size() < count)
+		mScratch.resize(count);
+
+	// Build the histograms for the digits in use in a single read over the
+	// items.  11-bit digits keep each histogram inside the L1 cache.
+	std::uint32_t histograms[MaxPasses][DigitCount];
+	std::memset(histograms, 0, numPasses * sizeof(histograms[0]));
+	switch (numPasses)
+	{
+	case 1: CountDigits<1, DigitBits>(items, count, histograms); break;
+	case 2: CountDigits<2, DigitBits>(items, count, histograms); break;
+	default: CountDigits<MaxPasses, DigitBits>(items, count, histograms); break;
+	}
+
+	std::uint64_t* src = items;
+	std::uint64_t* dst = mScratch.data();
+
+	for (int pass = 0; pass < numPasses; ++pass)
+	{
+		std::uint32_t* histogram = histograms[pass];
+		const int shift = 32 + pass * DigitBits;
+
+		// Every key shares this digit, so the pass would be an identity copy.
+		if (histogram[(src[0] >> shift) & (DigitCount - 1)] == count)
+			continue;
+
+		// Exclusive prefix sum turns counts into output offsets.
+		std::uint32_t sum = 0;
+		for (int d = 0; d < DigitCount; ++d)
+		{
+			std::uint32_t c = histogram[d];
+			histogram[d] = sum;
+			sum += c;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			std::uint64_t item = src[i];
+			dst[histogram[(item >> shift) & (DigitCount - 1)]++] = item;
+		}
+
+		std::swap(src, dst);
+	}
+
+	// An odd number of scatter passes leaves the result in the scratch array.
+	if (src != items)
+		std::memcpy(items, src, count * sizeof(std::uint64_t));
+}
+
+RadixSortBenchResult RunRadixSortBenchmark(std::size_t itemCount, int keyBits, int iterations)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	std::mt19937 rng(1);
+	const std::uint32_t keyMask = keyBits >= 32 ? 0xFFFFFFFFu : (1u << keyBits) - 1;
+	std::vector<std::uint64_t> source(itemCount);
+	for (std::size_t i = 0; i < itemCount; ++i)
+		source[i] = RadixSorter::MakeItem((std::uint32_t)rng() & keyMask, (std::uint32_t)i);
+
+	RadixSortBenchResult result;
+	result.Items = itemCount;
+	result.KeyBits = keyBits;
+	result.Sorted = true;
+
+	// One untimed sort grows the scratch, as the first frame would.
+	RadixSorter sorter;
+	std::vector<std::uint64_t> items(source);
+	sorter.Sort(items.data(), items.size(), keyBits);
+
+	std::vector<double> times;
+	for (int it = 0; it < iterations; ++it)
+	{
+		items = source;
+		auto start = Clock::now();
+		sorter.Sort(items.data(), items.size(), keyBits);
+		times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+
+		// Payloads are the original positions, so ties must keep them rising.
+		for (std::size_t i = 1; i < items.size(); ++i)
+		{
+			if (items[i] < items[i - 1])
+			{
+				result.Sorted = false;
+				break;
+			}
+		}
+	}
+
+	if (!times.empty())
+	{
+		double sum = 0.0;
+		for (double t : times)
+			sum += t;
+		result.MeanMicroseconds = sum / times.size();
+		result.MaxMicroseconds = *std::max_element(times.begin(), times.end());
+		std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+		result.MedianMicroseconds = times[times.size() / 2];
+	}
+	return result;
+}
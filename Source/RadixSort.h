@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// LSD radix sort over 64-bit items whose upper 32 bits are the sort key and
+// whose lower 32 bits are a payload (typically an index into the array being
+// ordered).  Keeping key and payload together means each pass scatters one
+// value instead of two.  Scratch memory is kept between calls so per-frame
+// sorts do not allocate once the high-water mark is reached.
+class RadixSorter
+{
+public:
+	RadixSorter() = default;
+	RadixSorter(const RadixSorter& rhs) = delete;
+	RadixSorter& operator=(const RadixSorter& rhs) = delete;
+
+	static std::uint64_t MakeItem(std::uint32_t key, std::uint32_t payload)
+	{
+		return ((std::uint64_t)key << 32) | payload;
+	}
+
+	static std::uint32_t Payload(std::uint64_t item)
+	{
+		return (std::uint32_t)item;
+	}
+
+	// Sorts items ascending by key.  The sort is stable.  keyBits limits the
+	// passes to the low key bits actually in use; 22-bit keys take two passes.
+	void Sort(std::uint64_t* items, size_t count, int keyBits = 32);
+
+private:
+	static const int DigitBits = 11;
+	static const int DigitCount = 1 << DigitBits;
+	static const int MaxPasses = (32 + DigitBits - 1) / DigitBits;
+
+	std::vector<std::uint64_t> mScratch;
+};
+
+struct RadixSortBenchResult
+{
+	std::size_t Items = 0;
+	int KeyBits = 0;
+	double MeanMicroseconds = 0.0;
+	double MedianMicroseconds = 0.0;
+	double MaxMicroseconds = 0.0;
+
+	// Every sort came out ascending and stable.
+	bool Sorted = false;
+};
+
+// Sorts iterations fresh copies of itemCount random keyBits-bit keys, as
+// SortBackToFront does with quantized depths, and times each Sort call
+// alone (not the copy).
+RadixSortBenchResult RunRadixSortBenchmark(std::size_t itemCount, int keyBits, int iterations);
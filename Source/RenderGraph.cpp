@@ -0,0 +1,463 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	const std::uint32_t WriteStates =
+		(std::uint32_t)RGState::RenderTarget |
+		(std::uint32_t)RGState::DepthWrite |
+		(std::uint32_t)RGState::CopyDest;
+
+	std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+	{
+		return alignment == 0 ? value : (value + alignment - 1) / alignment * alignment;
+	}
+
+	void HashCombine(std::uint64_t& hash, std::uint64_t value)
+	{
+		// FNV-1a style mixing, one 64-bit word at a time.
+		hash ^= value;
+		hash *= 1099511628211ULL;
+	}
+}
+
+void RenderGraph::Reset()
+{
+	mPasses.clear();
+	mResources.clear();
+	mFinalBarriers.clear();
+	mHeapSize = 0;
+	mStats = RGStats();
+}
+
+RGResource RenderGraph::ImportResource(const std::string& name, RGState initialState, RGState finalState)
+{
+	Resource resource;
+	resource.Name = name;
+	resource.InitialState = initialState;
+	resource.FinalState = finalState;
+	mResources.push_back(resource);
+
+	return (RGResource)mResources.size() - 1;
+}
+
+RGResource RenderGraph::CreateTransient(const std::string& name, const RGTransientDesc& desc)
+{
+	Resource resource;
+	resource.Name = name;
+	resource.Transient = true;
+	resource.Desc = desc;
+	mResources.push_back(resource);
+
+	return (RGResource)mResources.size() - 1;
+}
+
+void RenderGraph::MarkOutput(RGResource resource)
+{
+	mResources[resource].Output = true;
+}
+
+std::uint32_t RenderGraph::AddPass(const std::string& name, std::function<void()> execute)
+{
+	Pass pass;
+	pass.Name = name;
+	pass.Execute = execute;
+	mPasses.push_back(pass);
+
+	return (std::uint32_t)mPasses.size() - 1;
+}
+
+void RenderGraph::SetSideEffects(std::uint32_t pass)
+{
+	mPasses[pass].SideEffects = true;
+}
+
+void RenderGraph::Read(std::uint32_t pass, RGResource resource, RGState state)
+{
+	AddAccess(pass, resource, state, true, false);
+}
+
+void RenderGraph::Write(std::uint32_t pass, RGResource resource, RGState state)
+{
+	AddAccess(pass, resource, state, false, true);
+}
+
+void RenderGraph::ReadWrite(std::uint32_t pass, RGResource resource, RGState state)
+{
+	AddAccess(pass, resource, state, true, true);
+}
+
+void RenderGraph::AddAccess(std::uint32_t pass, RGResource resource, RGState state, bool reads, bool writes)
+{
+	// A pass sees a resource in a single state.  Several reads combine their
+	// read states; a write state cannot be combined with anything.
+	for (auto& access : mPasses[pass].Accesses)
+	{
+		if (access.Resource == resource)
+		{
+			assert((((std::uint32_t)access.State | (std::uint32_t)state) & WriteStates) == 0 || access.State == state);
+			access.State = access.State | state;
+			access.Reads |= reads;
+			access.Writes |= writes;
+			return;
+		}
+	}
+
+	Access access;
+	access.Resource = resource;
+	access.State = state;
+	access.Reads = reads;
+	access.Writes = writes;
+	mPasses[pass].Accesses.push_back(access);
+}
+
+void RenderGraph::Compile()
+{
+	mStats = RGStats();
+	mStats.DeclaredPasses = (std::uint32_t)mPasses.size();
+
+	CullPasses();
+	ComputeLifetimes();
+	AllocateTransients();
+	BuildBarriers();
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walk the passes backwards tracking which resources somebody still
+	// needs.  A pass survives if it writes a needed resource (or has side
+	// effects); its reads then become needed.  A pure write satisfies the
+	// need, so earlier writers of the same resource are culled unless a read
+	// sits in between.
+	std::vector<bool> needed(mResources.size(), false);
+	for (size_t i = 0; i < mResources.size(); ++i)
+		needed[i] = mResources[i].Output;
+
+	for (int p = (int)mPasses.size() - 1; p >= 0; --p)
+	{
+		Pass& pass = mPasses[p];
+
+		bool live = pass.SideEffects;
+		for (auto& access : pass.Accesses)
+		{
+			if (access.Writes && needed[access.Resource])
+				live = true;
+		}
+
+		pass.Culled = !live;
+		if (!live)
+		{
+			mStats.CulledPasses++;
+			continue;
+		}
+
+		for (auto& access : pass.Accesses)
+		{
+			if (access.Writes && !access.Reads)
+				needed[access.Resource] = false;
+		}
+		for (auto& access : pass.Accesses)
+		{
+			if (access.Reads)
+				needed[access.Resource] = true;
+		}
+	}
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+	for (auto& resource : mResources)
+	{
+		resource.FirstPass = -1;
+		resource.LastPass = -1;
+	}
+
+	for (int p = 0; p < (int)mPasses.size(); ++p)
+	{
+		if (mPasses[p].Culled)
+			continue;
+
+		for (auto& access : mPasses[p].Accesses)
+		{
+			Resource& resource = mResources[access.Resource];
+			if (resource.FirstPass < 0)
+			{
+				resource.FirstPass = p;
+
+				// Transients are created in the state of their first use, so
+				// they need no transition before it.
+				if (resource.Transient)
+					resource.InitialState = resource.FinalState = access.State;
+			}
+			resource.LastPass = p;
+		}
+	}
+}
+
+void RenderGraph::AllocateTransients()
+{
+	// Greedy first fit, biggest resources first.  A resource can take any
+	// offset whose range does not overlap a resource already placed that is
+	// alive at the same time.
+	std::vector<RGResource> order;
+	for (RGResource r = 0; r < (RGResource)mResources.size(); ++r)
+	{
+		if (mResources[r].Transient && mResources[r].FirstPass >= 0)
+		{
+			order.push_back(r);
+			mStats.TransientBytes += mResources[r].Desc.SizeInBytes;
+		}
+	}
+
+	std::stable_sort(order.begin(), order.end(), [this](RGResource a, RGResource b)
+	{
+		return mResources[a].Desc.SizeInBytes > mResources[b].Desc.SizeInBytes;
+	});
+
+	std::vector<RGResource> placed;
+	mHeapSize = 0;
+
+	for (RGResource r : order)
+	{
+		Resource& resource = mResources[r];
+
+		// Memory ranges already taken by resources alive alongside this one,
+		// sorted by offset.
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> taken;
+		for (RGResource other : placed)
+		{
+			const Resource& o = mResources[other];
+			if (o.FirstPass <= resource.LastPass && resource.FirstPass <= o.LastPass)
+				taken.push_back(std::make_pair(o.Offset, o.Offset + o.Desc.SizeInBytes));
+		}
+		std::sort(taken.begin(), taken.end());
+
+		std::uint64_t offset = 0;
+		for (auto& range : taken)
+		{
+			offset = AlignUp(offset, resource.Desc.Alignment);
+			if (offset + resource.Desc.SizeInBytes <= range.first)
+				break;
+			offset = (std::max)(offset, range.second);
+		}
+		offset = AlignUp(offset, resource.Desc.Alignment);
+
+		resource.Offset = offset;
+		mHeapSize = (std::max)(mHeapSize, offset + resource.Desc.SizeInBytes);
+		placed.push_back(r);
+	}
+
+	mStats.AliasedHeapBytes = mHeapSize;
+}
+
+void RenderGraph::BuildBarriers()
+{
+	std::vector<RGState> current(mResources.size());
+	for (size_t i = 0; i < mResources.size(); ++i)
+		current[i] = mResources[i].InitialState;
+
+	// Transients whose memory another transient has taken over.  They are
+	// returned to their creation state while they still own it, and get no
+	// final barrier.
+	std::vector<bool> aliasedAway(mResources.size(), false);
+
+	for (int p = 0; p < (int)mPasses.size(); ++p)
+	{
+		Pass& pass = mPasses[p];
+		pass.Barriers.clear();
+		if (pass.Culled)
+			continue;
+
+		for (auto& access : pass.Accesses)
+		{
+			RGResource r = access.Resource;
+			const Resource& resource = mResources[r];
+
+			// First use of transient memory that another transient also
+			// occupies: the GPU has to be told the memory changes owner.
+			if (resource.Transient && resource.FirstPass == p)
+			{
+				bool overlaps = false;
+				RGResource aliasBefore = RGInvalidResource;
+				int aliasBeforeLastPass = -1;
+				for (RGResource other = 0; other < (RGResource)mResources.size(); ++other)
+				{
+					const Resource& o = mResources[other];
+					if (other == r || !o.Transient || o.FirstPass < 0)
+						continue;
+					if (o.Offset < resource.Offset + resource.Desc.SizeInBytes &&
+						resource.Offset < o.Offset + o.Desc.SizeInBytes)
+					{
+						overlaps = true;
+						if (o.LastPass < p && o.LastPass > aliasBeforeLastPass)
+						{
+							aliasBefore = other;
+							aliasBeforeLastPass = o.LastPass;
+						}
+
+						// Earlier owners are done with the memory: put them
+						// back in their creation state before giving it up.
+						if (o.LastPass < p && !aliasedAway[other])
+						{
+							aliasedAway[other] = true;
+							if (current[other] != o.FinalState)
+							{
+								RGBarrier barrier;
+								barrier.Resource = other;
+								barrier.Before = current[other];
+								barrier.After = o.FinalState;
+								pass.Barriers.push_back(barrier);
+
+								current[other] = o.FinalState;
+							}
+						}
+					}
+				}
+
+				if (overlaps)
+				{
+					RGBarrier barrier;
+					barrier.BarrierType = RGBarrier::Type::Aliasing;
+					barrier.Resource = r;
+					barrier.AliasBefore = aliasBefore;
+					pass.Barriers.push_back(barrier);
+				}
+			}
+
+			if (current[r] != access.State)
+			{
+				RGBarrier barrier;
+				barrier.Resource = r;
+				barrier.Before = current[r];
+				barrier.After = access.State;
+				pass.Barriers.push_back(barrier);
+
+				current[r] = access.State;
+			}
+		}
+
+		mStats.Barriers += (std::uint32_t)pass.Barriers.size();
+		if (!pass.Barriers.empty())
+			mStats.BarrierBatches++;
+	}
+
+	// Hand imported resources back in the state the outside world expects,
+	// and return the transients that still own their memory to their
+	// creation state for the next frame.
+	mFinalBarriers.clear();
+	for (RGResource r = 0; r < (RGResource)mResources.size(); ++r)
+	{
+		if (!aliasedAway[r] && current[r] != mResources[r].FinalState)
+		{
+			RGBarrier barrier;
+			barrier.Resource = r;
+			barrier.Before = current[r];
+			barrier.After = mResources[r].FinalState;
+			mFinalBarriers.push_back(barrier);
+		}
+	}
+
+	mStats.Barriers += (std::uint32_t)mFinalBarriers.size();
+	if (!mFinalBarriers.empty())
+		mStats.BarrierBatches++;
+}
+
+void RenderGraph::Execute(const std::function<void(const std::vector<RGBarrier>&)>& submitBarriers)const
+{
+	for (auto& pass : mPasses)
+	{
+		if (pass.Culled)
+			continue;
+
+		if (!pass.Barriers.empty())
+			submitBarriers(pass.Barriers);
+
+		if (pass.Execute)
+			pass.Execute();
+	}
+
+	if (!mFinalBarriers.empty())
+		submitBarriers(mFinalBarriers);
+}
+
+bool RenderGraph::IsPassCulled(std::uint32_t pass)const
+{
+	return mPasses[pass].Culled;
+}
+
+const std::vector<RGBarrier>& RenderGraph::PassBarriers(std::uint32_t pass)const
+{
+	return mPasses[pass].Barriers;
+}
+
+const std::vector<RGBarrier>& RenderGraph::FinalBarriers()const
+{
+	return mFinalBarriers;
+}
+
+bool RenderGraph::IsTransient(RGResource resource)const
+{
+	return mResources[resource].Transient;
+}
+
+bool RenderGraph::IsUsed(RGResource resource)const
+{
+	return mResources[resource].FirstPass >= 0;
+}
+
+const RGTransientDesc& RenderGraph::TransientDesc(RGResource resource)const
+{
+	return mResources[resource].Desc;
+}
+
+std::uint64_t RenderGraph::TransientOffset(RGResource resource)const
+{
+	return mResources[resource].Offset;
+}
+
+RGState RenderGraph::TransientInitialState(RGResource resource)const
+{
+	return mResources[resource].InitialState;
+}
+
+std::uint64_t RenderGraph::HeapSize()const
+{
+	return mHeapSize;
+}
+
+std::uint64_t RenderGraph::TransientLayoutHash()const
+{
+	std::uint64_t hash = 14695981039346656037ULL;
+	HashCombine(hash, mHeapSize);
+
+	for (auto& resource : mResources)
+	{
+		if (!resource.Transient || resource.FirstPass < 0)
+			continue;
+
+		HashCombine(hash, resource.Desc.Width);
+		HashCombine(hash, resource.Desc.Height);
+		HashCombine(hash, resource.Desc.Format);
+		HashCombine(hash, resource.Offset);
+		HashCombine(hash, (std::uint64_t)resource.InitialState);
+	}
+
+	return hash;
+}
+
+std::uint32_t RenderGraph::ResourceCount()const
+{
+	return (std::uint32_t)mResources.size();
+}
+
+const std::string& RenderGraph::ResourceName(RGResource resource)const
+{
+	return mResources[resource].Name;
+}
+
+const RGStats& RenderGraph::Stats()const
+{
+	return mStats;
+}
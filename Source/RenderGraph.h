@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Resource states the graph tracks.  They mirror D3D12_RESOURCE_STATES but
+// keep the graph free of any device or D3D12 header, so compiling a graph
+// can be exercised on its own.  Read states can be combined; write states
+// are exclusive.
+enum class RGState : std::uint32_t
+{
+	Common = 0,
+	RenderTarget = 1 << 0,
+	DepthWrite = 1 << 1,
+	DepthRead = 1 << 2,
+	PixelShaderResource = 1 << 3,
+	NonPixelShaderResource = 1 << 4,
+	CopySource = 1 << 5,
+	CopyDest = 1 << 6,
+	Present = 1 << 7
+};
+
+inline RGState operator|(RGState a, RGState b)
+{
+	return (RGState)((std::uint32_t)a | (std::uint32_t)b);
+}
+
+typedef std::uint32_t RGResource;
+const RGResource RGInvalidResource = 0xffffffff;
+
+// Description of a resource the graph owns for the length of a frame.  The
+// caller fills in the allocation size and alignment (from the device), the
+// rest is only carried through so the caller can create the resource.
+struct RGTransientDesc
+{
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+	std::uint32_t Format = 0;
+
+	std::uint64_t SizeInBytes = 0;
+	std::uint64_t Alignment = 65536;
+};
+
+struct RGBarrier
+{
+	enum class Type
+	{
+		Transition,
+		Aliasing
+	};
+
+	Type BarrierType = Type::Transition;
+
+	RGResource Resource = RGInvalidResource;
+
+	// Transition states.
+	RGState Before = RGState::Common;
+	RGState After = RGState::Common;
+
+	// For aliasing barriers: the resource that last used the memory, or
+	// RGInvalidResource if it could be any of several.
+	RGResource AliasBefore = RGInvalidResource;
+};
+
+struct RGStats
+{
+	std::uint32_t DeclaredPasses = 0;
+	std::uint32_t CulledPasses = 0;
+
+	std::uint32_t Barriers = 0;
+
+	// Number of ResourceBarrier calls the barriers are submitted in.
+	std::uint32_t BarrierBatches = 0;
+
+	// Transient memory with and without aliasing.
+	std::uint64_t TransientBytes = 0;
+	std::uint64_t AliasedHeapBytes = 0;
+};
+
+// Frame graph of render passes.  Each frame the passes are declared with the
+// resources they read and write, then Compile culls the passes that do not
+// contribute to an output, works out the state transitions each pass needs
+// (submitted as one batch per pass), and packs the transient resources into
+// one heap, letting resources whose lifetimes do not overlap share memory.
+class RenderGraph
+{
+public:
+	RenderGraph() = default;
+	RenderGraph(const RenderGraph& rhs) = delete;
+	RenderGraph& operator=(const RenderGraph& rhs) = delete;
+
+	// Clears all passes and resources so the graph can be declared again.
+	void Reset();
+
+	// A resource that lives outside the graph (swap chain buffer, depth
+	// buffer...).  It enters the frame in initialState and is returned to
+	// finalState once the graph has run.
+	RGResource ImportResource(const std::string& name, RGState initialState, RGState finalState);
+
+	// A resource that only lives for the frame.  Its contents do not survive
+	// between frames and its memory may be shared with other transients.
+	RGResource CreateTransient(const std::string& name, const RGTransientDesc& desc);
+
+	// Resources the frame exists to produce.  Passes that do not lead to one
+	// of these are culled.
+	void MarkOutput(RGResource resource);
+
+	std::uint32_t AddPass(const std::string& name, std::function<void()> execute);
+
+	// Passes with side effects outside the graph (queries, readbacks) are
+	// never culled.
+	void SetSideEffects(std::uint32_t pass);
+
+	void Read(std::uint32_t pass, RGResource resource, RGState state);
+
+	// Write discards the previous contents; ReadWrite keeps them (e.g. a
+	// depth buffer that is tested and written).
+	void Write(std::uint32_t pass, RGResource resource, RGState state);
+	void ReadWrite(std::uint32_t pass, RGResource resource, RGState state);
+
+	void Compile();
+
+	// Runs the surviving passes in order, handing each batch of barriers to
+	// submitBarriers first.
+	void Execute(const std::function<void(const std::vector<RGBarrier>&)>& submitBarriers)const;
+
+	//
+	// Results of Compile.
+	//
+
+	bool IsPassCulled(std::uint32_t pass)const;
+	const std::vector<RGBarrier>& PassBarriers(std::uint32_t pass)const;
+	const std::vector<RGBarrier>& FinalBarriers()const;
+
+	bool IsTransient(RGResource resource)const;
+
+	// False for resources no surviving pass touches.  Unused transients get
+	// no memory.
+	bool IsUsed(RGResource resource)const;
+	const RGTransientDesc& TransientDesc(RGResource resource)const;
+
+	// Byte offset of a transient in the shared heap.
+	std::uint64_t TransientOffset(RGResource resource)const;
+
+	// State a transient is created in: the state of its first use.
+	RGState TransientInitialState(RGResource resource)const;
+
+	std::uint64_t HeapSize()const;
+
+	// Changes whenever the transients or their placement change, so the
+	// caller knows when to recreate them.
+	std::uint64_t TransientLayoutHash()const;
+
+	std::uint32_t ResourceCount()const;
+	const std::string& ResourceName(RGResource resource)const;
+
+	const RGStats& Stats()const;
+
+private:
+	struct Access
+	{
+		RGResource Resource = RGInvalidResource;
+		RGState State = RGState::Common;
+		bool Reads = false;
+		bool Writes = false;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		std::function<void()> Execute;
+		std::vector<Access> Accesses;
+		bool SideEffects = false;
+
+		bool Culled = false;
+		std::vector<RGBarrier> Barriers;
+	};
+
+	struct Resource
+	{
+		std::string Name;
+		bool Transient = false;
+		bool Output = false;
+		RGState InitialState = RGState::Common;
+		RGState FinalState = RGState::Common;
+		RGTransientDesc Desc;
+
+		// Filled in by Compile for transients.
+		int FirstPass = -1;
+		int LastPass = -1;
+		std::uint64_t Offset = 0;
+	};
+
+	void AddAccess(std::uint32_t pass, RGResource resource, RGState state, bool reads, bool writes);
+	void CullPasses();
+	void ComputeLifetimes();
+	void AllocateTransients();
+	void BuildBarriers();
+
+private:
+	std::vector<Pass> mPasses;
+	std::vector<Resource> mResources;
+	std::vector<RGBarrier> mFinalBarriers;
+
+	std::uint64_t mHeapSize = 0;
+	RGStats mStats;
+};
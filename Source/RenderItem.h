@@ -0,0 +1,99 @@
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+#include "../../Common/MathHelper.h"
+
+const int gNumFrameResources = 3;
+
+// Render queues, drawn in this order, each with its own PSO.
+enum class RenderLayer : int
+{
+	Opaque = 0,
+	AlphaTested,
+	Transparent,
+	Count
+};
+
+// Lightweight structure stores parameters to draw a shape.  This will
+// vary from app-to-app.
+struct RenderItem
+{
+	RenderItem() = default;
+
+	// World matrix of the shape that describes the object's local space
+	// relative to the world space, which defines the position, orientation,
+	// and scale of the object in the world.
+	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+
+	// World space bounding box, used for frustum culling.
+	DirectX::BoundingBox Bounds;
+
+	// Immobile items never change World after they are built, so they can be
+	// pre-transformed and merged into static batches.
+	bool IsStatic = false;
+
+	// Animated items are moved by the fixed-rate simulation.  World is the
+	// newest simulated state and PrevWorld the one before it; each frame's
+	// object constants blend the two by how far the frame is between steps.
+	bool IsAnimated = false;
+	DirectX::XMFLOAT4X4 PrevWorld = MathHelper::Identity4x4();
+
+	// Render queue this item is drawn in.
+	RenderLayer Layer = RenderLayer::Opaque;
+
+	// Castle copy this item belongs to, or -1.  When the copy is far away all
+	// of its items are skipped and its impostor is drawn instead.
+	int ImpostorGroup = -1;
+
+	// Streamed texture the item samples, or -1, and how many texture
+	// coordinate units one world unit of its surface spans.  Together with
+	// the texture's size they decide which mips the item needs on screen.
+	int StreamedTexture = -1;
+	float TexCPerUnit = 1.0f;
+
+	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
+	// Because we have an object cbuffer for each FrameResource, we have to apply the
+	// update to each FrameResource.  Thus, when we modify obect data we should set
+	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
+	int NumFramesDirty = gNumFrameResources;
+
+	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
+	UINT ObjCBIndex = -1;
+
+	MeshGeometry* Geo = nullptr;
+
+	// Primitive topology.
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	// DrawIndexedInstanced parameters.
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+};
+
+// Turns a render item about its local vertical axis, one simulation step
+// at a time.
+struct SpinAnimation
+{
+	RenderItem* Ritem = nullptr;
+
+	// World of the item at angle 0, and the bounds of what it draws.
+	DirectX::XMFLOAT4X4 BaseWorld = MathHelper::Identity4x4();
+	DirectX::BoundingBox LocalBounds;
+
+	// Radians per second.
+	float Speed = 0.0f;
+	float Angle = 0.0f;
+};
+
+// Static render items of one queue and impostor group.  Their draws never
+// change, so they are recorded once into a bundle and replayed.
+struct RenderItemGroup
+{
+	int ImpostorGroup = -1;
+
+	// World space bounds of all the items, culled as a whole.
+	DirectX::BoundingBox Bounds;
+
+	std::vector<RenderItem*> Ritems;
+};
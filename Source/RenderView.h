@@ -0,0 +1,55 @@
+#pragma once
+
+#include "RenderItem.h"
+#include "RadixSort.h"
+
+// Most views drawn in one frame, which is also the number of pass constant
+// slots in each frame resource.
+const int gMaxRenderViews = 2;
+
+// One camera's look at the scene: its pass constant slot, the part of the
+// render target it covers, and the draw lists culled and sorted for it.
+// Views are culled in parallel, so everything culling writes lives here.
+struct RenderView
+{
+	RenderView() = default;
+	RenderView(const RenderView& rhs) = delete;
+	RenderView& operator=(const RenderView& rhs) = delete;
+
+	// Slot in each frame resource's PassCB.
+	UINT PassIndex = 0;
+
+	// Part of the render target the view covers, as fractions of its size.
+	float Left = 0.0f;
+	float Top = 0.0f;
+	float Width = 1.0f;
+	float Height = 1.0f;
+
+	DirectX::XMFLOAT3 EyePos = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
+	DirectX::XMFLOAT4X4 Proj = MathHelper::Identity4x4();
+
+	// View space frustum the view culls with: Proj's, or with late latching
+	// a wider one from behind the camera.
+	DirectX::BoundingFrustum Frustum;
+
+	// For each castle, whether this view draws it as its impostor, and the
+	// visible ones that do.
+	std::vector<std::uint8_t> UseImpostor;
+	std::vector<UINT> VisibleImpostors;
+
+	std::vector<RenderItem*> VisibleRitems[(int)RenderLayer::Count];
+	std::vector<const RenderItemGroup*> VisibleGroups[(int)RenderLayer::Count];
+
+	// On the vertex pulling path, each layer's visible items (grouped ones
+	// included) as a range of the frame's IndirectDraws, plus the ones the
+	// geometry pool cannot draw, which go through the input assembler.
+	UINT FirstPulledDraw[(int)RenderLayer::Count] = {};
+	UINT PulledDrawCount[(int)RenderLayer::Count] = {};
+	std::vector<RenderItem*> UnpulledRitems[(int)RenderLayer::Count];
+
+	// Scratch for the back to front sort of transparent items.
+	RadixSorter DepthSorter;
+	std::vector<std::uint64_t> DepthSortItems;
+	std::vector<RenderItem*> DepthSortScratch;
+};
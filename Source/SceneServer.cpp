@@ -0,0 +1,150 @@
+#include "SceneServer.h"
+
+#include <chrono>
+
+using namespace DirectX;
+
+void NullBackend::BeginFrame()
+{
+}
+
+void NullBackend::Submit(const DrawPacket& packet)
+{
+	mDraws++;
+	mIndices += packet.IndexCount;
+}
+
+void NullBackend::EndFrame()
+{
+	mFrames++;
+}
+
+std::uint64_t NullBackend::Frames()const
+{
+	return mFrames;
+}
+
+std::uint64_t NullBackend::Draws()const
+{
+	return mDraws;
+}
+
+std::uint64_t NullBackend::Indices()const
+{
+	return mIndices;
+}
+
+SceneInstance::SceneInstance(const std::vector<std::unique_ptr<RenderItem>>& ritems,
+	float theta, float phi, float radius, float orbitSpeed, float aspectRatio)
+	: mTheta(theta), mPhi(phi), mRadius(radius), mOrbitSpeed(orbitSpeed)
+{
+	mRitems.reserve(ritems.size());
+	for (auto& e : ritems)
+		mRitems.push_back(*e);
+
+	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, aspectRatio, 1.0f, 1000.0f);
+	XMStoreFloat4x4(&mProj, P);
+	BoundingFrustum::CreateFromMatrix(mCamFrustum, P);
+}
+
+void SceneInstance::RenderFrame(float dt)
+{
+	mTheta += mOrbitSpeed * dt;
+
+	XMVECTOR pos = XMVectorSet(mRadius * sinf(mPhi) * cosf(mTheta), mRadius * cosf(mPhi), mRadius * sinf(mPhi) * sinf(mTheta), 1.0f);
+	XMVECTOR target = XMVectorZero();
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+	XMMATRIX view = XMMatrixLookAtLH(pos, target, up);
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+	XMMATRIX viewProj = XMMatrixMultiply(view, XMLoadFloat4x4(&mProj));
+
+	BoundingFrustum worldFrustum;
+	mCamFrustum.Transform(worldFrustum, invView);
+
+	for (auto& packets : mPackets)
+		packets.clear();
+
+	for (auto& ri : mRitems)
+	{
+		if (worldFrustum.Contains(ri.Bounds) == DirectX::DISJOINT)
+			continue;
+
+		DrawPacket packet;
+		packet.Geo = ri.Geo;
+		packet.PrimitiveType = ri.PrimitiveType;
+		packet.IndexCount = ri.IndexCount;
+		packet.StartIndexLocation = ri.StartIndexLocation;
+		packet.BaseVertexLocation = ri.BaseVertexLocation;
+
+		XMMATRIX worldViewProj = XMMatrixMultiply(XMLoadFloat4x4(&ri.World), viewProj);
+		XMStoreFloat4x4(&packet.WorldViewProj, XMMatrixTranspose(worldViewProj));
+		packet.Depth = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&ri.Bounds.Center), view));
+
+		mPackets[(int)ri.Layer].push_back(packet);
+	}
+
+	// Same order as the windowed renderer: depth-writing queues front to
+	// back, transparent back to front.
+	auto frontToBack = [](const DrawPacket& a, const DrawPacket& b) { return a.Depth < b.Depth; };
+	auto backToFront = [](const DrawPacket& a, const DrawPacket& b) { return a.Depth > b.Depth; };
+	std::sort(mPackets[(int)RenderLayer::Opaque].begin(), mPackets[(int)RenderLayer::Opaque].end(), frontToBack);
+	std::sort(mPackets[(int)RenderLayer::AlphaTested].begin(), mPackets[(int)RenderLayer::AlphaTested].end(), frontToBack);
+	std::sort(mPackets[(int)RenderLayer::Transparent].begin(), mPackets[(int)RenderLayer::Transparent].end(), backToFront);
+
+	mBackend.BeginFrame();
+	for (auto& packets : mPackets)
+	{
+		for (auto& packet : packets)
+			mBackend.Submit(packet);
+	}
+	mBackend.EndFrame();
+}
+
+const NullBackend& SceneInstance::Backend()const
+{
+	return mBackend;
+}
+
+SceneServer::SceneServer(const std::vector<std::unique_ptr<RenderItem>>& ritems, UINT sceneCount, float aspectRatio)
+{
+	// Spread the variants' cameras out so they see different parts of the
+	// map: golden angle steps around, a spread of heights and distances.
+	const float goldenAngle = 2.39996323f;
+	for (UINT i = 0; i < sceneCount; ++i)
+	{
+		float theta = i * goldenAngle;
+		float phi = 0.15f * XM_PI + 0.25f * XM_PI * ((i * 7) % 11) / 10.0f;
+		float radius = 15.0f + 100.0f * ((i * 5) % 13) / 12.0f;
+		float orbitSpeed = 0.1f + 0.05f * (i % 5);
+
+		mScenes.push_back(std::make_unique<SceneInstance>(ritems, theta, phi, radius, orbitSpeed, aspectRatio));
+	}
+}
+
+SceneServerStats SceneServer::Run(ThreadPool& pool, UINT frameCount, float dt)
+{
+	std::uint64_t drawsBefore = 0;
+	for (auto& scene : mScenes)
+		drawsBefore += scene->Backend().Draws();
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (UINT frame = 0; frame < frameCount; ++frame)
+		pool.ParallelFor(mScenes.size(), 1, [this, dt](std::size_t i) { mScenes[i]->RenderFrame(dt); });
+
+	auto end = std::chrono::steady_clock::now();
+
+	SceneServerStats stats;
+	stats.Threads = pool.ThreadCount();
+	stats.Scenes = (UINT)mScenes.size();
+	stats.Frames = frameCount;
+	stats.Seconds = std::chrono::duration<double>(end - start).count();
+	stats.SceneFramesPerSecond = stats.Seconds > 0.0 ? (double)stats.Scenes * frameCount / stats.Seconds : 0.0;
+
+	for (auto& scene : mScenes)
+		stats.Draws += scene->Backend().Draws();
+	stats.Draws -= drawsBefore;
+
+	return stats;
+}
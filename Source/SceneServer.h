@@ -0,0 +1,99 @@
+#pragma once
+
+#include "RenderItem.h"
+#include "ThreadPool.h"
+
+// One draw as a backend receives it: the geometry to draw and the object's
+// transform already folded into the camera's.
+struct DrawPacket
+{
+	const MeshGeometry* Geo = nullptr;
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+
+	DirectX::XMFLOAT4X4 WorldViewProj = MathHelper::Identity4x4();
+
+	// View space depth of the bounds center, the sort key.
+	float Depth = 0.0f;
+};
+
+// Backend without a device.  It takes the frame's packets and only counts
+// them, so a headless frame costs exactly the CPU side of a real one.
+class NullBackend
+{
+public:
+	void BeginFrame();
+	void Submit(const DrawPacket& packet);
+	void EndFrame();
+
+	std::uint64_t Frames()const;
+	std::uint64_t Draws()const;
+	std::uint64_t Indices()const;
+
+private:
+	std::uint64_t mFrames = 0;
+	std::uint64_t mDraws = 0;
+	std::uint64_t mIndices = 0;
+};
+
+// One variant of the scene: its own copy of the render items, its own
+// orbiting camera, and its own packet lists and backend, so instances can be
+// rendered on different threads without sharing anything writable.  The
+// geometry the items point at is shared by all instances.
+class SceneInstance
+{
+public:
+	SceneInstance(const std::vector<std::unique_ptr<RenderItem>>& ritems,
+		float theta, float phi, float radius, float orbitSpeed, float aspectRatio);
+	SceneInstance(const SceneInstance& rhs) = delete;
+	SceneInstance& operator=(const SceneInstance& rhs) = delete;
+
+	// Moves the camera along by dt seconds, culls and sorts the items, and
+	// submits them to the backend.
+	void RenderFrame(float dt);
+
+	const NullBackend& Backend()const;
+
+private:
+	std::vector<RenderItem> mRitems;
+
+	float mTheta = 0.0f;
+	float mPhi = 0.0f;
+	float mRadius = 0.0f;
+	float mOrbitSpeed = 0.0f;
+	DirectX::XMFLOAT4X4 mProj = MathHelper::Identity4x4();
+	DirectX::BoundingFrustum mCamFrustum;
+
+	std::vector<DrawPacket> mPackets[(int)RenderLayer::Count];
+	NullBackend mBackend;
+};
+
+struct SceneServerStats
+{
+	unsigned Threads = 0;
+	UINT Scenes = 0;
+	UINT Frames = 0;
+	double Seconds = 0.0;
+
+	// Scene frames (one frame of one instance) per second.
+	double SceneFramesPerSecond = 0.0;
+
+	std::uint64_t Draws = 0;
+};
+
+// Hosts many scene instances and renders them from a work queue: each
+// frame, every instance is one job on the pool.
+class SceneServer
+{
+public:
+	SceneServer(const std::vector<std::unique_ptr<RenderItem>>& ritems, UINT sceneCount, float aspectRatio);
+	SceneServer(const SceneServer& rhs) = delete;
+	SceneServer& operator=(const SceneServer& rhs) = delete;
+
+	SceneServerStats Run(ThreadPool& pool, UINT frameCount, float dt);
+
+private:
+	std::vector<std::unique_ptr<SceneInstance>> mScenes;
+};
@@ -0,0 +1,273 @@
+#include "StaticBatch.h"
+#include "Stripifier.h"
+#include "VertexFrames.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+using namespace DirectX;
+
+namespace
+{
+	// Fetches index i of a submesh from the CPU copy of the index buffer,
+	// whatever format the source geometry was built with.
+	UINT ReadIndex(const MeshGeometry* geo, UINT i)
+	{
+		if (geo->IndexFormat == DXGI_FORMAT_R16_UINT)
+			return reinterpret_cast<const std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer())[i];
+
+		return reinterpret_cast<const std::uint32_t*>(geo->IndexBufferCPU->GetBufferPointer())[i];
+	}
+
+	// The triangles ri draws, as a list.  Strips cannot simply be
+	// concatenated, so they are expanded before merging.
+	std::vector<std::uint32_t> ReadTriangles(const RenderItem* ri)
+	{
+		std::vector<std::uint32_t> indices(ri->IndexCount);
+		for (UINT i = 0; i < ri->IndexCount; ++i)
+			indices[i] = ReadIndex(ri->Geo, ri->StartIndexLocation + i);
+
+		if (ri->PrimitiveType != D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP)
+			return indices;
+
+		std::uint32_t cutIndex = ri->Geo->IndexFormat == DXGI_FORMAT_R16_UINT ? 0xFFFF : 0xFFFFFFFF;
+		return UnstripTriangles(indices.data(), indices.size(), cutIndex);
+	}
+
+	// A packed normal or tangent moved by m (normals by the inverse
+	// transpose of the world matrix) and packed again.
+	UINT TransformUnitVector(UINT packed, FXMMATRIX m)
+	{
+		XMFLOAT3 v;
+		UnpackUnitVector(packed, v.x, v.y, v.z);
+		XMStoreFloat3(&v, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&v), m)));
+		return PackUnitVector(v.x, v.y, v.z);
+	}
+
+	D3D12_PRIMITIVE_TOPOLOGY ListTopology(D3D12_PRIMITIVE_TOPOLOGY topology)
+	{
+		return topology == D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP ? D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST : topology;
+	}
+}
+
+StaticBatcher::StaticBatcher(float chunkSize)
+	: mChunkSize(chunkSize)
+{
+}
+
+bool StaticBatcher::CanBatch(const RenderItem* ri)
+{
+	return ri->IsStatic && ri->Layer != RenderLayer::Transparent &&
+		ri->Geo != nullptr && ri->Geo->VertexBufferCPU != nullptr;
+}
+
+std::unique_ptr<MeshGeometry> StaticBatcher::Build(
+	ID3D12Device* device,
+	ID3D12GraphicsCommandList* cmdList,
+	const std::vector<RenderItem*>& ritems,
+	std::vector<StaticBatch>& batches,
+	bool allowStrips)
+{
+	mStats = StaticBatchStats();
+	batches.clear();
+
+	//
+	// Bucket the static items by chunk and draw state.  std::map keeps the
+	// batch order deterministic from run to run.
+	//
+	typedef std::tuple<int, int, int, int, int, int> BatchKey;
+	std::map<BatchKey, std::vector<RenderItem*>> buckets;
+
+	for (auto ri : ritems)
+	{
+		if (!CanBatch(ri))
+			continue;
+
+		XMFLOAT4X4& w = ri->World;
+		int cx = (int)floorf(w._41 / mChunkSize);
+		int cz = (int)floorf(w._43 / mChunkSize);
+
+		buckets[BatchKey((int)ri->Layer, ri->ImpostorGroup, cx, cz, (int)ListTopology(ri->PrimitiveType), ri->StreamedTexture)].push_back(ri);
+		mStats.SourceDrawCalls++;
+	}
+
+	//
+	// Pre-transform and concatenate.  Each batch keeps its own base vertex so
+	// the indices stay local to the batch.
+	//
+	std::vector<Vertex> vertices;
+	std::vector<std::uint32_t> indices;
+	std::vector<SubmeshGeometry> submeshes;
+	bool fitsIn16Bits = true;
+
+	for (auto& bucket : buckets)
+	{
+		SubmeshGeometry submesh;
+		submesh.StartIndexLocation = (UINT)indices.size();
+		submesh.BaseVertexLocation = (INT)vertices.size();
+
+		for (auto ri : bucket.second)
+		{
+			const Vertex* srcVertices = reinterpret_cast<const Vertex*>(ri->Geo->VertexBufferCPU->GetBufferPointer());
+			XMMATRIX world = XMLoadFloat4x4(&ri->World);
+			XMMATRIX worldInvTranspose = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
+
+			std::vector<std::uint32_t> triangles = ReadTriangles(ri);
+			if (triangles.empty())
+				continue;
+
+			// Remap the referenced source vertices into the batch.  Submeshes
+			// in the shared buffer are tightly packed, so a plain min/max range
+			// over the referenced vertices is exact.
+			UINT minIndex = UINT_MAX;
+			UINT maxIndex = 0;
+			for (std::uint32_t index : triangles)
+			{
+				minIndex = MathHelper::Min(minIndex, index);
+				maxIndex = MathHelper::Max(maxIndex, index);
+			}
+
+			UINT batchBase = (UINT)vertices.size() - submesh.BaseVertexLocation;
+			for (UINT v = minIndex; v <= maxIndex; ++v)
+			{
+				Vertex out = srcVertices[ri->BaseVertexLocation + v];
+				XMStoreFloat3(&out.Pos, XMVector3TransformCoord(XMLoadFloat3(&out.Pos), world));
+				out.Normal = TransformUnitVector(out.Normal, worldInvTranspose);
+				out.Tangent = TransformUnitVector(out.Tangent, world);
+				vertices.push_back(out);
+			}
+
+			for (std::uint32_t index : triangles)
+				indices.push_back(batchBase + index - minIndex);
+		}
+
+		submesh.IndexCount = (UINT)indices.size() - submesh.StartIndexLocation;
+
+		UINT batchVertexCount = (UINT)vertices.size() - submesh.BaseVertexLocation;
+		if (batchVertexCount == 0)
+			continue;
+		if (batchVertexCount > 0xffff)
+			fitsIn16Bits = false;
+
+		BoundingBox::CreateFromPoints(submesh.Bounds, batchVertexCount,
+			&vertices[submesh.BaseVertexLocation].Pos, sizeof(Vertex));
+
+		StaticBatch batch;
+		batch.Name = "batch_" + std::to_string(std::get<0>(bucket.first)) + "_" +
+			std::to_string(std::get<1>(bucket.first)) + "_" + std::to_string(std::get<2>(bucket.first)) + "_" +
+			std::to_string(std::get<3>(bucket.first)) + "_" + std::to_string(std::get<4>(bucket.first)) + "_" +
+			std::to_string(std::get<5>(bucket.first));
+		batch.Layer = (RenderLayer)std::get<0>(bucket.first);
+		batch.ImpostorGroup = std::get<1>(bucket.first);
+		batch.PrimitiveType = (D3D12_PRIMITIVE_TOPOLOGY)std::get<4>(bucket.first);
+		batch.StreamedTexture = std::get<5>(bucket.first);
+		batch.TexCPerUnit = 0.0f;
+		for (auto ri : bucket.second)
+			batch.TexCPerUnit = (std::max)(batch.TexCPerUnit, ri->TexCPerUnit);
+		batch.Bounds = submesh.Bounds;
+		batch.SourceCount = (UINT)bucket.second.size();
+
+		batches.push_back(batch);
+		submeshes.push_back(submesh);
+	}
+
+	mStats.BatchedDrawCalls = (UINT)batches.size();
+
+	if (vertices.empty())
+		return nullptr;
+
+	//
+	// With 16-bit indices every batch's vertices stop short of the 0xFFFF cut
+	// value, so a triangle list batch can be redrawn as strips when that
+	// takes fewer indices.
+	//
+	if (allowStrips && fitsIn16Bits)
+	{
+		std::vector<std::uint32_t> stripped;
+		for (size_t i = 0; i < batches.size(); ++i)
+		{
+			SubmeshGeometry& submesh = submeshes[i];
+			const std::uint32_t* first = indices.data() + submesh.StartIndexLocation;
+			std::vector<std::uint32_t> strips;
+			if (batches[i].PrimitiveType == D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
+				strips = StripifyTriangles(first, submesh.IndexCount, 0xFFFF);
+
+			submesh.StartIndexLocation = (UINT)stripped.size();
+			if (!strips.empty() && strips.size() < submesh.IndexCount)
+			{
+				mStats.StripIndicesSaved += submesh.IndexCount - (UINT)strips.size();
+				batches[i].PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+				submesh.IndexCount = (UINT)strips.size();
+				stripped.insert(stripped.end(), strips.begin(), strips.end());
+			}
+			else
+			{
+				stripped.insert(stripped.end(), first, first + submesh.IndexCount);
+			}
+		}
+		indices.swap(stripped);
+	}
+
+	//
+	// Upload the merged mesh, using 16-bit indices whenever every batch fits.
+	//
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = "staticBatchGeo";
+
+	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+
+	std::vector<std::uint16_t> indices16;
+	const void* indexData = indices.data();
+	UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
+	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+	if (fitsIn16Bits)
+	{
+		indices16.assign(indices.begin(), indices.end());
+		indexData = indices16.data();
+		ibByteSize = (UINT)indices16.size() * sizeof(std::uint16_t);
+		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	}
+
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indexData, ibByteSize);
+
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device,
+		cmdList, vertices.data(), vbByteSize, geo->VertexBufferUploader);
+
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(device,
+		cmdList, indexData, ibByteSize, geo->IndexBufferUploader);
+
+	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexBufferByteSize = ibByteSize;
+
+	for (size_t i = 0; i < batches.size(); ++i)
+		geo->DrawArgs[batches[i].Name] = submeshes[i];
+
+	mStats.AddedVertexBytes = vbByteSize;
+	mStats.AddedIndexBytes = ibByteSize;
+
+	return geo;
+}
+
+const StaticBatchStats& StaticBatcher::Stats()const
+{
+	return mStats;
+}
+
+std::wstring StaticBatcher::Report()const
+{
+	std::wostringstream out;
+	out << L"Static batching: " << mStats.SourceDrawCalls << L" draws -> "
+		<< mStats.BatchedDrawCalls << L" draws ("
+		<< (mStats.SourceDrawCalls - mStats.BatchedDrawCalls) << L" saved), +"
+		<< (mStats.AddedVertexBytes + mStats.AddedIndexBytes) / 1024.0 << L" KB ("
+		<< mStats.AddedVertexBytes << L" vertex bytes, "
+		<< mStats.AddedIndexBytes << L" index bytes, "
+		<< mStats.StripIndicesSaved << L" indices saved by strips)\n";
+	return out.str();
+}
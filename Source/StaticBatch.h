@@ -0,0 +1,86 @@
+#pragma once
+
+#include "RenderItem.h"
+#include "FrameResource.h"
+
+// One merged draw produced by the StaticBatcher.  All the source items that
+// fell into the same chunk and share the same draw state end up here, already
+// transformed to world space.
+struct StaticBatch
+{
+	std::string Name;
+
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	RenderLayer Layer = RenderLayer::Opaque;
+
+	// Impostor group of every item merged into this batch.
+	int ImpostorGroup = -1;
+
+	// Streamed texture (typically an atlas page) every item merged into this
+	// batch samples, and the finest texture coordinate density among them.
+	int StreamedTexture = -1;
+	float TexCPerUnit = 1.0f;
+
+	// World space bounds of everything merged into this batch, so the batch
+	// can still be frustum culled as a whole.
+	DirectX::BoundingBox Bounds;
+
+	// Number of source render items merged into this batch.
+	UINT SourceCount = 0;
+};
+
+struct StaticBatchStats
+{
+	UINT SourceDrawCalls = 0;
+	UINT BatchedDrawCalls = 0;
+
+	// Bytes of vertex/index data the merged mesh adds on top of the shared
+	// shape geometry it was built from.
+	UINT64 AddedVertexBytes = 0;
+	UINT64 AddedIndexBytes = 0;
+
+	// Indices saved by drawing batches as strips instead of lists.
+	UINT StripIndicesSaved = 0;
+};
+
+// Startup pass that pre-transforms immobile render items by their World
+// matrices and merges them into a few large meshes.  Items are bucketed by a
+// square grid on the XZ plane (ChunkSize world units per cell), by impostor
+// group and by draw state (render queue, topology and streamed texture, so
+// items whose textures share an atlas page merge), so culling and
+// impostor swaps stay effective while draw calls collapse.
+class StaticBatcher
+{
+public:
+	explicit StaticBatcher(float chunkSize = 16.0f);
+	StaticBatcher(const StaticBatcher& rhs) = delete;
+	StaticBatcher& operator=(const StaticBatcher& rhs) = delete;
+
+	// True for items the batcher merges: static, and not transparent, since
+	// transparent items have to be sorted one by one every frame.
+	static bool CanBatch(const RenderItem* ri);
+
+	// Builds one MeshGeometry holding every batch as a submesh (DrawArgs keyed
+	// by batch name).  Only items accepted by CanBatch are consumed.  The GPU
+	// buffers are created through cmdList, so the caller must execute it and
+	// flush before disposing the uploaders.  Strip items are merged as lists;
+	// with allowStrips a batch becomes strips cut by 0xFFFF when the merged
+	// mesh has 16-bit indices and strips take fewer of them.
+	std::unique_ptr<MeshGeometry> Build(
+		ID3D12Device* device,
+		ID3D12GraphicsCommandList* cmdList,
+		const std::vector<RenderItem*>& ritems,
+		std::vector<StaticBatch>& batches,
+		bool allowStrips = false);
+
+	const StaticBatchStats& Stats()const;
+
+	// Human readable summary of draw calls saved against memory added.
+	std::wstring Report()const;
+
+private:
+	float mChunkSize = 16.0f;
+
+	StaticBatchStats mStats;
+};
@@ -0,0 +1,199 @@
+#include "StreamingUpload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define STREAMING_UPLOAD_SSE2 1
+#endif
+
+void StreamCopy(void* dst, const void* src, std::size_t size)
+{
+#if STREAMING_UPLOAD_SSE2
+	std::uint8_t* d = static_cast<std::uint8_t*>(dst);
+	const std::uint8_t* s = static_cast<const std::uint8_t*>(src);
+
+	// Plain stores up to the first 16-byte boundary of the destination.
+	std::size_t head = (16 - ((std::uintptr_t)d & 15)) & 15;
+	if (head > size)
+		head = size;
+	std::memcpy(d, s, head);
+	d += head;
+	s += head;
+	size -= head;
+
+	// A whole 64-byte write-combining line per iteration.
+	while (size >= 64)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+		__m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+		d += 64;
+		s += 64;
+		size -= 64;
+	}
+
+	while (size >= 16)
+	{
+		_mm_stream_si128(reinterpret_cast<__m128i*>(d), _mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+		d += 16;
+		s += 16;
+		size -= 16;
+	}
+
+	std::memcpy(d, s, size);
+#else
+	std::memcpy(dst, src, size);
+#endif
+}
+
+void StreamFence()
+{
+#if STREAMING_UPLOAD_SSE2
+	_mm_sfence();
+#endif
+}
+
+UploadBatch::UploadBatch(std::size_t elementCount, std::size_t elementStride)
+	: mStride(elementStride), mStaging(elementCount * elementStride, 0), mSizes(elementCount, 0)
+{
+	mDirty.reserve(elementCount);
+}
+
+void UploadBatch::Write(std::size_t index, const void* data, std::size_t size)
+{
+	std::memcpy(&mStaging[index * mStride], data, size);
+	mDirty.push_back((std::uint32_t)index);
+	mSizes[index] = (std::uint32_t)size;
+}
+
+std::size_t UploadBatch::Flush(void* mapped)
+{
+	if (mDirty.empty())
+		return 0;
+
+	std::sort(mDirty.begin(), mDirty.end());
+	mDirty.erase(std::unique(mDirty.begin(), mDirty.end()), mDirty.end());
+
+	std::uint8_t* dst = static_cast<std::uint8_t*>(mapped);
+	std::size_t runs = 0;
+	for (std::size_t i = 0; i < mDirty.size(); )
+	{
+		// A run grows while the element before fills its stride, so its
+		// bytes end where the next element's begin.
+		std::size_t first = mDirty[i];
+		std::size_t count = 1;
+		while (i + count < mDirty.size() && mDirty[i + count] == first + count &&
+			mSizes[first + count - 1] == mStride)
+			count++;
+
+		std::size_t size = (count - 1) * mStride + mSizes[first + count - 1];
+		StreamCopy(dst + first * mStride, &mStaging[first * mStride], size);
+		runs++;
+		i += count;
+	}
+	StreamFence();
+
+	mDirty.clear();
+	return runs;
+}
+
+std::size_t UploadBatch::ElementStride()const
+{
+	return mStride;
+}
+
+std::vector<UploadBenchResult> RunUploadBenchmark(std::size_t elementCount, std::size_t elementStride,
+	std::size_t elementSize, double dirtyFraction, int iterations)
+{
+	// Dirty runs of 1 to 16 elements, separated by clean gaps sized to hit
+	// the requested fraction.  A fixed seed keeps runs comparable.
+	std::vector<std::pair<std::size_t, std::size_t>> runs;
+	std::uint32_t seed = 12345;
+	auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+
+	std::size_t dirtyElements = 0;
+	for (std::size_t index = 0; index < elementCount; )
+	{
+		std::size_t length = (std::min)((std::size_t)(1 + next() % 16), elementCount - index);
+		runs.push_back(std::make_pair(index, length));
+		dirtyElements += length;
+
+		double gap = length * (1.0 - dirtyFraction) / (std::max)(dirtyFraction, 0.001);
+		index += length + (std::size_t)(gap * (0.5 + (next() % 1000) / 1000.0));
+	}
+
+	std::vector<std::uint8_t> staging(elementCount * elementStride + 64, 1);
+	std::vector<std::uint8_t> destination(elementCount * elementStride + 64, 0);
+
+	// Constant buffers are 256-byte aligned; line both buffers up likewise.
+	std::uint8_t* src = staging.data() + ((64 - ((std::uintptr_t)staging.data() & 63)) & 63);
+	std::uint8_t* dst = destination.data() + ((64 - ((std::uintptr_t)destination.data() & 63)) & 63);
+
+	struct Strategy
+	{
+		const char* Name;
+		bool Stream;
+		bool Coalesce;
+	};
+	const Strategy strategies[] =
+	{
+		{ "memcpy per element", false, false },
+		{ "memcpy per run", false, true },
+		{ "stream per element", true, false },
+		{ "stream per run", true, true },
+	};
+
+	std::vector<UploadBenchResult> results;
+	for (const Strategy& strategy : strategies)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		for (int it = 0; it < iterations; ++it)
+		{
+			for (auto& run : runs)
+			{
+				std::size_t offset = run.first * elementStride;
+				if (strategy.Coalesce && elementSize == elementStride)
+				{
+					std::size_t size = run.second * elementStride;
+					if (strategy.Stream)
+						StreamCopy(dst + offset, src + offset, size);
+					else
+						std::memcpy(dst + offset, src + offset, size);
+				}
+				else
+				{
+					for (std::size_t i = 0; i < run.second; ++i, offset += elementStride)
+					{
+						if (strategy.Stream)
+							StreamCopy(dst + offset, src + offset, elementSize);
+						else
+							std::memcpy(dst + offset, src + offset, elementSize);
+					}
+				}
+			}
+
+			if (strategy.Stream)
+				StreamFence();
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double bytes = (double)dirtyElements * elementSize * iterations;
+
+		UploadBenchResult result;
+		result.Strategy = strategy.Name;
+		result.GBPerSecond = seconds > 0.0 ? bytes / seconds / 1.0e9 : 0.0;
+		result.MicrosecondsPerUpload = seconds * 1.0e6 / iterations;
+		results.push_back(result);
+	}
+
+	return results;
+}
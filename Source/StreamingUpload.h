@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Copies size bytes to dst with non-temporal stores where dst is 16-byte
+// aligned, and plain stores for the unaligned head and tail.  Never reads
+// dst, so it is safe on write-combined memory such as a mapped upload heap.
+// The stores are weakly ordered: call StreamFence before the GPU may read.
+void StreamCopy(void* dst, const void* src, std::size_t size);
+void StreamFence();
+
+// Gathers one frame's writes to an upload buffer of fixed-stride elements
+// in ordinary cached memory, then streams only the bytes written to the
+// mapped buffer.  Elements whose written bytes touch (every one but the
+// last filling its stride) go as a single stream.
+class UploadBatch
+{
+public:
+	UploadBatch(std::size_t elementCount, std::size_t elementStride);
+
+	// Stages size (at most the stride) bytes for element index.
+	void Write(std::size_t index, const void* data, std::size_t size);
+
+	// Streams the staged elements to mapped, which points at element 0, and
+	// fences.  Returns the number of runs written.
+	std::size_t Flush(void* mapped);
+
+	std::size_t ElementStride()const;
+
+private:
+	std::size_t mStride = 0;
+	std::vector<std::uint8_t> mStaging;
+	std::vector<std::uint32_t> mDirty;
+
+	// Bytes last written to each element.
+	std::vector<std::uint32_t> mSizes;
+};
+
+struct UploadBenchResult
+{
+	std::string Strategy;
+	double GBPerSecond = 0.0;
+	double MicrosecondsPerUpload = 0.0;
+};
+
+// Times ways of writing a frame's dirty elements (dirtyFraction of
+// elementCount, in runs of random length) of elementSize bytes each, at
+// elementStride apart, from a staging copy into a destination buffer in
+// plain host memory:
+// - memcpy per element, as UploadBuffer::CopyData does
+// - memcpy per coalesced run
+// - non-temporal stream per element
+// - non-temporal stream per coalesced run
+// Runs only coalesce when elements fill their stride; otherwise the
+// written bytes do not touch and each element is copied on its own.
+std::vector<UploadBenchResult> RunUploadBenchmark(std::size_t elementCount, std::size_t elementStride,
+	std::size_t elementSize, double dirtyFraction, int iterations);
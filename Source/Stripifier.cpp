@@ -0,0 +1,165 @@
+#include "Stripifier.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+	std::uint64_t EdgeKey(std::uint32_t from, std::uint32_t to)
+	{
+		return ((std::uint64_t)from << 32) | to;
+	}
+
+	// Every directed edge of the list with the triangle it belongs to,
+	// sorted so the triangles across an edge can be looked up.
+	class EdgeMap
+	{
+	public:
+		EdgeMap(const std::uint32_t* indices, std::size_t triangleCount)
+			: mIndices(indices)
+		{
+			mEdges.reserve(triangleCount * 3);
+			for (std::size_t t = 0; t < triangleCount; ++t)
+			{
+				const std::uint32_t* tri = indices + t * 3;
+				for (int k = 0; k < 3; ++k)
+					mEdges.push_back(std::make_pair(EdgeKey(tri[k], tri[(k + 1) % 3]), (std::uint32_t)t));
+			}
+			std::sort(mEdges.begin(), mEdges.end());
+		}
+
+		// A triangle with the directed edge from -> to that is not taken, or
+		// -1.  taken(t) says whether triangle t is in use.
+		template<typename Taken>
+		std::int64_t Find(std::uint32_t from, std::uint32_t to, const Taken& taken)const
+		{
+			std::uint64_t key = EdgeKey(from, to);
+			auto it = std::lower_bound(mEdges.begin(), mEdges.end(), std::make_pair(key, 0u));
+			for (; it != mEdges.end() && it->first == key; ++it)
+			{
+				if (!taken(it->second))
+					return it->second;
+			}
+			return -1;
+		}
+
+		// The vertex that follows from -> to in triangle t.
+		std::uint32_t Third(std::uint32_t t, std::uint32_t from, std::uint32_t to)const
+		{
+			const std::uint32_t* tri = mIndices + (std::size_t)t * 3;
+			for (int k = 0; k < 3; ++k)
+			{
+				if (tri[k] == from && tri[(k + 1) % 3] == to)
+					return tri[(k + 2) % 3];
+			}
+			return tri[2];
+		}
+
+	private:
+		const std::uint32_t* mIndices;
+		std::vector<std::pair<std::uint64_t, std::uint32_t>> mEdges;
+	};
+}
+
+std::vector<std::uint32_t> StripifyTriangles(const std::uint32_t* indices, std::size_t indexCount,
+	std::uint32_t cutIndex)
+{
+	std::vector<std::uint32_t> strips;
+	if (indexCount % 3 != 0 || std::find(indices, indices + indexCount, cutIndex) != indices + indexCount)
+		return strips;
+
+	const std::size_t triangleCount = indexCount / 3;
+	EdgeMap edges(indices, triangleCount);
+
+	// used marks triangles already in a strip; trial stamps the ones a dry
+	// run has passed over, so trying a rotation needs no clean up.
+	std::vector<std::uint8_t> used(triangleCount, 0);
+	std::vector<std::uint32_t> trial(triangleCount, 0);
+	std::uint32_t stamp = 0;
+
+	// Grows a strip that starts with triangle start as (a, b, c).  The
+	// k-th triangle after it winds the other way when k is odd, so the
+	// edge it must share runs back from the last vertex.  Returns the
+	// triangle count; with out set it takes the triangles and appends the
+	// vertices past the first three.
+	auto grow = [&](std::uint32_t start, std::uint32_t b, std::uint32_t c, std::vector<std::uint32_t>* out)
+	{
+		stamp++;
+		trial[start] = stamp;
+		auto taken = [&](std::uint32_t t) { return used[t] != 0 || trial[t] == stamp; };
+
+		std::size_t count = 1;
+		std::uint32_t p = b, q = c;
+		for (bool odd = true; ; odd = !odd)
+		{
+			std::uint32_t from = odd ? q : p;
+			std::uint32_t to = odd ? p : q;
+			std::int64_t t = edges.Find(from, to, taken);
+			if (t < 0)
+				break;
+
+			std::uint32_t x = edges.Third((std::uint32_t)t, from, to);
+			trial[t] = stamp;
+			if (out != nullptr)
+			{
+				used[t] = 1;
+				out->push_back(x);
+			}
+			p = q;
+			q = x;
+			count++;
+		}
+		return count;
+	};
+
+	for (std::size_t start = 0; start < triangleCount; ++start)
+	{
+		if (used[start])
+			continue;
+
+		const std::uint32_t* tri = indices + start * 3;
+		int bestRotation = 0;
+		std::size_t bestCount = 0;
+		for (int rotation = 0; rotation < 3; ++rotation)
+		{
+			std::size_t count = grow((std::uint32_t)start, tri[(rotation + 1) % 3], tri[(rotation + 2) % 3], nullptr);
+			if (count > bestCount)
+			{
+				bestCount = count;
+				bestRotation = rotation;
+			}
+		}
+
+		if (!strips.empty())
+			strips.push_back(cutIndex);
+		used[start] = 1;
+		strips.push_back(tri[bestRotation]);
+		strips.push_back(tri[(bestRotation + 1) % 3]);
+		strips.push_back(tri[(bestRotation + 2) % 3]);
+		grow((std::uint32_t)start, tri[(bestRotation + 1) % 3], tri[(bestRotation + 2) % 3], &strips);
+	}
+
+	return strips;
+}
+
+std::vector<std::uint32_t> UnstripTriangles(const std::uint32_t* strips, std::size_t indexCount,
+	std::uint32_t cutIndex)
+{
+	std::vector<std::uint32_t> triangles;
+	std::size_t first = 0;
+	for (std::size_t i = 0; i <= indexCount; ++i)
+	{
+		if (i < indexCount && strips[i] != cutIndex)
+			continue;
+
+		for (std::size_t k = first; k + 2 < i; ++k)
+		{
+			bool odd = ((k - first) & 1) != 0;
+			triangles.push_back(strips[odd ? k + 1 : k]);
+			triangles.push_back(strips[odd ? k : k + 1]);
+			triangles.push_back(strips[k + 2]);
+		}
+		first = i + 1;
+	}
+	return triangles;
+}
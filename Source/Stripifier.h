@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Turns a triangle list into triangle strips joined by cutIndex, the strip
+// cut (primitive restart) value of the index format: 0xFFFF for 16-bit
+// indices, 0xFFFFFFFF for 32-bit ones.  Each triangle is drawn once with its
+// winding kept.  Strips are grown greedily across shared edges, starting
+// each from the rotation of its first triangle that reaches furthest.
+// Returns nothing if indexCount is not a multiple of 3 or an index already
+// equals cutIndex; the caller keeps the list then.
+std::vector<std::uint32_t> StripifyTriangles(const std::uint32_t* indices, std::size_t indexCount,
+	std::uint32_t cutIndex);
+
+// The triangle list a strip draws, for code that needs whole triangles
+// (the static batcher, for one).  Triangles come back in strip order, each
+// rotated as the strip starts it.
+std::vector<std::uint32_t> UnstripTriangles(const std::uint32_t* strips, std::size_t indexCount,
+	std::uint32_t cutIndex);
@@ -0,0 +1,227 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+TextureAtlasBuilder::TextureAtlasBuilder(std::uint32_t pageSize, std::uint32_t padding, std::uint32_t mipLevels)
+	: mPageSize(pageSize)
+{
+	assert(mipLevels > 0);
+
+	// One texel of level mipLevels - 1 covers this many texels of level 0.
+	std::uint32_t footprint = 1u << (mipLevels - 1);
+	mGutter = padding * footprint;
+	mAlignment = (std::max)(4u, footprint);
+
+	assert(mPageSize % mAlignment == 0);
+}
+
+std::uint32_t TextureAtlasBuilder::Add(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height, std::size_t rowPitch)
+{
+	Image image;
+	image.Width = width;
+	image.Height = height;
+	image.Texels.resize((std::size_t)width * height * 4);
+	for (std::uint32_t y = 0; y < height; ++y)
+		std::memcpy(&image.Texels[(std::size_t)y * width * 4], rgba + y * rowPitch, (std::size_t)width * 4);
+
+	mImages.push_back(std::move(image));
+	return (std::uint32_t)mImages.size() - 1;
+}
+
+std::uint32_t TextureAtlasBuilder::CellSize(std::uint32_t size)const
+{
+	return (size + 2 * mGutter + mAlignment - 1) / mAlignment * mAlignment;
+}
+
+bool TextureAtlasBuilder::Place(std::vector<SkylineSegment>& skyline, std::uint32_t width, std::uint32_t height,
+	std::uint32_t& x, std::uint32_t& y)const
+{
+	// Bottom-left rule: the spot that leaves the cell's top lowest, then the
+	// leftmost.  A cell starting at segment i rests on the highest segment it
+	// spans.
+	std::size_t bestSegment = skyline.size();
+	std::uint32_t bestTop = UINT32_MAX;
+	for (std::size_t i = 0; i < skyline.size(); ++i)
+	{
+		std::uint32_t left = skyline[i].X;
+		if (left + width > mPageSize)
+			break;
+
+		std::uint32_t base = 0;
+		for (std::size_t j = i; j < skyline.size() && skyline[j].X < left + width; ++j)
+			base = (std::max)(base, skyline[j].Y);
+
+		if (base + height <= mPageSize && base + height < bestTop)
+		{
+			bestTop = base + height;
+			bestSegment = i;
+			y = base;
+		}
+	}
+
+	if (bestSegment == skyline.size())
+		return false;
+
+	x = skyline[bestSegment].X;
+
+	// The cell's top becomes a new segment; the ones under it shrink or go.
+	SkylineSegment top;
+	top.X = x;
+	top.Y = bestTop;
+	top.Width = width;
+
+	std::vector<SkylineSegment> updated;
+	for (auto& segment : skyline)
+	{
+		std::uint32_t segmentEnd = segment.X + segment.Width;
+		if (segmentEnd <= x || segment.X >= x + width)
+		{
+			updated.push_back(segment);
+			continue;
+		}
+		if (segment.X < x)
+		{
+			SkylineSegment left = segment;
+			left.Width = x - segment.X;
+			updated.push_back(left);
+		}
+		if (segment.X <= x)
+			updated.push_back(top);
+		if (segmentEnd > x + width)
+		{
+			SkylineSegment right = segment;
+			right.X = x + width;
+			right.Width = segmentEnd - right.X;
+			updated.push_back(right);
+		}
+	}
+
+	// Neighbours at the same height merge back into one.
+	skyline.clear();
+	for (auto& segment : updated)
+	{
+		if (!skyline.empty() && skyline.back().Y == segment.Y)
+			skyline.back().Width += segment.Width;
+		else
+			skyline.push_back(segment);
+	}
+
+	return true;
+}
+
+bool TextureAtlasBuilder::Pack(std::string* error)
+{
+	mRegions.assign(mImages.size(), AtlasRegion());
+	mPageCount = 0;
+
+	std::vector<std::uint32_t> order(mImages.size());
+	for (std::uint32_t i = 0; i < (std::uint32_t)order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b)
+	{
+		return mImages[a].Height > mImages[b].Height;
+	});
+
+	// Every page stays open, so small images can still fill the gaps left
+	// on earlier pages.
+	std::vector<std::vector<SkylineSegment>> pages;
+	for (std::uint32_t i : order)
+	{
+		const Image& image = mImages[i];
+		std::uint32_t width = CellSize(image.Width);
+		std::uint32_t height = CellSize(image.Height);
+		if (width > mPageSize || height > mPageSize)
+		{
+			if (error != nullptr)
+				*error = "image " + std::to_string(i) + " does not fit on a page";
+			return false;
+		}
+
+		std::uint32_t x = 0;
+		std::uint32_t y = 0;
+		std::uint32_t page = 0;
+		while (page < pages.size() && !Place(pages[page], width, height, x, y))
+			page++;
+
+		if (page == pages.size())
+		{
+			SkylineSegment floor;
+			floor.Width = mPageSize;
+			pages.push_back({ floor });
+			Place(pages[page], width, height, x, y);
+		}
+
+		AtlasRegion& region = mRegions[i];
+		region.Page = page;
+		region.X = x + mGutter;
+		region.Y = y + mGutter;
+		region.Width = image.Width;
+		region.Height = image.Height;
+		region.ScaleU = (float)image.Width / mPageSize;
+		region.ScaleV = (float)image.Height / mPageSize;
+		region.OffsetU = (float)region.X / mPageSize;
+		region.OffsetV = (float)region.Y / mPageSize;
+	}
+
+	mPageCount = (std::uint32_t)pages.size();
+	return true;
+}
+
+const AtlasRegion& TextureAtlasBuilder::Region(std::uint32_t image)const
+{
+	return mRegions[image];
+}
+
+std::uint32_t TextureAtlasBuilder::PageCount()const
+{
+	return mPageCount;
+}
+
+std::uint32_t TextureAtlasBuilder::PageSize()const
+{
+	return mPageSize;
+}
+
+float TextureAtlasBuilder::Utilization()const
+{
+	if (mPageCount == 0)
+		return 0.0f;
+
+	std::uint64_t used = 0;
+	for (auto& image : mImages)
+		used += (std::uint64_t)image.Width * image.Height;
+	return (float)((double)used / ((double)mPageCount * mPageSize * mPageSize));
+}
+
+std::vector<std::uint8_t> TextureAtlasBuilder::ComposePage(std::uint32_t page)const
+{
+	std::vector<std::uint8_t> texels((std::size_t)mPageSize * mPageSize * 4, 0);
+
+	for (std::uint32_t i = 0; i < (std::uint32_t)mImages.size(); ++i)
+	{
+		const AtlasRegion& region = mRegions[i];
+		if (region.Page != page)
+			continue;
+
+		// The image and its gutter, which repeats the nearest edge texel.
+		// The gutter runs on over the rounding at the cell's far sides, as
+		// the last mip texels over the image's far edge can reach into it.
+		const Image& image = mImages[i];
+		std::uint32_t cellWidth = CellSize(image.Width);
+		std::uint32_t cellHeight = CellSize(image.Height);
+		for (std::uint32_t y = 0; y < cellHeight; ++y)
+		{
+			std::uint32_t srcY = (std::uint32_t)(std::min)((std::max)((int)y - (int)mGutter, 0), (int)image.Height - 1);
+			std::uint8_t* dst = &texels[(((std::size_t)region.Y - mGutter + y) * mPageSize + region.X - mGutter) * 4];
+			for (std::uint32_t x = 0; x < cellWidth; ++x, dst += 4)
+			{
+				std::uint32_t srcX = (std::uint32_t)(std::min)((std::max)((int)x - (int)mGutter, 0), (int)image.Width - 1);
+				std::memcpy(dst, &image.Texels[((std::size_t)srcY * image.Width + srcX) * 4], 4);
+			}
+		}
+	}
+
+	return texels;
+}
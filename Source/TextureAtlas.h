@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where an image landed in an atlas, and the scale and offset that take its
+// texture coordinates there.
+struct AtlasRegion
+{
+	std::uint32_t Page = 0;
+
+	// Texels of the image itself, without its gutter.
+	std::uint32_t X = 0;
+	std::uint32_t Y = 0;
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+
+	float ScaleU = 1.0f;
+	float ScaleV = 1.0f;
+	float OffsetU = 0.0f;
+	float OffsetV = 0.0f;
+};
+
+// Packs many small RGBA8 images into a few square atlas pages, so the items
+// using them share one texture (one descriptor, one bind) and can be batched
+// together.
+//
+// Mip-safe: every image's cell starts and ends on a multiple of the texels
+// one texel of level mipLevels - 1 covers (and of 4, for block
+// compression).  The image's edge texels are repeated out to the cell's
+// edges, at least padding of those texels wide on each side, so each of the
+// first mipLevels levels keeps padding texels of gutter.  Box filtered mips
+// of a page therefore never mix images.
+class TextureAtlasBuilder
+{
+public:
+	TextureAtlasBuilder(std::uint32_t pageSize, std::uint32_t padding = 1, std::uint32_t mipLevels = 1);
+
+	// Copies a width x height image, rowPitch bytes per row, and returns its
+	// index.
+	std::uint32_t Add(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height, std::size_t rowPitch);
+
+	// Places every added image, tallest first, on as few pages as it can.
+	// False (with the reason in error) if an image does not fit on a page.
+	bool Pack(std::string* error = nullptr);
+
+	const AtlasRegion& Region(std::uint32_t image)const;
+	std::uint32_t PageCount()const;
+	std::uint32_t PageSize()const;
+
+	// Share of the pages' texels covered by images, gutters excluded.
+	float Utilization()const;
+
+	// The page's texels, pageSize x pageSize tightly packed.  Space no image
+	// uses is transparent black.
+	std::vector<std::uint8_t> ComposePage(std::uint32_t page)const;
+
+private:
+	struct Image
+	{
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+		std::vector<std::uint8_t> Texels;
+	};
+
+	// Top edge of the packed space from X on, Width texels wide.
+	struct SkylineSegment
+	{
+		std::uint32_t X = 0;
+		std::uint32_t Y = 0;
+		std::uint32_t Width = 0;
+	};
+
+	// Texels along one side of an image's cell: the image, its gutter on
+	// both sides, rounded up to the alignment.
+	std::uint32_t CellSize(std::uint32_t size)const;
+
+	bool Place(std::vector<SkylineSegment>& skyline, std::uint32_t width, std::uint32_t height,
+		std::uint32_t& x, std::uint32_t& y)const;
+
+	std::uint32_t mPageSize = 0;
+	std::uint32_t mGutter = 0;
+	std::uint32_t mAlignment = 4;
+
+	std::vector<Image> mImages;
+	std::vector<AtlasRegion> mRegions;
+	std::uint32_t mPageCount = 0;
+};
+
+// Moves a mesh's texture coordinates into region.  Works on any mesh with
+// a Vertices array whose elements have a TexC with x and y, such as
+// GeometryGenerator::MeshData.  The coordinates must stay within [0, 1]:
+// wrapping would sample the neighbours.
+template <class MeshData>
+void RemapTexC(MeshData& mesh, const AtlasRegion& region)
+{
+	for (auto& vertex : mesh.Vertices)
+	{
+		vertex.TexC.x = region.OffsetU + vertex.TexC.x * region.ScaleU;
+		vertex.TexC.y = region.OffsetV + vertex.TexC.y * region.ScaleV;
+	}
+}
@@ -0,0 +1,230 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+std::uint32_t EstimateMip(float texelsPerUnit, float pixelsPerUnit, float distance,
+	std::uint32_t mipCount, float bias)
+{
+	assert(mipCount > 0);
+
+	// Texels that land on one pixel at this distance.  Every halving of the
+	// texture halves that, so the mip is its log2.
+	float pixels = pixelsPerUnit / (std::max)(distance, 1e-4f);
+	float texelsPerPixel = texelsPerUnit / (std::max)(pixels, 1e-8f);
+	float mip = std::log2((std::max)(texelsPerPixel, 1.0f)) + bias;
+
+	if (mip <= 0.0f)
+		return 0;
+	if (mip >= (float)(mipCount - 1))
+		return mipCount - 1;
+	return (std::uint32_t)mip;
+}
+
+TextureResidency::TextureResidency(std::uint64_t budgetBytes, std::uint64_t uploadBytesPerFrame)
+	: mBudgetBytes(budgetBytes), mUploadBytesPerFrame(uploadBytesPerFrame)
+{
+}
+
+std::uint32_t TextureResidency::AddTexture(const std::vector<std::uint64_t>& mipBytes, std::uint32_t tailMipCount)
+{
+	assert(!mipBytes.empty());
+
+	std::uint32_t mipCount = (std::uint32_t)mipBytes.size();
+	tailMipCount = (std::min)((std::max)(tailMipCount, 1u), mipCount);
+
+	Texture tex;
+	tex.MipBytes = mipBytes;
+	tex.TailMip = mipCount - tailMipCount;
+	tex.TopMip = mipCount;
+	tex.WantedMip = mipCount;
+	tex.LastUsedFrame = mFrame;
+
+	mTextures.push_back(tex);
+	mFrameStartTopMip.push_back(mipCount);
+
+	return (std::uint32_t)mTextures.size() - 1;
+}
+
+void TextureResidency::BeginFrame()
+{
+	mFrame++;
+	for (auto& tex : mTextures)
+		tex.WantedMip = (std::uint32_t)tex.MipBytes.size();
+}
+
+void TextureResidency::Request(std::uint32_t texture, std::uint32_t mip)
+{
+	assert(texture < mTextures.size());
+
+	Texture& tex = mTextures[texture];
+	tex.WantedMip = (std::min)(tex.WantedMip, (std::min)(mip, tex.TailMip));
+	tex.LastUsedFrame = mFrame;
+}
+
+std::uint64_t TextureResidency::BytesFrom(const Texture& tex, std::uint32_t mip)const
+{
+	std::uint64_t bytes = 0;
+	for (std::uint32_t i = mip; i < (std::uint32_t)tex.MipBytes.size(); ++i)
+		bytes += tex.MipBytes[i];
+	return bytes;
+}
+
+void TextureResidency::SetTopMip(Texture& tex, std::uint32_t mip)
+{
+	mResidentBytes -= BytesFrom(tex, tex.TopMip);
+	mResidentBytes += BytesFrom(tex, mip);
+	tex.TopMip = mip;
+}
+
+bool TextureResidency::MakeRoom(std::uint64_t bytes, std::uint32_t loading)
+{
+	if (mResidentBytes + bytes <= mBudgetBytes)
+		return true;
+
+	// Do not evict anything unless it makes enough room.
+	std::uint64_t reclaimable = 0;
+	for (std::uint32_t i = 0; i < (std::uint32_t)mTextures.size(); ++i)
+	{
+		const Texture& tex = mTextures[i];
+		bool requested = tex.WantedMip < (std::uint32_t)tex.MipBytes.size();
+		std::uint32_t keepMip = requested ? tex.WantedMip : tex.TailMip;
+		if (i != loading && tex.TopMip < keepMip)
+			reclaimable += BytesFrom(tex, tex.TopMip) - BytesFrom(tex, keepMip);
+	}
+	if (bytes > 0 && mResidentBytes - reclaimable + bytes > mBudgetBytes)
+		return false;
+
+	while (mResidentBytes + bytes > mBudgetBytes)
+	{
+		// Least recently used first among the textures not needed this frame,
+		// which drop to their tail.  Failing that, a needed texture holding
+		// finer mips than it asked for drops to what it asked for.
+		Texture* victim = nullptr;
+		for (std::uint32_t i = 0; i < (std::uint32_t)mTextures.size(); ++i)
+		{
+			Texture& tex = mTextures[i];
+			bool requested = tex.WantedMip < (std::uint32_t)tex.MipBytes.size();
+			if (i != loading && !requested && tex.TopMip < tex.TailMip &&
+				(victim == nullptr || tex.LastUsedFrame < victim->LastUsedFrame))
+				victim = &tex;
+		}
+
+		std::uint32_t victimMip = victim != nullptr ? victim->TailMip : 0;
+		for (std::uint32_t i = 0; victim == nullptr && i < (std::uint32_t)mTextures.size(); ++i)
+		{
+			Texture& tex = mTextures[i];
+			if (i != loading && tex.TopMip < tex.WantedMip && tex.WantedMip < (std::uint32_t)tex.MipBytes.size())
+			{
+				victim = &tex;
+				victimMip = tex.WantedMip;
+			}
+		}
+
+		if (victim == nullptr)
+			return false;
+
+		SetTopMip(*victim, victimMip);
+	}
+
+	return true;
+}
+
+const std::vector<TextureResidency::Change>& TextureResidency::Update()
+{
+	mChanges.clear();
+	mUploadedBytes = 0;
+
+	for (std::uint32_t i = 0; i < (std::uint32_t)mTextures.size(); ++i)
+		mFrameStartTopMip[i] = mTextures[i].TopMip;
+
+	// New textures get their tail straight away.  It does not count against
+	// the upload allowance and may push the total past the budget.
+	for (auto& tex : mTextures)
+	{
+		if (tex.TopMip > tex.TailMip)
+		{
+			mUploadedBytes += BytesFrom(tex, tex.TailMip) - BytesFrom(tex, tex.TopMip);
+			SetTopMip(tex, tex.TailMip);
+		}
+	}
+
+	// Textures furthest from the mip they asked for load first, so every
+	// visible surface gets sharper before any one of them gets sharp.
+	std::vector<std::uint32_t> order;
+	for (std::uint32_t i = 0; i < (std::uint32_t)mTextures.size(); ++i)
+	{
+		if (mTextures[i].WantedMip < mTextures[i].TopMip)
+			order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+	{
+		return mTextures[a].TopMip - mTextures[a].WantedMip > mTextures[b].TopMip - mTextures[b].WantedMip;
+	});
+
+	std::uint64_t streamed = 0;
+	for (std::uint32_t i : order)
+	{
+		Texture& tex = mTextures[i];
+		std::uint64_t bytes = tex.MipBytes[tex.TopMip - 1];
+
+		// The first load always goes, so a mip bigger than the whole
+		// allowance still gets in eventually.
+		if (streamed > 0 && streamed + bytes > mUploadBytesPerFrame)
+			break;
+		if (!MakeRoom(bytes, i))
+			continue;
+
+		SetTopMip(tex, tex.TopMip - 1);
+		streamed += bytes;
+	}
+	mUploadedBytes += streamed;
+
+	// A budget that was already exceeded (by tails) gives back what it can.
+	MakeRoom(0, (std::uint32_t)mTextures.size());
+
+	for (std::uint32_t i = 0; i < (std::uint32_t)mTextures.size(); ++i)
+	{
+		if (mTextures[i].TopMip != mFrameStartTopMip[i])
+		{
+			Change change;
+			change.Texture = i;
+			change.OldTopMip = mFrameStartTopMip[i];
+			change.NewTopMip = mTextures[i].TopMip;
+			mChanges.push_back(change);
+		}
+	}
+
+	return mChanges;
+}
+
+std::uint32_t TextureResidency::TextureCount()const
+{
+	return (std::uint32_t)mTextures.size();
+}
+
+std::uint32_t TextureResidency::MipCount(std::uint32_t texture)const
+{
+	return (std::uint32_t)mTextures[texture].MipBytes.size();
+}
+
+std::uint32_t TextureResidency::ResidentTopMip(std::uint32_t texture)const
+{
+	return mTextures[texture].TopMip;
+}
+
+std::uint64_t TextureResidency::ResidentBytes()const
+{
+	return mResidentBytes;
+}
+
+std::uint64_t TextureResidency::BudgetBytes()const
+{
+	return mBudgetBytes;
+}
+
+std::uint64_t TextureResidency::UploadedBytes()const
+{
+	return mUploadedBytes;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Finest mip worth having for a surface seen at distance from the eye.
+// texelsPerUnit is how many mip 0 texels span one world unit of the surface,
+// pixelsPerUnit how many pixels one world unit at distance 1 covers on screen
+// (half the viewport height times the projection's y scale).  A positive
+// bias trades sharpness for memory.
+std::uint32_t EstimateMip(float texelsPerUnit, float pixelsPerUnit, float distance,
+	std::uint32_t mipCount, float bias = 0.0f);
+
+// Decides which mips of each streamed texture should be in video memory.
+// Only the CPU side bookkeeping lives here, so it can be driven and checked
+// without a device.
+//
+// A texture is resident as one contiguous range of mips, from its top
+// (finest) resident mip down to the last.  The coarsest few, the tail, are
+// loaded right away and never leave.  Each frame the caller requests the
+// mip each visible texture needs; Update then moves textures one mip finer
+// at a time, spending at most the per-frame upload allowance, and when the
+// budget is full drops mips from the least recently used textures first.
+class TextureResidency
+{
+public:
+	struct Change
+	{
+		std::uint32_t Texture = 0;
+
+		// Finest resident mip before and after.  OldTopMip is the mip count
+		// for a texture that had nothing resident yet.
+		std::uint32_t OldTopMip = 0;
+		std::uint32_t NewTopMip = 0;
+	};
+
+	TextureResidency(std::uint64_t budgetBytes, std::uint64_t uploadBytesPerFrame);
+
+	// Adds a texture whose mip i takes mipBytes[i] bytes.  Its last
+	// tailMipCount mips become resident on the next Update regardless of the
+	// budget and upload allowance.
+	std::uint32_t AddTexture(const std::vector<std::uint64_t>& mipBytes, std::uint32_t tailMipCount);
+
+	// Starts collecting the requests of a new frame.
+	void BeginFrame();
+
+	// Asks for mip (and everything coarser) of texture this frame.  Several
+	// requests for one texture keep the finest.
+	void Request(std::uint32_t texture, std::uint32_t mip);
+
+	// Applies this frame's requests.  Returns what changed, at most one entry
+	// per texture; the caller moves the GPU copies to match.
+	const std::vector<Change>& Update();
+
+	std::uint32_t TextureCount()const;
+	std::uint32_t MipCount(std::uint32_t texture)const;
+	std::uint32_t ResidentTopMip(std::uint32_t texture)const;
+
+	std::uint64_t ResidentBytes()const;
+	std::uint64_t BudgetBytes()const;
+	std::uint64_t UploadedBytes()const;
+
+private:
+	struct Texture
+	{
+		std::vector<std::uint64_t> MipBytes;
+
+		// Finest mip of the tail, the finest resident mip (MipCount when
+		// nothing is resident) and the finest mip requested this frame
+		// (MipCount when none was).
+		std::uint32_t TailMip = 0;
+		std::uint32_t TopMip = 0;
+		std::uint32_t WantedMip = 0;
+
+		std::uint64_t LastUsedFrame = 0;
+	};
+
+	std::uint64_t BytesFrom(const Texture& tex, std::uint32_t mip)const;
+	void SetTopMip(Texture& tex, std::uint32_t mip);
+	bool MakeRoom(std::uint64_t bytes, std::uint32_t loading);
+
+	std::vector<Texture> mTextures;
+	std::vector<std::uint32_t> mFrameStartTopMip;
+	std::vector<Change> mChanges;
+
+	std::uint64_t mBudgetBytes = 0;
+	std::uint64_t mUploadBytesPerFrame = 0;
+	std::uint64_t mResidentBytes = 0;
+	std::uint64_t mUploadedBytes = 0;
+	std::uint64_t mFrame = 0;
+};
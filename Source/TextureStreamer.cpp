@@ -0,0 +1,332 @@
+#include "TextureStreamer.h"
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <fstream>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Mips no larger than this on either side make up a texture's tail: they
+	// cost little and are loaded as soon as the texture is.
+	const UINT TailMipSize = 128;
+}
+
+TextureStreamer::TextureStreamer(ID3D12Device* device, UINT frameCount, UINT maxTextures,
+	UINT64 budgetBytes, UINT64 uploadBytesPerFrame)
+	: mDevice(device), mFrameCount(frameCount), mMaxTextures(maxTextures),
+	mResidency(budgetBytes, uploadBytesPerFrame), mViewVersions(frameCount)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+}
+
+void TextureStreamer::SetDescriptors(D3D12_CPU_DESCRIPTOR_HANDLE srvStart, UINT descriptorSize)
+{
+	mSrvStart = srvStart;
+	mDescriptorSize = descriptorSize;
+
+	// Every view is written again on its frame's next Update.
+	for (auto& versions : mViewVersions)
+		std::fill(versions.begin(), versions.end(), ~0u);
+}
+
+int TextureStreamer::Load(const std::wstring& filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		OutputDebugStringW((L"TextureStreamer: cannot open " + filename + L"\n").c_str());
+		return -1;
+	}
+
+	std::vector<std::uint8_t> fileData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Load(std::move(fileData), filename);
+}
+
+int TextureStreamer::Load(std::vector<std::uint8_t> fileData, const std::wstring& name)
+{
+	if (mTextures.size() >= mMaxTextures)
+	{
+		OutputDebugStringW((L"TextureStreamer: no room for " + name + L"\n").c_str());
+		return -1;
+	}
+
+	Texture tex;
+	std::string error;
+	if (!ParseDDS(fileData.data(), fileData.size(), tex.Image, &error))
+	{
+		OutputDebugStringW((L"TextureStreamer: " + name + L": " + std::wstring(error.begin(), error.end()) + L"\n").c_str());
+		return -1;
+	}
+
+	// A lone top level would leave nothing to stream, and minified
+	// surfaces would shimmer.
+	if (tex.Image.MipCount == 1 && FullMipCount(tex.Image.Width, tex.Image.Height) > 1)
+	{
+		if (mMipPool == nullptr)
+			mMipPool = std::make_unique<ThreadPool>();
+
+		std::vector<std::uint8_t> mipped;
+		if (GenerateDDSMips(fileData, MipFilter::Kaiser, *mMipPool, mipped, nullptr))
+		{
+			fileData.swap(mipped);
+			ParseDDS(fileData.data(), fileData.size(), tex.Image, nullptr);
+		}
+	}
+
+	tex.Name = name;
+	tex.FileData = std::move(fileData);
+	tex.TopMip = tex.Image.MipCount;
+
+	std::vector<std::uint64_t> mipBytes(tex.Image.MipCount, 0);
+	UINT tailMipCount = 0;
+	for (UINT mip = 0; mip < tex.Image.MipCount; ++mip)
+	{
+		for (UINT slice = 0; slice < tex.Image.ArraySize; ++slice)
+			mipBytes[mip] += tex.Image.Mip(slice, mip).SizeInBytes;
+
+		const DDSMipLevel& level = tex.Image.Mip(0, mip);
+		if (level.Width <= TailMipSize && level.Height <= TailMipSize)
+			tailMipCount++;
+	}
+
+	UINT index = mResidency.AddTexture(mipBytes, tailMipCount);
+	mTextures.push_back(std::move(tex));
+	for (auto& versions : mViewVersions)
+		versions.push_back(~0u);
+
+	return (int)index;
+}
+
+void TextureStreamer::BeginFrame()
+{
+	mResidency.BeginFrame();
+}
+
+void TextureStreamer::Request(UINT texture, UINT mip)
+{
+	mResidency.Request(texture, mip);
+}
+
+void TextureStreamer::Update(ID3D12GraphicsCommandList* cmdList, UINT frameIndex, UINT64 frameFence, UINT64 completedFence)
+{
+	mRetired.erase(std::remove_if(mRetired.begin(), mRetired.end(),
+		[&](const Retired& retired) { return retired.Fence <= completedFence; }), mRetired.end());
+
+	const auto& changes = mResidency.Update();
+	for (auto& change : changes)
+		Restream(cmdList, mTextures[change.Texture], change.NewTopMip, frameFence);
+	mChanged = !changes.empty();
+
+	// This frame's views catch up with every replacement made since the
+	// frame resource was last used, not just this frame's.
+	for (UINT i = 0; i < (UINT)mTextures.size(); ++i)
+	{
+		if (mViewVersions[frameIndex][i] != mTextures[i].Version)
+		{
+			WriteView(mTextures[i], frameIndex, i);
+			mViewVersions[frameIndex][i] = mTextures[i].Version;
+		}
+	}
+}
+
+void TextureStreamer::Restream(ID3D12GraphicsCommandList* cmdList, Texture& tex, UINT newTopMip, UINT64 frameFence)
+{
+	const DDSImage& image = tex.Image;
+	const DDSMipLevel& top = image.Mip(0, newTopMip);
+	UINT levels = image.MipCount - newTopMip;
+
+	D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D((DXGI_FORMAT)image.Format,
+		top.Width, top.Height, (UINT16)image.ArraySize, (UINT16)levels);
+
+	ComPtr<ID3D12Resource> resource;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&resource)));
+
+	// Mips from firstShared on are in both the old and the new resource.
+	UINT firstShared = (std::max)(newTopMip, tex.TopMip);
+	if (tex.Resource != nullptr)
+	{
+		UINT oldLevels = image.MipCount - tex.TopMip;
+
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(tex.Resource.Get(),
+			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+		for (UINT slice = 0; slice < image.ArraySize; ++slice)
+		{
+			for (UINT mip = firstShared; mip < image.MipCount; ++mip)
+			{
+				CD3DX12_TEXTURE_COPY_LOCATION dst(resource.Get(),
+					D3D12CalcSubresource(mip - newTopMip, slice, 0, levels, image.ArraySize));
+				CD3DX12_TEXTURE_COPY_LOCATION src(tex.Resource.Get(),
+					D3D12CalcSubresource(mip - tex.TopMip, slice, 0, oldLevels, image.ArraySize));
+				cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+			}
+		}
+
+		Retired retired;
+		retired.Resource = tex.Resource;
+		retired.Fence = frameFence;
+		mRetired.push_back(retired);
+	}
+
+	// Mips the old resource did not have come from the file, through an
+	// upload buffer laid out the way the copy engine wants them.
+	if (newTopMip < firstShared)
+	{
+		struct Upload
+		{
+			UINT Subresource;
+			const DDSMipLevel* Level;
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT Layout;
+			UINT RowCount;
+		};
+
+		std::vector<Upload> uploads;
+		UINT64 uploadBytes = 0;
+		for (UINT slice = 0; slice < image.ArraySize; ++slice)
+		{
+			for (UINT mip = newTopMip; mip < firstShared; ++mip)
+			{
+				Upload upload;
+				upload.Subresource = D3D12CalcSubresource(mip - newTopMip, slice, 0, levels, image.ArraySize);
+				upload.Level = &image.Mip(slice, mip);
+
+				UINT64 rowSize = 0;
+				UINT64 totalBytes = 0;
+				mDevice->GetCopyableFootprints(&desc, upload.Subresource, 1, uploadBytes,
+					&upload.Layout, &upload.RowCount, &rowSize, &totalBytes);
+				uploads.push_back(upload);
+
+				uploadBytes += totalBytes;
+				uploadBytes = (uploadBytes + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) &
+					~(UINT64)(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+			}
+		}
+
+		ComPtr<ID3D12Resource> uploadBuffer;
+		ThrowIfFailed(mDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(uploadBytes),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&uploadBuffer)));
+
+		BYTE* mapped = nullptr;
+		ThrowIfFailed(uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mapped)));
+		for (auto& upload : uploads)
+		{
+			const std::uint8_t* src = tex.FileData.data() + upload.Level->Offset;
+			BYTE* dst = mapped + upload.Layout.Offset;
+			for (UINT row = 0; row < upload.RowCount; ++row)
+			{
+				memcpy(dst + row * upload.Layout.Footprint.RowPitch,
+					src + row * upload.Level->RowPitch, (size_t)upload.Level->RowPitch);
+			}
+		}
+		uploadBuffer->Unmap(0, nullptr);
+
+		for (auto& upload : uploads)
+		{
+			CD3DX12_TEXTURE_COPY_LOCATION dst(resource.Get(), upload.Subresource);
+			CD3DX12_TEXTURE_COPY_LOCATION src(uploadBuffer.Get(), upload.Layout);
+			cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+		}
+
+		Retired retired;
+		retired.Resource = uploadBuffer;
+		retired.Fence = frameFence;
+		mRetired.push_back(retired);
+	}
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(resource.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+	tex.Resource = resource;
+	tex.TopMip = newTopMip;
+	tex.Version++;
+}
+
+void TextureStreamer::WriteView(const Texture& tex, UINT frameIndex, UINT texture)
+{
+	const DDSImage& image = tex.Image;
+	UINT levels = tex.Resource != nullptr ? image.MipCount - tex.TopMip : 1;
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = (DXGI_FORMAT)image.Format;
+	if (image.IsCubeMap && image.ArraySize == 6)
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MostDetailedMip = 0;
+		srvDesc.TextureCube.MipLevels = levels;
+	}
+	else if (image.ArraySize > 1)
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.MipLevels = levels;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = image.ArraySize;
+	}
+	else
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = levels;
+	}
+
+	auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvStart);
+	handle.Offset(frameIndex * mMaxTextures + texture, mDescriptorSize);
+	mDevice->CreateShaderResourceView(tex.Resource.Get(), &srvDesc, handle);
+}
+
+UINT TextureStreamer::TextureCount()const
+{
+	return (UINT)mTextures.size();
+}
+
+UINT TextureStreamer::MaxTextures()const
+{
+	return mMaxTextures;
+}
+
+UINT TextureStreamer::MipCount(UINT texture)const
+{
+	return mTextures[texture].Image.MipCount;
+}
+
+UINT TextureStreamer::Width(UINT texture)const
+{
+	return mTextures[texture].Image.Width;
+}
+
+UINT TextureStreamer::ResidentTopMip(UINT texture)const
+{
+	return mTextures[texture].TopMip;
+}
+
+UINT64 TextureStreamer::ResidentBytes()const
+{
+	return mResidency.ResidentBytes();
+}
+
+UINT64 TextureStreamer::BudgetBytes()const
+{
+	return mResidency.BudgetBytes();
+}
+
+bool TextureStreamer::Changed()const
+{
+	return mChanged;
+}
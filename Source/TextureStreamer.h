@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+#include "DDSFile.h"
+#include "TextureResidency.h"
+#include "ThreadPool.h"
+
+// Streams the mips of DDS textures in and out of video memory as
+// TextureResidency decides.  The whole file stays in system memory; each
+// texture's resident mips live in one committed resource that is replaced
+// whenever the range changes.  Mips both versions hold are copied on the GPU,
+// newly needed ones are uploaded from the file.
+//
+// Every texture has one SRV per frame resource, so a frame still in flight
+// keeps reading the resource it was recorded with.  Replaced resources are
+// released once the GPU has finished every frame that could use them.
+class TextureStreamer
+{
+public:
+	TextureStreamer(ID3D12Device* device, UINT frameCount, UINT maxTextures,
+		UINT64 budgetBytes, UINT64 uploadBytesPerFrame);
+	TextureStreamer(const TextureStreamer& rhs) = delete;
+	TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+	~TextureStreamer();
+
+	// Where the frameCount * maxTextures SRVs go: the one for texture t of
+	// frame f is at index f * maxTextures + t.
+	void SetDescriptors(D3D12_CPU_DESCRIPTOR_HANDLE srvStart, UINT descriptorSize);
+
+	// Reads a DDS file.  Returns the texture's index, or -1 (with the reason
+	// sent to the debugger) if the file cannot be used.  Its tail is resident
+	// after the next Update.  An 8-bit RGBA file without mips gets a full
+	// chain generated here.
+	int Load(const std::wstring& filename);
+	int Load(std::vector<std::uint8_t> fileData, const std::wstring& name);
+
+	// Per-frame requests, as TextureResidency.
+	void BeginFrame();
+	void Request(UINT texture, UINT mip);
+
+	// Applies this frame's requests, recording the copies on cmdList, and
+	// refreshes frameIndex's SRVs.  frameFence is the fence value the frame
+	// being recorded will signal, completedFence the value the GPU reached.
+	void Update(ID3D12GraphicsCommandList* cmdList, UINT frameIndex, UINT64 frameFence, UINT64 completedFence);
+
+	UINT TextureCount()const;
+	UINT MaxTextures()const;
+	UINT MipCount(UINT texture)const;
+	UINT Width(UINT texture)const;
+	UINT ResidentTopMip(UINT texture)const;
+
+	UINT64 ResidentBytes()const;
+	UINT64 BudgetBytes()const;
+
+	// Whether the last Update replaced any texture.  More replacements may
+	// follow while it does.
+	bool Changed()const;
+
+private:
+	struct Texture
+	{
+		std::wstring Name;
+		std::vector<std::uint8_t> FileData;
+		DDSImage Image;
+
+		// Holds mips [TopMip, MipCount) of every array slice.
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource = nullptr;
+		UINT TopMip = 0;
+
+		// Bumped whenever Resource is replaced; each frame's SRV is rewritten
+		// when its version falls behind.
+		UINT Version = 0;
+	};
+
+	struct Retired
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource = nullptr;
+		UINT64 Fence = 0;
+	};
+
+	void Restream(ID3D12GraphicsCommandList* cmdList, Texture& tex, UINT newTopMip, UINT64 frameFence);
+	void WriteView(const Texture& tex, UINT frameIndex, UINT texture);
+
+	ID3D12Device* mDevice = nullptr;
+	UINT mFrameCount = 0;
+	UINT mMaxTextures = 0;
+
+	D3D12_CPU_DESCRIPTOR_HANDLE mSrvStart = {};
+	UINT mDescriptorSize = 0;
+
+	TextureResidency mResidency;
+	std::vector<Texture> mTextures;
+
+	// Resource version each frame's SRV of each texture was written for.
+	std::vector<std::vector<UINT>> mViewVersions;
+
+	std::vector<Retired> mRetired;
+	bool mChanged = false;
+
+	// Workers for generating missing mips, started the first time a file
+	// needs them.
+	std::unique_ptr<ThreadPool> mMipPool;
+};
@@ -0,0 +1,90 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	mWorkers.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; ++i)
+		mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mWorkAvailable.notify_all();
+
+	for (auto& worker : mWorkers)
+		worker.join();
+}
+
+unsigned ThreadPool::ThreadCount()const
+{
+	return (unsigned)mWorkers.size();
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQueue.push_back(std::move(job));
+	}
+	mWorkAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mWorkDone.wait(lock, [this]() { return mQueue.empty() && mRunning == 0; });
+}
+
+void ThreadPool::ParallelFor(std::size_t count, std::size_t grainSize, const std::function<void(std::size_t)>& fn)
+{
+	if (grainSize == 0)
+		grainSize = 1;
+
+	for (std::size_t begin = 0; begin < count; begin += grainSize)
+	{
+		std::size_t end = begin + grainSize < count ? begin + grainSize : count;
+		Submit([begin, end, &fn]()
+		{
+			for (std::size_t i = begin; i < end; ++i)
+				fn(i);
+		});
+	}
+
+	Wait();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWorkAvailable.wait(lock, [this]() { return mStopping || !mQueue.empty(); });
+			if (mQueue.empty())
+				return;
+
+			job = std::move(mQueue.front());
+			mQueue.pop_front();
+			mRunning++;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mRunning--;
+			if (mQueue.empty() && mRunning == 0)
+				mWorkDone.notify_all();
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs from one shared queue.
+//
+// Jobs are meant to be independent chunks of a frame's work; Wait blocks
+// until every submitted job has finished, which is the only point where the
+// caller sees their results.
+class ThreadPool
+{
+public:
+	// 0 threads means one per hardware thread.
+	explicit ThreadPool(unsigned threadCount = 0);
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+	~ThreadPool();
+
+	unsigned ThreadCount()const;
+
+	void Submit(std::function<void()> job);
+
+	// Blocks until the queue is empty and no job is running.
+	void Wait();
+
+	// Runs fn(i) for i in [0, count) across the workers, in chunks of
+	// grainSize indices, and waits for all of them.
+	void ParallelFor(std::size_t count, std::size_t grainSize, const std::function<void(std::size_t)>& fn);
+
+private:
+	void WorkerLoop();
+
+private:
+	std::vector<std::thread> mWorkers;
+
+	std::mutex mMutex;
+	std::condition_variable mWorkAvailable;
+	std::condition_variable mWorkDone;
+	std::deque<std::function<void()>> mQueue;
+	std::size_t mRunning = 0;
+	bool mStopping = false;
+};
@@ -0,0 +1,230 @@
+#include "VertexFrames.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	const std::size_t TriangleGrain = 4096;
+	const std::size_t VertexGrain = 4096;
+
+	// A given tangent is kept only if at least this much of it (sin 0.5
+	// degrees, squared) is left once its part along the normal goes.
+	const float MinTangentLengthSq = 0.0087f * 0.0087f;
+
+	float SignNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	std::uint32_t PackSnorm16(float value)
+	{
+		float clamped = (std::min)((std::max)(value, -1.0f), 1.0f);
+		return (std::uint32_t)(std::uint16_t)(std::int16_t)std::lround(clamped * 32767.0f);
+	}
+
+	float UnpackSnorm16(std::uint32_t bits)
+	{
+		// -32768 and -32767 both stand for -1, as the hardware reads them.
+		return (std::max)((float)(std::int16_t)(std::uint16_t)bits / 32767.0f, -1.0f);
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Normalizes v in place; false, leaving it alone, if it has no length.
+	bool Normalize(float* v)
+	{
+		float length = std::sqrt(Dot(v, v));
+		if (!(length > 1e-20f))
+			return false;
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+		return true;
+	}
+
+	bool IsUnit(const float* v)
+	{
+		float lengthSq = Dot(v, v);
+		return lengthSq > 0.98f && lengthSq < 1.02f;
+	}
+
+	// The unit part of t orthogonal to the unit normal n.  False when t is
+	// within about half a degree of n, where what is left is mostly
+	// rounding and gives no real direction.  Projecting twice takes out
+	// what rounding in the first pass left along n.
+	bool Orthogonalize(const float* n, const float* t, float* out)
+	{
+		float along = Dot(t, n);
+		out[0] = t[0] - n[0] * along;
+		out[1] = t[1] - n[1] * along;
+		out[2] = t[2] - n[2] * along;
+		if (Dot(out, out) < MinTangentLengthSq * Dot(t, t) || !Normalize(out))
+			return false;
+
+		along = Dot(out, n);
+		out[0] -= n[0] * along;
+		out[1] -= n[1] * along;
+		out[2] -= n[2] * along;
+		return Normalize(out);
+	}
+}
+
+std::uint32_t PackUnitVector(float x, float y, float z)
+{
+	float l1 = std::fabs(x) + std::fabs(y) + std::fabs(z);
+	if (!(l1 > 0.0f))
+		return PackSnorm16(0.0f) | (PackSnorm16(0.0f) << 16);
+
+	float u = x / l1;
+	float v = y / l1;
+	if (z < 0.0f)
+	{
+		float foldedU = (1.0f - std::fabs(v)) * SignNotZero(u);
+		float foldedV = (1.0f - std::fabs(u)) * SignNotZero(v);
+		u = foldedU;
+		v = foldedV;
+	}
+	return PackSnorm16(u) | (PackSnorm16(v) << 16);
+}
+
+void UnpackUnitVector(std::uint32_t packed, float& x, float& y, float& z)
+{
+	float v[3] = { UnpackSnorm16(packed & 0xFFFF), UnpackSnorm16(packed >> 16), 0.0f };
+	v[2] = 1.0f - std::fabs(v[0]) - std::fabs(v[1]);
+
+	// Below the equator, unfold the corner back onto the lower half.
+	float t = (std::max)(-v[2], 0.0f);
+	v[0] += v[0] >= 0.0f ? -t : t;
+	v[1] += v[1] >= 0.0f ? -t : t;
+	Normalize(v);
+
+	x = v[0];
+	y = v[1];
+	z = v[2];
+}
+
+VertexFrameStats BuildVertexFrames(const float* positions, std::size_t positionStride, std::size_t vertexCount,
+	const std::uint32_t* indices, std::size_t indexCount, float* normals, float* tangents, ThreadPool& pool)
+{
+	const std::size_t triangleCount = indexCount / 3;
+	auto position = [&](std::uint32_t v)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const std::uint8_t*>(positions) + v * positionStride);
+	};
+
+	// Cross products, not normalized: their length is twice the area, which
+	// is the weight each face gets.  Triangles that reach past the vertices
+	// get no weight.
+	std::vector<float> faceNormals(triangleCount * 3);
+	pool.ParallelFor(triangleCount, TriangleGrain, [&](std::size_t t)
+	{
+		const std::uint32_t* tri = indices + t * 3;
+		float* n = &faceNormals[t * 3];
+		if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount)
+		{
+			n[0] = n[1] = n[2] = 0.0f;
+			return;
+		}
+
+		const float* p0 = position(tri[0]);
+		const float* p1 = position(tri[1]);
+		const float* p2 = position(tri[2]);
+		float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+		// Clockwise front faces in left-handed space, as Direct3D draws them,
+		// face along e0 x e1.
+		n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+		n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+		n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+	});
+
+	// Vertex to triangle table, counting sort style: firsts[v] to
+	// firsts[v + 1] are the slots of v's triangles.
+	std::vector<std::uint32_t> firsts(vertexCount + 1, 0);
+	for (std::size_t i = 0; i < triangleCount * 3; ++i)
+	{
+		if (indices[i] < vertexCount)
+			firsts[indices[i] + 1]++;
+	}
+	for (std::size_t v = 0; v < vertexCount; ++v)
+		firsts[v + 1] += firsts[v];
+
+	std::vector<std::uint32_t> fill(firsts.begin(), firsts.end() - 1);
+	std::vector<std::uint32_t> vertexTriangles(firsts[vertexCount]);
+	for (std::size_t i = 0; i < triangleCount * 3; ++i)
+	{
+		if (indices[i] < vertexCount)
+			vertexTriangles[fill[indices[i]]++] = (std::uint32_t)(i / 3);
+	}
+
+	// Per vertex flags for the stats: bit 0 a kept normal, bit 1 a kept
+	// tangent.
+	std::vector<std::uint8_t> kept(vertexCount, 0);
+	pool.ParallelFor(vertexCount, VertexGrain, [&](std::size_t v)
+	{
+		float* n = normals + v * 3;
+		if (IsUnit(n))
+		{
+			Normalize(n);
+			kept[v] |= 1;
+		}
+		else
+		{
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			for (std::uint32_t slot = firsts[v]; slot < firsts[v + 1]; ++slot)
+			{
+				const float* face = &faceNormals[vertexTriangles[slot] * 3];
+				sum[0] += face[0];
+				sum[1] += face[1];
+				sum[2] += face[2];
+			}
+
+			// A vertex no face uses, or one whose faces cancel out, still
+			// needs a direction to pack.
+			if (!Normalize(sum))
+			{
+				sum[0] = 0.0f;
+				sum[1] = 1.0f;
+				sum[2] = 0.0f;
+			}
+			n[0] = sum[0];
+			n[1] = sum[1];
+			n[2] = sum[2];
+		}
+
+		float* t = tangents + v * 3;
+		float orthogonal[3];
+		if (IsUnit(t) && Orthogonalize(n, t, orthogonal))
+		{
+			kept[v] |= 2;
+		}
+		else
+		{
+			// The axis least along the normal, projected onto its plane.
+			float axis[3] = { 0.0f, 0.0f, 0.0f };
+			float ax = std::fabs(n[0]), ay = std::fabs(n[1]), az = std::fabs(n[2]);
+			axis[ax <= ay && ax <= az ? 0 : ay <= az ? 1 : 2] = 1.0f;
+			Orthogonalize(n, axis, orthogonal);
+		}
+		t[0] = orthogonal[0];
+		t[1] = orthogonal[1];
+		t[2] = orthogonal[2];
+	});
+
+	VertexFrameStats stats;
+	for (std::uint8_t flags : kept)
+	{
+		stats.KeptNormals += flags & 1;
+		stats.KeptTangents += (flags >> 1) & 1;
+	}
+	stats.GeneratedNormals = vertexCount - stats.KeptNormals;
+	stats.GeneratedTangents = vertexCount - stats.KeptTangents;
+	return stats;
+}
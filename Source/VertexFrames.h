@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class ThreadPool;
+
+// Unit vectors in 32 bits, as two snorm16 values (DXGI_FORMAT_R16G16_SNORM,
+// first value in the low half).  The sphere is projected onto the octahedron
+// |x| + |y| + |z| = 1, whose lower half is folded out over the corners of
+// the upper one's square; the worst error is about 0.004 degrees.
+std::uint32_t PackUnitVector(float x, float y, float z);
+void UnpackUnitVector(std::uint32_t packed, float& x, float& y, float& z);
+
+struct VertexFrameStats
+{
+	std::size_t KeptNormals = 0;
+	std::size_t GeneratedNormals = 0;
+	std::size_t KeptTangents = 0;
+	std::size_t GeneratedTangents = 0;
+};
+
+// Completes the normal and tangent of every vertex of an indexed triangle
+// list.  normals and tangents hold three floats per vertex, in and out:
+// - A unit length normal that comes in is kept.  Any other becomes the area
+//   weighted average of the faces around the vertex, so shared vertices
+//   come out smooth and split ones (a box's corners) flat.
+// - A tangent that comes in unit length and more than half a degree off the
+//   normal is kept, made orthogonal to it.  Others are built from the normal
+//   and the world axis least along it, since there are no texture
+//   coordinates to follow.
+// Face normals are found on the pool a chunk of triangles at a time, then
+// each vertex gathers the faces around it through a vertex to triangle
+// table, so the sums need no locks or per-thread copies and do not depend
+// on the thread count.
+VertexFrameStats BuildVertexFrames(const float* positions, std::size_t positionStride, std::size_t vertexCount,
+	const std::uint32_t* indices, std::size_t indexCount, float* normals, float* tangents, ThreadPool& pool);
@@ -7,9 +7,40 @@
  *
  *   Controls:
  *   Hold down '1' key to view scene in wireframe mode.
+ *   Press '2' to toggle drawing the merged static batches.
+ *   Press '3' to toggle the depth pre-pass.
+ *   Press '4' to toggle dynamic resolution scaling.
+ *   Press '5' to toggle the 60 Hz frame limiter.
+ *   Press '6' to toggle low latency frame pacing.
+ *   Press '7' to toggle impostors for far away castles.
+ *   Press '8' to toggle late latching of the camera.
+ *   Press '9' to toggle replaying static draws from cached bundles.
+ *   Press '0' to toggle skipping frames when nothing changed.
+ *   Press 'G' to toggle drawing through vertex pulling, one ExecuteIndirect
+ *   per view and queue.
+ *   Press 'P' to pause and resume the simulation.
+ *   Press 'V' to toggle split-screen with a second view from across the map.
  *   Hold the left mouse button down and move the mouse to rotate.
  *   Hold the right mouse button down and move the mouse to zoom in and out.
  *
+ *   Run with "-server <scenes> <frames>" to render that many independent
+ *   scene variants headless, with no window or device, through the null
+ *   backend on every core, and report the throughput.
+ *   Run with "-uploadbench" to time the constant buffer upload strategies
+ *   on plain host memory.
+ *   Run with "-bcn <in.dds> <out.dds> [bc1|bc3|bc7] [fast|normal|high]" to
+ *   compress an RGBA8 DDS file (mips and all) into a block compressed one,
+ *   on every core.  Defaults are bc7 and normal; any other name is an
+ *   error.  A file without mips gets a full Kaiser filtered chain first.
+ *   Run with "-meshbench" to compress the shape geometry with the mesh
+ *   codec, check that it round trips, and report the ratio and the encode
+ *   and single core decode throughput.
+ *   Run with "-particlebench [particles]" to time the particle update and
+ *   instance write for that many live particles (default 1M), on one
+ *   thread and then on every core.
+ *   Run with "-sortbench [items]" to time the back to front radix sort on
+ *   that many random 22-bit depth keys (default 100k).
+ *
  *  @author Hooman Salamat
  */
 
@@ -18,43 +49,160 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "FrameResource.h"
+#include "RenderItem.h"
+#include "StaticBatch.h"
+#include "OverdrawCounter.h"
+#include "RadixSort.h"
+#include "GpuTimer.h"
+#include "DynamicResolution.h"
+#include "FramePacer.h"
+#include "RenderGraph.h"
+#include "Impostor.h"
+#include "BundleCache.h"
+#include "SceneServer.h"
+#include "StreamingUpload.h"
+#include "RenderView.h"
+#include "ThreadPool.h"
+#include "TextureStreamer.h"
+#include "BCnEncoder.h"
+#include "MipGenerator.h"
+#include "GeometryPool.h"
+#include "MeshCodec.h"
+#include "Stripifier.h"
+#include "VertexFrames.h"
+#include "ParticleSystem.h"
+
+#include <chrono>
+#include <map>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 using namespace DirectX::PackedVector;
 
-const int gNumFrameResources = 3;
-
-// Lightweight structure stores parameters to draw a shape.  This will
-// vary from app-to-app.
-struct RenderItem
+namespace
 {
-	RenderItem() = default;
+	// Render graph states are bit flags that line up with the D3D12 states
+	// they stand for.
+	D3D12_RESOURCE_STATES ToD3D12States(RGState state)
+	{
+		D3D12_RESOURCE_STATES result = D3D12_RESOURCE_STATE_COMMON;
+		std::uint32_t bits = (std::uint32_t)state;
+		if (bits & (std::uint32_t)RGState::RenderTarget) result |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+		if (bits & (std::uint32_t)RGState::DepthWrite) result |= D3D12_RESOURCE_STATE_DEPTH_WRITE;
+		if (bits & (std::uint32_t)RGState::DepthRead) result |= D3D12_RESOURCE_STATE_DEPTH_READ;
+		if (bits & (std::uint32_t)RGState::PixelShaderResource) result |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+		if (bits & (std::uint32_t)RGState::NonPixelShaderResource) result |= D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+		if (bits & (std::uint32_t)RGState::CopySource) result |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+		if (bits & (std::uint32_t)RGState::CopyDest) result |= D3D12_RESOURCE_STATE_COPY_DEST;
+		if (bits & (std::uint32_t)RGState::Present) result |= D3D12_RESOURCE_STATE_PRESENT;
+		return result;
+	}
 
-	// World matrix of the shape that describes the object's local space
-	// relative to the world space, which defines the position, orientation,
-	// and scale of the object in the world.
-	XMFLOAT4X4 World = MathHelper::Identity4x4();
+	// The late latch moves the camera after culling, so with it on each view
+	// culls for its camera pulled back by LateLatchPullBack, with a field of
+	// view LateLatchFovMargin wider.  A latch that would show more than that
+	// covers waits for the next frame instead.
+	const float LateLatchPullBack = 20.0f;
+	const float LateLatchFovMargin = 0.05f * XM_PI;
 
-	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
-	// Because we have an object cbuffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify obect data we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
+	// FNV-1a over raw bytes, for cheap change detection.
+	std::uint64_t HashBytes(std::uint64_t hash, const void* data, std::size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
 
-	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
-	UINT ObjCBIndex = -1;
+	// Blends two affine transforms: translation and scale linearly, the
+	// rotation along the shortest arc.
+	XMMATRIX InterpolateWorld(FXMMATRIX a, CXMMATRIX b, float t)
+	{
+		XMVECTOR scaleA, rotA, transA;
+		XMVECTOR scaleB, rotB, transB;
+		XMMatrixDecompose(&scaleA, &rotA, &transA, a);
+		XMMatrixDecompose(&scaleB, &rotB, &transB, b);
 
-	MeshGeometry* Geo = nullptr;
+		XMVECTOR scale = XMVectorLerp(scaleA, scaleB, t);
+		XMVECTOR rot = XMQuaternionSlerp(rotA, rotB, t);
+		XMVECTOR trans = XMVectorLerp(transA, transB, t);
 
-	// Primitive topology.
-	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		return XMMatrixAffineTransformation(scale, XMVectorZero(), rot, trans);
+	}
 
-	// DrawIndexedInstanced parameters.
-	UINT IndexCount = 0;
-	UINT StartIndexLocation = 0;
-	int BaseVertexLocation = 0;
-};
+	// Fills the camera block of pass constants.
+	void SetPassCamera(PassConstants& pass, const XMFLOAT4X4& viewMatrix, const XMFLOAT4X4& projMatrix, const XMFLOAT3& eyePos)
+	{
+		XMMATRIX view = XMLoadFloat4x4(&viewMatrix);
+		XMMATRIX proj = XMLoadFloat4x4(&projMatrix);
+
+		XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+		XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+		XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
+		XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+
+		XMStoreFloat4x4(&pass.View, XMMatrixTranspose(view));
+		XMStoreFloat4x4(&pass.InvView, XMMatrixTranspose(invView));
+		XMStoreFloat4x4(&pass.Proj, XMMatrixTranspose(proj));
+		XMStoreFloat4x4(&pass.InvProj, XMMatrixTranspose(invProj));
+		XMStoreFloat4x4(&pass.ViewProj, XMMatrixTranspose(viewProj));
+		XMStoreFloat4x4(&pass.InvViewProj, XMMatrixTranspose(invViewProj));
+		pass.EyePosW = eyePos;
+	}
+
+	// Headless modes report to the console they were started from, if any,
+	// and to the debugger.
+	void WriteReport(const std::wstring& text)
+	{
+		if (AttachConsole(ATTACH_PARENT_PROCESS))
+		{
+			DWORD written = 0;
+			WriteConsoleW(GetStdHandle(STD_OUTPUT_HANDLE), text.c_str(), (DWORD)text.size(), &written, nullptr);
+			FreeConsole();
+		}
+		OutputDebugStringW(text.c_str());
+	}
+
+	// The names -bcn takes for a block format and an encoder quality.  False
+	// for anything else.
+	bool ParseBCFormat(const std::string& name, BCFormat& format)
+	{
+		if (name == "bc1")
+			format = BCFormat::BC1;
+		else if (name == "bc3")
+			format = BCFormat::BC3;
+		else if (name == "bc7")
+			format = BCFormat::BC7;
+		else
+			return false;
+		return true;
+	}
+
+	bool ParseBCQuality(const std::string& name, BCQuality& quality)
+	{
+		if (name == "fast")
+			quality = BCQuality::Fast;
+		else if (name == "normal")
+			quality = BCQuality::Normal;
+		else if (name == "high")
+			quality = BCQuality::High;
+		else
+			return false;
+		return true;
+	}
+
+	// Input timestamps (GetMessageTime, MOUSEMOVEPOINT::time) are
+	// milliseconds on the GetTickCount clock.  Moves one onto PacerClock by
+	// its age; the subtraction wraps along with the tick count.
+	std::int64_t InputTimeToPacerClock(DWORD inputTime)
+	{
+		DWORD age = GetTickCount() - inputTime;
+		return PacerClock::Now() - (std::int64_t)age * 1000000;
+	}
+}
 
 class ShapesApp : public D3DApp
 {
@@ -66,7 +214,15 @@ public:
 
 	virtual bool Initialize()override;
 
+	int RunServer(UINT sceneCount, UINT frameCount);
+	int RunUploadBench();
+	int RunCompressor(const std::string& inFile, const std::string& outFile, BCFormat format, BCQuality quality);
+	int RunMeshBench();
+	int RunParticleBench(std::size_t particleCount);
+	int RunSortBench(std::size_t itemCount);
+
 private:
+	virtual void CreateRtvAndDsvDescriptorHeaps()override;
 	virtual void OnResize()override;
 	virtual void Update(const GameTimer& gt)override;
 	virtual void Draw(const GameTimer& gt)override;
@@ -75,20 +231,57 @@ private:
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseMove(WPARAM btnState, int x, int y)override;
 
+	// Orbits or zooms the camera by the mouse's move to (x, y).  Returns
+	// whether the camera moved.
+	bool MoveCamera(WPARAM btnState, int x, int y);
+
 	void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void UpdateViews();
+	void UpdateViewCameras();
+	bool SceneChanged();
+	bool AnimationVisible()const;
+	void StepSimulation(const GameTimer& gt);
+	void SimulateStep(float dt);
+	void UpdateParticles();
+	void UpdateCaption(const GameTimer& gt);
+	void UpdateVisibleRitems();
+	void UpdateTextureStreaming();
+	void UpdateIndirectDraws();
+	void CullView(RenderView& rview);
+	void SortBackToFront(RenderView& rview, std::vector<RenderItem*>& ritems);
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	bool BuildCameraPassBlock();
+	void WriteOtherViewPassCBs();
+	void LatchCamera(const GameTimer& gt);
 
 	void BuildDescriptorHeaps();
 	void BuildConstantBufferViews();
+	void BuildRenderGraph();
+	void BuildTransientResources();
 	void BuildRootSignature();
 	void BuildShadersAndInputLayout();
 	void BuildShapeGeometry();
+	void StripifyShapeGeometry(std::vector<std::uint16_t>& indices,
+		const std::vector<std::pair<std::string, SubmeshGeometry*>>& submeshes);
+	D3D12_PRIMITIVE_TOPOLOGY SubmeshTopology(const std::string& name)const;
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildRenderItems();
+	void BuildParticles();
+	void BuildImpostors();
+	void BuildStaticBatches();
+	void BuildStaticGroups();
+	void BuildGeometryPool();
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void DrawLayer(const RenderView& rview, RenderLayer layer, ID3D12PipelineState* pso);
+	void DrawParticles();
+	void BindView(const RenderView& rview);
+	CD3DX12_GPU_DESCRIPTOR_HANDLE PassCbvHandle(UINT passIndex)const;
+
+	D3D12_CPU_DESCRIPTOR_HANDLE SceneColorView()const;
+	ID3D12Resource* GraphResource(RGResource resource)const;
 
 private:
 
@@ -102,23 +295,200 @@ private:
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+
+	// Each shapeGeo submesh is drawn as strips or as a list, whichever takes
+	// fewer indices.  Render items take their topology from here.
+	bool mUseTriangleStrips = true;
+	std::unordered_map<std::string, D3D12_PRIMITIVE_TOPOLOGY> mSubmeshTopologies;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mParticleInputLayout;
 
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
 	// Render items divided by PSO.
-	std::vector<RenderItem*> mOpaqueRitems;
+	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
+
+	// Same queues with the static items replaced by their merged batches.
+	std::vector<RenderItem*> mBatchedRitemLayer[(int)RenderLayer::Count];
+	StaticBatcher mStaticBatcher;
+	bool mUseStaticBatching = true;
+	bool mStaticBatchKeyDown = false;
+
+	// The views drawn this frame, each with its own pass constant slot and
+	// culled, sorted draw lists: the main view, and in split-screen a second
+	// one watching from across the map.  Views are culled on mViewPool.
+	RenderView mViews[gMaxRenderViews];
+	int mViewCount = 1;
+	std::unique_ptr<ThreadPool> mViewPool;
+	bool mSplitScreen = false;
+	bool mSplitScreenKeyDown = false;
+
+	// The static items of the depth-writing queues, grouped per impostor
+	// group, for each static batching mode ([0] unbatched, [1] batched).
+	// Visible groups replay a cached bundle instead of recording their draws.
+	std::vector<RenderItemGroup> mStaticGroups[2][(int)RenderLayer::Count];
+	std::unique_ptr<BundleCache> mBundleCache;
+	bool mUseBundles = true;
+	bool mBundleKeyDown = false;
+
+	// Staging copy of the object constants.  Each frame the dirty ones are
+	// streamed to the frame resource's buffer in runs of adjacent indices.
+	std::unique_ptr<UploadBatch> mObjectUpload;
 
 	PassConstants mMainPassCB;
 
+	// Inputs mMainPassCB was last built from, and for each PassBlock the
+	// number of frame resources still holding a stale copy of it (as
+	// RenderItem::NumFramesDirty does for objects).
+	XMFLOAT4X4 mPassView = XMFLOAT4X4();
+	XMFLOAT4X4 mPassProj = XMFLOAT4X4();
+	int mPassWidth = 0;
+	int mPassHeight = 0;
+	int mPassBlockFramesDirty[(int)PassBlock::Count] = { gNumFrameResources, gNumFrameResources, gNumFrameResources };
+
+	// Late latching: right before submission the mouse is sampled again and
+	// the camera block of this frame's pass constants is rewritten, so the
+	// GPU sees the newest camera rather than the one from the top of Update.
+	// The input-to-submit time of each frame the camera moved is averaged
+	// for the caption.  It runs from when the mouse reached the position the
+	// submitted camera was built from, as the system recorded it, not from
+	// when the app got round to reading it.
+	bool mUseLateLatch = true;
+	bool mLateLatchKeyDown = false;
+	std::int64_t mCameraInputTime = 0;
+	bool mCameraInputPending = false;
+	double mInputLatencySumMs = 0.0;
+	UINT mInputLatencyCount = 0;
+
+	// Latches taken back because they left what was culled.
+	UINT mLateLatchSkips = 0;
+
 	UINT mPassCbvOffset = 0;
 
 	bool mIsWireframe = false;
 
+	// Depth-only pass that lays down the depth buffer before the color pass,
+	// which then shades each visible pixel once with an EQUAL depth test.
+	bool mUseDepthPrepass = false;
+	bool mDepthPrepassKeyDown = false;
+
+	std::unique_ptr<OverdrawCounter> mOverdrawCounter;
+
+	// The scene is drawn into the top-left corner of an offscreen target the
+	// size of the window, then stretched onto the back buffer.  The corner
+	// shrinks and grows to hold the target GPU frame time.
+	RGResource mSceneColor = RGInvalidResource;
+	RGTransientDesc mSceneColorDesc;
+	UINT mSceneColorSrvIndex = 0;
+	std::unique_ptr<GpuTimer> mGpuTimer;
+	DynamicResolution mDynamicResolution = DynamicResolution(1000.0f / 60.0f);
+	bool mUseDynamicResolution = false;
+	bool mDynamicResolutionKeyDown = false;
+	int mRenderWidth = 0;
+	int mRenderHeight = 0;
+
+	// Caps the frame rate instead of rendering flat out.
+	FramePacer mFramePacer = FramePacer(60.0);
+	bool mFrameLimiterKeyDown = false;
+	bool mLowLatencyKeyDown = false;
+
+	// The frame's passes are declared into the graph every frame; it works
+	// out the barriers and where the transient targets live in mTransientHeap.
+	// The transients are only recreated when their layout changes.
+	RenderGraph mRenderGraph;
+	RGResource mBackBuffer = RGInvalidResource;
+	RGResource mDepth = RGInvalidResource;
+	RGResource mImpostorAtlasResource = RGInvalidResource;
+	ComPtr<ID3D12Heap> mTransientHeap = nullptr;
+	std::vector<ComPtr<ID3D12Resource>> mTransientResources;
+	std::uint64_t mTransientLayoutHash = 0;
+
+
+	// Copies of the castle in a ring around the map.  Each castle past
+	// mImpostorDistance from the eye is drawn as one quad from the atlas
+	// instead of its ~30 draws.
+	std::unique_ptr<ImpostorAtlas> mImpostorAtlas;
+	std::vector<ImpostorInstance> mCastles;
+	std::vector<RenderItem*> mImpostorBakeRitems[(int)RenderLayer::Count];
+	UINT mImpostorSrvIndex = 0;
+	UINT mImpostorPassCbvOffset = 0;
+	int mFarCastleCount = 8;
+	float mFarCastleRingRadius = 90.0f;
+	float mImpostorDistance = 80.0f;
+	bool mUseImpostors = true;
+	bool mImpostorKeyDown = false;
+
+	// Mips of the streamed textures come and go with what the views see,
+	// within mTextureBudget bytes.  Each of the mMaxStreamedTextures slots
+	// has one SRV per frame resource, from mStreamedTextureSrvOffset on.
+	std::unique_ptr<TextureStreamer> mTextureStreamer;
+	UINT mMaxStreamedTextures = 16;
+	UINT mStreamedTextureSrvOffset = 0;
+	UINT64 mTextureBudget = 64ull * 1024 * 1024;
+	UINT64 mTextureUploadPerFrame = 4ull * 1024 * 1024;
+
+	// Vertex pulling: every mesh lives in mGeometryPool, and each view's
+	// queues are drawn with one ExecuteIndirect apiece from the frame's
+	// IndirectDraws, through the "_pulled" twin (mPulledPSOs) of the PSO the
+	// input assembler path would use.
+	GeometryPool mGeometryPool;
+	ComPtr<ID3D12CommandSignature> mPulledDrawSignature = nullptr;
+	std::unordered_map<ID3D12PipelineState*, ID3D12PipelineState*> mPulledPSOs;
+	UINT mPulledDrawCount = 0;
+	bool mUseVertexPulling = false;
+	bool mVertexPullingKeyDown = false;
+
+	// Idle frame skipping: once nothing the image depends on has changed
+	// for gNumFrameResources frames, Update and Draw record nothing and the
+	// thread sleeps until a window message (input, resize) wakes it.
+	bool mSkipIdleFrames = true;
+	bool mIdleKeyDown = false;
+	bool mIdleFrame = false;
+	int mFramesToSettle = gNumFrameResources;
+	std::uint64_t mSceneStateHash = 0;
+	UINT mIdleFrameCount = 0;
+
+	// Frames drawn only because animation was in view, for the caption.
+	UINT mAnimatedFrameCount = 0;
+	DWORD mIdleWakeMs = 100;
+
+	// The simulation runs at mSimStep no matter the frame rate.  Frame time
+	// piles up in mSimAccumulator and is spent in whole steps; what is left
+	// over, as a fraction of a step, is how far rendering blends from the
+	// previous step's transforms to the newest.  At most mMaxSimStepsPerFrame
+	// steps run per frame so a long stall cannot snowball.
+	std::vector<SpinAnimation> mSpinAnimations;
+	float mSimStep = 1.0f / 30.0f;
+	int mMaxSimStepsPerFrame = 8;
+	float mSimAccumulator = 0.0f;
+	float mSimAlpha = 0.0f;
+	UINT mSimStepCount = 0;
+	bool mSimPaused = false;
+	bool mSimPauseKeyDown = false;
+
+	// Torches, their smoke, and banners on the towers.  The particles step
+	// with the simulation on mParticlePool; every frame they are written
+	// to a span of the frame resource's dynamic geometry and drawn with one
+	// instanced call per type.  mTowerTops is where each tower's roof sits.
+	ParticleSystem mParticles;
+	std::unique_ptr<ThreadPool> mParticlePool;
+	std::vector<XMFLOAT3> mTowerTops;
+	DynamicVertexSpan mParticleInstances;
+
+	// Where each emitter's particles can get to in a lifetime.
+	std::vector<BoundingBox> mParticleBounds;
+
+	// Starting size of each frame resource's dynamic geometry buffer.  It
+	// grows if a frame needs more.
+	UINT64 mDynamicGeometryBytes = 256 * 1024;
+
+	float mStatsTimeElapsed = 0.0f;
+	std::wstring mAppCaption;
+
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
@@ -141,6 +511,59 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	try
 	{
 		ShapesApp theApp(hInstance);
+
+		std::istringstream args(cmdLine);
+		std::string mode;
+		UINT sceneCount = 64;
+		UINT frameCount = 300;
+		if (args >> mode && mode == "-server")
+		{
+			args >> sceneCount >> frameCount;
+			return theApp.RunServer(sceneCount, frameCount);
+		}
+		if (mode == "-uploadbench")
+			return theApp.RunUploadBench();
+		if (mode == "-bcn")
+		{
+			std::string inFile, outFile, formatName = "bc7", qualityName = "normal";
+			args >> inFile >> outFile >> formatName >> qualityName;
+
+			BCFormat format;
+			BCQuality quality;
+			if (outFile.empty())
+			{
+				WriteReport(L"-bcn needs an input and an output file\n");
+				return 1;
+			}
+			if (!ParseBCFormat(formatName, format))
+			{
+				WriteReport(L"unknown block format " + std::wstring(formatName.begin(), formatName.end()) + L", expected bc1, bc3 or bc7\n");
+				return 1;
+			}
+			if (!ParseBCQuality(qualityName, quality))
+			{
+				WriteReport(L"unknown quality " + std::wstring(qualityName.begin(), qualityName.end()) + L", expected fast, normal or high\n");
+				return 1;
+			}
+			return theApp.RunCompressor(inFile, outFile, format, quality);
+		}
+		if (mode == "-meshbench")
+			return theApp.RunMeshBench();
+		if (mode == "-particlebench")
+		{
+			std::size_t particleCount = 0;
+			if (!(args >> particleCount) || particleCount == 0)
+				particleCount = 1000000;
+			return theApp.RunParticleBench(particleCount);
+		}
+		if (mode == "-sortbench")
+		{
+			std::size_t itemCount = 0;
+			if (!(args >> itemCount) || itemCount == 0)
+				itemCount = 100000;
+			return theApp.RunSortBench(itemCount);
+		}
+
 		if (!theApp.Initialize())
 			return 0;
 
@@ -176,11 +599,29 @@ bool ShapesApp::Initialize()
 	BuildShadersAndInputLayout();
 	BuildShapeGeometry();
 	BuildRenderItems();
+	BuildParticles();
+	BuildImpostors();
+	BuildStaticBatches();
+	BuildStaticGroups();
+	BuildGeometryPool();
 	BuildFrameResources();
 	BuildDescriptorHeaps();
 	BuildConstantBufferViews();
 	BuildPSOs();
 
+	mTextureStreamer = std::make_unique<TextureStreamer>(md3dDevice.Get(), gNumFrameResources,
+		mMaxStreamedTextures, mTextureBudget, mTextureUploadPerFrame);
+	auto streamedSrvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
+	streamedSrvHandle.Offset(mStreamedTextureSrvOffset, mCbvSrvUavDescriptorSize);
+	mTextureStreamer->SetDescriptors(streamedSrvHandle, mCbvSrvUavDescriptorSize);
+
+	mOverdrawCounter = std::make_unique<OverdrawCounter>(md3dDevice.Get(), gNumFrameResources);
+	mGpuTimer = std::make_unique<GpuTimer>(md3dDevice.Get(), mCommandQueue.Get(), gNumFrameResources);
+	mBundleCache = std::make_unique<BundleCache>(md3dDevice.Get(), gNumFrameResources);
+	mViewPool = std::make_unique<ThreadPool>(gMaxRenderViews);
+	mParticlePool = std::make_unique<ThreadPool>();
+	mAppCaption = mMainWndCaption;
+
 	// Execute the initialization commands.
 	ThrowIfFailed(mCommandList->Close());
 	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
@@ -192,19 +633,276 @@ bool ShapesApp::Initialize()
 	return true;
 }
 
+int ShapesApp::RunServer(UINT sceneCount, UINT frameCount)
+{
+	// No device: the geometry keeps only its CPU copies, which is all the
+	// null backend needs.  Every instance shares it.
+	BuildShapeGeometry();
+	BuildRenderItems();
+
+	SceneServer server(mAllRitems, sceneCount, 16.0f / 9.0f);
+
+	// One thread first, as the baseline the scaling is measured against.
+	std::wostringstream report;
+	report.precision(4);
+	double baseline = 0.0;
+	for (unsigned threads : { 1u, 0u })
+	{
+		ThreadPool pool(threads);
+		SceneServerStats stats = server.Run(pool, frameCount, 1.0f / 60.0f);
+		if (baseline == 0.0)
+			baseline = stats.SceneFramesPerSecond;
+
+		report << stats.Scenes << L" scenes x " << stats.Frames << L" frames on " << stats.Threads << L" threads: "
+			<< stats.Seconds << L" s, " << stats.SceneFramesPerSecond << L" scene frames/s, "
+			<< stats.Draws << L" draws, " << stats.SceneFramesPerSecond / baseline << L"x\n";
+	}
+
+	WriteReport(report.str());
+
+	return 0;
+}
+
+int ShapesApp::RunUploadBench()
+{
+	// As many elements as a large scene's object constants, each padded to
+	// the constant buffer alignment.  Host memory is cached, unlike an upload
+	// heap, so this compares the strategies rather than predicting GPU
+	// upload speed.
+	const std::size_t elementCount = 4096;
+	const std::size_t stride = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+
+	std::wostringstream report;
+	report.precision(4);
+	for (double dirtyFraction : { 0.05, 0.25, 1.0 })
+	{
+		report << elementCount << L" elements of " << sizeof(ObjectConstants) << L" bytes at a stride of " << stride
+			<< L", " << dirtyFraction * 100.0 << L"% dirty:\n";
+		for (auto& result : RunUploadBenchmark(elementCount, stride, sizeof(ObjectConstants), dirtyFraction, 500))
+		{
+			report << L"    " << std::wstring(result.Strategy.begin(), result.Strategy.end()) << L": "
+				<< result.GBPerSecond << L" GB/s, " << result.MicrosecondsPerUpload << L" us per upload\n";
+		}
+	}
+
+	WriteReport(report.str());
+
+	return 0;
+}
+
+int ShapesApp::RunCompressor(const std::string& inFile, const std::string& outFile, BCFormat format, BCQuality quality)
+{
+	std::ifstream in(inFile, std::ios::binary);
+	if (!in)
+	{
+		WriteReport(L"cannot open " + std::wstring(inFile.begin(), inFile.end()) + L"\n");
+		return 1;
+	}
+	std::vector<std::uint8_t> source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	ThreadPool pool;
+	std::vector<std::uint8_t> result;
+	std::string error;
+
+	auto start = std::chrono::steady_clock::now();
+
+	DDSImage image;
+	if (ParseDDS(source.data(), source.size(), image) && image.MipCount == 1 &&
+		FullMipCount(image.Width, image.Height) > 1)
+	{
+		std::vector<std::uint8_t> mipped;
+		if (GenerateDDSMips(source, MipFilter::Kaiser, pool, mipped))
+			source.swap(mipped);
+	}
+
+	bool compressed = CompressDDS(source, format, quality, pool, result, &error);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (!compressed)
+	{
+		WriteReport(std::wstring(inFile.begin(), inFile.end()) + L": " + std::wstring(error.begin(), error.end()) + L"\n");
+		return 1;
+	}
+
+	std::ofstream out(outFile, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(result.data()), result.size());
+	if (!out)
+	{
+		WriteReport(L"cannot write " + std::wstring(outFile.begin(), outFile.end()) + L"\n");
+		return 1;
+	}
+
+	std::wostringstream report;
+	report.precision(4);
+	report << std::wstring(inFile.begin(), inFile.end()) << L" -> " << std::wstring(outFile.begin(), outFile.end())
+		<< L": " << source.size() / 1024 << L" KB to " << result.size() / 1024 << L" KB in " << seconds
+		<< L" s on " << pool.ThreadCount() << L" threads\n";
+	WriteReport(report.str());
+
+	return 0;
+}
+
+int ShapesApp::RunMeshBench()
+{
+	static_assert(sizeof(Vertex) == sizeof(MeshCodecVertex) && offsetof(Vertex, Color) == offsetof(MeshCodecVertex, Color) &&
+		offsetof(Vertex, Normal) == offsetof(MeshCodecVertex, Normal) && offsetof(Vertex, Tangent) == offsetof(MeshCodecVertex, Tangent),
+		"DecodeMesh writes Vertex in place");
+
+	// No device needed: only the CPU copies are compressed.
+	BuildShapeGeometry();
+	MeshGeometry* geo = mGeometries["shapeGeo"].get();
+
+	// DrawArgs only records where each submesh starts; the next start (or
+	// the end of the buffer) closes it.
+	const UINT vertexCount = geo->VertexBufferByteSize / sizeof(Vertex);
+	std::vector<UINT> vertexStarts;
+	for (auto& drawArgs : geo->DrawArgs)
+		vertexStarts.push_back((UINT)drawArgs.second.BaseVertexLocation);
+	vertexStarts.push_back(vertexCount);
+	std::sort(vertexStarts.begin(), vertexStarts.end());
+
+	// The codec takes triangle lists, so submeshes drawn as strips are
+	// expanded back to the triangles they draw, and every submesh moves to
+	// its place in the rebuilt list.
+	const std::uint16_t* indices = reinterpret_cast<const std::uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+	std::vector<std::uint16_t> listIndices;
+	std::vector<MeshCodecSubmesh> submeshes;
+	for (auto& drawArgs : geo->DrawArgs)
+	{
+		const SubmeshGeometry& args = drawArgs.second;
+
+		std::vector<std::uint32_t> triangles(indices + args.StartIndexLocation,
+			indices + args.StartIndexLocation + args.IndexCount);
+		if (SubmeshTopology(drawArgs.first) == D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP)
+			triangles = UnstripTriangles(triangles.data(), triangles.size(), 0xFFFF);
+
+		MeshCodecSubmesh submesh;
+		submesh.FirstVertex = (UINT)args.BaseVertexLocation;
+		submesh.VertexCount = *std::upper_bound(vertexStarts.begin(), vertexStarts.end(), submesh.FirstVertex) - submesh.FirstVertex;
+		submesh.FirstIndex = (UINT)listIndices.size();
+		submesh.IndexCount = (UINT)triangles.size();
+		std::memcpy(submesh.BoundsCenter, &args.Bounds.Center, sizeof(submesh.BoundsCenter));
+		std::memcpy(submesh.BoundsExtents, &args.Bounds.Extents, sizeof(submesh.BoundsExtents));
+		submeshes.push_back(submesh);
+
+		listIndices.insert(listIndices.end(), triangles.begin(), triangles.end());
+	}
+
+	MeshCodecBenchResult result = RunMeshCodecBenchmark(
+		reinterpret_cast<const MeshCodecVertex*>(geo->VertexBufferCPU->GetBufferPointer()), vertexCount,
+		listIndices.data(), (std::uint32_t)listIndices.size(), true, submeshes, 2000);
+
+	std::wostringstream report;
+	report.precision(4);
+	report << L"shapeGeo: " << result.RawBytes << L" bytes to " << result.EncodedBytes << L" (" << result.Ratio
+		<< L":1), encode " << result.EncodeMBPerSecond << L" MB/s, decode " << result.DecodeGBPerSecond << L" GB/s\n"
+		<< L"    indices " << (result.IndicesMatch ? L"exact" : L"MISMATCH") << L", frames "
+		<< (result.FramesMatch ? L"exact" : L"MISMATCH") << L", position error " << result.MaxPositionError
+		<< L" (bound " << result.MaxPositionErrorBound << L"), color error " << result.MaxColorError << L"\n"
+		<< (result.Passed ? L"round trip passed\n" : L"round trip FAILED\n");
+	WriteReport(report.str());
+
+	return result.Passed ? 0 : 1;
+}
+
+int ShapesApp::RunParticleBench(std::size_t particleCount)
+{
+	// As with -uploadbench, the instances go to plain host memory rather
+	// than an upload heap.  One thread first, as the baseline.
+	std::wostringstream report;
+	report.precision(4);
+	double baseline = 0.0;
+	for (unsigned threads : { 1u, 0u })
+	{
+		ThreadPool pool(threads);
+		ParticleBenchResult result = RunParticleBenchmark(particleCount, 300, pool);
+		if (baseline == 0.0)
+			baseline = result.FrameMs;
+
+		report << result.Particles << L" particles x " << result.Frames << L" frames on " << result.Threads
+			<< L" threads: simulate " << result.SimulateMs << L" ms, write " << result.WriteMs << L" ms, "
+			<< result.FrameMs << L" ms per frame, " << baseline / result.FrameMs << L"x\n";
+	}
+
+	WriteReport(report.str());
+
+	return 0;
+}
+
+int ShapesApp::RunSortBench(std::size_t itemCount)
+{
+	// The same key width SortBackToFront quantizes view depth to.
+	RadixSortBenchResult result = RunRadixSortBenchmark(itemCount, 22, 500);
+
+	std::wostringstream report;
+	report.precision(4);
+	report << result.Items << L" items, " << result.KeyBits << L"-bit keys: median " << result.MedianMicroseconds
+		<< L" us, mean " << result.MeanMicroseconds << L" us, worst " << result.MaxMicroseconds << L" us per sort\n"
+		<< (result.Sorted ? L"sorted and stable\n" : L"NOT SORTED\n");
+	WriteReport(report.str());
+
+	return result.Sorted ? 0 : 1;
+}
+
+void ShapesApp::CreateRtvAndDsvDescriptorHeaps()
+{
+	// Add +1 RTV for the offscreen scene color target.
+	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc;
+	rtvHeapDesc.NumDescriptors = SwapChainBufferCount + 1;
+	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+	rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	rtvHeapDesc.NodeMask = 0;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
+		&rtvHeapDesc, IID_PPV_ARGS(mRtvHeap.GetAddressOf())));
+
+	D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
+	dsvHeapDesc.NumDescriptors = 1;
+	dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+	dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	dsvHeapDesc.NodeMask = 0;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
+		&dsvHeapDesc, IID_PPV_ARGS(mDsvHeap.GetAddressOf())));
+}
+
 void ShapesApp::OnResize()
 {
 	D3DApp::OnResize();
 
-	// The window resized, so update the aspect ratio and recompute the projection matrix.
-	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
-	XMStoreFloat4x4(&mProj, P);
+	// The scene color target always covers the whole window.  The render
+	// graph notices the new size and recreates it before the next frame.
+	D3D12_RESOURCE_DESC sceneColorDesc = CD3DX12_RESOURCE_DESC::Tex2D(mBackBufferFormat,
+		mClientWidth, mClientHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+	D3D12_RESOURCE_ALLOCATION_INFO allocInfo = md3dDevice->GetResourceAllocationInfo(0, 1, &sceneColorDesc);
+
+	mSceneColorDesc.Width = mClientWidth;
+	mSceneColorDesc.Height = mClientHeight;
+	mSceneColorDesc.Format = mBackBufferFormat;
+	mSceneColorDesc.SizeInBytes = allocInfo.SizeInBytes;
+	mSceneColorDesc.Alignment = allocInfo.Alignment;
+
+	// The projections depend on the aspect ratio of each view's part of the
+	// window; UpdateViews rebuilds them every frame.
 }
 
 void ShapesApp::Update(const GameTimer& gt)
 {
+	// In low latency mode this is where the pacer waits, so the input below
+	// is as fresh as possible.
+	mFramePacer.BeginFrame();
+
 	OnKeyboardInput(gt);
 	UpdateCamera(gt);
+	UpdateViews();
+
+	// The last frame is still on screen and would come out the same: skip
+	// the frame resource, the constant buffers and, in Draw, the recording.
+	mIdleFrame = mSkipIdleFrames && !SceneChanged();
+	if (mIdleFrame)
+	{
+		mIdleFrameCount++;
+		UpdateCaption(gt);
+		return;
+	}
 
 	// Cycle through the circular frame resource array.
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -220,12 +918,59 @@ void ShapesApp::Update(const GameTimer& gt)
 		CloseHandle(eventHandle);
 	}
 
+	// Its frame is finished, so its spans of dynamic geometry are free again.
+	mCurrFrameResource->DynamicGeometry->Reset();
+
+	// The GPU is done with this frame resource, so its counters are ready.
+	if (mCurrFrameResource->Fence != 0)
+	{
+		mOverdrawCounter->Readback(mCurrFrameResourceIndex);
+		mGpuTimer->Readback(mCurrFrameResourceIndex);
+
+		if (mUseDynamicResolution)
+			mDynamicResolution.Update(mGpuTimer->ElapsedMs());
+	}
+
+	if (!mUseDynamicResolution)
+		mDynamicResolution.Reset();
+	mDynamicResolution.ScaledSize(mClientWidth, mClientHeight, mRenderWidth, mRenderHeight);
+
+	UpdateCaption(gt);
+
+	StepSimulation(gt);
+	UpdateParticles();
+
 	UpdateObjectCBs(gt);
 	UpdateMainPassCB(gt);
+	UpdateVisibleRitems();
+	UpdateTextureStreaming();
+	UpdateIndirectDraws();
 }
 
 void ShapesApp::Draw(const GameTimer& gt)
 {
+	if (mIdleFrame)
+	{
+		// Nothing is presented, so the pacer should not count this frame.
+		mFramePacer.SkipFrame();
+
+		// Sleep until a message arrives.  Input and resizing all come in as
+		// messages, so the first change wakes the loop right away; the
+		// timeout only keeps the caption ticking.
+		MsgWaitForMultipleObjectsEx(0, nullptr, mIdleWakeMs, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		return;
+	}
+
+	BuildRenderGraph();
+
+	// The transients moved or changed size: wait for the GPU to finish with
+	// the old ones before replacing them.
+	if (mRenderGraph.TransientLayoutHash() != mTransientLayoutHash)
+	{
+		FlushCommandQueue();
+		BuildTransientResources();
+	}
+
 	auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
 
 	// Reuse the memory associated with command recording.
@@ -243,39 +988,56 @@ void ShapesApp::Draw(const GameTimer& gt)
 		ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
 	}
 
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
-
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+	// Move the streamed textures to this frame's requests before anything
+	// samples them.  The replaced resources live until this frame's fence.
+	mTextureStreamer->Update(mCommandList.Get(), mCurrFrameResourceIndex, mCurrentFence + 1, mFence->GetCompletedValue());
 
-	// Clear the back buffer and depth buffer.
-	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
-	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
-
-	// Specify the buffers we are going to render to.
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+	mGpuTimer->Begin(mCommandList.Get(), mCurrFrameResourceIndex);
 
 	ID3D12DescriptorHeap* descriptorHeaps[] = { mCbvHeap.Get() };
 	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
 	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
 
-	int passCbvIndex = mPassCbvOffset + mCurrFrameResourceIndex;
-	auto passCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-	passCbvHandle.Offset(passCbvIndex, mCbvSrvUavDescriptorSize);
-	mCommandList->SetGraphicsRootDescriptorTable(1, passCbvHandle);
+	mCommandList->SetGraphicsRootDescriptorTable(1, PassCbvHandle(0));
+
+	if (mUseVertexPulling)
+	{
+		mCommandList->SetGraphicsRootShaderResourceView(PulledVertices, mGeometryPool.VertexBufferAddress());
+		mCommandList->SetGraphicsRootShaderResourceView(PulledIndices, mGeometryPool.IndexBufferAddress());
+		mCommandList->SetGraphicsRootShaderResourceView(PulledObjects, mCurrFrameResource->ObjectCB->Resource()->GetGPUVirtualAddress());
+	}
 
-	DrawRenderItems(mCommandList.Get(), mOpaqueRitems);
+	// Run the passes.  Each batch of barriers the graph worked out goes to the
+	// command list in a single ResourceBarrier call.
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+	mRenderGraph.Execute([&](const std::vector<RGBarrier>& batch)
+	{
+		barriers.clear();
+		for (auto& barrier : batch)
+		{
+			if (barrier.BarrierType == RGBarrier::Type::Aliasing)
+			{
+				barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(
+					GraphResource(barrier.AliasBefore), GraphResource(barrier.Resource)));
+			}
+			else
+			{
+				barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(GraphResource(barrier.Resource),
+					ToD3D12States(barrier.Before), ToD3D12States(barrier.After)));
+			}
+		}
+		mCommandList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+	});
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+	mGpuTimer->End(mCommandList.Get(), mCurrFrameResourceIndex);
 
 	// Done recording commands.
 	ThrowIfFailed(mCommandList->Close());
 
+	// Refresh the camera from the newest input just before the GPU gets it.
+	LatchCamera(gt);
+
 	// Add the command list to the queue for execution.
 	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
@@ -291,6 +1053,10 @@ void ShapesApp::Draw(const GameTimer& gt)
 	// Because we are on the GPU timeline, the new fence point won't be 
 	// set until the GPU finishes processing all the commands prior to this Signal().
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+
+	// Sleep off the rest of the frame (unless the pacer is in low latency
+	// mode) and record the present-to-present interval.
+	mFramePacer.EndFrame();
 }
 
 void ShapesApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -307,6 +1073,16 @@ void ShapesApp::OnMouseUp(WPARAM btnState, int x, int y)
 }
 
 void ShapesApp::OnMouseMove(WPARAM btnState, int x, int y)
+{
+	// The message carries the time the mouse got there.
+	if (MoveCamera(btnState, x, y))
+	{
+		mCameraInputTime = InputTimeToPacerClock((DWORD)GetMessageTime());
+		mCameraInputPending = true;
+	}
+}
+
+bool ShapesApp::MoveCamera(WPARAM btnState, int x, int y)
 {
 	if ((btnState & MK_LBUTTON) != 0)
 	{
@@ -334,8 +1110,12 @@ void ShapesApp::OnMouseMove(WPARAM btnState, int x, int y)
 		mRadius = MathHelper::Clamp(mRadius, 5.0f, 150.0f);
 	}
 
+	bool moved = (btnState & (MK_LBUTTON | MK_RBUTTON)) != 0 && (x != mLastMousePos.x || y != mLastMousePos.y);
+
 	mLastMousePos.x = x;
 	mLastMousePos.y = y;
+
+	return moved;
 }
 
 void ShapesApp::OnKeyboardInput(const GameTimer& gt)
@@ -344,6 +1124,67 @@ void ShapesApp::OnKeyboardInput(const GameTimer& gt)
 		mIsWireframe = true;
 	else
 		mIsWireframe = false;
+
+	// Toggle on the key press, not while the key is held.
+	bool staticBatchKeyDown = (GetAsyncKeyState('2') & 0x8000) != 0;
+	if (staticBatchKeyDown && !mStaticBatchKeyDown)
+		mUseStaticBatching = !mUseStaticBatching;
+	mStaticBatchKeyDown = staticBatchKeyDown;
+
+	bool depthPrepassKeyDown = (GetAsyncKeyState('3') & 0x8000) != 0;
+	if (depthPrepassKeyDown && !mDepthPrepassKeyDown)
+		mUseDepthPrepass = !mUseDepthPrepass;
+	mDepthPrepassKeyDown = depthPrepassKeyDown;
+
+	bool dynamicResolutionKeyDown = (GetAsyncKeyState('4') & 0x8000) != 0;
+	if (dynamicResolutionKeyDown && !mDynamicResolutionKeyDown)
+		mUseDynamicResolution = !mUseDynamicResolution;
+	mDynamicResolutionKeyDown = dynamicResolutionKeyDown;
+
+	bool frameLimiterKeyDown = (GetAsyncKeyState('5') & 0x8000) != 0;
+	if (frameLimiterKeyDown && !mFrameLimiterKeyDown)
+		mFramePacer.SetTargetRate(mFramePacer.TargetRate() > 0.0 ? 0.0 : 60.0);
+	mFrameLimiterKeyDown = frameLimiterKeyDown;
+
+	bool lowLatencyKeyDown = (GetAsyncKeyState('6') & 0x8000) != 0;
+	if (lowLatencyKeyDown && !mLowLatencyKeyDown)
+		mFramePacer.SetLowLatency(!mFramePacer.LowLatency());
+	mLowLatencyKeyDown = lowLatencyKeyDown;
+
+	bool impostorKeyDown = (GetAsyncKeyState('7') & 0x8000) != 0;
+	if (impostorKeyDown && !mImpostorKeyDown)
+		mUseImpostors = !mUseImpostors;
+	mImpostorKeyDown = impostorKeyDown;
+
+	bool lateLatchKeyDown = (GetAsyncKeyState('8') & 0x8000) != 0;
+	if (lateLatchKeyDown && !mLateLatchKeyDown)
+		mUseLateLatch = !mUseLateLatch;
+	mLateLatchKeyDown = lateLatchKeyDown;
+
+	bool bundleKeyDown = (GetAsyncKeyState('9') & 0x8000) != 0;
+	if (bundleKeyDown && !mBundleKeyDown)
+		mUseBundles = !mUseBundles;
+	mBundleKeyDown = bundleKeyDown;
+
+	bool idleKeyDown = (GetAsyncKeyState('0') & 0x8000) != 0;
+	if (idleKeyDown && !mIdleKeyDown)
+		mSkipIdleFrames = !mSkipIdleFrames;
+	mIdleKeyDown = idleKeyDown;
+
+	bool vertexPullingKeyDown = (GetAsyncKeyState('G') & 0x8000) != 0;
+	if (vertexPullingKeyDown && !mVertexPullingKeyDown)
+		mUseVertexPulling = !mUseVertexPulling;
+	mVertexPullingKeyDown = vertexPullingKeyDown;
+
+	bool simPauseKeyDown = (GetAsyncKeyState('P') & 0x8000) != 0;
+	if (simPauseKeyDown && !mSimPauseKeyDown)
+		mSimPaused = !mSimPaused;
+	mSimPauseKeyDown = simPauseKeyDown;
+
+	bool splitScreenKeyDown = (GetAsyncKeyState('V') & 0x8000) != 0;
+	if (splitScreenKeyDown && !mSplitScreenKeyDown)
+		mSplitScreen = !mSplitScreen;
+	mSplitScreenKeyDown = splitScreenKeyDown;
 }
 
 void ShapesApp::UpdateCamera(const GameTimer& gt)
@@ -362,67 +1203,723 @@ void ShapesApp::UpdateCamera(const GameTimer& gt)
 	XMStoreFloat4x4(&mView, view);
 }
 
+void ShapesApp::StepSimulation(const GameTimer& gt)
+{
+	if (mSimPaused)
+		return;
+
+	mSimAccumulator += gt.DeltaTime();
+
+	int steps = 0;
+	while (mSimAccumulator >= mSimStep && steps < mMaxSimStepsPerFrame)
+	{
+		SimulateStep(mSimStep);
+		mSimAccumulator -= mSimStep;
+		steps++;
+	}
+
+	// Too far behind to catch up: drop the backlog rather than run ever
+	// more steps per frame.
+	if (mSimAccumulator >= mSimStep)
+		mSimAccumulator = 0.0f;
+
+	mSimStepCount += steps;
+	mSimAlpha = mSimAccumulator / mSimStep;
+}
+
+void ShapesApp::SimulateStep(float dt)
+{
+	for (auto& anim : mSpinAnimations)
+	{
+		RenderItem* ri = anim.Ritem;
+		ri->PrevWorld = ri->World;
+
+		anim.Angle = fmodf(anim.Angle + anim.Speed * dt, XM_2PI);
+		XMMATRIX world = XMMatrixRotationY(anim.Angle) * XMLoadFloat4x4(&anim.BaseWorld);
+		XMStoreFloat4x4(&ri->World, world);
+
+		// Cover both states a frame can be blended between: this step's and
+		// the last one's, not everything the item swept through before.
+		BoundingBox prevBounds, bounds;
+		anim.LocalBounds.Transform(prevBounds, XMLoadFloat4x4(&ri->PrevWorld));
+		anim.LocalBounds.Transform(bounds, world);
+		BoundingBox::CreateMerged(ri->Bounds, prevBounds, bounds);
+
+		ri->NumFramesDirty = gNumFrameResources;
+	}
+
+	mParticles.Simulate(dt, *mParticlePool);
+}
+
+void ShapesApp::UpdateParticles()
+{
+	// Every frame resource needs its own copy, so this runs every frame,
+	// stepped or not.  The spin animations blend up to the newest step;
+	// particles keep no previous state, so they are carried on past it by
+	// the same fraction of a step instead.
+	mParticleInstances = mCurrFrameResource->DynamicGeometry->AllocateVertices(
+		(UINT)mParticles.TotalCount(), sizeof(ParticleInstance));
+	mParticles.WriteInstances(static_cast<ParticleInstance*>(mParticleInstances.Data), mSimAlpha * mSimStep, *mParticlePool);
+}
+
+void ShapesApp::UpdateViews()
+{
+	// Side by side halves in split-screen, the whole target otherwise.
+	mViewCount = mSplitScreen ? 2 : 1;
+	for (int i = 0; i < mViewCount; ++i)
+	{
+		RenderView& view = mViews[i];
+		view.PassIndex = i;
+		view.Left = mSplitScreen ? 0.5f * i : 0.0f;
+		view.Top = 0.0f;
+		view.Width = mSplitScreen ? 0.5f : 1.0f;
+		view.Height = 1.0f;
+
+		float aspect = (view.Width * mClientWidth) / (view.Height * mClientHeight);
+		XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, aspect, 1.0f, 1000.0f);
+		XMStoreFloat4x4(&view.Proj, P);
+		BoundingFrustum::CreateFromMatrix(view.Frustum, P);
+
+		if (mUseLateLatch)
+		{
+			XMMATRIX wide = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi + LateLatchFovMargin, aspect, 1.0f, 1000.0f);
+			BoundingFrustum::CreateFromMatrix(view.Frustum, wide);
+			view.Frustum.Origin.z = -LateLatchPullBack;
+			view.Frustum.Far = 1000.0f + 2.0f * LateLatchPullBack;
+		}
+	}
+
+	mProj = mViews[0].Proj;
+	UpdateViewCameras();
+}
+
+void ShapesApp::UpdateViewCameras()
+{
+	// The main view is the orbit camera.
+	mViews[0].EyePos = mEyePos;
+	mViews[0].View = mView;
+
+	// The second one orbits with it from the opposite side of the map.
+	if (mViewCount > 1)
+	{
+		RenderView& view = mViews[1];
+		float theta = mTheta + XM_PI;
+		view.EyePos.x = mRadius * sinf(mPhi) * cosf(theta);
+		view.EyePos.z = mRadius * sinf(mPhi) * sinf(theta);
+		view.EyePos.y = mRadius * cosf(mPhi);
+
+		XMVECTOR pos = XMVectorSet(view.EyePos.x, view.EyePos.y, view.EyePos.z, 1.0f);
+		XMVECTOR target = XMVectorZero();
+		XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		XMStoreFloat4x4(&view.View, XMMatrixLookAtLH(pos, target, up));
+	}
+}
+
+bool ShapesApp::SceneChanged()
+{
+	// Everything the image is built from: the camera, the window size, the
+	// toggles that change how the scene is drawn, and the render items.  The
+	// time block of the pass constants changes every frame but nothing is
+	// shaded with it, so it is left out.
+	std::uint64_t hash = 14695981039346656037ULL;
+	hash = HashBytes(hash, &mView, sizeof(mView));
+	hash = HashBytes(hash, &mProj, sizeof(mProj));
+
+	int clientSize[] = { mClientWidth, mClientHeight };
+	hash = HashBytes(hash, clientSize, sizeof(clientSize));
+
+	bool toggles[] = { mIsWireframe, mUseStaticBatching, mUseDepthPrepass, mUseDynamicResolution, mUseImpostors, mUseBundles, mSplitScreen, mUseVertexPulling };
+	hash = HashBytes(hash, toggles, sizeof(toggles));
+
+	bool changed = hash != mSceneStateHash || !mImpostorAtlas->IsBaked() || mImpostorAtlas->MipsPending() ||
+		mTextureStreamer->Changed();
+	mSceneStateHash = hash;
+
+	// A running simulation changes the image only where a view sees it.
+	// Out of sight it is not stepped: idle frames skip StepSimulation, so
+	// the simulation waits until it comes into view again.
+	if (!changed && !mSimPaused && AnimationVisible())
+	{
+		mAnimatedFrameCount++;
+		changed = true;
+	}
+
+	// Items moved or animated since their constants were last uploaded.
+	for (auto& e : mAllRitems)
+	{
+		if (e->NumFramesDirty > 0)
+		{
+			changed = true;
+			break;
+		}
+	}
+
+	// After a change keep drawing until every frame resource holds the new
+	// constants and the GPU counters the last frames produced are read back.
+	if (changed)
+	{
+		mFramesToSettle = gNumFrameResources;
+		return true;
+	}
+
+	if (mFramesToSettle > 0)
+	{
+		mFramesToSettle--;
+		return true;
+	}
+
+	return false;
+}
+
+bool ShapesApp::AnimationVisible()const
+{
+	for (int v = 0; v < mViewCount; ++v)
+	{
+		const RenderView& rview = mViews[v];
+		XMMATRIX view = XMLoadFloat4x4(&rview.View);
+		BoundingFrustum worldFrustum;
+		rview.Frustum.Transform(worldFrustum, XMMatrixInverse(&XMMatrixDeterminant(view), view));
+
+		for (auto& anim : mSpinAnimations)
+		{
+			if (worldFrustum.Contains(anim.Ritem->Bounds) != DirectX::DISJOINT)
+				return true;
+		}
+
+		if (mParticles.TotalCount() > 0)
+		{
+			for (auto& bounds : mParticleBounds)
+			{
+				if (worldFrustum.Contains(bounds) != DirectX::DISJOINT)
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+void ShapesApp::UpdateCaption(const GameTimer& gt)
+{
+	// Refresh the overdraw readout once per second.
+	mStatsTimeElapsed += gt.DeltaTime();
+	if (mStatsTimeElapsed >= 1.0f)
+	{
+		std::wostringstream caption;
+		caption.precision(3);
+		caption << mAppCaption << L"    prepass: " << (mUseDepthPrepass ? L"on" : L"off")
+			<< L"    PS invocations: " << mOverdrawCounter->PixelShaderInvocations()
+			<< L"    overdraw: " << mOverdrawCounter->Overdraw(mRenderWidth * mRenderHeight) << L"x"
+			<< L"    GPU: " << mGpuTimer->ElapsedMs() << L" ms"
+			<< L"    views: " << mViewCount
+			<< L"    impostors: " << mViews[0].VisibleImpostors.size() << L"/" << mCastles.size()
+			<< L"    bundles: " << (mUseBundles ? L"" : L"off ") << mBundleCache->Hits() << L" replayed, " << mBundleCache->Records() << L" recorded"
+			<< L"    scale: " << mDynamicResolution.Scale() << L" (" << mRenderWidth << L"x" << mRenderHeight << L")";
+
+		caption << L"    pulling: ";
+		if (mUseVertexPulling)
+			caption << mPulledDrawCount << L" indirect draws";
+		else
+			caption << L"off";
+
+		FramePacingStats pacing = mFramePacer.Stats();
+		caption << L"    limiter: ";
+		if (mFramePacer.TargetRate() > 0.0)
+			caption << mFramePacer.TargetRate() << L" Hz" << (mFramePacer.LowLatency() ? L" low latency" : L"");
+		else
+			caption << L"off";
+		caption << L"    present interval: " << pacing.MeanMs << L" ms (sd " << pacing.StdDevMs
+			<< L", p99 " << pacing.P99Ms << L", max " << pacing.MaxMs << L")";
+		mFramePacer.ResetStats();
+
+		caption << L"    input to submit: ";
+		if (mInputLatencyCount > 0)
+			caption << mInputLatencySumMs / mInputLatencyCount << L" ms";
+		else
+			caption << L"-";
+		if (mUseLateLatch)
+			caption << L" (late latched, " << mLateLatchSkips << L" skipped)";
+		mInputLatencySumMs = 0.0;
+		mInputLatencyCount = 0;
+		mLateLatchSkips = 0;
+
+		const RGStats& graph = mRenderGraph.Stats();
+		caption << L"    graph: " << graph.DeclaredPasses - graph.CulledPasses << L"/" << graph.DeclaredPasses
+			<< L" passes, " << graph.Barriers << L" barriers in " << graph.BarrierBatches << L" batches, "
+			<< graph.AliasedHeapBytes / 1024 << L" KB transient heap (" << graph.TransientBytes / 1024 << L" KB unaliased)";
+
+		mBundleCache->ResetStats();
+
+		caption << L"    sim: " << mSimStepCount << L" steps";
+		if (mSimPaused)
+			caption << L" (paused)";
+		mSimStepCount = 0;
+
+		caption << L"    idle: ";
+		if (mSkipIdleFrames)
+			caption << mIdleFrameCount << L" frames skipped, " << mAnimatedFrameCount << L" drawn for animation in view";
+		else
+			caption << L"off";
+		mIdleFrameCount = 0;
+		mAnimatedFrameCount = 0;
+
+		caption << L"    textures: " << mTextureStreamer->ResidentBytes() / 1024 << L"/"
+			<< mTextureStreamer->BudgetBytes() / 1024 << L" KB";
+
+		// The last frame of this frame resource against its buffer, and the
+		// busiest frame and growth over all of them.
+		const DynamicGeometryBuffer& dynamicGeometry = *mCurrFrameResource->DynamicGeometry;
+		UINT64 dynamicPeak = 0;
+		UINT dynamicGrows = 0;
+		for (auto& frameResource : mFrameResources)
+		{
+			dynamicPeak = (std::max)(dynamicPeak, frameResource->DynamicGeometry->PeakFrameBytes());
+			dynamicGrows += frameResource->DynamicGeometry->GrowCount();
+		}
+		caption << L"    dynamic geometry: " << dynamicGeometry.LastFrameBytes() / 1024 << L"/"
+			<< dynamicGeometry.Capacity() / 1024 << L" KB (peak " << dynamicPeak / 1024 << L" KB, "
+			<< dynamicGrows << L" grows)";
+
+		mMainWndCaption = caption.str();
+		mStatsTimeElapsed = 0.0f;
+	}
+}
+
+void ShapesApp::UpdateVisibleRitems()
+{
+	// Culling a view only reads shared state, so each view gets a worker and
+	// the secondary views do not hold up the main one.
+	if (mViewCount == 1)
+		CullView(mViews[0]);
+	else
+		mViewPool->ParallelFor(mViewCount, 1, [this](std::size_t i) { CullView(mViews[i]); });
+}
+
+void ShapesApp::UpdateTextureStreaming()
+{
+	mTextureStreamer->BeginFrame();
+
+	// Each visible item asks for the mip that puts about one texel on each
+	// pixel at its nearest point to the eye.  Items seen by several views
+	// keep the finest request.
+	auto request = [this](const RenderView& rview, const RenderItem* ri)
+	{
+		if (ri->StreamedTexture < 0)
+			return;
+
+		UINT texture = (UINT)ri->StreamedTexture;
+		XMVECTOR toCenter = XMLoadFloat3(&ri->Bounds.Center) - XMLoadFloat3(&rview.EyePos);
+		float distance = XMVectorGetX(XMVector3Length(toCenter)) -
+			XMVectorGetX(XMVector3Length(XMLoadFloat3(&ri->Bounds.Extents)));
+
+		float pixelsPerUnit = 0.5f * rview.Height * mRenderHeight * rview.Proj._22;
+		float texelsPerUnit = ri->TexCPerUnit * mTextureStreamer->Width(texture);
+		mTextureStreamer->Request(texture,
+			EstimateMip(texelsPerUnit, pixelsPerUnit, distance, mTextureStreamer->MipCount(texture)));
+	};
+
+	for (int v = 0; v < mViewCount; ++v)
+	{
+		const RenderView& rview = mViews[v];
+		for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+		{
+			for (auto group : rview.VisibleGroups[layer])
+			{
+				for (auto ri : group->Ritems)
+					request(rview, ri);
+			}
+
+			for (auto ri : rview.VisibleRitems[layer])
+				request(rview, ri);
+		}
+	}
+}
+
+void ShapesApp::UpdateIndirectDraws()
+{
+	mPulledDrawCount = 0;
+	if (!mUseVertexPulling)
+		return;
+
+	// Grouped items are flattened into the ranges too: a single
+	// ExecuteIndirect per queue already saves what their bundles would.
+	// The ranges keep the order culling sorted the queues in.
+	UINT drawIndex = 0;
+	for (int v = 0; v < mViewCount; ++v)
+	{
+		RenderView& rview = mViews[v];
+		for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+		{
+			rview.FirstPulledDraw[layer] = drawIndex;
+			rview.UnpulledRitems[layer].clear();
+
+			auto pull = [&](RenderItem* ri)
+			{
+				if (mGeometryPool.CanPull(ri))
+					mCurrFrameResource->DrawArgs->CopyData(drawIndex++, mGeometryPool.Draw(ri));
+				else
+					rview.UnpulledRitems[layer].push_back(ri);
+			};
+
+			for (auto group : rview.VisibleGroups[layer])
+			{
+				for (auto ri : group->Ritems)
+					pull(ri);
+			}
+
+			for (auto ri : rview.VisibleRitems[layer])
+				pull(ri);
+
+			rview.PulledDrawCount[layer] = drawIndex - rview.FirstPulledDraw[layer];
+		}
+	}
+
+	mPulledDrawCount = drawIndex;
+}
+
+void ShapesApp::CullView(RenderView& rview)
+{
+	const auto* ritemLayer = mUseStaticBatching ? mBatchedRitemLayer : mRitemLayer;
+
+	// Bring the view space frustum into world space so it can be tested
+	// directly against the world space bounds of the render items.
+	XMMATRIX view = XMLoadFloat4x4(&rview.View);
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+
+	BoundingFrustum worldFrustum;
+	rview.Frustum.Transform(worldFrustum, invView);
+
+	// Swap far castles for their impostors.  The atlas is baked during the
+	// first frame, so until then every castle is drawn in full.
+	XMVECTOR eyePos = XMLoadFloat3(&rview.EyePos);
+	bool impostorsReady = mUseImpostors && mImpostorAtlas->IsBaked();
+	rview.UseImpostor.resize(mCastles.size());
+	rview.VisibleImpostors.clear();
+	for (UINT i = 0; i < (UINT)mCastles.size(); ++i)
+	{
+		const ImpostorInstance& castle = mCastles[i];
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&castle.Bounds.Center) - eyePos));
+		rview.UseImpostor[i] = impostorsReady && distance > mImpostorDistance;
+
+		if (rview.UseImpostor[i] && worldFrustum.Contains(castle.Bounds) != DirectX::DISJOINT)
+			rview.VisibleImpostors.push_back(i);
+	}
+
+	const auto* staticGroups = mStaticGroups[mUseStaticBatching ? 1 : 0];
+
+	for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+	{
+		// Static items of grouped queues are culled and drawn per group.
+		bool grouped = mUseBundles && !staticGroups[layer].empty();
+
+		rview.VisibleGroups[layer].clear();
+		if (grouped)
+		{
+			for (auto& group : staticGroups[layer])
+			{
+				if (group.ImpostorGroup >= 0 && rview.UseImpostor[group.ImpostorGroup])
+					continue;
+
+				if (worldFrustum.Contains(group.Bounds) != DirectX::DISJOINT)
+					rview.VisibleGroups[layer].push_back(&group);
+			}
+		}
+
+		rview.VisibleRitems[layer].clear();
+		for (auto ri : ritemLayer[layer])
+		{
+			if (grouped && ri->IsStatic)
+				continue;
+
+			if (ri->ImpostorGroup >= 0 && rview.UseImpostor[ri->ImpostorGroup])
+				continue;
+
+			if (worldFrustum.Contains(ri->Bounds) != DirectX::DISJOINT)
+				rview.VisibleRitems[layer].push_back(ri);
+		}
+	}
+
+	// Sort the depth-writing queues front to back from the eye so the depth
+	// test rejects hidden pixels as early as possible.
+	auto frontToBack = [eyePos](const RenderItem* a, const RenderItem* b)
+	{
+		float distA = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&a->Bounds.Center) - eyePos));
+		float distB = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&b->Bounds.Center) - eyePos));
+		return distA < distB;
+	};
+	std::sort(rview.VisibleRitems[(int)RenderLayer::Opaque].begin(), rview.VisibleRitems[(int)RenderLayer::Opaque].end(), frontToBack);
+	std::sort(rview.VisibleRitems[(int)RenderLayer::AlphaTested].begin(), rview.VisibleRitems[(int)RenderLayer::AlphaTested].end(), frontToBack);
+
+	// Whole groups are ordered the same way.
+	auto groupFrontToBack = [eyePos](const RenderItemGroup* a, const RenderItemGroup* b)
+	{
+		float distA = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&a->Bounds.Center) - eyePos));
+		float distB = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&b->Bounds.Center) - eyePos));
+		return distA < distB;
+	};
+	std::sort(rview.VisibleGroups[(int)RenderLayer::Opaque].begin(), rview.VisibleGroups[(int)RenderLayer::Opaque].end(), groupFrontToBack);
+	std::sort(rview.VisibleGroups[(int)RenderLayer::AlphaTested].begin(), rview.VisibleGroups[(int)RenderLayer::AlphaTested].end(), groupFrontToBack);
+
+	// Transparent items blend over what is behind them, so they go back to front.
+	SortBackToFront(rview, rview.VisibleRitems[(int)RenderLayer::Transparent]);
+}
+
+void ShapesApp::SortBackToFront(RenderView& rview, std::vector<RenderItem*>& ritems)
+{
+	// Quantize the view space depth of each item over [near, far] to 22 bits
+	// and invert it, so an ascending radix sort (two 11-bit passes) puts the
+	// farthest item first.
+	const UINT maxKey = (1u << 22) - 1;
+	const float nearZ = mMainPassCB.NearZ;
+	const float invDepthRange = 1.0f / (mMainPassCB.FarZ - mMainPassCB.NearZ);
+
+	XMMATRIX view = XMLoadFloat4x4(&rview.View);
+
+	rview.DepthSortItems.resize(ritems.size());
+	for (size_t i = 0; i < ritems.size(); ++i)
+	{
+		XMVECTOR posV = XMVector3TransformCoord(XMLoadFloat3(&ritems[i]->Bounds.Center), view);
+		float depth = MathHelper::Clamp((XMVectorGetZ(posV) - nearZ) * invDepthRange, 0.0f, 1.0f);
+
+		UINT key = maxKey - (UINT)(depth * maxKey);
+		rview.DepthSortItems[i] = RadixSorter::MakeItem(key, (UINT)i);
+	}
+
+	rview.DepthSorter.Sort(rview.DepthSortItems.data(), rview.DepthSortItems.size(), 22);
+
+	rview.DepthSortScratch.resize(ritems.size());
+	for (size_t i = 0; i < ritems.size(); ++i)
+		rview.DepthSortScratch[i] = ritems[RadixSorter::Payload(rview.DepthSortItems[i])];
+
+	ritems.swap(rview.DepthSortScratch);
+}
+
 void ShapesApp::UpdateObjectCBs(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
 	for (auto& e : mAllRitems)
 	{
 		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if (e->NumFramesDirty > 0)
+		// This needs to be tracked per frame resource.  Animated items blend
+		// between their last two simulated states, which changes every frame.
+		if (e->NumFramesDirty > 0 || e->IsAnimated)
 		{
 			XMMATRIX world = XMLoadFloat4x4(&e->World);
+			if (e->IsAnimated)
+				world = InterpolateWorld(XMLoadFloat4x4(&e->PrevWorld), world, mSimAlpha);
 
 			ObjectConstants objConstants;
 			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+			mObjectUpload->Write(e->ObjCBIndex, &objConstants, sizeof(ObjectConstants));
+
+			// Next FrameResource need to be updated too.
+			if (e->NumFramesDirty > 0)
+				e->NumFramesDirty--;
+		}
+	}
+
+	mObjectUpload->Flush(mCurrFrameResource->MappedObjectCB);
+}
+
+void ShapesApp::UpdateMainPassCB(const GameTimer& gt)
+{
+	if (BuildCameraPassBlock())
+		mPassBlockFramesDirty[(int)PassBlock::Camera] = gNumFrameResources;
+
+	// Resize block: rebuilt when the internal resolution changes.
+	if (mRenderWidth != mPassWidth || mRenderHeight != mPassHeight)
+	{
+		mPassWidth = mRenderWidth;
+		mPassHeight = mRenderHeight;
+
+		mMainPassCB.RenderTargetSize = XMFLOAT2((float)mRenderWidth, (float)mRenderHeight);
+		mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mRenderWidth, 1.0f / mRenderHeight);
+		mMainPassCB.NearZ = 1.0f;
+		mMainPassCB.FarZ = 1000.0f;
+
+		mPassBlockFramesDirty[(int)PassBlock::Resize] = gNumFrameResources;
+	}
+
+	// Time block: changes every frame unless the timer is stopped.
+	if (gt.TotalTime() != mMainPassCB.TotalTime || gt.DeltaTime() != mMainPassCB.DeltaTime)
+	{
+		mMainPassCB.TotalTime = gt.TotalTime();
+		mMainPassCB.DeltaTime = gt.DeltaTime();
+
+		mPassBlockFramesDirty[(int)PassBlock::Time] = gNumFrameResources;
+	}
+
+	// Only upload the blocks this frame resource holds a stale copy of.
+	for (int block = 0; block < (int)PassBlock::Count; ++block)
+	{
+		if (mPassBlockFramesDirty[block] > 0)
+		{
+			UINT offset = 0;
+			UINT size = 0;
+			PassBlockRange((PassBlock)block, offset, size);
+			StreamCopy(mCurrFrameResource->MappedPassCB + offset, reinterpret_cast<const BYTE*>(&mMainPassCB) + offset, size);
+
+			// Next FrameResource need to be updated too.
+			mPassBlockFramesDirty[block]--;
+		}
+	}
+
+	WriteOtherViewPassCBs();
+	StreamFence();
+}
+
+void ShapesApp::WriteOtherViewPassCBs()
+{
+	// The other views share the main view's size and time blocks.  Their
+	// slots are small and rewritten whole every frame.
+	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
+	for (int i = 1; i < mViewCount; ++i)
+	{
+		const RenderView& view = mViews[i];
+
+		PassConstants viewPassCB = mMainPassCB;
+		SetPassCamera(viewPassCB, view.View, view.Proj, view.EyePos);
+		StreamCopy(mCurrFrameResource->MappedPassCB + view.PassIndex * passCBByteSize, &viewPassCB, sizeof(PassConstants));
+	}
+}
+
+bool ShapesApp::BuildCameraPassBlock()
+{
+	// Camera block: rebuilt when the view or projection matrix moves.
+	if (memcmp(&mView, &mPassView, sizeof(XMFLOAT4X4)) == 0 &&
+		memcmp(&mProj, &mPassProj, sizeof(XMFLOAT4X4)) == 0)
+		return false;
+
+	mPassView = mView;
+	mPassProj = mProj;
+
+	SetPassCamera(mMainPassCB, mView, mProj, mEyePos);
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
-		}
-	}
+	return true;
 }
 
-void ShapesApp::UpdateMainPassCB(const GameTimer& gt)
+void ShapesApp::LatchCamera(const GameTimer& gt)
 {
-	XMMATRIX view = XMLoadFloat4x4(&mView);
-	XMMATRIX proj = XMLoadFloat4x4(&mProj);
+	// Pick up mouse movement that arrived while the frame was being built.
+	// The window message for it will come later and see no movement.
+	if (mUseLateLatch && GetCapture() == mhMainWnd)
+	{
+		WPARAM btnState = 0;
+		if (GetAsyncKeyState(VK_LBUTTON) & 0x8000)
+			btnState |= MK_LBUTTON;
+		if (GetAsyncKeyState(VK_RBUTTON) & 0x8000)
+			btnState |= MK_RBUTTON;
+
+		POINT screenPos;
+		if (btnState != 0 && GetCursorPos(&screenPos))
+		{
+			// What the frame was culled and built for, in case the latch has
+			// to be taken back.
+			float theta = mTheta, phi = mPhi, radius = mRadius;
+			POINT lastMousePos = mLastMousePos;
+			std::int64_t inputTime = mCameraInputTime;
+			bool inputPending = mCameraInputPending;
+			XMFLOAT4X4 culledViews[gMaxRenderViews];
+			for (int v = 0; v < mViewCount; ++v)
+				culledViews[v] = mViews[v].View;
+
+			POINT cursorPos = screenPos;
+			ScreenToClient(mhMainWnd, &cursorPos);
+
+			// The system keeps the recent mouse positions with the time each
+			// was reached; look up the one the camera now follows.  A move
+			// whose time cannot be found is left out of the average.
+			if (MoveCamera(btnState, cursorPos.x, cursorPos.y))
+			{
+				MOUSEMOVEPOINT point = {};
+				point.x = screenPos.x & 0xFFFF;
+				point.y = screenPos.y & 0xFFFF;
+				MOUSEMOVEPOINT found;
+				bool timed = GetMouseMovePointsEx(sizeof(MOUSEMOVEPOINT), &point, &found, 1, GMMP_USE_DISPLAY_POINTS) == 1;
+				if (timed)
+					mCameraInputTime = InputTimeToPacerClock(found.time);
+				mCameraInputPending = timed;
+			}
+			UpdateCamera(gt);
+			UpdateViewCameras();
+
+			// Every view's latched frustum must lie inside the one its items
+			// were culled with, or something it now sees may be missing.
+			// Otherwise the move is taken back; the window message for it
+			// still comes and applies it next frame.
+			bool covered = true;
+			for (int v = 0; v < mViewCount; ++v)
+			{
+				const RenderView& view = mViews[v];
+				XMMATRIX culled = XMLoadFloat4x4(&culledViews[v]);
+				XMMATRIX latched = XMLoadFloat4x4(&view.View);
+
+				BoundingFrustum cullFrustum, projFrustum, latchedFrustum;
+				view.Frustum.Transform(cullFrustum, XMMatrixInverse(&XMMatrixDeterminant(culled), culled));
+				BoundingFrustum::CreateFromMatrix(projFrustum, XMLoadFloat4x4(&view.Proj));
+				projFrustum.Transform(latchedFrustum, XMMatrixInverse(&XMMatrixDeterminant(latched), latched));
+				covered = covered && cullFrustum.Contains(latchedFrustum) == DirectX::CONTAINS;
+			}
+
+			if (!covered)
+			{
+				mTheta = theta;
+				mPhi = phi;
+				mRadius = radius;
+				mLastMousePos = lastMousePos;
+				mCameraInputTime = inputTime;
+				mCameraInputPending = inputPending;
+				UpdateCamera(gt);
+				UpdateViewCameras();
+				mLateLatchSkips++;
+			}
+			else if (BuildCameraPassBlock())
+			{
+				// The GPU has not seen this frame's pass constants yet, so the
+				// camera block and the other views' slots can still be
+				// replaced.  The other frame resources pick the camera block
+				// up when their turn comes.
+				UINT offset = 0;
+				UINT size = 0;
+				PassBlockRange(PassBlock::Camera, offset, size);
+				StreamCopy(mCurrFrameResource->MappedPassCB + offset, reinterpret_cast<const BYTE*>(&mMainPassCB) + offset, size);
+				WriteOtherViewPassCBs();
+				StreamFence();
+
+				mPassBlockFramesDirty[(int)PassBlock::Camera] = gNumFrameResources - 1;
+			}
+		}
+	}
 
-	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
-
-	XMStoreFloat4x4(&mMainPassCB.View, XMMatrixTranspose(view));
-	XMStoreFloat4x4(&mMainPassCB.InvView, XMMatrixTranspose(invView));
-	XMStoreFloat4x4(&mMainPassCB.Proj, XMMatrixTranspose(proj));
-	XMStoreFloat4x4(&mMainPassCB.InvProj, XMMatrixTranspose(invProj));
-	XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
-	XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
-	mMainPassCB.EyePosW = mEyePos;
-	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
-	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
-	mMainPassCB.NearZ = 1.0f;
-	mMainPassCB.FarZ = 1000.0f;
-	mMainPassCB.TotalTime = gt.TotalTime();
-	mMainPassCB.DeltaTime = gt.DeltaTime();
-
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, mMainPassCB);
+	// Age of the newest input the submitted camera was built from.
+	if (mCameraInputPending)
+	{
+		mInputLatencySumMs += (PacerClock::Now() - mCameraInputTime) / 1.0e6;
+		mInputLatencyCount++;
+		mCameraInputPending = false;
+	}
 }
 
 void ShapesApp::BuildDescriptorHeaps()
 {
-	UINT objCount = (UINT)mOpaqueRitems.size();
+	UINT objCount = (UINT)mAllRitems.size();
 
 	// Need a CBV descriptor for each object for each frame resource,
-	// +1 for the perPass CBV for each frame resource.
-	UINT numDescriptors = (objCount + 1) * gNumFrameResources;
+	// +gMaxRenderViews for the perPass CBVs for each frame resource,
+	// +1 for the scene color SRV,
+	// +1 for the impostor atlas SRV and one pass CBV per impostor view,
+	// +mMaxStreamedTextures streamed texture SRVs for each frame resource.
+	UINT numDescriptors = (objCount + gMaxRenderViews + mMaxStreamedTextures) * gNumFrameResources + 2 + mImpostorAtlas->ViewCount();
 
-	// Save an offset to the start of the pass CBVs.  These are the last 3 descriptors.
+	// Save an offset to the start of the pass CBVs.  These come right after the object CBVs.
 	mPassCbvOffset = objCount * gNumFrameResources;
 
+	// The scene color SRV, the impostor atlas SRV, the impostor view CBVs
+	// and the streamed texture SRVs come last.
+	mSceneColorSrvIndex = mPassCbvOffset + gNumFrameResources * gMaxRenderViews;
+	mImpostorSrvIndex = mSceneColorSrvIndex + 1;
+	mImpostorPassCbvOffset = mImpostorSrvIndex + 1;
+	mStreamedTextureSrvOffset = mImpostorPassCbvOffset + mImpostorAtlas->ViewCount();
+
 	D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc;
 	cbvHeapDesc.NumDescriptors = numDescriptors;
 	cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
@@ -436,7 +1933,7 @@ void ShapesApp::BuildConstantBufferViews()
 {
 	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 
-	UINT objCount = (UINT)mOpaqueRitems.size();
+	UINT objCount = (UINT)mAllRitems.size();
 
 	// Need a CBV descriptor for each object for each frame resource.
 	for (int frameIndex = 0; frameIndex < gNumFrameResources; ++frameIndex)
@@ -464,23 +1961,283 @@ void ShapesApp::BuildConstantBufferViews()
 
 	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
 
-	// Last three descriptors are the pass CBVs for each frame resource.
+	// Then the pass CBVs, one per view slot for each frame resource.
 	for (int frameIndex = 0; frameIndex < gNumFrameResources; ++frameIndex)
 	{
 		auto passCB = mFrameResources[frameIndex]->PassCB->Resource();
-		D3D12_GPU_VIRTUAL_ADDRESS cbAddress = passCB->GetGPUVirtualAddress();
+		for (int slot = 0; slot < gMaxRenderViews; ++slot)
+		{
+			D3D12_GPU_VIRTUAL_ADDRESS cbAddress = passCB->GetGPUVirtualAddress() + slot * passCBByteSize;
+
+			// Offset to the pass cbv in the descriptor heap.
+			int heapIndex = mPassCbvOffset + frameIndex * gMaxRenderViews + slot;
+			auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
+			handle.Offset(heapIndex, mCbvSrvUavDescriptorSize);
+
+			D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
+			cbvDesc.BufferLocation = cbAddress;
+			cbvDesc.SizeInBytes = passCBByteSize;
+
+			md3dDevice->CreateConstantBufferView(&cbvDesc, handle);
+		}
+	}
+
+	auto impostorSrvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
+	impostorSrvHandle.Offset(mImpostorSrvIndex, mCbvSrvUavDescriptorSize);
+	auto impostorCbvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
+	impostorCbvHandle.Offset(mImpostorPassCbvOffset, mCbvSrvUavDescriptorSize);
+	mImpostorAtlas->CreateViews(md3dDevice.Get(), impostorSrvHandle, impostorCbvHandle, mCbvSrvUavDescriptorSize);
+}
+
+void ShapesApp::BuildRenderGraph()
+{
+	mRenderGraph.Reset();
+
+	mBackBuffer = mRenderGraph.ImportResource("BackBuffer", RGState::Present, RGState::Present);
+	mDepth = mRenderGraph.ImportResource("Depth", RGState::DepthWrite, RGState::DepthWrite);
+	mImpostorAtlasResource = mRenderGraph.ImportResource("ImpostorAtlas", RGState::PixelShaderResource, RGState::PixelShaderResource);
+	mSceneColor = mRenderGraph.CreateTransient("SceneColor", mSceneColorDesc);
+	mRenderGraph.MarkOutput(mBackBuffer);
+
+	// Take the castle's pictures once, with the same PSOs as the scene.
+	if (!mImpostorAtlas->IsBaked())
+	{
+		std::uint32_t bake = mRenderGraph.AddPass("ImpostorBake", [this]()
+		{
+			mImpostorAtlas->Bake(mCommandList.Get(), [this](UINT view)
+			{
+				auto viewCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
+				viewCbvHandle.Offset(mImpostorPassCbvOffset + view, mCbvSrvUavDescriptorSize);
+				mCommandList->SetGraphicsRootDescriptorTable(1, viewCbvHandle);
+
+				mCommandList->SetPipelineState(mPSOs["opaque"].Get());
+				DrawRenderItems(mCommandList.Get(), mImpostorBakeRitems[(int)RenderLayer::Opaque]);
+
+				mCommandList->SetPipelineState(mPSOs["alphaTested"].Get());
+				DrawRenderItems(mCommandList.Get(), mImpostorBakeRitems[(int)RenderLayer::AlphaTested]);
+
+				mCommandList->SetPipelineState(mPSOs["transparent"].Get());
+				DrawRenderItems(mCommandList.Get(), mImpostorBakeRitems[(int)RenderLayer::Transparent]);
+			});
+
+			// Back to the main camera for the passes that follow.
+			mCommandList->SetGraphicsRootDescriptorTable(1, PassCbvHandle(0));
+		});
+		mRenderGraph.Write(bake, mImpostorAtlasResource, RGState::RenderTarget);
+		mRenderGraph.SetSideEffects(bake);
+
+		// The pictures go to the CPU for their mips.
+		std::uint32_t readback = mRenderGraph.AddPass("ImpostorReadback", [this]()
+		{
+			mImpostorAtlas->ReadBack(mCommandList.Get(), mCurrentFence + 1);
+		});
+		mRenderGraph.Read(readback, mImpostorAtlasResource, RGState::CopySource);
+		mRenderGraph.SetSideEffects(readback);
+	}
+	// Once the copy is back, the mips are built on the particle pool (idle
+	// while the frame is recorded) and copied up before the scene samples
+	// the atlas.
+	else if (mImpostorAtlas->PrepareMips(mFence->GetCompletedValue(), *mParticlePool))
+	{
+		std::uint32_t mips = mRenderGraph.AddPass("ImpostorMips", [this]()
+		{
+			mImpostorAtlas->UploadMips(mCommandList.Get(), mCurrentFence + 1);
+		});
+		mRenderGraph.ReadWrite(mips, mImpostorAtlasResource, RGState::CopyDest);
+		mRenderGraph.SetSideEffects(mips);
+	}
+
+	// Render the scene at the internal resolution into the corner of the
+	// offscreen target.
+	D3D12_VIEWPORT sceneViewport = { 0.0f, 0.0f, (float)mRenderWidth, (float)mRenderHeight, 0.0f, 1.0f };
+	D3D12_RECT sceneScissorRect = { 0, 0, mRenderWidth, mRenderHeight };
+
+	// Both opaque passes walk the same front to back list.  The pre-pass has
+	// no pixel shader and no render target; the color pass then only shades
+	// the pixels whose depth matches exactly.
+	bool depthPrepass = mUseDepthPrepass && !mIsWireframe;
+	if (depthPrepass)
+	{
+		std::uint32_t prepass = mRenderGraph.AddPass("DepthPrepass", [this, sceneViewport, sceneScissorRect]()
+		{
+			mCommandList->RSSetViewports(1, &sceneViewport);
+			mCommandList->RSSetScissorRects(1, &sceneScissorRect);
+			mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 1, &sceneScissorRect);
+			mCommandList->OMSetRenderTargets(0, nullptr, false, &DepthStencilView());
+
+			mOverdrawCounter->Begin(mCommandList.Get(), mCurrFrameResourceIndex);
+
+			for (int i = 0; i < mViewCount; ++i)
+			{
+				BindView(mViews[i]);
+				DrawLayer(mViews[i], RenderLayer::Opaque, mPSOs["depth_prepass"].Get());
+			}
+		});
+		mRenderGraph.Write(prepass, mDepth, RGState::DepthWrite);
+	}
+
+	std::uint32_t scene = mRenderGraph.AddPass("Scene", [this, sceneViewport, sceneScissorRect, depthPrepass]()
+	{
+		ID3D12Resource* sceneColor = GraphResource(mSceneColor);
+
+		mCommandList->RSSetViewports(1, &sceneViewport);
+		mCommandList->RSSetScissorRects(1, &sceneScissorRect);
+
+		// The target is placed in the transient heap, so its old contents are
+		// discarded before the clear rather than assumed.
+		mCommandList->DiscardResource(sceneColor, nullptr);
+		mCommandList->ClearRenderTargetView(SceneColorView(), Colors::LightSteelBlue, 1, &sceneScissorRect);
+		if (!depthPrepass)
+		{
+			mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 1, &sceneScissorRect);
+			mOverdrawCounter->Begin(mCommandList.Get(), mCurrFrameResourceIndex);
+		}
 
-		// Offset to the pass cbv in the descriptor heap.
-		int heapIndex = mPassCbvOffset + frameIndex;
-		auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
-		handle.Offset(heapIndex, mCbvSrvUavDescriptorSize);
+		mCommandList->OMSetRenderTargets(1, &SceneColorView(), true, &DepthStencilView());
 
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-		cbvDesc.BufferLocation = cbAddress;
-		cbvDesc.SizeInBytes = passCBByteSize;
+		for (int i = 0; i < mViewCount; ++i)
+		{
+			const RenderView& view = mViews[i];
+			BindView(view);
+
+			if (mIsWireframe)
+			{
+				// Every queue goes through the wireframe PSO.
+				for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+					DrawLayer(view, (RenderLayer)layer, mPSOs["opaque_wireframe"].Get());
+			}
+			else
+			{
+				DrawLayer(view, RenderLayer::Opaque, mPSOs[depthPrepass ? "opaque_equal" : "opaque"].Get());
+				DrawLayer(view, RenderLayer::AlphaTested, mPSOs["alphaTested"].Get());
+			}
+
+			// Far castles, one quad each.  They write depth, so they go before
+			// the transparent queue.
+			if (!view.VisibleImpostors.empty())
+			{
+				mCommandList->SetPipelineState(mPSOs["impostor"].Get());
+
+				auto atlasSrvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
+				atlasSrvHandle.Offset(mImpostorSrvIndex, mCbvSrvUavDescriptorSize);
+				mCommandList->SetGraphicsRootDescriptorTable(2, atlasSrvHandle);
+				mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+				for (UINT castle : view.VisibleImpostors)
+				{
+					ImpostorConstants constants = mImpostorAtlas->Constants(mCastles[castle].Position);
+					mCommandList->SetGraphicsRoot32BitConstants(3, sizeof(ImpostorConstants) / 4, &constants, 0);
+					mCommandList->DrawInstanced(6, 1, 0, 0);
+				}
+			}
+
+			if (!mIsWireframe)
+			{
+				DrawLayer(view, RenderLayer::Transparent, mPSOs["transparent"].Get());
+				DrawParticles();
+			}
+		}
+
+		mOverdrawCounter->End(mCommandList.Get(), mCurrFrameResourceIndex);
+	});
+	mRenderGraph.Write(scene, mSceneColor, RGState::RenderTarget);
+	mRenderGraph.ReadWrite(scene, mDepth, RGState::DepthWrite);
+	mRenderGraph.Read(scene, mImpostorAtlasResource, RGState::PixelShaderResource);
+
+	//
+	// Upscale the scene onto the back buffer.
+	//
+	std::uint32_t upscale = mRenderGraph.AddPass("Upscale", [this]()
+	{
+		mCommandList->RSSetViewports(1, &mScreenViewport);
+		mCommandList->RSSetScissorRects(1, &mScissorRect);
+		mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, nullptr);
+
+		mCommandList->SetPipelineState(mPSOs["upscale"].Get());
 
-		md3dDevice->CreateConstantBufferView(&cbvDesc, handle);
+		auto sceneSrvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
+		sceneSrvHandle.Offset(mSceneColorSrvIndex, mCbvSrvUavDescriptorSize);
+		mCommandList->SetGraphicsRootDescriptorTable(2, sceneSrvHandle);
+
+		// Map the back buffer onto the rendered corner, and keep the bilinear
+		// footprint half a texel inside it so nothing outside bleeds in.
+		float upscaleConstants[] =
+		{
+			(float)mRenderWidth / mClientWidth,
+			(float)mRenderHeight / mClientHeight,
+			(mRenderWidth - 0.5f) / mClientWidth,
+			(mRenderHeight - 0.5f) / mClientHeight
+		};
+		mCommandList->SetGraphicsRoot32BitConstants(3, _countof(upscaleConstants), upscaleConstants, 0);
+
+		mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		mCommandList->DrawInstanced(3, 1, 0, 0);
+	});
+	mRenderGraph.Read(upscale, mSceneColor, RGState::PixelShaderResource);
+	mRenderGraph.Write(upscale, mBackBuffer, RGState::RenderTarget);
+
+	mRenderGraph.Compile();
+}
+
+void ShapesApp::BuildTransientResources()
+{
+	mTransientResources.clear();
+	mTransientResources.resize(mRenderGraph.ResourceCount());
+	mTransientHeap.Reset();
+	mTransientLayoutHash = mRenderGraph.TransientLayoutHash();
+
+	if (mRenderGraph.HeapSize() == 0)
+		return;
+
+	// Only render and depth targets go in the heap, which every resource
+	// binding tier supports.
+	D3D12_HEAP_DESC heapDesc = {};
+	heapDesc.SizeInBytes = mRenderGraph.HeapSize();
+	heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+	ThrowIfFailed(md3dDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&mTransientHeap)));
+
+	for (RGResource r = 0; r < mRenderGraph.ResourceCount(); ++r)
+	{
+		if (!mRenderGraph.IsTransient(r) || !mRenderGraph.IsUsed(r))
+			continue;
+
+		const RGTransientDesc& desc = mRenderGraph.TransientDesc(r);
+		RGState initialState = mRenderGraph.TransientInitialState(r);
+		bool isDepth = initialState == RGState::DepthWrite || initialState == RGState::DepthRead;
+
+		D3D12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D((DXGI_FORMAT)desc.Format,
+			desc.Width, desc.Height, 1, 1, 1, 0,
+			isDepth ? D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL : D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET);
+
+		CD3DX12_CLEAR_VALUE optClear = isDepth ?
+			CD3DX12_CLEAR_VALUE((DXGI_FORMAT)desc.Format, 1.0f, 0) :
+			CD3DX12_CLEAR_VALUE((DXGI_FORMAT)desc.Format, Colors::LightSteelBlue);
+
+		ThrowIfFailed(md3dDevice->CreatePlacedResource(
+			mTransientHeap.Get(),
+			mRenderGraph.TransientOffset(r),
+			&texDesc,
+			ToD3D12States(initialState),
+			&optClear,
+			IID_PPV_ARGS(&mTransientResources[r])));
 	}
+
+	// Point the scene color views at the new resource.
+	ID3D12Resource* sceneColor = mTransientResources[mSceneColor].Get();
+	md3dDevice->CreateRenderTargetView(sceneColor, nullptr, SceneColorView());
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = mBackBufferFormat;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = 1;
+
+	auto srvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
+	srvHandle.Offset(mSceneColorSrvIndex, mCbvSrvUavDescriptorSize);
+	md3dDevice->CreateShaderResourceView(sceneColor, &srvDesc, srvHandle);
 }
 
 void ShapesApp::BuildRootSignature()
@@ -491,15 +2248,37 @@ void ShapesApp::BuildRootSignature()
 	CD3DX12_DESCRIPTOR_RANGE cbvTable1;
 	cbvTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1);
 
+	CD3DX12_DESCRIPTOR_RANGE srvTable;
+	srvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+
 	// Root parameter can be a table, root descriptor or root constants.
-	CD3DX12_ROOT_PARAMETER slotRootParameter[2];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[PulledRootParameterEnd];
 
 	// Create root CBVs.
 	slotRootParameter[0].InitAsDescriptorTable(1, &cbvTable0);
 	slotRootParameter[1].InitAsDescriptorTable(1, &cbvTable1);
 
+	// Texture and constants for the upscale and impostor passes.
+	slotRootParameter[2].InitAsDescriptorTable(1, &srvTable, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[3].InitAsConstants(8, 2);
+
+	// Raw buffers and per-draw offsets for the vertex pulling path.  Root
+	// SRVs need no descriptors, and ExecuteIndirect can change root
+	// constants but not tables, so the draw's object goes in as an index.
+	slotRootParameter[PulledVertices].InitAsShaderResourceView(1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[PulledIndices].InitAsShaderResourceView(2, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[PulledObjects].InitAsShaderResourceView(3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+	slotRootParameter[PulledDrawConstants].InitAsConstants(offsetof(IndirectDraw, Args) / 4, 3, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
+	const CD3DX12_STATIC_SAMPLER_DESC linearClamp(
+		0, // shaderRegister
+		D3D12_FILTER_MIN_MAG_MIP_LINEAR, // filter
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP,  // addressU
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP,  // addressV
+		D3D12_TEXTURE_ADDRESS_MODE_CLAMP); // addressW
+
 	// A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(2, slotRootParameter, 0, nullptr,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(PulledRootParameterEnd, slotRootParameter, 1, &linearClamp,
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
 	// create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
@@ -526,10 +2305,42 @@ void ShapesApp::BuildShadersAndInputLayout()
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\VS.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\PS.hlsl", nullptr, "PS", "ps_5_1");
 
+	const D3D_SHADER_MACRO vertexPullingDefines[] =
+	{
+		"VERTEX_PULLING", "1",
+		NULL, NULL
+	};
+	mShaders["pulledVS"] = d3dUtil::CompileShader(L"Shaders\\VS.hlsl", vertexPullingDefines, "VS", "vs_5_1");
+
+	const D3D_SHADER_MACRO alphaTestDefines[] =
+	{
+		"ALPHA_TEST", "1",
+		NULL, NULL
+	};
+	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\PS.hlsl", alphaTestDefines, "PS", "ps_5_1");
+
+	mShaders["upscaleVS"] = d3dUtil::CompileShader(L"Shaders\\Upscale.hlsl", nullptr, "VS", "vs_5_1");
+	mShaders["upscalePS"] = d3dUtil::CompileShader(L"Shaders\\Upscale.hlsl", nullptr, "PS", "ps_5_1");
+
+	mShaders["impostorVS"] = d3dUtil::CompileShader(L"Shaders\\Impostor.hlsl", nullptr, "VS", "vs_5_1");
+	mShaders["impostorPS"] = d3dUtil::CompileShader(L"Shaders\\Impostor.hlsl", nullptr, "PS", "ps_5_1");
+
+	mShaders["particleVS"] = d3dUtil::CompileShader(L"Shaders\\Particle.hlsl", nullptr, "VS", "vs_5_1");
+	mShaders["particlePS"] = d3dUtil::CompileShader(L"Shaders\\Particle.hlsl", nullptr, "PS", "ps_5_1");
+
 	mInputLayout =
 	{
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 28, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	};
+
+	// ParticleInstance, one per instance; the corners come from SV_VertexID.
+	mParticleInputLayout =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+		{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
 	};
 }
 
@@ -723,10 +2534,13 @@ void ShapesApp::BuildShapeGeometry()
 		vertices[k].Color = XMFLOAT4(DirectX::Colors::Coral);
 	}
 
+	// The diamond is see-through, so its color carries alpha.
+	XMFLOAT4 diamondColor = XMFLOAT4(DirectX::Colors::DarkViolet);
+	diamondColor.w = 0.6f;
 	for (size_t i = 0; i < diamond.Vertices.size(); ++i, ++k)
 	{
 		vertices[k].Pos = diamond.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkViolet);
+		vertices[k].Color = diamondColor;
 	}
 
 	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
@@ -760,6 +2574,54 @@ void ShapesApp::BuildShapeGeometry()
 	//	vertices[k].Color = XMFLOAT4(DirectX::Colors::SteelBlue);
 	//}
 
+	// Local space bounds of each submesh; render items transform these into
+	// world space for frustum culling.
+	BoundingBox::CreateFromPoints(boxSubmesh.Bounds, box.Vertices.size(), &vertices[boxVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(wedgeSubmesh.Bounds, wedge.Vertices.size(), &vertices[wedgeVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(triPrismSubmesh.Bounds, triPrism.Vertices.size(), &vertices[triPrismVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(pentaPrismSubmesh.Bounds, pentaPrism.Vertices.size(), &vertices[pentaPrismVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(pyramidSubmesh.Bounds, pyramid.Vertices.size(), &vertices[pyramidVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(coneSubmesh.Bounds, cone.Vertices.size(), &vertices[coneVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(diamondSubmesh.Bounds, diamond.Vertices.size(), &vertices[diamondVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(cylinderSubmesh.Bounds, cylinder.Vertices.size(), &vertices[cylinderVertexOffset].Pos, sizeof(Vertex));
+	BoundingBox::CreateFromPoints(gridSubmesh.Bounds, grid.Vertices.size(), &vertices[gridVertexOffset].Pos, sizeof(Vertex));
+
+	// Normals and tangents: the generator's where it made them, the rest
+	// built from the faces around each vertex, then packed.
+	const std::pair<const GeometryGenerator::MeshData*, UINT> meshes[] =
+	{
+		{ &box, boxVertexOffset }, { &wedge, wedgeVertexOffset }, { &triPrism, triPrismVertexOffset },
+		{ &pentaPrism, pentaPrismVertexOffset }, { &pyramid, pyramidVertexOffset }, { &cone, coneVertexOffset },
+		{ &diamond, diamondVertexOffset }, { &cylinder, cylinderVertexOffset }, { &grid, gridVertexOffset }
+	};
+	std::vector<XMFLOAT3> normals(vertices.size());
+	std::vector<XMFLOAT3> tangents(vertices.size());
+	std::vector<std::uint32_t> frameIndices;
+	for (auto& mesh : meshes)
+	{
+		for (size_t i = 0; i < mesh.first->Vertices.size(); ++i)
+		{
+			normals[mesh.second + i] = mesh.first->Vertices[i].Normal;
+			tangents[mesh.second + i] = mesh.first->Vertices[i].TangentU;
+		}
+		for (std::uint32_t index : mesh.first->Indices32)
+			frameIndices.push_back(mesh.second + index);
+	}
+
+	ThreadPool framePool;
+	VertexFrameStats frameStats = BuildVertexFrames(&vertices[0].Pos.x, sizeof(Vertex), vertices.size(),
+		frameIndices.data(), frameIndices.size(), &normals[0].x, &tangents[0].x, framePool);
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		vertices[i].Normal = PackUnitVector(normals[i].x, normals[i].y, normals[i].z);
+		vertices[i].Tangent = PackUnitVector(tangents[i].x, tangents[i].y, tangents[i].z);
+	}
+
+	std::wostringstream frameReport;
+	frameReport << L"Vertex frames: " << frameStats.KeptNormals << L" normals kept, " << frameStats.GeneratedNormals
+		<< L" generated; " << frameStats.KeptTangents << L" tangents kept, " << frameStats.GeneratedTangents << L" generated\n";
+	::OutputDebugString(frameReport.str().c_str());
+
 	std::vector<std::uint16_t> indices;
 	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
 	//TODO: Step7 
@@ -777,6 +2639,14 @@ void ShapesApp::BuildShapeGeometry()
 	//indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
 	//indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
 
+	if (mUseTriangleStrips)
+	{
+		StripifyShapeGeometry(indices, {
+			{ "box", &boxSubmesh }, { "wedge", &wedgeSubmesh }, { "triPrism", &triPrismSubmesh },
+			{ "pentaPrism", &pentaPrismSubmesh }, { "pyramid", &pyramidSubmesh }, { "cone", &coneSubmesh },
+			{ "diamond", &diamondSubmesh }, { "cylinder", &cylinderSubmesh }, { "grid", &gridSubmesh } });
+	}
+
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
@@ -789,11 +2659,15 @@ void ShapesApp::BuildShapeGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	// Headless server mode runs without a device.
+	if (md3dDevice != nullptr)
+	{
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	}
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -819,8 +2693,64 @@ void ShapesApp::BuildShapeGeometry()
 	mGeometries[geo->Name] = std::move(geo);
 }
 
+void ShapesApp::StripifyShapeGeometry(std::vector<std::uint16_t>& indices,
+	const std::vector<std::pair<std::string, SubmeshGeometry*>>& submeshes)
+{
+	// submeshes must be in index buffer order; each is moved to its place in
+	// the rebuilt buffer.
+	std::vector<std::uint16_t> result;
+	std::wostringstream report;
+	size_t listTotal = 0;
+	for (auto& named : submeshes)
+	{
+		SubmeshGeometry& submesh = *named.second;
+		std::vector<std::uint32_t> list(indices.begin() + submesh.StartIndexLocation,
+			indices.begin() + submesh.StartIndexLocation + submesh.IndexCount);
+		std::vector<std::uint32_t> strips = StripifyTriangles(list.data(), list.size(), 0xFFFF);
+
+		bool useStrips = !strips.empty() && strips.size() < list.size();
+		const std::vector<std::uint32_t>& chosen = useStrips ? strips : list;
+		mSubmeshTopologies[named.first] = useStrips ? D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP : D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+		report << L"    " << std::wstring(named.first.begin(), named.first.end()) << L": " << list.size()
+			<< L" list indices, " << strips.size() << L" as strips, drawn as " << (useStrips ? L"strips" : L"a list") << L"\n";
+		listTotal += list.size();
+
+		submesh.StartIndexLocation = (UINT)result.size();
+		submesh.IndexCount = (UINT)chosen.size();
+		result.insert(result.end(), chosen.begin(), chosen.end());
+	}
+
+	std::wostringstream summary;
+	summary << L"Triangle strips: " << listTotal << L" indices -> " << result.size() << L"\n" << report.str();
+	::OutputDebugString(summary.str().c_str());
+
+	indices.swap(result);
+}
+
+D3D12_PRIMITIVE_TOPOLOGY ShapesApp::SubmeshTopology(const std::string& name)const
+{
+	auto it = mSubmeshTopologies.find(name);
+	return it != mSubmeshTopologies.end() ? it->second : D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+}
+
 void ShapesApp::BuildPSOs()
 {
+	// Each PSO the scene queues are drawn with gets a "_pulled" twin for the
+	// vertex pulling path: no input layout, and the VS built with
+	// VERTEX_PULLING.
+	auto createPulledPSO = [this](D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc, const std::string& name)
+	{
+		psoDesc.InputLayout = { nullptr, 0 };
+		psoDesc.VS =
+		{
+			reinterpret_cast<BYTE*>(mShaders["pulledVS"]->GetBufferPointer()),
+			mShaders["pulledVS"]->GetBufferSize()
+		};
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&mPSOs[name + "_pulled"])));
+		mPulledPSOs[mPSOs[name].Get()] = mPSOs[name + "_pulled"].Get();
+	};
+
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
 
 	//
@@ -845,12 +2775,17 @@ void ShapesApp::BuildPSOs()
 	opaquePsoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
 	opaquePsoDesc.SampleMask = UINT_MAX;
 	opaquePsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	// Strips are only built for 16-bit indices (see StripifyShapeGeometry and
+	// the static batcher), so one cut value serves every PSO.  Lists ignore it.
+	opaquePsoDesc.IBStripCutValue = mUseTriangleStrips ?
+		D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_0xFFFF : D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
 	opaquePsoDesc.NumRenderTargets = 1;
 	opaquePsoDesc.RTVFormats[0] = mBackBufferFormat;
 	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	createPulledPSO(opaquePsoDesc, "opaque");
 
 
 	//
@@ -860,15 +2795,148 @@ void ShapesApp::BuildPSOs()
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueWireframePsoDesc = opaquePsoDesc;
 	opaqueWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueWireframePsoDesc, IID_PPV_ARGS(&mPSOs["opaque_wireframe"])));
+	createPulledPSO(opaqueWireframePsoDesc, "opaque_wireframe");
+
+	//
+	// PSO for the depth pre-pass: depth writes only, no pixel shader.
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC depthPrepassPsoDesc = opaquePsoDesc;
+	depthPrepassPsoDesc.PS = { nullptr, 0 };
+	depthPrepassPsoDesc.NumRenderTargets = 0;
+	depthPrepassPsoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&depthPrepassPsoDesc, IID_PPV_ARGS(&mPSOs["depth_prepass"])));
+	createPulledPSO(depthPrepassPsoDesc, "depth_prepass");
+
+	//
+	// PSO for the color pass after the pre-pass: the depth buffer is already
+	// final, so test for equality and leave it untouched.
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueEqualPsoDesc = opaquePsoDesc;
+	opaqueEqualPsoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+	opaqueEqualPsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueEqualPsoDesc, IID_PPV_ARGS(&mPSOs["opaque_equal"])));
+	createPulledPSO(opaqueEqualPsoDesc, "opaque_equal");
+
+	//
+	// PSO for alpha tested objects.
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC alphaTestedPsoDesc = opaquePsoDesc;
+	alphaTestedPsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["alphaTestedPS"]->GetBufferPointer()),
+		mShaders["alphaTestedPS"]->GetBufferSize()
+	};
+	alphaTestedPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&alphaTestedPsoDesc, IID_PPV_ARGS(&mPSOs["alphaTested"])));
+	createPulledPSO(alphaTestedPsoDesc, "alphaTested");
+
+	//
+	// PSO for transparent objects.
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC transparentPsoDesc = opaquePsoDesc;
+
+	D3D12_RENDER_TARGET_BLEND_DESC transparencyBlendDesc;
+	transparencyBlendDesc.BlendEnable = true;
+	transparencyBlendDesc.LogicOpEnable = false;
+	transparencyBlendDesc.SrcBlend = D3D12_BLEND_SRC_ALPHA;
+	transparencyBlendDesc.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+	transparencyBlendDesc.BlendOp = D3D12_BLEND_OP_ADD;
+	transparencyBlendDesc.SrcBlendAlpha = D3D12_BLEND_ONE;
+	transparencyBlendDesc.DestBlendAlpha = D3D12_BLEND_ZERO;
+	transparencyBlendDesc.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+	transparencyBlendDesc.LogicOp = D3D12_LOGIC_OP_NOOP;
+	transparencyBlendDesc.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
+
+	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
+	transparentPsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mPSOs["transparent"])));
+	createPulledPSO(transparentPsoDesc, "transparent");
+
+	//
+	// PSO for stretching the scene color onto the back buffer.  The
+	// fullscreen triangle is generated from SV_VertexID, so there is no
+	// input layout and no depth buffer.
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC upscalePsoDesc = opaquePsoDesc;
+	upscalePsoDesc.InputLayout = { nullptr, 0 };
+	upscalePsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["upscaleVS"]->GetBufferPointer()),
+		mShaders["upscaleVS"]->GetBufferSize()
+	};
+	upscalePsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["upscalePS"]->GetBufferPointer()),
+		mShaders["upscalePS"]->GetBufferSize()
+	};
+	upscalePsoDesc.DepthStencilState.DepthEnable = false;
+	upscalePsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+	upscalePsoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
+	upscalePsoDesc.SampleDesc.Count = 1;
+	upscalePsoDesc.SampleDesc.Quality = 0;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&upscalePsoDesc, IID_PPV_ARGS(&mPSOs["upscale"])));
+
+	//
+	// PSO for impostor quads.  The quad is generated from SV_VertexID and
+	// clipped to the castle's silhouette, so it writes depth like any opaque
+	// object.
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC impostorPsoDesc = opaquePsoDesc;
+	impostorPsoDesc.InputLayout = { nullptr, 0 };
+	impostorPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["impostorVS"]->GetBufferPointer()),
+		mShaders["impostorVS"]->GetBufferSize()
+	};
+	impostorPsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["impostorPS"]->GetBufferPointer()),
+		mShaders["impostorPS"]->GetBufferSize()
+	};
+	impostorPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&impostorPsoDesc, IID_PPV_ARGS(&mPSOs["impostor"])));
+
+	//
+	// PSO for particles.  Their colors are premultiplied, so flames (alpha
+	// 0) add and smoke covers under the same blend.  They test depth but do
+	// not write it.
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC particlePsoDesc = transparentPsoDesc;
+	particlePsoDesc.InputLayout = { mParticleInputLayout.data(), (UINT)mParticleInputLayout.size() };
+	particlePsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["particleVS"]->GetBufferPointer()),
+		mShaders["particleVS"]->GetBufferSize()
+	};
+	particlePsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["particlePS"]->GetBufferPointer()),
+		mShaders["particlePS"]->GetBufferSize()
+	};
+	particlePsoDesc.BlendState.RenderTarget[0].SrcBlend = D3D12_BLEND_ONE;
+	particlePsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&particlePsoDesc, IID_PPV_ARGS(&mPSOs["particle"])));
 }
 
 void ShapesApp::BuildFrameResources()
 {
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
+		// Each view draws an item at most once.
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size()));
+			gMaxRenderViews, (UINT)mAllRitems.size(), gMaxRenderViews * (UINT)mAllRitems.size(),
+			mDynamicGeometryBytes));
 	}
+
+	mObjectUpload = std::make_unique<UploadBatch>(mAllRitems.size(),
+		d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants)));
 }
 
 void ShapesApp::BuildRenderItems()
@@ -979,13 +3047,16 @@ void ShapesApp::BuildRenderItems()
 	gridRitem->World = MathHelper::Identity4x4();
 	gridRitem->ObjCBIndex = objCBIndex++;
 	gridRitem->Geo = mGeometries["shapeGeo"].get();
-	gridRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	gridRitem->PrimitiveType = SubmeshTopology("grid");
 	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
 	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
 	mAllRitems.push_back(std::move(gridRitem));
 	// ------------------
 
+	// Every item from here to the end of the castle is part of it.
+	const size_t castleBegin = mAllRitems.size();
+
 	// Walls <<Left, right, back>>
 	for (int i = 0; i < numWalls; ++i)
 	{
@@ -993,7 +3064,7 @@ void ShapesApp::BuildRenderItems()
 		XMStoreFloat4x4(&wallRitem->World, vectorWallsWorld[i]);
 		wallRitem->ObjCBIndex = objCBIndex++;
 		wallRitem->Geo = mGeometries["shapeGeo"].get();
-		wallRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallRitem->PrimitiveType = SubmeshTopology("box");
 		wallRitem->IndexCount = wallRitem->Geo->DrawArgs["box"].IndexCount;
 		wallRitem->StartIndexLocation = wallRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		wallRitem->BaseVertexLocation = wallRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1008,7 +3079,7 @@ void ShapesApp::BuildRenderItems()
 		XMStoreFloat4x4(&shortWallRitem->World, vectorShortWallsWorld[i]);
 		shortWallRitem->ObjCBIndex = objCBIndex++;
 		shortWallRitem->Geo = mGeometries["shapeGeo"].get();
-		shortWallRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		shortWallRitem->PrimitiveType = SubmeshTopology("box");
 		shortWallRitem->IndexCount = shortWallRitem->Geo->DrawArgs["box"].IndexCount;
 		shortWallRitem->StartIndexLocation = shortWallRitem->Geo->DrawArgs["box"].StartIndexLocation;
 		shortWallRitem->BaseVertexLocation = shortWallRitem->Geo->DrawArgs["box"].BaseVertexLocation;
@@ -1023,7 +3094,7 @@ void ShapesApp::BuildRenderItems()
 		XMStoreFloat4x4(&wedgeDoorRitem->World, scaleWedgeDoor * vectorDoorRota[i] * vectorDoorTransf[i]);
 		wedgeDoorRitem->ObjCBIndex = objCBIndex++;
 		wedgeDoorRitem->Geo = mGeometries["shapeGeo"].get();
-		wedgeDoorRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wedgeDoorRitem->PrimitiveType = SubmeshTopology("wedge");
 		wedgeDoorRitem->IndexCount = wedgeDoorRitem->Geo->DrawArgs["wedge"].IndexCount;
 		wedgeDoorRitem->StartIndexLocation = wedgeDoorRitem->Geo->DrawArgs["wedge"].StartIndexLocation;
 		wedgeDoorRitem->BaseVertexLocation = wedgeDoorRitem->Geo->DrawArgs["wedge"].BaseVertexLocation;
@@ -1038,7 +3109,7 @@ void ShapesApp::BuildRenderItems()
 												XMMatrixTranslation(0.0f, +heightWall + 0.75f, -castleDepth2));
 	triPrismRitem->ObjCBIndex = objCBIndex++;
 	triPrismRitem->Geo = mGeometries["shapeGeo"].get();
-	triPrismRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	triPrismRitem->PrimitiveType = SubmeshTopology("triPrism");
 	triPrismRitem->IndexCount = triPrismRitem->Geo->DrawArgs["triPrism"].IndexCount;
 	triPrismRitem->StartIndexLocation = triPrismRitem->Geo->DrawArgs["triPrism"].StartIndexLocation;
 	triPrismRitem->BaseVertexLocation = triPrismRitem->Geo->DrawArgs["triPrism"].BaseVertexLocation;
@@ -1052,7 +3123,7 @@ void ShapesApp::BuildRenderItems()
 		XMStoreFloat4x4(&cylRitem->World, vectorCylsWorld[i]);
 		cylRitem->ObjCBIndex = objCBIndex++;
 		cylRitem->Geo = mGeometries["shapeGeo"].get();
-		cylRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		cylRitem->PrimitiveType = SubmeshTopology("cylinder");
 		cylRitem->IndexCount = cylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		cylRitem->StartIndexLocation = cylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		cylRitem->BaseVertexLocation = cylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
@@ -1062,11 +3133,15 @@ void ShapesApp::BuildRenderItems()
 		XMStoreFloat4x4(&coneRitem->World, vectorConesWorld[i]);
 		coneRitem->ObjCBIndex = objCBIndex++;
 		coneRitem->Geo = mGeometries["shapeGeo"].get();
-		coneRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		coneRitem->PrimitiveType = SubmeshTopology("cone");
 		coneRitem->IndexCount = coneRitem->Geo->DrawArgs["cone"].IndexCount;
 		coneRitem->StartIndexLocation = coneRitem->Geo->DrawArgs["cone"].StartIndexLocation;
 		coneRitem->BaseVertexLocation = coneRitem->Geo->DrawArgs["cone"].BaseVertexLocation;
 		mAllRitems.push_back(std::move(coneRitem));
+
+		XMFLOAT3 towerTop;
+		XMStoreFloat3(&towerTop, vectorConesWorld[i].r[3]);
+		mTowerTops.push_back(towerTop);
 	}
 	// -------------------------------
 
@@ -1077,7 +3152,7 @@ void ShapesApp::BuildRenderItems()
 												XMMatrixTranslation(0.0f, 0.5f, 0.0f));
 	pentaPrismRitem->ObjCBIndex = objCBIndex++;
 	pentaPrismRitem->Geo = mGeometries["shapeGeo"].get();
-	pentaPrismRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	pentaPrismRitem->PrimitiveType = SubmeshTopology("pentaPrism");
 	pentaPrismRitem->IndexCount = pentaPrismRitem->Geo->DrawArgs["pentaPrism"].IndexCount;
 	pentaPrismRitem->StartIndexLocation = pentaPrismRitem->Geo->DrawArgs["pentaPrism"].StartIndexLocation;
 	pentaPrismRitem->BaseVertexLocation = pentaPrismRitem->Geo->DrawArgs["pentaPrism"].BaseVertexLocation;
@@ -1090,8 +3165,10 @@ void ShapesApp::BuildRenderItems()
 												XMMatrixRotationRollPitchYaw(0.0f, 0.0f, 0.0f) *
 												XMMatrixTranslation(0.0f, 3.5f, 0.0f));
 	diamondRitem->ObjCBIndex = objCBIndex++;
+	diamondRitem->Layer = RenderLayer::Transparent;
+	diamondRitem->IsAnimated = true;
 	diamondRitem->Geo = mGeometries["shapeGeo"].get();
-	diamondRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	diamondRitem->PrimitiveType = SubmeshTopology("diamond");
 	diamondRitem->IndexCount = diamondRitem->Geo->DrawArgs["diamond"].IndexCount;
 	diamondRitem->StartIndexLocation = diamondRitem->Geo->DrawArgs["diamond"].StartIndexLocation;
 	diamondRitem->BaseVertexLocation = diamondRitem->Geo->DrawArgs["diamond"].BaseVertexLocation;
@@ -1105,7 +3182,7 @@ void ShapesApp::BuildRenderItems()
 		tranfLeftWallSpikes);
 	pyramidRitem->ObjCBIndex = objCBIndex++;
 	pyramidRitem->Geo = mGeometries["shapeGeo"].get();
-	pyramidRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	pyramidRitem->PrimitiveType = SubmeshTopology("pyramid");
 	pyramidRitem->IndexCount = pyramidRitem->Geo->DrawArgs["pyramid"].IndexCount;
 	pyramidRitem->StartIndexLocation = pyramidRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
 	pyramidRitem->BaseVertexLocation = pyramidRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
@@ -1119,7 +3196,7 @@ void ShapesApp::BuildRenderItems()
 			XMMatrixTranslation(-castleWidth2, heightWall, (i + 1) * (castleDepth / 7)));
 		leftTopSpikeRitem->ObjCBIndex = objCBIndex++;
 		leftTopSpikeRitem->Geo = mGeometries["shapeGeo"].get();
-		leftTopSpikeRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		leftTopSpikeRitem->PrimitiveType = SubmeshTopology("pyramid");
 		leftTopSpikeRitem->IndexCount = leftTopSpikeRitem->Geo->DrawArgs["pyramid"].IndexCount;
 		leftTopSpikeRitem->StartIndexLocation = leftTopSpikeRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
 		leftTopSpikeRitem->BaseVertexLocation = leftTopSpikeRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
@@ -1132,7 +3209,7 @@ void ShapesApp::BuildRenderItems()
 			XMMatrixTranslation(-castleWidth2, heightWall, -(i + 1) * (castleDepth / 7)));
 		leftBottomSpikeRitem->ObjCBIndex = objCBIndex++;
 		leftBottomSpikeRitem->Geo = mGeometries["shapeGeo"].get();
-		leftBottomSpikeRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		leftBottomSpikeRitem->PrimitiveType = SubmeshTopology("pyramid");
 		leftBottomSpikeRitem->IndexCount = leftBottomSpikeRitem->Geo->DrawArgs["pyramid"].IndexCount;
 		leftBottomSpikeRitem->StartIndexLocation = leftBottomSpikeRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
 		leftBottomSpikeRitem->BaseVertexLocation = leftBottomSpikeRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
@@ -1145,7 +3222,7 @@ void ShapesApp::BuildRenderItems()
 			XMMatrixTranslation(castleWidth2, heightWall, (i + 1) * (castleDepth / 7)));
 		rightTopSpikeRitem->ObjCBIndex = objCBIndex++;
 		rightTopSpikeRitem->Geo = mGeometries["shapeGeo"].get();
-		rightTopSpikeRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		rightTopSpikeRitem->PrimitiveType = SubmeshTopology("pyramid");
 		rightTopSpikeRitem->IndexCount = rightTopSpikeRitem->Geo->DrawArgs["pyramid"].IndexCount;
 		rightTopSpikeRitem->StartIndexLocation = rightTopSpikeRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
 		rightTopSpikeRitem->BaseVertexLocation = rightTopSpikeRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
@@ -1158,7 +3235,7 @@ void ShapesApp::BuildRenderItems()
 			XMMatrixTranslation(castleWidth2, heightWall, -(i + 1) * (castleDepth / 7)));
 		rightBottomRitem->ObjCBIndex = objCBIndex++;
 		rightBottomRitem->Geo = mGeometries["shapeGeo"].get();
-		rightBottomRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		rightBottomRitem->PrimitiveType = SubmeshTopology("pyramid");
 		rightBottomRitem->IndexCount = rightBottomRitem->Geo->DrawArgs["pyramid"].IndexCount;
 		rightBottomRitem->StartIndexLocation = rightBottomRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
 		rightBottomRitem->BaseVertexLocation = rightBottomRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
@@ -1170,7 +3247,7 @@ void ShapesApp::BuildRenderItems()
 		tranfRightWallSpikes);
 	rightpyramidRitem->ObjCBIndex = objCBIndex++;
 	rightpyramidRitem->Geo = mGeometries["shapeGeo"].get();
-	rightpyramidRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	rightpyramidRitem->PrimitiveType = SubmeshTopology("pyramid");
 	rightpyramidRitem->IndexCount = rightpyramidRitem->Geo->DrawArgs["pyramid"].IndexCount;
 	rightpyramidRitem->StartIndexLocation = rightpyramidRitem->Geo->DrawArgs["pyramid"].StartIndexLocation;
 	rightpyramidRitem->BaseVertexLocation = rightpyramidRitem->Geo->DrawArgs["pyramid"].BaseVertexLocation;
@@ -1178,6 +3255,10 @@ void ShapesApp::BuildRenderItems()
 
 	// --------------------------------------------------------------------
 
+	// The castle is impostor group 0.
+	for (size_t i = castleBegin; i < mAllRitems.size(); ++i)
+		mAllRitems[i]->ImpostorGroup = 0;
+
 	//TODO: Step9 
 	//auto wedgeRitem = std::make_unique<RenderItem>();
 	////wedgeRitem->World = MathHelper::Identity4x4();
@@ -1309,9 +3390,299 @@ void ShapesApp::BuildRenderItems()
 		mAllRitems.push_back(std::move(rightSphereRitem));
 	}*/
 
-	// All the render items are opaque.
+	// Copies of the castle stand in a ring around the map, each in its own
+	// impostor group so each can be swapped for its impostor on its own.
+	std::vector<const RenderItem*> castleRitems;
+	for (auto& e : mAllRitems)
+	{
+		if (e->ImpostorGroup == 0)
+			castleRitems.push_back(e.get());
+	}
+
+	for (int castle = 0; castle < mFarCastleCount; ++castle)
+	{
+		float angle = castle * XM_2PI / mFarCastleCount;
+		XMMATRIX offset = XMMatrixTranslation(mFarCastleRingRadius * cosf(angle), 0.0f, mFarCastleRingRadius * sinf(angle));
+
+		for (const RenderItem* ri : castleRitems)
+		{
+			auto copyRitem = std::make_unique<RenderItem>(*ri);
+			XMStoreFloat4x4(&copyRitem->World, XMLoadFloat4x4(&ri->World) * offset);
+			copyRitem->ObjCBIndex = objCBIndex++;
+			copyRitem->ImpostorGroup = castle + 1;
+			mAllRitems.push_back(std::move(copyRitem));
+		}
+	}
+
+	// Sort the render items into their queues.
+	for (auto& e : mAllRitems)
+		mRitemLayer[(int)e->Layer].push_back(e.get());
+
+	// Apart from the spinning diamonds nothing in the castle moves, so the
+	// rest is static.  Derive the world space bounds from the submesh the
+	// item draws.
+	for (auto& e : mAllRitems)
+	{
+		e->IsStatic = !e->IsAnimated;
+		e->PrevWorld = e->World;
+
+		for (auto& drawArg : e->Geo->DrawArgs)
+		{
+			if (drawArg.second.StartIndexLocation == e->StartIndexLocation &&
+				drawArg.second.BaseVertexLocation == e->BaseVertexLocation)
+			{
+				drawArg.second.Bounds.Transform(e->Bounds, XMLoadFloat4x4(&e->World));
+
+				if (e->IsAnimated)
+				{
+					SpinAnimation anim;
+					anim.Ritem = e.get();
+					anim.BaseWorld = e->World;
+					anim.LocalBounds = drawArg.second.Bounds;
+					anim.Speed = 0.5f * XM_PI;
+					mSpinAnimations.push_back(anim);
+				}
+				break;
+			}
+		}
+	}
+}
+
+void ShapesApp::BuildParticles()
+{
+	// A torch on the outer face of each tower.  Alpha 0: the flame only
+	// adds light.
+	ParticleEmitterDesc torch;
+	torch.Rate = 240.0f;
+	torch.Lifetime = 0.6f;
+	torch.LifetimeJitter = 0.3f;
+	torch.Spread[0] = torch.Spread[2] = 0.12f;
+	torch.Spread[1] = 0.05f;
+	torch.Velocity[1] = 1.2f;
+	torch.VelocityJitter[0] = torch.VelocityJitter[2] = 0.25f;
+	torch.VelocityJitter[1] = 0.3f;
+	torch.Acceleration[1] = 1.5f;
+	torch.Damping = 0.5f;
+	torch.StartSize = 0.25f;
+	torch.EndSize = 0.05f;
+	const float torchStart[4] = { 1.0f, 0.55f, 0.15f, 0.0f };
+	const float torchEnd[4] = { 0.4f, 0.05f, 0.0f, 0.0f };
+	std::copy(torchStart, torchStart + 4, torch.StartColor);
+	std::copy(torchEnd, torchEnd + 4, torch.EndColor);
+
+	// Smoke off the flame, growing and thinning as the wind takes it.
+	ParticleEmitterDesc smoke;
+	smoke.Rate = 40.0f;
+	smoke.Lifetime = 4.0f;
+	smoke.LifetimeJitter = 0.25f;
+	smoke.Spread[0] = smoke.Spread[1] = smoke.Spread[2] = 0.1f;
+	smoke.Velocity[1] = 0.8f;
+	smoke.VelocityJitter[0] = smoke.VelocityJitter[1] = smoke.VelocityJitter[2] = 0.2f;
+	smoke.Acceleration[0] = 0.35f;
+	smoke.Acceleration[1] = 0.1f;
+	smoke.Acceleration[2] = 0.1f;
+	smoke.Damping = 0.7f;
+	smoke.StartSize = 0.2f;
+	smoke.EndSize = 1.2f;
+	const float smokeStart[4] = { 0.125f, 0.125f, 0.125f, 0.5f };
+	const float smokeEnd[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	std::copy(smokeStart, smokeStart + 4, smoke.StartColor);
+	std::copy(smokeEnd, smokeEnd + 4, smoke.EndColor);
+
+	// A banner off the tip of each roof: short lived particles streaming
+	// downwind, which together flutter like a pennant.
+	ParticleEmitterDesc banner;
+	banner.Rate = 300.0f;
+	banner.Lifetime = 0.5f;
+	banner.LifetimeJitter = 0.1f;
+	banner.Spread[1] = 0.08f;
+	banner.Velocity[0] = 2.5f;
+	banner.VelocityJitter[0] = banner.VelocityJitter[2] = 0.3f;
+	banner.VelocityJitter[1] = 0.6f;
+	banner.Acceleration[1] = -0.5f;
+	banner.Damping = 0.9f;
+	banner.StartSize = 0.15f;
+	banner.EndSize = 0.12f;
+	const float bannerStart[4] = { 0.7f, 0.05f, 0.1f, 1.0f };
+	const float bannerEnd[4] = { 0.4f, 0.02f, 0.06f, 0.8f };
+	std::copy(bannerStart, bannerStart + 4, banner.StartColor);
+	std::copy(bannerEnd, bannerEnd + 4, banner.EndColor);
+
+	// Room for the longest lived particles of every emitter, and a step's
+	// births on top.
+	auto capacity = [this](const ParticleEmitterDesc& desc)
+	{
+		float perEmitter = desc.Rate * (desc.Lifetime * (1.0f + desc.LifetimeJitter) + mSimStep);
+		return (std::size_t)std::ceil(perEmitter) * mTowerTops.size();
+	};
+	int torchType = mParticles.AddType(torch, capacity(torch));
+	int smokeType = mParticles.AddType(smoke, capacity(smoke));
+	int bannerType = mParticles.AddType(banner, capacity(banner));
+
+	// How far a particle can get from its emitter in its longest life,
+	// ignoring the damping that only slows it, plus its largest size.
+	auto addBounds = [this](const ParticleEmitterDesc& desc, const XMFLOAT3& position)
+	{
+		float life = desc.Lifetime * (1.0f + desc.LifetimeJitter);
+		float reach[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			reach[a] = desc.Spread[a] + (std::fabs(desc.Velocity[a]) + desc.VelocityJitter[a]) * life +
+				0.5f * std::fabs(desc.Acceleration[a]) * life * life + (std::max)(desc.StartSize, desc.EndSize);
+		}
+		mParticleBounds.push_back(BoundingBox(position, XMFLOAT3(reach[0], reach[1], reach[2])));
+	};
+
+	for (const XMFLOAT3& top : mTowerTops)
+	{
+		// The towers narrow towards the top; the torch sits just outside
+		// the wall, facing away from the keep.
+		XMVECTOR outward = XMVector3Normalize(XMVectorSet(top.x, 0.0f, top.z, 0.0f));
+		XMFLOAT3 torchPos;
+		XMStoreFloat3(&torchPos, XMVectorSet(top.x, top.y * 0.6f, top.z, 1.0f) + outward * 1.9f);
+
+		XMFLOAT3 smokePos(torchPos.x, torchPos.y + 0.6f, torchPos.z);
+		XMFLOAT3 bannerPos(top.x, top.y + 2.2f, top.z);
+
+		mParticles.AddEmitter(torchType, torchPos.x, torchPos.y, torchPos.z);
+		mParticles.AddEmitter(smokeType, smokePos.x, smokePos.y, smokePos.z);
+		mParticles.AddEmitter(bannerType, bannerPos.x, bannerPos.y, bannerPos.z);
+		addBounds(torch, torchPos);
+		addBounds(smoke, smokePos);
+		addBounds(banner, bannerPos);
+	}
+}
+
+void ShapesApp::BuildImpostors()
+{
+	// One instance per impostor group, bounded by its items.  Group 0 is the
+	// castle at the origin and doubles as the archetype.
+	mCastles.resize(mFarCastleCount + 1);
+	std::vector<bool> hasBounds(mCastles.size(), false);
+	for (auto& e : mAllRitems)
+	{
+		if (e->ImpostorGroup < 0)
+			continue;
+
+		ImpostorInstance& castle = mCastles[e->ImpostorGroup];
+		if (hasBounds[e->ImpostorGroup])
+			BoundingBox::CreateMerged(castle.Bounds, castle.Bounds, e->Bounds);
+		else
+			castle.Bounds = e->Bounds;
+		hasBounds[e->ImpostorGroup] = true;
+
+		if (e->ImpostorGroup == 0)
+			mImpostorBakeRitems[(int)e->Layer].push_back(e.get());
+	}
+
+	for (int castle = 0; castle < mFarCastleCount; ++castle)
+	{
+		float angle = castle * XM_2PI / mFarCastleCount;
+		mCastles[castle + 1].Position = XMFLOAT3(mFarCastleRingRadius * cosf(angle), 0.0f, mFarCastleRingRadius * sinf(angle));
+	}
+
+	// Pictures from 8 directions, looking down at roughly the angle of the
+	// orbit camera.
+	mImpostorAtlas = std::make_unique<ImpostorAtlas>(md3dDevice.Get(), mBackBufferFormat, mDepthStencilFormat);
+	mImpostorAtlas->SetArchetype(mCastles[0].Bounds, 0.3f * XM_PI);
+}
+
+void ShapesApp::BuildStaticBatches()
+{
+	std::vector<RenderItem*> sourceRitems;
+	for (auto& e : mAllRitems)
+		sourceRitems.push_back(e.get());
+
+	// Whatever the batcher does not merge is drawn as is.
+	for (auto ri : sourceRitems)
+	{
+		if (!StaticBatcher::CanBatch(ri))
+			mBatchedRitemLayer[(int)ri->Layer].push_back(ri);
+	}
+
+	std::vector<StaticBatch> batches;
+	auto geo = mStaticBatcher.Build(md3dDevice.Get(), mCommandList.Get(), sourceRitems, batches, mUseTriangleStrips);
+	if (geo == nullptr)
+		return;
+
+	// The batches are already in world space, so they draw with an identity
+	// world matrix and their own object constants.
+	UINT objCBIndex = (UINT)mAllRitems.size();
+	for (auto& batch : batches)
+	{
+		auto batchRitem = std::make_unique<RenderItem>();
+		batchRitem->World = MathHelper::Identity4x4();
+		batchRitem->Bounds = batch.Bounds;
+		batchRitem->IsStatic = true;
+		batchRitem->Layer = batch.Layer;
+		batchRitem->ImpostorGroup = batch.ImpostorGroup;
+		batchRitem->StreamedTexture = batch.StreamedTexture;
+		batchRitem->TexCPerUnit = batch.TexCPerUnit;
+		batchRitem->ObjCBIndex = objCBIndex++;
+		batchRitem->Geo = geo.get();
+		batchRitem->PrimitiveType = batch.PrimitiveType;
+		batchRitem->IndexCount = geo->DrawArgs[batch.Name].IndexCount;
+		batchRitem->StartIndexLocation = geo->DrawArgs[batch.Name].StartIndexLocation;
+		batchRitem->BaseVertexLocation = geo->DrawArgs[batch.Name].BaseVertexLocation;
+		mBatchedRitemLayer[(int)batch.Layer].push_back(batchRitem.get());
+		mAllRitems.push_back(std::move(batchRitem));
+	}
+
+	mGeometries[geo->Name] = std::move(geo);
+
+	::OutputDebugString(mStaticBatcher.Report().c_str());
+}
+
+void ShapesApp::BuildStaticGroups()
+{
+	// Transparent items are sorted one by one every frame, so only the
+	// depth-writing queues are grouped.
+	const RenderLayer groupedLayers[] = { RenderLayer::Opaque, RenderLayer::AlphaTested };
+
+	for (int batched = 0; batched < 2; ++batched)
+	{
+		const auto* ritemLayer = batched ? mBatchedRitemLayer : mRitemLayer;
+
+		for (RenderLayer layer : groupedLayers)
+		{
+			std::map<int, RenderItemGroup> groups;
+			for (auto ri : ritemLayer[(int)layer])
+			{
+				if (!ri->IsStatic)
+					continue;
+
+				auto it = groups.find(ri->ImpostorGroup);
+				if (it == groups.end())
+				{
+					it = groups.insert(std::make_pair(ri->ImpostorGroup, RenderItemGroup())).first;
+					it->second.ImpostorGroup = ri->ImpostorGroup;
+					it->second.Bounds = ri->Bounds;
+				}
+				else
+				{
+					BoundingBox::CreateMerged(it->second.Bounds, it->second.Bounds, ri->Bounds);
+				}
+				it->second.Ritems.push_back(ri);
+			}
+
+			for (auto& entry : groups)
+				mStaticGroups[batched][(int)layer].push_back(std::move(entry.second));
+		}
+	}
+}
+
+void ShapesApp::BuildGeometryPool()
+{
+	// Every mesh, the merged static batches included, so any mix of items
+	// can share an indirect batch.  Items drawn as strips get their
+	// triangles as a list, as the pulled PSOs only draw lists.
+	for (auto& entry : mGeometries)
+		mGeometryPool.Add(entry.second.get());
 	for (auto& e : mAllRitems)
-		mOpaqueRitems.push_back(e.get());
+		mGeometryPool.AddStrips(e.get());
+	mGeometryPool.Build(md3dDevice.Get(), mCommandList.Get());
+
+	mPulledDrawSignature = CreatePulledDrawSignature(md3dDevice.Get(), mRootSignature.Get());
 }
 
 void ShapesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -1330,7 +3701,7 @@ void ShapesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::v
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
 		// Offset to the CBV in the descriptor heap for this object and for this frame resource.
-		UINT cbvIndex = mCurrFrameResourceIndex * (UINT)mOpaqueRitems.size() + ri->ObjCBIndex;
+		UINT cbvIndex = mCurrFrameResourceIndex * (UINT)mAllRitems.size() + ri->ObjCBIndex;
 		auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
 		cbvHandle.Offset(cbvIndex, mCbvSrvUavDescriptorSize);
 
@@ -1340,4 +3711,110 @@ void ShapesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::v
 	}
 }
 
+void ShapesApp::DrawLayer(const RenderView& rview, RenderLayer layer, ID3D12PipelineState* pso)
+{
+	if (mUseVertexPulling)
+	{
+		// The whole queue in one call, no vertex or index buffer bound.  The
+		// pool's buffers and the object constants were bound at the top of
+		// Draw; each record sets its own offsets.
+		UINT drawCount = rview.PulledDrawCount[(int)layer];
+		if (drawCount > 0)
+		{
+			mCommandList->SetPipelineState(mPulledPSOs.at(pso));
+			mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			mCommandList->ExecuteIndirect(mPulledDrawSignature.Get(), drawCount, mCurrFrameResource->DrawArgs->Resource(),
+				(UINT64)rview.FirstPulledDraw[(int)layer] * sizeof(IndirectDraw), nullptr, 0);
+		}
+
+		mCommandList->SetPipelineState(pso);
+		DrawRenderItems(mCommandList.Get(), rview.UnpulledRitems[(int)layer]);
+		return;
+	}
+
+	// Replay the visible static groups.  A group's bundle is cached per frame
+	// resource and PSO.  The groups, and everything their bundles bake in,
+	// are built once at startup, so each is recorded once.
+	for (auto group : rview.VisibleGroups[(int)layer])
+	{
+		ID3D12GraphicsCommandList* bundle = mBundleCache->Get(mCurrFrameResourceIndex, group, pso,
+			[this, group](ID3D12GraphicsCommandList* bundleList)
+		{
+			// Same root signature as the calling list, so the pass constants
+			// it bound carry over.
+			bundleList->SetGraphicsRootSignature(mRootSignature.Get());
+			DrawRenderItems(bundleList, group->Ritems);
+		});
+
+		mCommandList->ExecuteBundle(bundle);
+	}
+
+	// Then whatever is not in a group, one draw at a time.  The bundles leave
+	// their PSO bound, so set it again.
+	mCommandList->SetPipelineState(pso);
+	DrawRenderItems(mCommandList.Get(), rview.VisibleRitems[(int)layer]);
+}
+
+void ShapesApp::DrawParticles()
+{
+	if (mParticles.TotalCount() == 0)
+		return;
+
+	// The instances UpdateParticles wrote this frame, grouped by type.
+	mCommandList->SetPipelineState(mPSOs["particle"].Get());
+	mCommandList->IASetVertexBuffers(0, 1, &mParticleInstances.View);
+	mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+	for (int type = 0; type < mParticles.TypeCount(); ++type)
+	{
+		UINT count = (UINT)mParticles.Count(type);
+		if (count > 0)
+			mCommandList->DrawInstanced(4, count, 0, (UINT)mParticles.FirstInstance(type));
+	}
+}
+
+void ShapesApp::BindView(const RenderView& rview)
+{
+	// The view's part of the corner the scene is rendered into.
+	int left = (int)(rview.Left * mRenderWidth);
+	int top = (int)(rview.Top * mRenderHeight);
+	int right = (int)((rview.Left + rview.Width) * mRenderWidth);
+	int bottom = (int)((rview.Top + rview.Height) * mRenderHeight);
+
+	D3D12_VIEWPORT viewport = { (float)left, (float)top, (float)(right - left), (float)(bottom - top), 0.0f, 1.0f };
+	D3D12_RECT scissorRect = { left, top, right, bottom };
+	mCommandList->RSSetViewports(1, &viewport);
+	mCommandList->RSSetScissorRects(1, &scissorRect);
+
+	mCommandList->SetGraphicsRootDescriptorTable(1, PassCbvHandle(rview.PassIndex));
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE ShapesApp::PassCbvHandle(UINT passIndex)const
+{
+	auto handle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
+	handle.Offset(mPassCbvOffset + mCurrFrameResourceIndex * gMaxRenderViews + passIndex, mCbvSrvUavDescriptorSize);
+	return handle;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE ShapesApp::SceneColorView()const
+{
+	// The scene color RTV comes right after the swap chain buffers.
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(
+		mRtvHeap->GetCPUDescriptorHandleForHeapStart(),
+		SwapChainBufferCount,
+		mRtvDescriptorSize);
+}
 
+ID3D12Resource* ShapesApp::GraphResource(RGResource resource)const
+{
+	if (resource == RGInvalidResource)
+		return nullptr;
+	if (resource == mBackBuffer)
+		return CurrentBackBuffer();
+	if (resource == mDepth)
+		return mDepthStencilBuffer.Get();
+	if (resource == mImpostorAtlasResource)
+		return mImpostorAtlas->Atlas();
+
+	return mTransientResources[resource].Get();
+}
@@ -0,0 +1,443 @@
+#include "../Source/BCnEncoder.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	//
+	// Decoders written from the format specifications, independently of the
+	// encoder, so a block only passes if any decoder would read it back.
+	//
+
+	void Expand565(std::uint16_t v, int* c)
+	{
+		int r = (v >> 11) & 31;
+		int g = (v >> 5) & 63;
+		int b = v & 31;
+		c[0] = (r << 3) | (r >> 2);
+		c[1] = (g << 2) | (g >> 4);
+		c[2] = (b << 3) | (b >> 2);
+	}
+
+	// Writes the RGB of the 16 texels; a three color block's index 3 is black.
+	void DecodeColor(const std::uint8_t* block, std::uint8_t* rgba)
+	{
+		std::uint16_t c0 = (std::uint16_t)(block[0] | (block[1] << 8));
+		std::uint16_t c1 = (std::uint16_t)(block[2] | (block[3] << 8));
+		int palette[4][3];
+		Expand565(c0, palette[0]);
+		Expand565(c1, palette[1]);
+		for (int c = 0; c < 3; ++c)
+		{
+			if (c0 > c1)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+
+		for (int i = 0; i < 16; ++i)
+		{
+			int index = (block[4 + i / 4] >> (2 * (i % 4))) & 3;
+			for (int c = 0; c < 3; ++c)
+				rgba[i * 4 + c] = (std::uint8_t)palette[index][c];
+		}
+	}
+
+	void DecodeAlpha(const std::uint8_t* block, std::uint8_t* rgba)
+	{
+		int a0 = block[0];
+		int a1 = block[1];
+		int palette[8] = { a0, a1 };
+		if (a0 > a1)
+		{
+			for (int i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		}
+		else
+		{
+			for (int i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		std::uint64_t bits = 0;
+		for (int i = 0; i < 6; ++i)
+			bits |= (std::uint64_t)block[2 + i] << (8 * i);
+		for (int i = 0; i < 16; ++i)
+			rgba[i * 4 + 3] = (std::uint8_t)palette[(bits >> (3 * i)) & 7];
+	}
+
+	void DecodeBC1(const std::uint8_t* block, std::uint8_t* rgba)
+	{
+		DecodeColor(block, rgba);
+		for (int i = 0; i < 16; ++i)
+			rgba[i * 4 + 3] = 255;
+	}
+
+	void DecodeBC3(const std::uint8_t* block, std::uint8_t* rgba)
+	{
+		DecodeAlpha(block, rgba);
+		DecodeColor(block + 8, rgba);
+	}
+
+	struct BitReader
+	{
+		const std::uint8_t* Block;
+		int Position = 0;
+
+		int Get(int count)
+		{
+			int value = 0;
+			for (int i = 0; i < count; ++i, ++Position)
+				value |= ((Block[Position >> 3] >> (Position & 7)) & 1) << i;
+			return value;
+		}
+	};
+
+	// Decodes a BC7 block, which must be mode 6; false if it is not.
+	bool DecodeBC7Mode6(const std::uint8_t* block, std::uint8_t* rgba)
+	{
+		BitReader reader{ block };
+		if (reader.Get(7) != 1 << 6)
+			return false;
+
+		int e[2][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			e[0][c] = reader.Get(7) << 1;
+			e[1][c] = reader.Get(7) << 1;
+		}
+		int p0 = reader.Get(1);
+		int p1 = reader.Get(1);
+		for (int c = 0; c < 4; ++c)
+		{
+			e[0][c] |= p0;
+			e[1][c] |= p1;
+		}
+
+		const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+		for (int i = 0; i < 16; ++i)
+		{
+			int index = reader.Get(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; ++c)
+				rgba[i * 4 + c] = (std::uint8_t)(((64 - weights[index]) * e[0][c] + weights[index] * e[1][c] + 32) >> 6);
+		}
+		return reader.Position == 128;
+	}
+
+	//
+	// Test blocks.
+	//
+
+	struct Random
+	{
+		std::uint32_t State;
+
+		int Next(int range)
+		{
+			State = State * 1664525u + 1013904223u;
+			return (int)((State >> 8) % (std::uint32_t)range);
+		}
+	};
+
+	// A smooth gradient between two random colors plus a little noise, like
+	// most blocks of a photographic texture.
+	void GradientBlock(Random& random, std::uint8_t* rgba)
+	{
+		int from[4];
+		int to[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			from[c] = random.Next(256);
+			to[c] = random.Next(256);
+		}
+		int dx = random.Next(4);
+		int dy = random.Next(4);
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = ((i % 4) * dx + (i / 4) * dy) / 18.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				int v = (int)(from[c] + (to[c] - from[c]) * t) + random.Next(9) - 4;
+				rgba[i * 4 + c] = (std::uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+			}
+		}
+	}
+
+	double SquaredError(const std::uint8_t* a, const std::uint8_t* b, int firstChannel, int channels)
+	{
+		double total = 0.0;
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = firstChannel; c < firstChannel + channels; ++c)
+			{
+				double d = (double)a[i * 4 + c] - b[i * 4 + c];
+				total += d * d;
+			}
+		}
+		return total;
+	}
+
+	int MaxError(const std::uint8_t* a, const std::uint8_t* b, int firstChannel, int channels)
+	{
+		int largest = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = firstChannel; c < firstChannel + channels; ++c)
+				largest = (std::max)(largest, std::abs(a[i * 4 + c] - b[i * 4 + c]));
+		}
+		return largest;
+	}
+
+	// What the ramps below may be off by.  Fast pulls the endpoints in by a
+	// sixteenth of the 0-255 range on purpose; the other presets fit the
+	// ends, leaving the endpoint and palette rounding.
+	int MaxRampError(BCQuality quality, int rounding)
+	{
+		return quality == BCQuality::Fast ? 16 + rounding : rounding;
+	}
+
+	const BCQuality Qualities[3] = { BCQuality::Fast, BCQuality::Normal, BCQuality::High };
+
+	//
+	// Tests.
+	//
+
+	// Four color mode needs C0 > C1 (or equal endpoints with every index 0),
+	// whichever way round the encoder found them.  A gradient each way
+	// exercises both orders.
+	void TestColorEndpointOrder()
+	{
+		for (int direction = 0; direction < 2; ++direction)
+		{
+			// Four grays, one per column, which the four colors can match.
+			std::uint8_t rgba[64];
+			for (int i = 0; i < 16; ++i)
+			{
+				int v = direction == 0 ? (i % 4) * 80 : 240 - (i % 4) * 80;
+				rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = (std::uint8_t)v;
+				rgba[i * 4 + 3] = 255;
+			}
+
+			for (BCQuality quality : Qualities)
+			{
+				std::uint8_t block[8];
+				EncodeBC1Block(rgba, block, quality);
+				std::uint16_t c0 = (std::uint16_t)(block[0] | (block[1] << 8));
+				std::uint16_t c1 = (std::uint16_t)(block[2] | (block[3] << 8));
+				CHECK(c0 > c1);
+
+				// Decoded as four colors, the ramp keeps its direction.
+				std::uint8_t decoded[64];
+				DecodeBC1(block, decoded);
+				CHECK(direction == 0 ? decoded[0] < decoded[12] : decoded[0] > decoded[12]);
+				CHECK(MaxError(rgba, decoded, 0, 3) <= MaxRampError(quality, 4));
+			}
+		}
+
+		// A flat block's endpoints may quantize equal; then every index must
+		// be 0, as index 1 would be too and 2 and 3 would be three color mode
+		// entries.
+		std::uint8_t flat[64];
+		for (int i = 0; i < 16; ++i)
+		{
+			flat[i * 4 + 0] = 200;
+			flat[i * 4 + 1] = 100;
+			flat[i * 4 + 2] = 50;
+			flat[i * 4 + 3] = 255;
+		}
+		for (BCQuality quality : Qualities)
+		{
+			std::uint8_t block[8];
+			EncodeBC1Block(flat, block, quality);
+			std::uint16_t c0 = (std::uint16_t)(block[0] | (block[1] << 8));
+			std::uint16_t c1 = (std::uint16_t)(block[2] | (block[3] << 8));
+			CHECK(c0 >= c1);
+			if (c0 == c1)
+				CHECK(block[4] == 0 && block[5] == 0 && block[6] == 0 && block[7] == 0);
+
+			std::uint8_t decoded[64];
+			DecodeBC1(block, decoded);
+			CHECK(SquaredError(flat, decoded, 0, 3) / 48.0 < 4.0 * 4.0);
+		}
+
+		// Random blocks never leave three color mode behind.
+		Random random{ 7 };
+		for (int b = 0; b < 200; ++b)
+		{
+			std::uint8_t rgba[64];
+			GradientBlock(random, rgba);
+			std::uint8_t block[8];
+			EncodeBC1Block(rgba, block, Qualities[b % 3]);
+			std::uint16_t c0 = (std::uint16_t)(block[0] | (block[1] << 8));
+			std::uint16_t c1 = (std::uint16_t)(block[2] | (block[3] << 8));
+			CHECK(c0 > c1 || (c0 == c1 && block[4] == 0 && block[5] == 0 && block[6] == 0 && block[7] == 0));
+		}
+	}
+
+	// Alpha that is mostly 0 and 255 with a few values between suits the six
+	// value mode, which has both extremes exactly; a smooth ramp suits the
+	// eight value mode.
+	void TestAlphaModes()
+	{
+		std::uint8_t cutout[64] = {};
+		const std::uint8_t alphas[16] = { 0, 0, 0, 255, 0, 0, 255, 255, 0, 100, 255, 255, 120, 255, 255, 255 };
+		for (int i = 0; i < 16; ++i)
+			cutout[i * 4 + 3] = alphas[i];
+
+		for (BCQuality quality : { BCQuality::Normal, BCQuality::High })
+		{
+			std::uint8_t block[16];
+			EncodeBC3Block(cutout, block, quality);
+			CHECK(block[0] <= block[1]);
+
+			std::uint8_t decoded[64];
+			DecodeBC3(block, decoded);
+			for (int i = 0; i < 16; ++i)
+			{
+				if (alphas[i] == 0 || alphas[i] == 255)
+					CHECK(decoded[i * 4 + 3] == alphas[i]);
+				else
+					CHECK_NEAR(decoded[i * 4 + 3], alphas[i], 3);
+			}
+		}
+
+		std::uint8_t ramp[64] = {};
+		for (int i = 0; i < 16; ++i)
+			ramp[i * 4 + 3] = (std::uint8_t)(40 + i * 10);
+
+		for (BCQuality quality : Qualities)
+		{
+			std::uint8_t block[16];
+			EncodeBC3Block(ramp, block, quality);
+			CHECK(block[0] > block[1]);
+
+			std::uint8_t decoded[64];
+			DecodeBC3(block, decoded);
+			for (int i = 0; i < 16; ++i)
+				CHECK_NEAR(decoded[i * 4 + 3], ramp[i * 4 + 3], 12);
+		}
+
+		// One alpha throughout needs neither: both endpoints are it.
+		std::uint8_t constant[64] = {};
+		for (int i = 0; i < 16; ++i)
+			constant[i * 4 + 3] = 77;
+		std::uint8_t block[16];
+		EncodeBC3Block(constant, block, BCQuality::High);
+		std::uint8_t decoded[64];
+		DecodeBC3(block, decoded);
+		for (int i = 0; i < 16; ++i)
+			CHECK(decoded[i * 4 + 3] == 77);
+	}
+
+	// Mode 6 stores the first texel's index in three bits, so the encoder
+	// must swap the endpoints when that index would need the fourth.  A
+	// block whose first texel is its brightest, and one where it is the
+	// darkest, both decode back.
+	void TestBC7FirstIndex()
+	{
+		for (int direction = 0; direction < 2; ++direction)
+		{
+			std::uint8_t rgba[64];
+			for (int i = 0; i < 16; ++i)
+			{
+				int v = direction == 0 ? 255 - i * 16 : i * 16;
+				rgba[i * 4 + 0] = (std::uint8_t)v;
+				rgba[i * 4 + 1] = (std::uint8_t)(v / 2);
+				rgba[i * 4 + 2] = (std::uint8_t)(255 - v);
+				rgba[i * 4 + 3] = 255;
+			}
+
+			for (BCQuality quality : Qualities)
+			{
+				std::uint8_t block[16];
+				EncodeBC7Block(rgba, block, quality);
+				CHECK((block[0] & 0x7f) == 0x40);
+
+				std::uint8_t decoded[64];
+				CHECK(DecodeBC7Mode6(block, decoded));
+				CHECK(MaxError(rgba, decoded, 0, 4) <= MaxRampError(quality, 4));
+			}
+		}
+	}
+
+	// Each quality keeps the error of smooth blocks within a bound, and the
+	// slower presets never do worse overall.  The bounds are root mean
+	// square errors per channel, with some headroom over what the encoder
+	// achieves.
+	void TestErrorBounds()
+	{
+		const double bc1Bounds[3] = { 6.5, 6.0, 5.75 };
+		const double alphaBounds[3] = { 2.75, 2.75, 2.5 };
+		const double bc7Bounds[3] = { 3.5, 2.75, 2.75 };
+		double bc1[3] = {};
+		double alpha[3] = {};
+		double bc7[3] = {};
+
+		const int blocks = 300;
+		Random random{ 1234 };
+		for (int b = 0; b < blocks; ++b)
+		{
+			std::uint8_t rgba[64];
+			GradientBlock(random, rgba);
+			for (int q = 0; q < 3; ++q)
+			{
+				std::uint8_t block[16];
+				std::uint8_t decoded[64];
+
+				EncodeBC1Block(rgba, block, Qualities[q]);
+				DecodeBC1(block, decoded);
+				bc1[q] += SquaredError(rgba, decoded, 0, 3);
+
+				// BC3's second half is the BC1 block of the same texels.
+				std::uint8_t color[8];
+				std::memcpy(color, block, sizeof(color));
+				EncodeBC3Block(rgba, block, Qualities[q]);
+				CHECK(std::memcmp(block + 8, color, sizeof(color)) == 0);
+				DecodeBC3(block, decoded);
+				alpha[q] += SquaredError(rgba, decoded, 3, 1);
+
+				EncodeBC7Block(rgba, block, Qualities[q]);
+				CHECK(DecodeBC7Mode6(block, decoded));
+				bc7[q] += SquaredError(rgba, decoded, 0, 4);
+			}
+		}
+
+		for (int q = 0; q < 3; ++q)
+		{
+			bc1[q] = std::sqrt(bc1[q] / (blocks * 48.0));
+			alpha[q] = std::sqrt(alpha[q] / (blocks * 16.0));
+			bc7[q] = std::sqrt(bc7[q] / (blocks * 64.0));
+			CHECK(bc1[q] < bc1Bounds[q]);
+			CHECK(alpha[q] < alphaBounds[q]);
+			CHECK(bc7[q] < bc7Bounds[q]);
+			if (q > 0)
+			{
+				CHECK(bc1[q] <= bc1[q - 1]);
+				CHECK(alpha[q] <= alpha[q - 1]);
+				CHECK(bc7[q] <= bc7[q - 1]);
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestColorEndpointOrder();
+	TestAlphaModes();
+	TestBC7FirstIndex();
+	TestErrorBounds();
+	return TestResult("BCnEncoderTest");
+}
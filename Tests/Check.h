@@ -0,0 +1,39 @@
+#pragma once
+
+// The checks the device-free tests share.  A failed CHECK prints where it
+// failed and the test carries on, so one run shows every failure;
+// TestResult gives main its exit code.
+
+#include <cmath>
+#include <cstdio>
+
+namespace TestCheck
+{
+	inline int& Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			++TestCheck::Failures(); \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(a, b, tolerance) CHECK(std::fabs((double)(a) - (double)(b)) <= (tolerance))
+
+inline int TestResult(const char* name)
+{
+	int failures = TestCheck::Failures();
+	if (failures == 0)
+		std::printf("%s: passed\n", name);
+	else
+		std::printf("%s: %d checks FAILED\n", name, failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+#include "../Source/DDSFile.h"
+#include "../Source/TextureResidency.h"
+#include "Check.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// Where ParseDDS finds the fields the tests tamper with.
+	const std::size_t HeaderEnd = 4 + 124;
+	const std::size_t WidthOffset = 16;
+	const std::size_t HeightOffset = 12;
+	const std::size_t DX10ArraySizeOffset = HeaderEnd + 12;
+
+	DDSImage Describe(std::uint32_t width, std::uint32_t height, std::uint32_t mipCount,
+		std::uint32_t arraySize, std::uint32_t format, bool cube)
+	{
+		DDSImage image;
+		image.Width = width;
+		image.Height = height;
+		image.MipCount = mipCount;
+		image.ArraySize = arraySize;
+		image.Format = format;
+		image.IsCubeMap = cube;
+		return image;
+	}
+
+	// A whole file for image: its header(s), then every mip filled with the
+	// index of the subresource it belongs to.
+	std::vector<std::uint8_t> MakeFile(const DDSImage& image)
+	{
+		std::vector<std::uint8_t> file;
+		WriteDDSHeader(image, file);
+
+		std::uint32_t blockBytes = 0, blockSize = 1;
+		DDSFormatInfo(image.Format, blockBytes, blockSize);
+		for (std::uint32_t slice = 0; slice < image.ArraySize; ++slice)
+		{
+			std::uint32_t width = image.Width, height = image.Height;
+			for (std::uint32_t mip = 0; mip < image.MipCount; ++mip)
+			{
+				std::size_t bytes = (std::size_t)((width + blockSize - 1) / blockSize) * blockBytes *
+					((height + blockSize - 1) / blockSize);
+				file.insert(file.end(), bytes, (std::uint8_t)(slice * image.MipCount + mip));
+				width = width > 1 ? width >> 1 : 1;
+				height = height > 1 ? height >> 1 : 1;
+			}
+		}
+		return file;
+	}
+
+	void Poke(std::vector<std::uint8_t>& file, std::size_t offset, std::uint32_t value)
+	{
+		std::memcpy(file.data() + offset, &value, sizeof(value));
+	}
+
+	bool Parses(const std::vector<std::uint8_t>& file, std::size_t size, DDSImage& image, std::string& error)
+	{
+		error.clear();
+		return ParseDDS(file.data(), size, image, &error);
+	}
+
+	void TestRoundTrip()
+	{
+		DDSImage image;
+		std::string error;
+
+		std::vector<std::uint8_t> file = MakeFile(Describe(64, 32, 7, 1, DDSFormat::BC1Unorm, false));
+		CHECK(Parses(file, file.size(), image, error));
+		CHECK(image.Width == 64 && image.Height == 32);
+		CHECK(image.MipCount == 7 && image.ArraySize == 1 && !image.IsCubeMap);
+		CHECK(image.Format == DDSFormat::BC1Unorm);
+		CHECK(image.Mips.size() == 7);
+
+		// 64x32 BC1 is 16x8 blocks of 8 bytes; below 4x4 a mip is one block.
+		CHECK(image.Mip(0, 0).RowPitch == 128 && image.Mip(0, 0).RowCount == 8);
+		CHECK(image.Mip(0, 6).Width == 1 && image.Mip(0, 6).SizeInBytes == 8);
+		CHECK(image.Mip(0, 6).Offset + image.Mip(0, 6).SizeInBytes == file.size());
+
+		// Uncompressed, non power of two, through the DX10 header.
+		file = MakeFile(Describe(5, 3, 3, 2, DDSFormat::R8G8B8A8Unorm, false));
+		CHECK(Parses(file, file.size(), image, error));
+		CHECK(image.ArraySize == 2 && image.Mips.size() == 6);
+		CHECK(image.Mip(0, 0).RowPitch == 20 && image.Mip(0, 1).Width == 2 && image.Mip(0, 2).Height == 1);
+		CHECK(file[image.Mip(1, 2).Offset] == 5);
+	}
+
+	void TestCubeMaps()
+	{
+		DDSImage image;
+		std::string error;
+
+		// BC1 cube maps take the legacy header with the cube caps.
+		std::vector<std::uint8_t> file = MakeFile(Describe(16, 16, 5, 6, DDSFormat::BC1Unorm, true));
+		CHECK(Parses(file, file.size(), image, error));
+		CHECK(image.IsCubeMap && image.ArraySize == 6 && image.Mips.size() == 30);
+		for (std::uint32_t face = 0; face < 6; ++face)
+			CHECK(file[image.Mip(face, 0).Offset] == face * 5);
+		CHECK(image.Mip(5, 4).Offset + image.Mip(5, 4).SizeInBytes == file.size());
+
+		// A cube array comes through the DX10 header as cubes, not faces.
+		file = MakeFile(Describe(8, 8, 1, 12, DDSFormat::BC7Unorm, true));
+		CHECK(Parses(file, file.size(), image, error));
+		CHECK(image.IsCubeMap && image.ArraySize == 12);
+
+		// Six times the cube count must not wrap round to a small array.
+		Poke(file, DX10ArraySizeOffset, 0x80000000u);
+		CHECK(!Parses(file, file.size(), image, error));
+		CHECK(!error.empty());
+		CHECK(image.Mips.empty());
+	}
+
+	void TestTruncated()
+	{
+		DDSImage image;
+		std::string error;
+
+		std::vector<std::uint8_t> legacy = MakeFile(Describe(16, 16, 1, 1, DDSFormat::BC3Unorm, false));
+		CHECK(!Parses(legacy, 0, image, error));
+		CHECK(!Parses(legacy, 4, image, error));
+		CHECK(!Parses(legacy, HeaderEnd - 1, image, error));
+		CHECK(error == "file is too small for a DDS header");
+		CHECK(!Parses(legacy, legacy.size() - 1, image, error));
+		CHECK(error == "file is truncated");
+		CHECK(image.Mips.empty());
+		CHECK(Parses(legacy, legacy.size(), image, error));
+
+		std::vector<std::uint8_t> dx10 = MakeFile(Describe(16, 16, 1, 3, DDSFormat::BC7Unorm, false));
+		CHECK(!Parses(dx10, HeaderEnd, image, error));
+		CHECK(error == "file is too small for a DX10 header");
+		CHECK(!Parses(dx10, HeaderEnd + 20, image, error));
+		CHECK(error == "file is truncated");
+
+		std::vector<std::uint8_t> wrong = legacy;
+		wrong[0] = 'X';
+		CHECK(!Parses(wrong, wrong.size(), image, error));
+	}
+
+	void TestHugeHeaders()
+	{
+		DDSImage image;
+		std::string error;
+
+		// An array size no file could hold fails on the size check, before
+		// anything is allocated for it.
+		std::vector<std::uint8_t> file = MakeFile(Describe(4, 4, 1, 2, DDSFormat::BC7Unorm, false));
+		Poke(file, DX10ArraySizeOffset, 0xffffffffu);
+		CHECK(!Parses(file, file.size(), image, error));
+		CHECK(error == "file is truncated");
+		CHECK(image.Mips.empty());
+
+		// Extents whose mip chain does not fit in 64 bits at all.
+		file = MakeFile(Describe(4, 4, 1, 1, DDSFormat::R32G32B32A32Float, false));
+		Poke(file, WidthOffset, 0xffffffffu);
+		Poke(file, HeightOffset, 0xffffffffu);
+		CHECK(!Parses(file, file.size(), image, error));
+		CHECK(!error.empty());
+		CHECK(image.Mips.empty());
+
+		// A mip chain that fits, times an array size that does not.
+		Poke(file, WidthOffset, 65536);
+		Poke(file, HeightOffset, 65536);
+		Poke(file, DX10ArraySizeOffset, 0xffffffffu);
+		CHECK(!Parses(file, file.size(), image, error));
+		CHECK(error == "texture is too large");
+	}
+
+	// Three textures of 100 + 25 + 5 bytes, tails of one mip, and room for
+	// the tails and two full textures.
+	void TestResidencyEvictsLeastRecentlyUsed()
+	{
+		TextureResidency residency(15 + 2 * 125, 1000);
+		std::vector<std::uint64_t> mips = { 100, 25, 5 };
+		std::uint32_t a = residency.AddTexture(mips, 1);
+		std::uint32_t b = residency.AddTexture(mips, 1);
+		std::uint32_t c = residency.AddTexture(mips, 1);
+
+		// One mip finer per texture per frame.
+		for (int frame = 0; frame < 2; ++frame)
+		{
+			residency.BeginFrame();
+			residency.Request(a, 0);
+			residency.Request(b, 0);
+			residency.Update();
+		}
+		CHECK(residency.ResidentTopMip(a) == 0 && residency.ResidentTopMip(b) == 0);
+		CHECK(residency.ResidentTopMip(c) == 2);
+		CHECK(residency.ResidentBytes() == residency.BudgetBytes());
+
+		// b stays in use a frame longer than a.
+		residency.BeginFrame();
+		residency.Request(b, 0);
+		CHECK(residency.Update().empty());
+
+		// c needs room: a, used least recently, goes back to its tail.
+		residency.BeginFrame();
+		residency.Request(c, 0);
+		const std::vector<TextureResidency::Change>& changes = residency.Update();
+		CHECK(residency.ResidentTopMip(a) == 2);
+		CHECK(residency.ResidentTopMip(b) == 0);
+		CHECK(residency.ResidentTopMip(c) == 1);
+		CHECK(residency.ResidentBytes() <= residency.BudgetBytes());
+		CHECK(changes.size() == 2);
+
+		// c's last mip fits exactly, so nothing more has to go.
+		residency.BeginFrame();
+		residency.Request(c, 0);
+		residency.Update();
+		CHECK(residency.ResidentTopMip(b) == 0 && residency.ResidentTopMip(c) == 0);
+		CHECK(residency.ResidentBytes() == residency.BudgetBytes());
+
+		// a coming back evicts b, now older than c.
+		residency.BeginFrame();
+		residency.Request(a, 0);
+		residency.Update();
+		CHECK(residency.ResidentTopMip(a) == 1);
+		CHECK(residency.ResidentTopMip(b) == 2);
+		CHECK(residency.ResidentTopMip(c) == 0);
+		CHECK(residency.ResidentBytes() <= residency.BudgetBytes());
+	}
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestCubeMaps();
+	TestTruncated();
+	TestHugeHeaders();
+	TestResidencyEvictsLeastRecentlyUsed();
+	return TestResult("DDSFileTest");
+}
@@ -0,0 +1,236 @@
+#include "../Source/FramePacer.h"
+#include "Check.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <thread>
+
+#include <pthread.h>
+
+namespace
+{
+	const std::int64_t Ms = 1000000;
+
+	// Simulated time: sleeping jumps the clock, and every read moves it on a
+	// little so spins end.
+	class FakeTime : public PacerTimeSource
+	{
+	public:
+		std::int64_t Now()override
+		{
+			Time += ReadCost;
+			return Time;
+		}
+
+		void Sleep(std::int64_t ns)override
+		{
+			Sleeps++;
+			SleptNs += ns;
+			Time += ns + Oversleep;
+		}
+
+		std::int64_t SpinThreshold()override
+		{
+			return Threshold;
+		}
+
+		std::int64_t Time = 1000 * Ms;
+		std::int64_t ReadCost = 1000;
+		std::int64_t Oversleep = 0;
+		std::int64_t Threshold = Ms;
+		int Sleeps = 0;
+		std::int64_t SleptNs = 0;
+	};
+
+	// The first frame is not paced: its wait comes after its present.  From
+	// the second on, presents are a period apart.
+	const int WarmUpFrames = 2;
+
+	void Frame(FramePacer& pacer, FakeTime& time, std::int64_t work)
+	{
+		pacer.BeginFrame();
+		time.Time += work;
+		pacer.EndFrame();
+	}
+
+	void TestSteadyRate()
+	{
+		FakeTime time;
+		FramePacer pacer(100.0, &time);
+		for (int i = 0; i < WarmUpFrames; ++i)
+			Frame(pacer, time, 3 * Ms);
+		pacer.ResetStats();
+		for (int i = 0; i < 50; ++i)
+			Frame(pacer, time, 3 * Ms);
+
+		FramePacingStats stats = pacer.Stats();
+		CHECK(stats.Count == 50);
+		CHECK_NEAR(stats.MeanMs, 10.0, 0.01);
+		CHECK(stats.StdDevMs < 0.01);
+
+		// Each frame sleeps most of its slack and spins the last threshold.
+		CHECK(time.Sleeps == 50 + WarmUpFrames);
+	}
+
+	void TestOversleepIsSpunOut()
+	{
+		// A sleep that overshoots by less than the spin threshold still
+		// lands on the deadline.
+		FakeTime time;
+		time.Oversleep = Ms / 2;
+		FramePacer pacer(100.0, &time);
+		for (int i = 0; i < WarmUpFrames; ++i)
+			Frame(pacer, time, 2 * Ms);
+		pacer.ResetStats();
+		for (int i = 0; i < 20; ++i)
+			Frame(pacer, time, 2 * Ms);
+		CHECK_NEAR(pacer.Stats().MaxMs, 10.0, 0.01);
+	}
+
+	void TestResyncAfterHitch()
+	{
+		FakeTime time;
+		FramePacer pacer(100.0, &time);
+		for (int i = 0; i < 5; ++i)
+			Frame(pacer, time, 2 * Ms);
+
+		// A frame that runs two periods over is not followed by a burst of
+		// short frames catching up.
+		Frame(pacer, time, 30 * Ms);
+		pacer.ResetStats();
+		for (int i = 0; i < 5; ++i)
+			Frame(pacer, time, 2 * Ms);
+		FramePacingStats stats = pacer.Stats();
+		CHECK(stats.MinMs > 9.9);
+	}
+
+	void TestResetStatsKeepsIntervalInFlight()
+	{
+		FakeTime time;
+		FramePacer pacer(100.0, &time);
+		for (int i = 0; i < 10; ++i)
+			Frame(pacer, time, 2 * Ms);
+
+		pacer.ResetStats();
+		CHECK(pacer.Stats().Count == 0);
+
+		Frame(pacer, time, 2 * Ms);
+		FramePacingStats stats = pacer.Stats();
+		CHECK(stats.Count == 1);
+		CHECK_NEAR(stats.MeanMs, 10.0, 0.01);
+	}
+
+	void TestSkipFrameDropsInterval()
+	{
+		FakeTime time;
+		FramePacer pacer(100.0, &time);
+		Frame(pacer, time, 2 * Ms);
+		Frame(pacer, time, 2 * Ms);
+
+		pacer.BeginFrame();
+		pacer.SkipFrame();
+		time.Time += 500 * Ms;
+		pacer.ResetStats();
+
+		Frame(pacer, time, 2 * Ms);
+		CHECK(pacer.Stats().Count == 0);
+
+		// Pacing starts over: the next interval is a fresh first frame's.
+		Frame(pacer, time, 2 * Ms);
+		FramePacingStats stats = pacer.Stats();
+		CHECK(stats.Count == 1);
+		CHECK(stats.MaxMs < 12.1);
+	}
+
+	void TestLowLatencyWaitsBeforeTheFrame()
+	{
+		FakeTime time;
+		FramePacer pacer(100.0, &time);
+		pacer.SetLowLatency(true);
+		for (int i = 0; i < 30; ++i)
+			Frame(pacer, time, 4 * Ms);
+
+		// The wait moves in front of the frame, which then ends about on the
+		// deadline: the period holds, and the 4 ms of work plus its 10%
+		// margin come out of the wait.
+		FramePacingStats stats = pacer.Stats();
+		CHECK_NEAR(stats.MeanMs, 10.0, 0.05);
+
+		std::int64_t before = time.Time;
+		pacer.BeginFrame();
+		std::int64_t waited = time.Time - before;
+		CHECK(waited > 5 * Ms && waited < 6 * Ms);
+	}
+
+	void TestUnlimitedDoesNotWait()
+	{
+		FakeTime time;
+		FramePacer pacer(0.0, &time);
+		for (int i = 0; i < 10; ++i)
+			Frame(pacer, time, 3 * Ms);
+		CHECK(time.Sleeps == 0);
+		CHECK_NEAR(pacer.Stats().MeanMs, 3.0, 0.01);
+	}
+
+	void OnSignal(int)
+	{
+	}
+
+	void TestSleepResumesAfterSignal()
+	{
+		// Signals during PacerClock::Sleep must not cut it short.
+		struct sigaction action;
+		std::memset(&action, 0, sizeof(action));
+		action.sa_handler = OnSignal;
+		sigaction(SIGUSR1, &action, nullptr);
+
+		pthread_t sleeper = pthread_self();
+		std::thread interrupter([sleeper]()
+		{
+			for (int i = 0; i < 5; ++i)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				pthread_kill(sleeper, SIGUSR1);
+			}
+		});
+
+		std::int64_t start = PacerClock::Now();
+		PacerClock::Sleep(60 * Ms);
+		std::int64_t slept = PacerClock::Now() - start;
+		interrupter.join();
+
+		CHECK(slept >= 60 * Ms);
+	}
+
+	void TestSystemClock()
+	{
+		FramePacer pacer(200.0);
+		for (int i = 0; i < 10; ++i)
+		{
+			pacer.BeginFrame();
+			pacer.EndFrame();
+		}
+
+		// No present comes before its deadline.  A late one (the scheduler
+		// decides that) is followed by a short catch-up interval, so only
+		// the mean is held to the period.
+		FramePacingStats stats = pacer.Stats();
+		CHECK(stats.Count == 9);
+		CHECK(stats.MeanMs >= 4.99);
+	}
+}
+
+int main()
+{
+	TestSteadyRate();
+	TestOversleepIsSpunOut();
+	TestResyncAfterHitch();
+	TestResetStatsKeepsIntervalInFlight();
+	TestSkipFrameDropsInterval();
+	TestLowLatencyWaitsBeforeTheFrame();
+	TestUnlimitedDoesNotWait();
+	TestSleepResumesAfterSignal();
+	TestSystemClock();
+	return TestResult("FramePacerTest");
+}
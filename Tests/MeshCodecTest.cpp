@@ -0,0 +1,286 @@
+#include "../Source/MeshCodec.h"
+#include "Check.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Mesh
+	{
+		std::vector<MeshCodecVertex> Vertices;
+		std::vector<std::uint32_t> Indices;
+		std::vector<MeshCodecSubmesh> Submeshes;
+
+		std::vector<std::uint16_t> Indices16()const
+		{
+			return std::vector<std::uint16_t>(Indices.begin(), Indices.end());
+		}
+	};
+
+	std::uint32_t PackHalves(float a, float b)
+	{
+		return (std::uint32_t)std::lround((a * 0.5f + 0.5f) * 65535.0f) |
+			((std::uint32_t)std::lround((b * 0.5f + 0.5f) * 65535.0f) << 16);
+	}
+
+	void CloseSubmesh(Mesh& mesh, MeshCodecSubmesh& submesh)
+	{
+		submesh.VertexCount = (std::uint32_t)mesh.Vertices.size() - submesh.FirstVertex;
+		submesh.IndexCount = (std::uint32_t)mesh.Indices.size() - submesh.FirstIndex;
+
+		float mins[3] = { 1e30f, 1e30f, 1e30f }, maxs[3] = { -1e30f, -1e30f, -1e30f };
+		for (std::uint32_t v = submesh.FirstVertex; v < submesh.FirstVertex + submesh.VertexCount; ++v)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				mins[a] = std::fmin(mins[a], mesh.Vertices[v].Pos[a]);
+				maxs[a] = std::fmax(maxs[a], mesh.Vertices[v].Pos[a]);
+			}
+		}
+		for (int a = 0; a < 3; ++a)
+		{
+			submesh.BoundsCenter[a] = 0.5f * (mins[a] + maxs[a]);
+			submesh.BoundsExtents[a] = 0.5f * (maxs[a] - mins[a]);
+		}
+		mesh.Submeshes.push_back(submesh);
+	}
+
+	// A flat m x n grid, one normal and one color throughout, indices
+	// relative to its first vertex like the app's submeshes.
+	void AddGrid(Mesh& mesh, std::uint32_t m, std::uint32_t n, float width, float depth)
+	{
+		MeshCodecSubmesh submesh;
+		submesh.FirstVertex = (std::uint32_t)mesh.Vertices.size();
+		submesh.FirstIndex = (std::uint32_t)mesh.Indices.size();
+
+		for (std::uint32_t i = 0; i < m; ++i)
+		{
+			for (std::uint32_t j = 0; j < n; ++j)
+			{
+				MeshCodecVertex v = { { -0.5f * width + j * width / (n - 1), 0.0f, 0.5f * depth - i * depth / (m - 1) },
+					{ 0.2f, 0.6f, 0.2f, 1.0f }, PackHalves(0.0f, 1.0f), PackHalves(1.0f, 0.0f) };
+				mesh.Vertices.push_back(v);
+			}
+		}
+		for (std::uint32_t i = 0; i + 1 < m; ++i)
+		{
+			for (std::uint32_t j = 0; j + 1 < n; ++j)
+			{
+				std::uint32_t a = i * n + j, b = a + 1, c = a + n, d = c + 1;
+				mesh.Indices.insert(mesh.Indices.end(), { a, b, c, c, b, d });
+			}
+		}
+		CloseSubmesh(mesh, submesh);
+	}
+
+	// A UV sphere: every vertex has its own normal and tangent.
+	void AddSphere(Mesh& mesh, std::uint32_t stacks, std::uint32_t slices, float radius)
+	{
+		MeshCodecSubmesh submesh;
+		submesh.FirstVertex = (std::uint32_t)mesh.Vertices.size();
+		submesh.FirstIndex = (std::uint32_t)mesh.Indices.size();
+
+		for (std::uint32_t i = 0; i <= stacks; ++i)
+		{
+			for (std::uint32_t j = 0; j <= slices; ++j)
+			{
+				float phi = 3.14159265f * i / stacks, theta = 6.28318531f * j / slices;
+				float nx = std::sin(phi) * std::cos(theta), ny = std::cos(phi), nz = std::sin(phi) * std::sin(theta);
+				MeshCodecVertex v = { { radius * nx, radius * ny, radius * nz }, { 0.8f, 0.3f, 0.3f, 1.0f },
+					PackHalves(nx, nz), PackHalves(-std::sin(theta), std::cos(theta)) };
+				mesh.Vertices.push_back(v);
+			}
+		}
+		for (std::uint32_t i = 0; i < stacks; ++i)
+		{
+			for (std::uint32_t j = 0; j < slices; ++j)
+			{
+				std::uint32_t a = i * (slices + 1) + j, b = a + 1, c = a + slices + 1, d = c + 1;
+				mesh.Indices.insert(mesh.Indices.end(), { a, b, c, c, b, d });
+			}
+		}
+		CloseSubmesh(mesh, submesh);
+	}
+
+	Mesh Shapes()
+	{
+		Mesh mesh;
+		AddGrid(mesh, 20, 30, 20.0f, 30.0f);
+		AddSphere(mesh, 16, 16, 0.5f);
+		AddGrid(mesh, 2, 5, 1.0f, 1.0f);
+		AddSphere(mesh, 12, 20, 3.0f);
+		return mesh;
+	}
+
+	// Positions, colors and frames that follow no pattern, and triangles
+	// that share no edges.
+	Mesh Noise(std::uint32_t vertexCount, std::uint32_t indexCount, std::uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f), color(-0.2f, 1.2f);
+
+		Mesh mesh;
+		mesh.Vertices.resize(vertexCount);
+		for (MeshCodecVertex& v : mesh.Vertices)
+		{
+			for (float& p : v.Pos)
+				p = position(rng);
+			for (float& c : v.Color)
+				c = color(rng);
+			v.Normal = rng();
+			v.Tangent = rng();
+		}
+		mesh.Indices.resize(indexCount);
+		for (std::uint32_t& index : mesh.Indices)
+			index = rng() % vertexCount;
+		return mesh;
+	}
+
+	MeshCodecBenchResult RoundTrip(const Mesh& mesh, bool indices16)
+	{
+		std::vector<std::uint16_t> indices16Data = mesh.Indices16();
+		const void* indices = indices16 ? (const void*)indices16Data.data() : (const void*)mesh.Indices.data();
+		return RunMeshCodecBenchmark(mesh.Vertices.data(), (std::uint32_t)mesh.Vertices.size(), indices,
+			(std::uint32_t)mesh.Indices.size(), indices16, mesh.Submeshes, 2);
+	}
+
+	void TestShapes()
+	{
+		Mesh mesh = Shapes();
+		MeshCodecBenchResult result = RoundTrip(mesh, true);
+		CHECK(result.Passed);
+		CHECK(result.IndicesMatch && result.FramesMatch);
+		CHECK(result.MaxPositionError <= result.MaxPositionErrorBound);
+		CHECK(result.Ratio > 4.0);
+
+		// The same mesh with 32-bit indices round trips too.
+		CHECK(RoundTrip(mesh, false).Passed);
+	}
+
+	void TestNoise()
+	{
+		Mesh mesh = Noise(3000, 9000, 1);
+		MeshCodecBenchResult result = RoundTrip(mesh, false);
+		CHECK(result.Passed);
+		CHECK(result.Ratio > 1.0);
+
+		// Vertices of no submesh use the bounds of all of them, and a cache
+		// reset that does not start a triangle is ignored.
+		mesh.Indices.resize(8999);
+		mesh.Submeshes.resize(2);
+		mesh.Submeshes[1].FirstIndex = 2001;
+		mesh.Submeshes[1].FirstVertex = 100;
+		mesh.Submeshes[1].VertexCount = 50;
+		CHECK(RoundTrip(mesh, false).Passed);
+	}
+
+	void TestFrameMasks()
+	{
+		// Each half changes on its own schedule, so every mask turns up.
+		Mesh mesh;
+		MeshCodecSubmesh submesh;
+		for (std::uint32_t v = 0; v < 64; ++v)
+		{
+			MeshCodecVertex vertex = { { (float)v, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f },
+				((v / 2) & 0xFFFF) | (((v / 3) & 0xFFFF) << 16), ((v / 5) & 0xFFFF) | (((v / 7) * 1000 & 0xFFFF) << 16) };
+			mesh.Vertices.push_back(vertex);
+		}
+		for (std::uint32_t t = 0; t + 2 < 64; ++t)
+			mesh.Indices.insert(mesh.Indices.end(), { t, t + 1, t + 2 });
+		CloseSubmesh(mesh, submesh);
+
+		MeshCodecBenchResult result = RoundTrip(mesh, true);
+		CHECK(result.Passed);
+		CHECK(result.FramesMatch);
+	}
+
+	void TestEmpty()
+	{
+		std::vector<std::uint8_t> encoded = EncodeMesh(nullptr, 0, nullptr, 0, true, {});
+		MeshCodecInfo info;
+		CHECK(ReadMeshInfo(encoded.data(), encoded.size(), info));
+		CHECK(info.VertexCount == 0 && info.IndexCount == 0 && info.Indices16);
+		CHECK(DecodeMesh(encoded.data(), encoded.size(), nullptr, nullptr));
+	}
+
+	void TestHeader()
+	{
+		Mesh mesh = Shapes();
+		std::vector<std::uint16_t> indices = mesh.Indices16();
+		std::vector<std::uint8_t> encoded = EncodeMesh(mesh.Vertices.data(), (std::uint32_t)mesh.Vertices.size(),
+			indices.data(), (std::uint32_t)indices.size(), true, mesh.Submeshes);
+
+		MeshCodecInfo info;
+		CHECK(ReadMeshInfo(encoded.data(), encoded.size(), info));
+		CHECK(info.VertexCount == mesh.Vertices.size() && info.IndexCount == indices.size() && info.Indices16);
+		CHECK(!ReadMeshInfo(encoded.data(), 19, info));
+
+		// Another magic number or format version is not read as this one.
+		for (std::size_t byte : { 0, 4 })
+		{
+			std::vector<std::uint8_t> other = encoded;
+			other[byte] ^= 1;
+			std::string error;
+			CHECK(!ReadMeshInfo(other.data(), other.size(), info));
+			CHECK(!DecodeMesh(other.data(), other.size(), nullptr, nullptr, &error));
+			CHECK(error == "not an encoded mesh");
+		}
+	}
+
+	// Flipped bytes and cut off files, decoded into buffers of exactly the
+	// size the header asks for: the decoder may fail or produce garbage,
+	// but must stay inside the input and the buffers (the sanitizers watch
+	// that) and must fail on every truncation.
+	void TestCorruption()
+	{
+		std::mt19937 rng(7);
+		for (int source = 0; source < 2; ++source)
+		{
+			Mesh mesh = source == 0 ? Shapes() : Noise(500, 1500, 3);
+			bool indices16 = source == 0;
+			std::vector<std::uint16_t> indices16Data = mesh.Indices16();
+			const void* indices = indices16 ? (const void*)indices16Data.data() : (const void*)mesh.Indices.data();
+			std::vector<std::uint8_t> encoded = EncodeMesh(mesh.Vertices.data(), (std::uint32_t)mesh.Vertices.size(),
+				indices, (std::uint32_t)mesh.Indices.size(), indices16, mesh.Submeshes);
+
+			int truncationsAccepted = 0;
+			for (int trial = 0; trial < 1500; ++trial)
+			{
+				std::vector<std::uint8_t> damaged = encoded;
+				bool truncated = trial % 3 == 0;
+				if (truncated)
+					damaged.resize(rng() % damaged.size());
+				else
+					damaged[20 + rng() % (damaged.size() - 20)] ^= (std::uint8_t)(1 + rng() % 255);
+
+				MeshCodecInfo info;
+				if (!ReadMeshInfo(damaged.data(), damaged.size(), info))
+					continue;
+
+				std::vector<MeshCodecVertex> vertices(info.VertexCount);
+				std::vector<std::uint8_t> out((std::size_t)info.IndexCount * (info.Indices16 ? 2 : 4));
+				std::string error;
+				bool decoded = DecodeMesh(damaged.data(), damaged.size(), vertices.data(), out.data(), &error);
+				CHECK(decoded || !error.empty());
+				if (truncated && decoded)
+					truncationsAccepted++;
+			}
+			CHECK(truncationsAccepted == 0);
+		}
+	}
+}
+
+int main()
+{
+	TestShapes();
+	TestNoise();
+	TestFrameMasks();
+	TestEmpty();
+	TestHeader();
+	TestCorruption();
+	return TestResult("MeshCodecTest");
+}
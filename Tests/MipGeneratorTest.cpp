@@ -0,0 +1,217 @@
+#include "../Source/MipGenerator.h"
+#include "../Source/ThreadPool.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+	const std::uint8_t* Texel(const MipChain& chain, std::uint32_t mip, std::uint32_t x, std::uint32_t y)
+	{
+		const MipChainLevel& level = chain.Levels[mip];
+		return chain.Data.data() + level.Offset + (std::size_t)y * level.RowPitch + x * 4;
+	}
+
+	std::vector<std::uint8_t> Constant(std::uint32_t width, std::uint32_t height, const std::uint8_t* rgba)
+	{
+		std::vector<std::uint8_t> image((std::size_t)width * height * 4);
+		for (std::size_t i = 0; i < image.size(); ++i)
+			image[i] = rgba[i % 4];
+		return image;
+	}
+
+	bool IsConstant(const MipChain& chain, const std::uint8_t* rgba)
+	{
+		for (std::uint32_t mip = 0; mip < chain.Levels.size(); ++mip)
+		{
+			for (std::uint32_t y = 0; y < chain.Levels[mip].Height; ++y)
+			{
+				for (std::uint32_t x = 0; x < chain.Levels[mip].Width; ++x)
+				{
+					const std::uint8_t* texel = Texel(chain, mip, x, y);
+					if (texel[0] != rgba[0] || texel[1] != rgba[1] || texel[2] != rgba[2] || texel[3] != rgba[3])
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Every level starts on a 512 byte boundary with 256 byte aligned rows
+	// wide enough for its texels, after the end of the level above; the
+	// chain's size is a multiple of 512 that holds the last level.
+	void TestLayout()
+	{
+		ThreadPool pool(2);
+		const std::uint32_t sizes[][2] = { { 1, 1 }, { 3, 1 }, { 64, 64 }, { 65, 17 }, { 100, 300 }, { 1, 1000 } };
+		for (auto& size : sizes)
+		{
+			std::uint32_t width = size[0];
+			std::uint32_t height = size[1];
+			const std::uint8_t gray[4] = { 128, 128, 128, 255 };
+			std::vector<std::uint8_t> image = Constant(width, height, gray);
+
+			MipChain chain;
+			GenerateMipChain(image.data(), width, height, width * 4, false, MipFilter::Box, pool, chain);
+			CHECK(chain.Levels.size() == FullMipCount(width, height));
+			CHECK(chain.Levels.back().Width == 1 && chain.Levels.back().Height == 1);
+
+			std::uint64_t end = 0;
+			for (std::uint32_t mip = 0; mip < chain.Levels.size(); ++mip)
+			{
+				const MipChainLevel& level = chain.Levels[mip];
+				CHECK(level.Width == (std::max)(width >> mip, 1u));
+				CHECK(level.Height == (std::max)(height >> mip, 1u));
+				CHECK(level.RowPitch % 256 == 0);
+				CHECK(level.RowPitch >= level.Width * 4 && level.RowPitch < level.Width * 4 + 256);
+				CHECK(level.Offset % 512 == 0);
+				CHECK(level.Offset >= end && level.Offset < end + 512);
+				end = level.Offset + (std::uint64_t)(level.Height - 1) * level.RowPitch + level.Width * 4;
+			}
+			CHECK(chain.Data.size() % 512 == 0);
+			CHECK(chain.Data.size() >= end && chain.Data.size() < end + 512);
+		}
+
+		// A partial chain stops where asked, and the count is clamped to a
+		// full one.
+		const std::uint8_t gray[4] = { 1, 2, 3, 4 };
+		std::vector<std::uint8_t> image = Constant(16, 8, gray);
+		MipChain chain;
+		GenerateMipChain(image.data(), 16, 8, 16 * 4, false, MipFilter::Box, pool, chain, 2);
+		CHECK(chain.Levels.size() == 2);
+		GenerateMipChain(image.data(), 16, 8, 16 * 4, false, MipFilter::Box, pool, chain, 99);
+		CHECK(chain.Levels.size() == 5);
+	}
+
+	// Level 0 is the image, whatever its row pitch.
+	void TestTopLevelCopied()
+	{
+		ThreadPool pool(2);
+		const std::uint32_t width = 5;
+		const std::uint32_t height = 3;
+		const std::size_t rowPitch = 32;
+		std::vector<std::uint8_t> image(rowPitch * height, 0xcd);
+		for (std::uint32_t y = 0; y < height; ++y)
+		{
+			for (std::uint32_t i = 0; i < width * 4; ++i)
+				image[y * rowPitch + i] = (std::uint8_t)(y * 31 + i * 7);
+		}
+
+		MipChain chain;
+		GenerateMipChain(image.data(), width, height, rowPitch, true, MipFilter::Kaiser, pool, chain);
+		for (std::uint32_t y = 0; y < height; ++y)
+		{
+			for (std::uint32_t i = 0; i < width * 4; ++i)
+				CHECK(Texel(chain, 0, 0, y)[i] == image[y * rowPitch + i]);
+		}
+	}
+
+	// Box weights sum to 1 on odd sides too, so a flat image stays flat,
+	// and each old texel counts the same: the total over a level shrinks
+	// by exactly the ratio of the sizes.
+	void TestOddBoxWeights()
+	{
+		ThreadPool pool(2);
+		const std::uint8_t color[4] = { 200, 17, 99, 255 };
+		for (std::uint32_t width : { 3u, 5u, 7u, 33u })
+		{
+			std::vector<std::uint8_t> image = Constant(width, 9, color);
+			MipChain chain;
+			GenerateMipChain(image.data(), width, 9, width * 4, false, MipFilter::Box, pool, chain);
+			CHECK(IsConstant(chain, color));
+			GenerateMipChain(image.data(), width, 9, width * 4, true, MipFilter::Box, pool, chain);
+			CHECK(IsConstant(chain, color));
+		}
+
+		// One row of 2n+1 texels going down to n, where each new texel is
+		// within half a code of its exact value.
+		const std::uint32_t width = 15;
+		const std::uint32_t n = width / 2;
+		std::vector<std::uint8_t> row(width * 4);
+		double total = 0.0;
+		for (std::uint32_t x = 0; x < width; ++x)
+		{
+			for (int c = 0; c < 4; ++c)
+				row[x * 4 + c] = (std::uint8_t)((x * 37 + c * 50) % 256);
+			total += row[x * 4];
+		}
+
+		MipChain chain;
+		GenerateMipChain(row.data(), width, 1, width * 4, false, MipFilter::Box, pool, chain, 2);
+		double halved = 0.0;
+		for (std::uint32_t x = 0; x < n; ++x)
+			halved += Texel(chain, 1, x, 0)[0];
+		CHECK_NEAR(halved, total * n / width, 0.5 * n);
+	}
+
+	// An sRGB level of four equal texels averages their linear values and
+	// encodes the result again, which must give back the same code for
+	// all 256 of them; alpha is linear and comes back too.
+	void TestSRGBRoundTrip()
+	{
+		ThreadPool pool(2);
+		const std::uint32_t width = 512;
+		std::vector<std::uint8_t> image(width * 2 * 4);
+		for (std::uint32_t y = 0; y < 2; ++y)
+		{
+			for (std::uint32_t x = 0; x < width; ++x)
+			{
+				std::uint8_t* texel = &image[(y * width + x) * 4];
+				texel[0] = texel[1] = texel[2] = texel[3] = (std::uint8_t)(x / 2);
+			}
+		}
+
+		MipChain chain;
+		GenerateMipChain(image.data(), width, 2, width * 4, true, MipFilter::Box, pool, chain, 2);
+		for (std::uint32_t x = 0; x < 256; ++x)
+		{
+			const std::uint8_t* texel = Texel(chain, 1, x, 0);
+			CHECK(texel[0] == x && texel[1] == x && texel[2] == x && texel[3] == x);
+		}
+
+		// Averaging black and white in linear light gives the sRGB code of a
+		// half, 188, not the 128 a filter on the codes would.
+		std::vector<std::uint8_t> checker(2 * 2 * 4, 0);
+		for (int i : { 0, 3 })
+		{
+			for (int c = 0; c < 4; ++c)
+				checker[i * 4 + c] = 255;
+		}
+		GenerateMipChain(checker.data(), 2, 2, 2 * 4, true, MipFilter::Box, pool, chain);
+		CHECK(Texel(chain, 1, 0, 0)[0] == 188);
+		CHECK(Texel(chain, 1, 0, 0)[3] == 128);
+	}
+
+	// The Kaiser weights are normalized, edges included, so a flat image
+	// stays flat at every level, odd sizes and sRGB included.
+	void TestKaiserKeepsConstant()
+	{
+		ThreadPool pool(2);
+		const std::uint8_t colors[][4] = { { 0, 0, 0, 0 }, { 255, 255, 255, 255 }, { 12, 130, 250, 77 } };
+		const std::uint32_t sizes[][2] = { { 64, 64 }, { 13, 9 }, { 1, 20 }, { 37, 2 } };
+		for (auto& color : colors)
+		{
+			for (auto& size : sizes)
+			{
+				std::vector<std::uint8_t> image = Constant(size[0], size[1], color);
+				MipChain chain;
+				GenerateMipChain(image.data(), size[0], size[1], size[0] * 4, false, MipFilter::Kaiser, pool, chain);
+				CHECK(IsConstant(chain, color));
+				GenerateMipChain(image.data(), size[0], size[1], size[0] * 4, true, MipFilter::Kaiser, pool, chain);
+				CHECK(IsConstant(chain, color));
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestLayout();
+	TestTopLevelCopied();
+	TestOddBoxWeights();
+	TestSRGBRoundTrip();
+	TestKaiserKeepsConstant();
+	return TestResult("MipGeneratorTest");
+}
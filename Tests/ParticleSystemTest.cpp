@@ -0,0 +1,105 @@
+#include "../Source/ParticleSystem.h"
+#include "../Source/ThreadPool.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const float Step = 1.0f / 60.0f;
+
+	// Particles that coast at their birth velocity and grow from size 0 to
+	// 1, so a particle's size is its age and one of size 1 has died.  Enough
+	// of them for several chunks.
+	ParticleSystem MakeSystem(std::size_t capacity)
+	{
+		ParticleEmitterDesc desc;
+		desc.Rate = 30000.0f;
+		desc.Lifetime = 0.5f;
+		desc.LifetimeJitter = 0.5f;
+		desc.Spread[0] = desc.Spread[1] = desc.Spread[2] = 1.0f;
+		desc.VelocityJitter[0] = desc.VelocityJitter[1] = desc.VelocityJitter[2] = 1.0f;
+		desc.StartSize = 0.0f;
+		desc.EndSize = 1.0f;
+		desc.EndColor[3] = 0.0f;
+
+		ParticleSystem particles;
+		int type = particles.AddType(desc, capacity);
+		for (int e = 0; e < 5; ++e)
+			particles.AddEmitter(type, (float)e, 0.0f, 0.0f);
+		return particles;
+	}
+
+	std::vector<ParticleInstance> Instances(const ParticleSystem& particles, float extrapolate, ThreadPool& pool)
+	{
+		std::vector<ParticleInstance> instances(particles.TotalCount());
+		particles.WriteInstances(instances.data(), extrapolate, pool);
+		return instances;
+	}
+
+	bool Before(const ParticleInstance& a, const ParticleInstance& b)
+	{
+		return std::memcmp(&a, &b, sizeof(a)) < 0;
+	}
+
+	bool Same(const std::vector<ParticleInstance>& a, const std::vector<ParticleInstance>& b)
+	{
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0);
+	}
+
+	// Written a step ahead, the instances show where every particle will
+	// be after the step, and which ones die in it.  The step must keep
+	// exactly those that live, births coming after them.
+	void TestStepKeepsSurvivors()
+	{
+		ThreadPool pool(3);
+		ParticleSystem particles = MakeSystem(40000);
+		for (int frame = 0; frame < 60; ++frame)
+		{
+			std::vector<ParticleInstance> expected = Instances(particles, Step, pool);
+			expected.erase(std::remove_if(expected.begin(), expected.end(),
+				[](const ParticleInstance& p) { return p.Size >= 1.0f; }), expected.end());
+
+			particles.Simulate(Step, pool);
+			std::vector<ParticleInstance> after = Instances(particles, 0.0f, pool);
+			CHECK(after.size() >= expected.size());
+			if (after.size() < expected.size())
+				return;
+
+			// Whatever is past the survivors was born in this step, so is at
+			// most a step old at the shortest lifetime, 0.25 s.
+			std::vector<ParticleInstance> survivors(after.begin(), after.begin() + expected.size());
+			std::sort(expected.begin(), expected.end(), Before);
+			std::sort(survivors.begin(), survivors.end(), Before);
+			CHECK(Same(survivors, expected));
+			for (std::size_t i = expected.size(); i < after.size(); ++i)
+				CHECK(after[i].Size <= Step / 0.25f);
+		}
+
+		// The type filled up: births past the capacity were dropped.
+		CHECK(particles.TotalCount() == particles.Capacity());
+	}
+
+	// Compaction and births do not depend on how the work is split.
+	void TestThreadCountDoesNotMatter()
+	{
+		ThreadPool one(1), four(4);
+		ParticleSystem a = MakeSystem(50000), b = MakeSystem(50000);
+		for (int frame = 0; frame < 40; ++frame)
+		{
+			a.Simulate(Step, one);
+			b.Simulate(Step, four);
+		}
+		CHECK(a.TotalCount() > 16384 * 2);
+		CHECK(Same(Instances(a, 0.5f * Step, one), Instances(b, 0.5f * Step, four)));
+	}
+}
+
+int main()
+{
+	TestStepKeepsSurvivors();
+	TestThreadCountDoesNotMatter();
+	return TestResult("ParticleSystemTest");
+}
@@ -0,0 +1,104 @@
+#include "../Source/RadixSort.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Items with keys from keyOf(i) and their position as the payload.
+	template <typename KeyOf>
+	std::vector<std::uint64_t> MakeItems(std::size_t count, KeyOf keyOf)
+	{
+		std::vector<std::uint64_t> items(count);
+		for (std::size_t i = 0; i < count; ++i)
+			items[i] = RadixSorter::MakeItem(keyOf(i), (std::uint32_t)i);
+		return items;
+	}
+
+	// What Sort must produce: ascending keys, ties in their original order.
+	std::vector<std::uint64_t> Expected(std::vector<std::uint64_t> items)
+	{
+		std::stable_sort(items.begin(), items.end(),
+			[](std::uint64_t a, std::uint64_t b) { return (a >> 32) < (b >> 32); });
+		return items;
+	}
+
+	bool SortsLikeStableSort(RadixSorter& sorter, std::vector<std::uint64_t> items, int keyBits)
+	{
+		std::vector<std::uint64_t> expected = Expected(items);
+		sorter.Sort(items.data(), items.size(), keyBits);
+		return items == expected;
+	}
+
+	void TestOrderAndStability()
+	{
+		RadixSorter sorter;
+		std::mt19937 rng(3);
+
+		// Few distinct keys, so most items tie and only stability orders them.
+		for (int keyBits : { 1, 5, 11, 12, 22, 32 })
+		{
+			const std::uint32_t mask = keyBits == 32 ? 0xFFFFFFFFu : (1u << keyBits) - 1;
+			CHECK(SortsLikeStableSort(sorter, MakeItems(5000, [&](std::size_t) { return (std::uint32_t)rng() & mask; }), keyBits));
+			CHECK(SortsLikeStableSort(sorter, MakeItems(5000, [&](std::size_t) { return (std::uint32_t)rng() & mask & 7; }), keyBits));
+		}
+
+		// Already sorted and reversed input.
+		CHECK(SortsLikeStableSort(sorter, MakeItems(3000, [](std::size_t i) { return (std::uint32_t)i * 1000; }), 22));
+		CHECK(SortsLikeStableSort(sorter, MakeItems(3000, [](std::size_t i) { return (std::uint32_t)(3000 - i) * 1000; }), 22));
+
+		// Nothing to do, and scratch that has to grow after a small sort.
+		std::vector<std::uint64_t> one = MakeItems(1, [](std::size_t) { return 7u; });
+		sorter.Sort(one.data(), 0, 22);
+		sorter.Sort(one.data(), one.size(), 22);
+		CHECK(RadixSorter::Payload(one[0]) == 0);
+		CHECK(SortsLikeStableSort(sorter, MakeItems(20000, [&](std::size_t) { return (std::uint32_t)rng(); }), 32));
+	}
+
+	void TestSkippedDigits()
+	{
+		RadixSorter sorter;
+		std::mt19937 rng(5);
+
+		// Every key equal: every pass is skipped and the items stay put.
+		std::vector<std::uint64_t> items = MakeItems(1000, [](std::size_t) { return 0x2ABCDEu; });
+		std::vector<std::uint64_t> original = items;
+		sorter.Sort(items.data(), items.size(), 22);
+		CHECK(items == original);
+
+		// Skipping the middle of three digits leaves two scatters, and
+		// skipping the low one of two leaves one, so the result ends up in
+		// the scratch and must be copied back.
+		CHECK(SortsLikeStableSort(sorter, MakeItems(4000, [&](std::size_t) { return ((std::uint32_t)rng() & 0xFFC007FFu) | 0x1000u; }), 32));
+		CHECK(SortsLikeStableSort(sorter, MakeItems(4000, [&](std::size_t) { return ((std::uint32_t)rng() & 0x3FF800u) | 0x5u; }), 22));
+
+		// Keys with bits above keyBits are ordered by the bits below only.
+		items = MakeItems(2000, [&](std::size_t) { return (std::uint32_t)rng(); });
+		sorter.Sort(items.data(), items.size(), 11);
+		bool lowBitsSorted = true;
+		for (std::size_t i = 1; i < items.size(); ++i)
+		{
+			std::uint32_t previous = (std::uint32_t)(items[i - 1] >> 32) & 0x7FF, key = (std::uint32_t)(items[i] >> 32) & 0x7FF;
+			if (key < previous || (key == previous && RadixSorter::Payload(items[i]) < RadixSorter::Payload(items[i - 1])))
+				lowBitsSorted = false;
+		}
+		CHECK(lowBitsSorted);
+	}
+
+	void TestBenchmark()
+	{
+		RadixSortBenchResult result = RunRadixSortBenchmark(10000, 22, 3);
+		CHECK(result.Sorted);
+		CHECK(result.Items == 10000 && result.KeyBits == 22);
+	}
+}
+
+int main()
+{
+	TestOrderAndStability();
+	TestSkippedDigits();
+	TestBenchmark();
+	return TestResult("RadixSortTest");
+}
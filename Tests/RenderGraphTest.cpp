@@ -0,0 +1,259 @@
+#include "../Source/RenderGraph.h"
+#include "Check.h"
+
+#include <vector>
+
+namespace
+{
+	RGTransientDesc Target(std::uint64_t sizeInBytes)
+	{
+		RGTransientDesc desc;
+		desc.Width = 256;
+		desc.Height = 256;
+		desc.SizeInBytes = sizeInBytes;
+		return desc;
+	}
+
+	bool Overlap(const RenderGraph& graph, RGResource a, RGResource b)
+	{
+		std::uint64_t aStart = graph.TransientOffset(a), bStart = graph.TransientOffset(b);
+		return aStart < bStart + graph.TransientDesc(b).SizeInBytes && bStart < aStart + graph.TransientDesc(a).SizeInBytes;
+	}
+
+	// Runs the compiled graph the way a command list would see it.  Every
+	// transition must start from the state the resource is really in, and
+	// may only touch a transient while it owns its memory; an aliasing
+	// barrier hands the memory to a new owner.  At the end every resource
+	// has to be back in the state the next frame expects.  The states given
+	// are the imported resources' (transients' entries are ignored).
+	void Validate(const RenderGraph& graph, const std::vector<RGState>& initialStates, const std::vector<RGState>& finalStates)
+	{
+		std::uint32_t count = graph.ResourceCount();
+		std::vector<RGState> state(count);
+		std::vector<bool> owns(count, true);
+		for (RGResource r = 0; r < count; ++r)
+			state[r] = graph.IsTransient(r) ? graph.TransientInitialState(r) : initialStates[r];
+
+		graph.Execute([&](const std::vector<RGBarrier>& barriers)
+		{
+			for (const RGBarrier& barrier : barriers)
+			{
+				RGResource r = barrier.Resource;
+				if (barrier.BarrierType == RGBarrier::Type::Aliasing)
+				{
+					CHECK(graph.IsTransient(r));
+					for (RGResource other = 0; other < count; ++other)
+					{
+						if (other != r && graph.IsTransient(other) && graph.IsUsed(other) && Overlap(graph, r, other))
+							owns[other] = false;
+					}
+					owns[r] = true;
+					continue;
+				}
+
+				if (graph.IsTransient(r))
+					CHECK(owns[r]);
+				CHECK(barrier.Before == state[r]);
+				CHECK(barrier.Before != barrier.After);
+				state[r] = barrier.After;
+			}
+		});
+
+		for (RGResource r = 0; r < count; ++r)
+		{
+			if (!graph.IsUsed(r))
+				continue;
+			RGState expected = graph.IsTransient(r) ? graph.TransientInitialState(r) : finalStates[r];
+			CHECK(state[r] == expected);
+		}
+	}
+
+	void TestCulling()
+	{
+		RenderGraph graph;
+		RGResource backBuffer = graph.ImportResource("back buffer", RGState::Present, RGState::Present);
+		RGResource unused = graph.CreateTransient("unused", Target(1024));
+		graph.MarkOutput(backBuffer);
+
+		std::uint32_t dead = graph.AddPass("dead", nullptr);
+		graph.Write(dead, unused, RGState::RenderTarget);
+
+		std::uint32_t overwritten = graph.AddPass("overwritten", nullptr);
+		graph.Write(overwritten, backBuffer, RGState::RenderTarget);
+
+		std::uint32_t query = graph.AddPass("query", nullptr);
+		graph.SetSideEffects(query);
+
+		std::uint32_t draw = graph.AddPass("draw", nullptr);
+		graph.Write(draw, backBuffer, RGState::RenderTarget);
+
+		graph.Compile();
+		CHECK(graph.IsPassCulled(dead));
+		CHECK(graph.IsPassCulled(overwritten));
+		CHECK(!graph.IsPassCulled(query));
+		CHECK(!graph.IsPassCulled(draw));
+		CHECK(graph.Stats().CulledPasses == 2);
+		CHECK(!graph.IsUsed(unused));
+		CHECK(graph.HeapSize() == 0);
+	}
+
+	void TestTransitions()
+	{
+		RenderGraph graph;
+		RGResource backBuffer = graph.ImportResource("back buffer", RGState::Present, RGState::Present);
+		RGResource depth = graph.ImportResource("depth", RGState::DepthWrite, RGState::DepthWrite);
+		RGResource color = graph.CreateTransient("scene color", Target(1024));
+		graph.MarkOutput(backBuffer);
+
+		std::uint32_t scene = graph.AddPass("scene", nullptr);
+		graph.Write(scene, color, RGState::RenderTarget);
+		graph.ReadWrite(scene, depth, RGState::DepthWrite);
+
+		std::uint32_t resolve = graph.AddPass("resolve", nullptr);
+		graph.Read(resolve, color, RGState::PixelShaderResource);
+		graph.Read(resolve, depth, RGState::PixelShaderResource);
+		graph.Read(resolve, depth, RGState::DepthRead);
+		graph.Write(resolve, backBuffer, RGState::RenderTarget);
+
+		graph.Compile();
+
+		// The transient is created as a render target, so the scene pass
+		// needs no barrier.
+		CHECK(graph.TransientInitialState(color) == RGState::RenderTarget);
+		CHECK(graph.PassBarriers(scene).empty());
+
+		// Reads of one resource combine into one state.
+		const std::vector<RGBarrier>& barriers = graph.PassBarriers(resolve);
+		CHECK(barriers.size() == 3);
+		for (const RGBarrier& barrier : barriers)
+		{
+			if (barrier.Resource == depth)
+				CHECK(barrier.After == (RGState::PixelShaderResource | RGState::DepthRead));
+			if (barrier.Resource == backBuffer)
+				CHECK(barrier.Before == RGState::Present && barrier.After == RGState::RenderTarget);
+		}
+
+		// Everything goes back: the back buffer to present, the depth buffer
+		// to depth write, the transient to its creation state.
+		CHECK(graph.FinalBarriers().size() == 3);
+		CHECK(graph.Stats().BarrierBatches == 2);
+
+		std::vector<RGState> states = { RGState::Present, RGState::DepthWrite, RGState::Common };
+		Validate(graph, states, states);
+	}
+
+	void TestExecuteOrder()
+	{
+		int executed = 0;
+		RenderGraph order;
+		RGResource out = order.ImportResource("out", RGState::Common, RGState::Common);
+		order.MarkOutput(out);
+		std::uint32_t first = order.AddPass("first", [&]() { CHECK(executed == 0); executed = 1; });
+		order.Write(first, out, RGState::CopyDest);
+		std::uint32_t second = order.AddPass("second", [&]() { CHECK(executed == 1); executed = 2; });
+		order.ReadWrite(second, out, RGState::RenderTarget);
+		order.Compile();
+		order.Execute([](const std::vector<RGBarrier>&) {});
+		CHECK(executed == 2);
+	}
+
+	// A chain of transients like a blur: a is read by the pass that writes
+	// b, b by the one that writes c, and so on.  Resources two apart never
+	// live at the same time, so they can share memory.
+	void TestAliasing()
+	{
+		RenderGraph graph;
+		RGResource backBuffer = graph.ImportResource("back buffer", RGState::Present, RGState::Present);
+		graph.MarkOutput(backBuffer);
+
+		const std::uint64_t size = 1 << 20;
+		RGResource chain[4];
+		for (int i = 0; i < 4; ++i)
+			chain[i] = graph.CreateTransient("chain", Target(size));
+
+		std::uint32_t passes[5];
+		passes[0] = graph.AddPass("0", nullptr);
+		graph.Write(passes[0], chain[0], RGState::RenderTarget);
+		for (int i = 1; i < 4; ++i)
+		{
+			passes[i] = graph.AddPass("n", nullptr);
+			graph.Read(passes[i], chain[i - 1], RGState::PixelShaderResource);
+			graph.Write(passes[i], chain[i], RGState::RenderTarget);
+		}
+		passes[4] = graph.AddPass("present", nullptr);
+		graph.Read(passes[4], chain[3], RGState::PixelShaderResource);
+		graph.Write(passes[4], backBuffer, RGState::RenderTarget);
+
+		graph.Compile();
+
+		// Two resources' worth of memory for four.
+		CHECK(graph.Stats().TransientBytes == 4 * size);
+		CHECK(graph.HeapSize() == 2 * size);
+		for (int i = 0; i < 3; ++i)
+			CHECK(!Overlap(graph, chain[i], chain[i + 1]));
+		CHECK(Overlap(graph, chain[0], chain[2]));
+		CHECK(Overlap(graph, chain[1], chain[3]));
+
+		// The third resource takes over the first's memory: the first goes
+		// back to its creation state, then the aliasing barrier names it.
+		const std::vector<RGBarrier>& barriers = graph.PassBarriers(passes[2]);
+		int returned = -1, aliased = -1;
+		for (int i = 0; i < (int)barriers.size(); ++i)
+		{
+			if (barriers[i].BarrierType == RGBarrier::Type::Aliasing)
+			{
+				CHECK(barriers[i].Resource == chain[2]);
+				CHECK(barriers[i].AliasBefore == chain[0]);
+				aliased = i;
+			}
+			else if (barriers[i].Resource == chain[0])
+			{
+				CHECK(barriers[i].After == RGState::RenderTarget);
+				returned = i;
+			}
+		}
+		CHECK(returned >= 0 && aliased > returned);
+
+		// Only the last owners of each range, and the back buffer, get a
+		// final barrier.  The first two were handed back already.
+		for (const RGBarrier& barrier : graph.FinalBarriers())
+			CHECK(barrier.Resource != chain[0] && barrier.Resource != chain[1]);
+
+		std::vector<RGState> states(graph.ResourceCount(), RGState::Common);
+		states[backBuffer] = RGState::Present;
+		Validate(graph, states, states);
+	}
+
+	void TestLayoutHash()
+	{
+		RenderGraph graph;
+		auto build = [&](std::uint64_t size)
+		{
+			graph.Reset();
+			RGResource out = graph.ImportResource("out", RGState::Present, RGState::Present);
+			graph.MarkOutput(out);
+			RGResource t = graph.CreateTransient("t", Target(size));
+			std::uint32_t a = graph.AddPass("a", nullptr);
+			graph.Write(a, t, RGState::RenderTarget);
+			std::uint32_t b = graph.AddPass("b", nullptr);
+			graph.Read(b, t, RGState::PixelShaderResource);
+			graph.Write(b, out, RGState::RenderTarget);
+			graph.Compile();
+			return graph.TransientLayoutHash();
+		};
+
+		std::uint64_t first = build(65536);
+		CHECK(build(65536) == first);
+		CHECK(build(131072) != first);
+	}
+}
+
+int main()
+{
+	TestCulling();
+	TestTransitions();
+	TestExecuteOrder();
+	TestAliasing();
+	TestLayoutHash();
+	return TestResult("RenderGraphTest");
+}
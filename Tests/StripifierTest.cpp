@@ -0,0 +1,150 @@
+#include "../Source/Stripifier.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+	const std::uint32_t Cut16 = 0xFFFF;
+	const std::uint32_t Cut32 = 0xFFFFFFFF;
+
+	typedef std::array<std::uint32_t, 3> Triangle;
+
+	// The triangles of a list, each turned to its least rotation (which
+	// keeps its winding, and is unique even for degenerate triangles),
+	// sorted so two lists compare as sets.
+	std::vector<Triangle> Canonical(const std::vector<std::uint32_t>& list)
+	{
+		std::vector<Triangle> triangles;
+		for (std::size_t i = 0; i + 2 < list.size(); i += 3)
+		{
+			Triangle t = { list[i], list[i + 1], list[i + 2] };
+			Triangle least = t;
+			for (int k = 1; k < 3; ++k)
+			{
+				std::rotate(t.begin(), t.begin() + 1, t.end());
+				least = (std::min)(least, t);
+			}
+			triangles.push_back(least);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	// A width x height grid of quads, two triangles each, wound
+	// counterclockwise, with its vertex indices offset by base.
+	std::vector<std::uint32_t> Grid(std::uint32_t width, std::uint32_t height, std::uint32_t base)
+	{
+		std::vector<std::uint32_t> list;
+		for (std::uint32_t y = 0; y < height; ++y)
+		{
+			for (std::uint32_t x = 0; x < width; ++x)
+			{
+				std::uint32_t v = base + y * (width + 1) + x;
+				std::uint32_t right = v + 1;
+				std::uint32_t up = v + width + 1;
+				list.insert(list.end(), { v, right, up + 1, v, up + 1, up });
+			}
+		}
+		return list;
+	}
+
+	// Strips and back again give the same triangles, each wound the same
+	// way, with a triangle for every three indices of a strip.
+	bool RoundTrips(const std::vector<std::uint32_t>& list, std::uint32_t cutIndex, std::vector<std::uint32_t>* stripsOut = nullptr)
+	{
+		std::vector<std::uint32_t> strips = StripifyTriangles(list.data(), list.size(), cutIndex);
+		std::vector<std::uint32_t> back = UnstripTriangles(strips.data(), strips.size(), cutIndex);
+		if (stripsOut != nullptr)
+			*stripsOut = strips;
+		return back.size() == list.size() && Canonical(back) == Canonical(list);
+	}
+
+	void TestRoundTrip()
+	{
+		// A grid shares nearly every edge, so it strips well.
+		std::vector<std::uint32_t> grid = Grid(16, 16, 0);
+		std::vector<std::uint32_t> strips;
+		CHECK(RoundTrips(grid, Cut16, &strips));
+		CHECK(strips.size() < grid.size() * 2 / 3);
+
+		// The same grid turned inside out must not borrow the other
+		// winding's edges.
+		std::vector<std::uint32_t> flipped = grid;
+		for (std::size_t i = 0; i < flipped.size(); i += 3)
+			std::swap(flipped[i + 1], flipped[i + 2]);
+		CHECK(RoundTrips(flipped, Cut16));
+
+		// Both at once, so every edge is shared by triangles of both
+		// windings, plus repeated triangles.
+		std::vector<std::uint32_t> both = grid;
+		both.insert(both.end(), flipped.begin(), flipped.end());
+		both.insert(both.end(), grid.begin(), grid.begin() + 30);
+		CHECK(RoundTrips(both, Cut16));
+
+		// A random soup over few vertices, with degenerate triangles.
+		std::vector<std::uint32_t> soup;
+		std::uint32_t state = 99;
+		for (int i = 0; i < 3000; ++i)
+		{
+			state = state * 1664525u + 1013904223u;
+			soup.push_back((state >> 8) % 40);
+		}
+		CHECK(RoundTrips(soup, Cut16));
+
+		// One triangle, and none.
+		CHECK(RoundTrips({ 4, 5, 6 }, Cut16, &strips));
+		CHECK(strips == std::vector<std::uint32_t>({ 4, 5, 6 }));
+		CHECK(RoundTrips({}, Cut16, &strips));
+		CHECK(strips.empty());
+	}
+
+	// An index equal to the cut value would read as a cut, so the list is
+	// refused, as is a count that is not whole triangles.
+	void TestRejects()
+	{
+		std::vector<std::uint32_t> list = Grid(4, 4, 0);
+		list[7] = Cut16;
+		CHECK(StripifyTriangles(list.data(), list.size(), Cut16).empty());
+
+		list = Grid(4, 4, 0);
+		list.back() = Cut32;
+		CHECK(StripifyTriangles(list.data(), list.size(), Cut32).empty());
+
+		list = Grid(4, 4, 0);
+		CHECK(StripifyTriangles(list.data(), list.size() - 1, Cut16).empty());
+		CHECK(!StripifyTriangles(list.data(), list.size(), Cut16).empty());
+	}
+
+	// With 32-bit indices, 0xFFFF is an ordinary vertex and only
+	// 0xFFFFFFFF cuts.
+	void TestCut32()
+	{
+		std::vector<std::uint32_t> grid = Grid(20, 20, 0xFFFF - 200);
+		CHECK(std::find(grid.begin(), grid.end(), Cut16) != grid.end());
+
+		std::vector<std::uint32_t> strips;
+		CHECK(RoundTrips(grid, Cut32, &strips));
+		CHECK(std::count(strips.begin(), strips.end(), Cut32) > 0);
+		CHECK(StripifyTriangles(grid.data(), grid.size(), Cut16).empty());
+
+		// Indices far past 16 bits, in two pieces that share no vertices.
+		std::vector<std::uint32_t> far = Grid(8, 3, 0x12345678);
+		std::vector<std::uint32_t> other = Grid(3, 8, 0x80000000);
+		far.insert(far.end(), other.begin(), other.end());
+		CHECK(RoundTrips(far, Cut32, &strips));
+		for (std::uint32_t index : strips)
+			CHECK(index == Cut32 || index >= 0x12345678);
+	}
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestRejects();
+	TestCut32();
+	return TestResult("StripifierTest");
+}
@@ -0,0 +1,198 @@
+#include "../Source/TextureAtlas.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Random
+	{
+		std::uint32_t State;
+
+		std::uint32_t Next(std::uint32_t range)
+		{
+			State = State * 1664525u + 1013904223u;
+			return (State >> 8) % range;
+		}
+	};
+
+	// Texel (x, y) of image i, never transparent black, so every texel of a
+	// page says which image it came from and where.
+	std::uint32_t Pattern(std::uint32_t image, std::uint32_t x, std::uint32_t y)
+	{
+		return 0xFF000000u | ((image & 0xFF) << 16) | ((x & 0xFF) << 8) | (y & 0xFF);
+	}
+
+	std::uint32_t PageTexel(const std::vector<std::uint8_t>& page, std::uint32_t pageSize, std::uint32_t x, std::uint32_t y)
+	{
+		const std::uint8_t* texel = &page[((std::size_t)y * pageSize + x) * 4];
+		return (std::uint32_t)texel[0] | ((std::uint32_t)texel[1] << 8) | ((std::uint32_t)texel[2] << 16) | ((std::uint32_t)texel[3] << 24);
+	}
+
+	struct Rect
+	{
+		std::uint32_t X0, Y0, X1, Y1;
+
+		bool Overlaps(const Rect& other)const
+		{
+			return X0 < other.X1 && other.X0 < X1 && Y0 < other.Y1 && other.Y0 < Y1;
+		}
+	};
+
+	// Packs a few hundred images of random sizes, some thin, and checks
+	// what the builder promises for mips levels of padding texels each.
+	void CheckAtlas(std::uint32_t pageSize, std::uint32_t padding, std::uint32_t mipLevels, std::uint32_t seed)
+	{
+		const std::uint32_t footprint = 1u << (mipLevels - 1);
+		const std::uint32_t gutter = padding * footprint;
+		const std::uint32_t alignment = (std::max)(4u, footprint);
+
+		TextureAtlasBuilder builder(pageSize, padding, mipLevels);
+		Random random{ seed };
+		std::vector<std::uint32_t> widths;
+		std::vector<std::uint32_t> heights;
+		for (std::uint32_t i = 0; i < 300; ++i)
+		{
+			std::uint32_t width = 1 + random.Next(i % 5 == 0 ? 3 : 90);
+			std::uint32_t height = 1 + random.Next(i % 7 == 0 ? 3 : 90);
+
+			// Rows padded past the image, which Add must skip.
+			std::size_t rowPitch = (std::size_t)width * 4 + 12;
+			std::vector<std::uint8_t> rgba(rowPitch * height, 0x5A);
+			for (std::uint32_t y = 0; y < height; ++y)
+			{
+				for (std::uint32_t x = 0; x < width; ++x)
+				{
+					std::uint32_t value = Pattern(i, x, y);
+					for (int c = 0; c < 4; ++c)
+						rgba[y * rowPitch + x * 4 + c] = (std::uint8_t)(value >> (8 * c));
+				}
+			}
+			CHECK(builder.Add(rgba.data(), width, height, rowPitch) == i);
+			widths.push_back(width);
+			heights.push_back(height);
+		}
+
+		std::string error;
+		CHECK(builder.Pack(&error));
+		CHECK(error.empty());
+		CHECK(builder.PageCount() > 0);
+		CHECK(builder.Utilization() > 0.0f && builder.Utilization() <= 1.0f);
+
+		// Each image's cell: the image, its gutter, and whatever rounding up
+		// to the alignment adds after it.
+		std::vector<Rect> cells;
+		for (std::uint32_t i = 0; i < widths.size(); ++i)
+		{
+			const AtlasRegion& region = builder.Region(i);
+			CHECK(region.Page < builder.PageCount());
+			CHECK(region.Width == widths[i] && region.Height == heights[i]);
+			CHECK(region.X >= gutter && region.Y >= gutter);
+			CHECK(region.ScaleU * pageSize == region.Width && region.ScaleV * pageSize == region.Height);
+			CHECK(region.OffsetU * pageSize == region.X && region.OffsetV * pageSize == region.Y);
+
+			Rect cell;
+			cell.X0 = region.X - gutter;
+			cell.Y0 = region.Y - gutter;
+			cell.X1 = cell.X0 + (widths[i] + 2 * gutter + alignment - 1) / alignment * alignment;
+			cell.Y1 = cell.Y0 + (heights[i] + 2 * gutter + alignment - 1) / alignment * alignment;
+			CHECK(cell.X0 % alignment == 0 && cell.Y0 % alignment == 0);
+			CHECK(cell.X1 <= pageSize && cell.Y1 <= pageSize);
+			cells.push_back(cell);
+		}
+
+		for (std::uint32_t i = 0; i < cells.size(); ++i)
+		{
+			for (std::uint32_t j = i + 1; j < cells.size(); ++j)
+			{
+				if (builder.Region(i).Page == builder.Region(j).Page)
+					CHECK(!cells[i].Overlaps(cells[j]));
+			}
+		}
+
+		std::vector<std::vector<std::uint8_t>> pages;
+		for (std::uint32_t page = 0; page < builder.PageCount(); ++page)
+		{
+			pages.push_back(builder.ComposePage(page));
+			CHECK(pages.back().size() == (std::size_t)pageSize * pageSize * 4);
+		}
+
+		for (std::uint32_t i = 0; i < widths.size(); ++i)
+		{
+			const AtlasRegion& region = builder.Region(i);
+			const std::vector<std::uint8_t>& page = pages[region.Page];
+
+			// The image, and a gutter repeating its nearest edge texel.
+			for (std::uint32_t y = region.Y - gutter; y < region.Y + region.Height + gutter; ++y)
+			{
+				for (std::uint32_t x = region.X - gutter; x < region.X + region.Width + gutter; ++x)
+				{
+					std::uint32_t sx = (std::uint32_t)(std::min)((std::max)((int)x - (int)region.X, 0), (int)region.Width - 1);
+					std::uint32_t sy = (std::uint32_t)(std::min)((std::max)((int)y - (int)region.Y, 0), (int)region.Height - 1);
+					if (PageTexel(page, pageSize, x, y) != Pattern(i, sx, sy))
+					{
+						CHECK(!"image or gutter texel wrong");
+						return;
+					}
+				}
+			}
+
+			// At every level a box filter keeps, the texels covering the
+			// image and padding more around it on each side average only
+			// texels of this image (its own or repeated edges), never
+			// another image's or empty space.
+			for (std::uint32_t level = 0; level < mipLevels; ++level)
+			{
+				std::uint32_t size = 1u << level;
+				std::uint32_t x0 = (region.X / size - padding) * size;
+				std::uint32_t y0 = (region.Y / size - padding) * size;
+				std::uint32_t x1 = ((region.X + region.Width + size - 1) / size + padding) * size;
+				std::uint32_t y1 = ((region.Y + region.Height + size - 1) / size + padding) * size;
+				CHECK(x0 >= cells[i].X0 && y0 >= cells[i].Y0 && x1 <= cells[i].X1 && y1 <= cells[i].Y1);
+
+				bool own = true;
+				for (std::uint32_t y = y0; y < y1 && own; ++y)
+				{
+					for (std::uint32_t x = x0; x < x1 && own; ++x)
+					{
+						std::uint32_t texel = PageTexel(page, pageSize, x, y);
+						own = (texel >> 24) == 0xFF && ((texel >> 16) & 0xFF) == (i & 0xFF);
+					}
+				}
+				CHECK(own);
+			}
+		}
+	}
+
+	void TestInvariants()
+	{
+		CheckAtlas(512, 1, 1, 1);
+		CheckAtlas(512, 1, 4, 2);
+		CheckAtlas(1024, 2, 5, 3);
+		CheckAtlas(256, 1, 3, 4);
+	}
+
+	// An image that cannot fit even on an empty page is refused by name.
+	void TestTooLarge()
+	{
+		TextureAtlasBuilder builder(64, 1, 3);
+		std::vector<std::uint8_t> small(8 * 8 * 4, 0xFF);
+		std::vector<std::uint8_t> large(60 * 10 * 4, 0xFF);
+		builder.Add(small.data(), 8, 8, 8 * 4);
+		builder.Add(large.data(), 60, 10, 60 * 4);
+
+		std::string error;
+		CHECK(!builder.Pack(&error));
+		CHECK(error.find("image 1") != std::string::npos);
+	}
+}
+
+int main()
+{
+	TestInvariants();
+	TestTooLarge();
+	return TestResult("TextureAtlasTest");
+}
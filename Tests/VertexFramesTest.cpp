@@ -0,0 +1,283 @@
+#include "../Source/VertexFrames.h"
+#include "../Source/ThreadPool.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+	// The worst error the header promises.
+	const double MaxAngleDegrees = 0.004;
+
+	// Angle between two directions, in double so it resolves thousandths of
+	// a degree.
+	double AngleDegrees(const float* a, const float* b)
+	{
+		double cx = (double)a[1] * b[2] - (double)a[2] * b[1];
+		double cy = (double)a[2] * b[0] - (double)a[0] * b[2];
+		double cz = (double)a[0] * b[1] - (double)a[1] * b[0];
+		double dot = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+		return std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot) * 180.0 / 3.14159265358979;
+	}
+
+	double RoundTripError(float x, float y, float z)
+	{
+		float in[3] = { x, y, z };
+		float out[3];
+		UnpackUnitVector(PackUnitVector(x, y, z), out[0], out[1], out[2]);
+		CHECK_NEAR(out[0] * out[0] + out[1] * out[1] + out[2] * out[2], 1.0, 1e-5);
+		return AngleDegrees(in, out);
+	}
+
+	double Dot(const float* a, const float* b)
+	{
+		return (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+	}
+
+	// Evenly spread directions over the whole sphere, then the spots the
+	// fold makes hard: the poles, the equator where the halves meet, the
+	// lower half's folded corners, and every sign of zero.
+	void TestOctahedralError()
+	{
+		const int count = 200000;
+		const double golden = 3.14159265358979 * (3.0 - std::sqrt(5.0));
+		double worst = 0.0;
+		for (int i = 0; i < count; ++i)
+		{
+			double z = 1.0 - 2.0 * (i + 0.5) / count;
+			double r = std::sqrt(1.0 - z * z);
+			worst = (std::max)(worst, RoundTripError((float)(r * std::cos(golden * i)), (float)(r * std::sin(golden * i)), (float)z));
+		}
+		CHECK(worst < MaxAngleDegrees);
+
+		for (int i = 0; i < 3600; ++i)
+		{
+			float a = i * 3.14159265f / 1800.0f;
+			for (float z : { 0.0f, -0.0f, 1e-4f, -1e-4f, -0.999f, 0.999f })
+			{
+				float r = std::sqrt(1.0f - z * z);
+				CHECK(RoundTripError(r * std::cos(a), r * std::sin(a), z) < MaxAngleDegrees);
+			}
+		}
+
+		// Zeros of either sign: the axes come back exact, and a vector in a
+		// coordinate plane stays in it, on whichever side of the fold.
+		for (int signs = 0; signs < 8; ++signs)
+		{
+			float zero[2] = { signs & 1 ? -0.0f : 0.0f, signs & 2 ? -0.0f : 0.0f };
+			float pole = signs & 4 ? -1.0f : 1.0f;
+			float out[3];
+			UnpackUnitVector(PackUnitVector(zero[0], zero[1], pole), out[0], out[1], out[2]);
+			CHECK(out[0] == 0.0f && out[1] == 0.0f && out[2] == pole);
+			UnpackUnitVector(PackUnitVector(pole, zero[0], zero[1]), out[0], out[1], out[2]);
+			CHECK(out[0] == pole && out[1] == 0.0f && out[2] == 0.0f);
+			UnpackUnitVector(PackUnitVector(zero[1], pole, zero[0]), out[0], out[1], out[2]);
+			CHECK(out[0] == 0.0f && out[1] == pole && out[2] == 0.0f);
+
+			UnpackUnitVector(PackUnitVector(0.6f * pole, zero[0], -0.8f), out[0], out[1], out[2]);
+			CHECK(out[1] == 0.0f);
+			CHECK_NEAR(out[0], 0.6f * pole, 1e-4);
+			CHECK_NEAR(out[2], -0.8f, 1e-4);
+		}
+
+		// -32768 reads as -1, as the hardware reads it.
+		float out[3];
+		UnpackUnitVector(0x8000u | (0x0000u << 16), out[0], out[1], out[2]);
+		CHECK(out[0] == -1.0f && out[1] == 0.0f && out[2] == 0.0f);
+		UnpackUnitVector(0x8001u | (0x0000u << 16), out[0], out[1], out[2]);
+		CHECK(out[0] == -1.0f && out[1] == 0.0f && out[2] == 0.0f);
+
+		// No direction at all packs to something that still unpacks.
+		UnpackUnitVector(PackUnitVector(0.0f, 0.0f, 0.0f), out[0], out[1], out[2]);
+		CHECK_NEAR(out[0] * out[0] + out[1] * out[1] + out[2] * out[2], 1.0, 1e-5);
+	}
+
+	// Positions padded to 16 bytes, to exercise the stride.
+	struct Vertex
+	{
+		float Position[3];
+		float Pad;
+	};
+
+	// The regular octahedron: six vertices shared by eight faces, wound
+	// clockwise seen from outside, so each vertex's faces average out to its
+	// own direction.
+	void Octahedron(std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices)
+	{
+		vertices = { { { 1, 0, 0 }, 0 }, { { -1, 0, 0 }, 0 }, { { 0, 1, 0 }, 0 }, { { 0, -1, 0 }, 0 }, { { 0, 0, 1 }, 0 }, { { 0, 0, -1 }, 0 } };
+		indices.clear();
+		for (std::uint32_t x : { 0u, 1u })
+		{
+			for (std::uint32_t y : { 2u, 3u })
+			{
+				for (std::uint32_t z : { 4u, 5u })
+				{
+					// Flip the order where the face's normal would point in.
+					const float* a = vertices[x].Position;
+					const float* b = vertices[y].Position;
+					const float* c = vertices[z].Position;
+					float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+					float e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+					float n[3] = { e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+					float outward[3] = { a[0] + b[0] + c[0], a[1] + b[1] + c[1], a[2] + b[2] + c[2] };
+					if (Dot(n, outward) > 0.0)
+						indices.insert(indices.end(), { x, y, z });
+					else
+						indices.insert(indices.end(), { x, z, y });
+				}
+			}
+		}
+	}
+
+	// Given frames survive (the normal made unit, the tangent made
+	// orthogonal to it); missing, zero, scaled or degenerate ones are
+	// generated, and the stats count which was which.
+	void TestKeptAndGenerated()
+	{
+		ThreadPool pool(2);
+		std::vector<Vertex> vertices;
+		std::vector<std::uint32_t> indices;
+		Octahedron(vertices, indices);
+
+		const float s = 1.0f / std::sqrt(2.0f);
+		float normals[6][3] = {
+			{ 0, 0, 0 },        // generated
+			{ 0, 2, 0 },        // not unit length: generated
+			{ 0, 0, 1.0f },     // kept
+			{ s, 0, s },        // kept
+			{ 0, 0, 0 },        // generated
+			{ 0, 0.99f, 0 },    // near enough unit: kept
+		};
+		float tangents[6][3] = {
+			{ 0, 1, 0 },        // kept, already orthogonal to the generated (1, 0, 0)
+			{ 0, 0, 1 },        // kept: orthogonal to the generated (-1, 0, 0)
+			{ 0.001f, 0, 1 },   // a tenth of a degree off the normal: generated
+			{ 1, 0, 0 },        // kept, made orthogonal
+			{ 0, 0, 0 },        // generated
+			{ 0.5f, 0, 0 },     // not unit length: generated
+		};
+
+		VertexFrameStats stats = BuildVertexFrames(&vertices[0].Position[0], sizeof(Vertex), vertices.size(),
+			indices.data(), indices.size(), &normals[0][0], &tangents[0][0], pool);
+		CHECK(stats.KeptNormals == 3 && stats.GeneratedNormals == 3);
+		CHECK(stats.KeptTangents == 3 && stats.GeneratedTangents == 3);
+
+		// Generated normals point out of the octahedron at their vertex.
+		for (int v : { 0, 1, 4 })
+			CHECK(AngleDegrees(normals[v], vertices[v].Position) < 1e-3);
+
+		// Kept ones are the given direction.
+		const float given[3][3] = { { 0, 0, 1 }, { s, 0, s }, { 0, 1, 0 } };
+		CHECK(AngleDegrees(normals[2], given[0]) < 1e-3);
+		CHECK(AngleDegrees(normals[3], given[1]) < 1e-3);
+		CHECK(AngleDegrees(normals[5], given[2]) < 1e-3);
+
+		// The kept oblique tangent loses only its part along the normal.
+		const float expected[3] = { s, 0, -s };
+		CHECK(AngleDegrees(tangents[3], expected) < 1e-3);
+
+		for (int v = 0; v < 6; ++v)
+		{
+			CHECK_NEAR(Dot(normals[v], normals[v]), 1.0, 1e-5);
+			CHECK_NEAR(Dot(tangents[v], tangents[v]), 1.0, 1e-5);
+			CHECK_NEAR(Dot(normals[v], tangents[v]), 0.0, 1e-5);
+		}
+
+		// A vertex no triangle uses, and triangles that reach past the
+		// vertices, still get a frame and count as generated.
+		std::vector<Vertex> lone = { { { 0, 0, 0 }, 0 } };
+		std::vector<std::uint32_t> past = { 0, 1, 2 };
+		float n[3] = {};
+		float t[3] = {};
+		stats = BuildVertexFrames(&lone[0].Position[0], sizeof(Vertex), 1, past.data(), past.size(), n, t, pool);
+		CHECK(stats.GeneratedNormals == 1 && stats.GeneratedTangents == 1);
+		CHECK_NEAR(Dot(n, n), 1.0, 1e-5);
+		CHECK_NEAR(Dot(n, t), 0.0, 1e-5);
+	}
+
+	// A bumpy grid big enough for several jobs: every tangent comes out
+	// unit length and orthogonal to its normal, whatever came in, and the
+	// result does not depend on the thread count.
+	void TestTangentsOrthogonal()
+	{
+		const std::uint32_t side = 120;
+		std::vector<Vertex> vertices;
+		for (std::uint32_t z = 0; z <= side; ++z)
+		{
+			for (std::uint32_t x = 0; x <= side; ++x)
+				vertices.push_back({ { (float)x, std::sin(x * 0.3f) * std::cos(z * 0.2f) * 3.0f, (float)z }, 0.0f });
+		}
+		std::vector<std::uint32_t> indices;
+		for (std::uint32_t z = 0; z < side; ++z)
+		{
+			for (std::uint32_t x = 0; x < side; ++x)
+			{
+				std::uint32_t v = z * (side + 1) + x;
+				std::uint32_t up = v + side + 1;
+				indices.insert(indices.end(), { v, up, up + 1, v, up + 1, v + 1 });
+			}
+		}
+
+		// A mix of missing, unit and skewed tangents, some nearly along the
+		// normal where the surface is flat or tilted that way.
+		std::vector<float> tangentsIn(vertices.size() * 3);
+		std::uint32_t state = 5;
+		for (std::size_t i = 0; i < vertices.size(); ++i)
+		{
+			state = state * 1664525u + 1013904223u;
+			float* t = &tangentsIn[i * 3];
+			switch (state >> 29)
+			{
+			case 0: t[0] = 1.0f; break;
+			case 1: t[1] = 1.0f; break;
+			case 2: t[0] = 0.6f; t[1] = 0.8f; break;
+			case 3: t[2] = 1.0f; break;
+			case 4: t[0] = 0.3f; break;
+			default: break;
+			}
+		}
+
+		ThreadPool one(1);
+		ThreadPool four(4);
+		std::vector<float> normals[2];
+		std::vector<float> tangents[2];
+		VertexFrameStats stats[2];
+		for (int run = 0; run < 2; ++run)
+		{
+			normals[run].assign(vertices.size() * 3, 0.0f);
+			tangents[run] = tangentsIn;
+			stats[run] = BuildVertexFrames(&vertices[0].Position[0], sizeof(Vertex), vertices.size(), indices.data(),
+				indices.size(), normals[run].data(), tangents[run].data(), run == 0 ? one : four);
+		}
+
+		CHECK(stats[0].GeneratedNormals == vertices.size());
+		CHECK(stats[0].KeptTangents > 0 && stats[0].GeneratedTangents > 0);
+		CHECK(stats[0].KeptTangents + stats[0].GeneratedTangents == vertices.size());
+		CHECK(stats[0].KeptTangents == stats[1].KeptTangents);
+		CHECK(normals[0] == normals[1]);
+		CHECK(tangents[0] == tangents[1]);
+
+		for (std::size_t v = 0; v < vertices.size(); ++v)
+		{
+			const float* n = &normals[0][v * 3];
+			const float* t = &tangents[0][v * 3];
+			CHECK_NEAR(Dot(n, n), 1.0, 1e-5);
+			CHECK_NEAR(Dot(t, t), 1.0, 1e-5);
+			CHECK_NEAR(Dot(n, t), 0.0, 1e-5);
+
+			// The surface faces up.
+			CHECK(n[1] > 0.0f);
+		}
+	}
+}
+
+int main()
+{
+	TestOctahedralError();
+	TestKeptAndGenerated();
+	TestTangentsOrthogonal();
+	return TestResult("VertexFramesTest");
+}